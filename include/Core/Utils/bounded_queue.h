@@ -0,0 +1,57 @@
+#pragma once
+
+namespace Utils::Jobs {
+
+	// fixed capacity mpmc queue, push blocks while full and pop blocks while empty.
+	// used to hand work from the job pool back to the render thread without unbounded memory growth
+	template<typename T>
+	class BoundedQueue {
+
+	public:
+
+		explicit BoundedQueue(size_t capacity) : _capacity(capacity > 0 ? capacity : 1) {}
+
+		void push(T item) {
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_notFull.wait(lock, [this]() { return _items.size() < _capacity; });
+				_items.push_back(std::move(item));
+			}
+			_notEmpty.notify_one();
+		}
+
+		T pop() {
+
+			T item;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_notEmpty.wait(lock, [this]() { return !_items.empty(); });
+				item = std::move(_items.front());
+				_items.pop_front();
+			}
+			_notFull.notify_one();
+			return item;
+		}
+
+		bool tryPop(T& out) {
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_items.empty()) return false;
+				out = std::move(_items.front());
+				_items.pop_front();
+			}
+			_notFull.notify_one();
+			return true;
+		}
+
+	private:
+
+		size_t _capacity;
+		std::deque<T> _items;
+		std::mutex _mutex;
+		std::condition_variable _notFull;
+		std::condition_variable _notEmpty;
+	};
+}
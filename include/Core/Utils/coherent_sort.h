@@ -0,0 +1,44 @@
+#pragma once
+
+namespace Utils::Sort {
+
+	struct KeyIndex {
+
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// lsd radix sort on 8 bit digits, stable. digits that are the same in every key are skipped, so packed keys only pay
+	// for the fields that actually vary this frame. scratch just has to outlive the call, it's resized as needed
+	void radixSort(std::vector<KeyIndex>& items, std::vector<KeyIndex>& scratch);
+
+	// a list that gets re-sorted every frame by keys that barely move between frames. it starts from last frame's order:
+	// with a still camera that's already sorted and one compare pass is the whole cost, a handful of neighbours swapping
+	// is fixed by an insertion sort with a move budget, anything bigger goes to radixSort
+	class CoherentSort {
+
+	public:
+
+		enum class Method : uint8_t {
+
+			Unchanged,
+			Insertion,
+			Radix
+		};
+
+		// keys[i] belongs to item i, items keep their index from frame to frame and new ones are appended.
+		// returns the item indices in key order
+		const std::vector<uint32_t>& sort(const std::vector<uint64_t>& keys);
+		const std::vector<uint32_t>& order() const { return _order; }
+		Method lastMethod() const { return _method; }
+
+	private:
+
+		bool insertionSort(size_t moveBudget);
+
+		std::vector<uint32_t> _order;
+		std::vector<KeyIndex> _items;
+		std::vector<KeyIndex> _scratch;
+		Method _method = Method::Radix;
+	};
+}
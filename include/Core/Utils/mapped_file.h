@@ -0,0 +1,38 @@
+#pragma once
+
+namespace Utils::File {
+
+	// read only memory mapping of a whole file, unmapped when this goes out of scope
+	class MappedFile {
+
+	public:
+
+		MappedFile() = default;
+		explicit MappedFile(const std::filesystem::path& path) { open(path); }
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool open(const std::filesystem::path& path);
+		void close();
+
+		bool isOpen() const { return _data != nullptr; }
+		const uint8_t* data() const { return _data; }
+		size_t size() const { return _size; }
+
+	private:
+
+		const uint8_t* _data = nullptr;
+		size_t _size = 0;
+
+#if defined(_WIN32)
+		void* _file = nullptr;
+		void* _mapping = nullptr;
+#else
+		int _fd = -1;
+#endif
+	};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+namespace Utils::Jobs {
+
+	// fixed size worker pool shared by the loaders (mesh decode, image decode, etc).
+	// the calling thread always helps out in parallelFor so nested calls from a worker can't deadlock.
+	class ThreadPool {
+
+	public:
+
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// runs fn(i) for every i in [0, count) and blocks until all of them are done
+		void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+		// fire a single job, result comes back through the future
+		template<typename F>
+		auto submit(F&& fn) -> std::future<std::invoke_result_t<F>> {
+
+			using Result = std::invoke_result_t<F>;
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+			std::future<Result> result = task->get_future();
+			enqueue([task]() { (*task)(); });
+			return result;
+		}
+
+		// workers + the calling thread
+		uint32_t concurrency() const { return static_cast<uint32_t>(_workers.size()) + 1; }
+
+	private:
+
+		void enqueue(std::function<void()> job);
+		void workerLoop();
+
+		std::vector<std::thread> _workers;
+		std::deque<std::function<void()>> _jobs;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _stopping = false;
+	};
+
+	inline ThreadPool& get() {
+
+		static ThreadPool pool;
+		return pool;
+	}
+}
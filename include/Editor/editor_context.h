@@ -5,6 +5,22 @@ struct EditorContext {
 	int winWidth, winHeight;
 	float fps;
 
+	// cluster culling counters for the last frame
+	uint32_t clustersTested = 0;
+	uint32_t clustersCulled = 0;
+	uint32_t trianglesSubmitted = 0;
+
+	// state changes actually issued vs ones skipped because they were already bound, last frame
+	// (vk: the scene recorder, gl: GLState)
+	uint32_t bindsIssued = 0;
+	uint32_t bindsSkipped = 0;
+	float recordMs = 0.0f; // cpu time spent sorting + recording / submitting the scene
+
+	// texture streaming, summed over every streamed texture
+	size_t textureResidentBytes = 0;
+	size_t textureRequestedBytes = 0;
+	size_t textureBudgetBytes = 0;
+
 	static EditorContext& Get() {
 
 		static EditorContext instance;
@@ -0,0 +1,20 @@
+#pragma once
+
+// fastgltf helpers both loaders share: getting at the raw bytes behind buffers and images, undoing
+// EXT_meshopt_compression right after parsing so everything downstream reads plain buffer views, and reading
+// EXT_mesh_gpu_instancing transforms
+namespace GltfUtils {
+
+	// whole bytes of a buffer, uri buffers get read into storage. a meshopt fallback buffer has nothing behind it
+	bool bufferBytes(const fastgltf::Buffer& buffer, std::vector<uint8_t>& storage, const uint8_t*& bytes);
+	// the encoded file behind a gltf image, uri images get read into storage
+	bool imageBytes(const fastgltf::Asset& asset, const fastgltf::Image& image, std::vector<uint8_t>& storage, const uint8_t*& bytes, size_t& size);
+
+	// every compressed view gets decoded on the job pool into a buffer of its own and the view is pointed at it,
+	// so the accessor code never knows the file was compressed
+	void decompressMeshopt(fastgltf::Asset& gltf);
+
+	// EXT_mesh_gpu_instancing: one trs per instance, any of the three can be missing. returned matrices are world * trs,
+	// empty when the node isn't instanced
+	std::vector<glm::mat4> loadInstanceTransforms(const fastgltf::Asset& gltf, fastgltf::Node& node, const glm::mat4& world);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Renderer/Scene/meshlet.h"
+
+// load time lod chain (quadric edge collapse) + per frame lod pick from projected bounding sphere size.
+// lower levels are appended to the mesh's own index buffer and reuse its vertices, so a lod is just another index range
+namespace MeshUtils {
+
+	struct LodSettings {
+
+		uint32_t maxLevels = 4; // including the full resolution one
+		float reduction = 0.5f; // index count target per level, as a fraction of the level above
+		// max simplification error per level (level 1 first) relative to the surface radius, last one repeats
+		std::vector<float> errorTargets = { 0.01f, 0.02f, 0.05f };
+		// how much normal/uv differences count next to geometric error, normals and uvs share one scale
+		float attributeWeight = 0.05f;
+		uint32_t minTriangles = 32; // stop once a level gets this small
+	};
+
+	// written to the scene cache as-is
+	struct LodLevel {
+
+		uint32_t indexStart;   // absolute, same space as the surface's startIndex
+		uint32_t indexCount;
+		uint32_t firstMeshlet; // into SurfaceDetail::meshlets
+		uint32_t meshletCount;
+		float error;           // accumulated, relative to the surface radius. 0 for level 0
+	};
+
+	// everything the per frame stage needs for one surface, shared by every object drawn from it
+	struct SurfaceDetail {
+
+		glm::vec3 center = glm::vec3(0.0f); // object space bounding sphere of level 0
+		float radius = 0.0f;
+		float uvDensity = 0.0f;             // sqrt(uv area / object space area) over level 0, drives texture mip streaming
+		std::vector<LodLevel> lods;         // lods[0] is the surface itself
+		std::vector<Meshlet> meshlets;      // every level's clusters back to back
+	};
+
+	// garland-heckbert quadrics, half edge collapses onto existing vertices. uv seams and open borders are locked.
+	// returns the new index list, *resultError gets the largest collapse error relative to the input's radius
+	std::vector<uint32_t> simplify(const uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, size_t targetIndexCount, float targetError, float attributeWeight, float* resultError);
+
+	// appends levels 1.. to indices (vertex cache optimised), each simplified from the one above
+	std::vector<LodLevel> buildLodChain(std::vector<uint32_t>& indices, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, IndexRange base, const LodSettings& settings);
+
+	// lod chain (or just level 0 without settings) + clusters for every level + bounds
+	SurfaceDetail buildSurfaceDetail(std::vector<uint32_t>& indices, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, IndexRange range, const LodSettings* lodSettings, const MeshletSettings& meshletSettings = {});
+
+	template<typename V>
+	SurfaceDetail buildSurfaceDetail(std::vector<uint32_t>& indices, const std::vector<V>& vertices, IndexRange range, const LodSettings* lodSettings) {
+
+		VertexAttribs attribs{ offsetof(V, pos), offsetof(V, normal), offsetof(V, texCoord) };
+		return buildSurfaceDetail(indices, reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size(), sizeof(V), attribs, range, lodSettings);
+	}
+
+	// coarsest level whose error stays under params.lodErrorPixels once projected, or params.forceLod when set
+	uint32_t selectLod(const SurfaceDetail& detail, const glm::mat4& model, const ClusterCullParams& params);
+
+	// selectLod + cullMeshlets on that level's clusters, visible ranges appended. returns the level used
+	uint32_t cullSurface(const SurfaceDetail& detail, const glm::mat4& model, const ClusterCullParams& params, bool backface,
+		std::vector<IndexRange>& visible, CullStats& stats);
+}
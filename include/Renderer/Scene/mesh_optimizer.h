@@ -0,0 +1,59 @@
+#pragma once
+
+// backend agnostic index/vertex buffer optimisation, run on the cpu copy of a mesh once tangents are in.
+// vertices are handled as raw bytes + stride so the gl and vk Vertex layouts both go through the same code
+namespace MeshUtils {
+
+	struct IndexRange {
+
+		uint32_t start;
+		uint32_t count;
+	};
+
+	// byte offsets of the attributes a pass looks at, everything else rides along with the vertex
+	struct VertexAttribs {
+
+		size_t position;
+		size_t normal;
+		size_t uv;
+	};
+
+	struct OptimizeSettings {
+
+		bool vertexCache = true;
+		bool overdraw = true;
+		// how much worse (as an acmr ratio) the overdraw pass may make the cache order, 1.0 = only split where it costs nothing
+		float overdrawThreshold = 1.05f;
+		bool vertexFetch = true;
+		bool report = true;
+	};
+
+	struct VertexCacheStats {
+
+		float acmr = 0.0f; // misses per triangle, ~0.5 is the best a regular grid gets, 3 is worst
+		float atvr = 0.0f; // misses per referenced vertex, 1 is ideal
+	};
+
+	// fifo cache simulation, 16 entries by default since that's what these numbers are usually quoted at
+	VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+	// forsyth's linear speed vertex cache optimisation, in place
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// splits a cache optimised order into clusters (without losing more than threshold x the acmr) and sorts them outside in, in place
+	void optimizeOverdraw(uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset, float threshold);
+
+	// renumbers vertices in first use order so fetches walk forward through memory, drops unreferenced ones. returns the new vertex count
+	size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, uint8_t* vertices, size_t vertexCount, size_t vertexStride);
+
+	// cache + overdraw per range (so surfaces keep their index ranges), then one fetch remap over the whole mesh. returns the new vertex count
+	size_t optimizeMesh(std::vector<uint32_t>& indices, uint8_t* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset,
+		const std::vector<IndexRange>& ranges, const OptimizeSettings& settings, const std::string& name);
+
+	template<typename V>
+	void optimizeMesh(std::vector<uint32_t>& indices, std::vector<V>& vertices, const std::vector<IndexRange>& ranges, const OptimizeSettings& settings, const std::string& name) {
+
+		size_t count = optimizeMesh(indices, reinterpret_cast<uint8_t*>(vertices.data()), vertices.size(), sizeof(V), offsetof(V, pos), ranges, settings, name);
+		vertices.resize(count);
+	}
+}
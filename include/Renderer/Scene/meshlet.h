@@ -0,0 +1,77 @@
+#pragma once
+#include "Renderer/Scene/mesh_optimizer.h"
+
+// load time cluster split + per frame cluster culling, backend agnostic.
+// clusters are contiguous runs of a surface's (already cache optimised) index range, so building them
+// never touches the index buffer and a visible run of neighbours still goes out as one draw
+namespace MeshUtils {
+
+	// written to the scene cache as-is
+	struct Meshlet {
+
+		uint32_t indexStart; // absolute, same space as the surface's startIndex
+		uint32_t indexCount;
+
+		// object space bounding sphere
+		glm::vec3 center;
+		float radius;
+
+		// normal cone, the whole cluster faces away when dot(normalize(apex - eye), axis) >= cutoff.
+		// cutoff 1 = normals spread too wide to ever reject
+		glm::vec3 coneApex;
+		glm::vec3 coneAxis;
+		float coneCutoff;
+	};
+
+	struct MeshletSettings {
+
+		uint32_t maxVertices = 64;
+		uint32_t maxTriangles = 124;
+	};
+
+	std::vector<Meshlet> buildMeshlets(const uint32_t* indices, IndexRange range, const uint8_t* vertices, size_t vertexCount,
+		size_t vertexStride, size_t positionOffset, const MeshletSettings& settings = {});
+
+	template<typename V>
+	std::vector<Meshlet> buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<V>& vertices, IndexRange range, const MeshletSettings& settings = {}) {
+
+		return buildMeshlets(indices.data(), range, reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size(), sizeof(V), offsetof(V, pos), settings);
+	}
+
+	// world space planes, xyz normalised and pointing inwards
+	struct Frustum {
+
+		glm::vec4 planes[6];
+	};
+
+	// gribb/hartmann on proj * view. near is taken as the -1..1 plane which is also conservative for 0..1 depth,
+	// and a flipped y (vk) only swaps top/bottom
+	Frustum extractFrustum(const glm::mat4& viewProj);
+
+	struct ClusterCullParams {
+
+		Frustum frustum;
+		glm::vec3 cameraPos;
+		bool frustumCull = true;
+		bool coneCull = true;
+
+		// lod pick (mesh_lod.h). lodScale = pixels per object unit at distance 1, i.e. proj[1][1] * viewport height / 2
+		bool lodSelect = true;
+		float lodScale = 0.0f;
+		float lodErrorPixels = 1.0f;
+		int32_t forceLod = -1; // debug override, -1 = pick by screen size
+	};
+
+	// per frame counters, reset by whoever owns the frame
+	struct CullStats {
+
+		uint32_t clustersTested = 0;
+		uint32_t clustersCulled = 0;
+		uint32_t trianglesSubmitted = 0;
+	};
+
+	// culls one instance's clusters and appends what survives to visible, merging neighbours into one range.
+	// backface is for single sided materials only, double sided ones pass backface = false
+	void cullMeshlets(const Meshlet* meshlets, size_t count, const glm::mat4& model, const ClusterCullParams& params, bool backface,
+		std::vector<IndexRange>& visible, CullStats& stats);
+}
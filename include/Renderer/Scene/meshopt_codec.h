@@ -0,0 +1,21 @@
+#pragma once
+
+// decoders for the EXT_meshopt_compression bitstreams (attribute, triangle and index sequence modes plus the three filters),
+// written from the extension spec so the loaders don't need meshoptimizer itself. everything works on raw bytes, the loaders
+// do the fastgltf side (which buffer views, where the output goes). each call returns false on a malformed stream
+namespace MeshUtils {
+
+	enum class MeshoptMode { Attributes, Triangles, Indices };
+	enum class MeshoptFilter { None, Octahedral, Quaternion, Exponential };
+
+	// count elements of byteStride bytes into out (count * byteStride), unfiltered
+	bool decodeMeshoptVertices(uint8_t* out, size_t count, size_t byteStride, const uint8_t* data, size_t size);
+	// indexSize 2 or 4
+	bool decodeMeshoptTriangles(uint8_t* out, size_t count, size_t indexSize, const uint8_t* data, size_t size);
+	bool decodeMeshoptIndices(uint8_t* out, size_t count, size_t indexSize, const uint8_t* data, size_t size);
+	// in place on decoded attributes
+	void applyMeshoptFilter(uint8_t* data, size_t count, size_t byteStride, MeshoptFilter filter);
+
+	// one compressed view: mode + filter straight from the extension, output is count * byteStride bytes
+	bool decodeMeshopt(uint8_t* out, size_t count, size_t byteStride, MeshoptMode mode, MeshoptFilter filter, const uint8_t* data, size_t size);
+}
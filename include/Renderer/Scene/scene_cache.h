@@ -0,0 +1,235 @@
+#pragma once
+#include "Core/Utils/mapped_file.h"
+#include "Renderer/Scene/mesh_lod.h"
+
+// baked .acrscene file that sits next to a glb. holds everything the loaders build on the cpu
+// (final vertex/index blobs, material constants, node transforms, rgba8 mip chains) so a warm start
+// can skip fastgltf, stb and tangent gen entirely and just copy out of a mapped file.
+// backend agnostic: vertex and material constant blobs are stored as raw bytes with their stride.
+namespace SceneCache {
+
+	constexpr uint32_t MAGIC = 0x53524341; // "ACRS"
+	constexpr uint32_t VERSION = 8;
+	constexpr int32_t NONE = -1;
+
+	enum TextureSlot : uint32_t {
+
+		SLOT_ALBEDO = 0,
+		SLOT_METAL_ROUGH,
+		SLOT_OCCLUSION,
+		SLOT_NORMAL,
+		SLOT_TRANSMISSION,
+		SLOT_THICKNESS,
+		SLOT_COUNT
+	};
+
+	// everything below is written to disk as-is, offsets are from the start of the file
+	struct Header {
+
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash; // see hashSource()
+
+		uint32_t vertexStride;
+		uint32_t materialStride;
+
+		uint32_t samplerCount;
+		uint32_t imageCount;
+		uint32_t materialCount;
+		uint32_t meshCount;
+		uint32_t surfaceCount;
+		uint32_t nodeCount;
+		uint32_t childCount;
+		uint32_t instanceCount;
+		uint32_t meshletCount;
+		uint32_t lodCount;
+
+		uint64_t samplerOffset;
+		uint64_t imageOffset;
+		uint64_t materialOffset;
+		uint64_t meshOffset;
+		uint64_t surfaceOffset;
+		uint64_t nodeOffset;
+		uint64_t childOffset;
+		uint64_t instanceOffset;
+		uint64_t meshletOffset;
+		uint64_t lodOffset;
+		uint64_t fileSize;
+	};
+
+	struct SamplerRecord {
+
+		// raw fastgltf enum values, NONE when the gltf left them unset
+		int32_t magFilter;
+		int32_t minFilter;
+		int32_t wrapS;
+		int32_t wrapT;
+	};
+
+	struct ImageRecord {
+
+		// width == 0 means the image failed to decode, loaders use their fallback
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+		uint32_t channels;   // channel count of the source file
+		uint32_t format;     // TextureCompress::Format of the stored levels
+		uint32_t pad;
+		uint64_t dataOffset; // mips tightly packed, largest first
+		uint64_t dataSize;
+	};
+
+	enum MaterialFlags : uint32_t {
+
+		MATERIAL_DOUBLE_SIDED = 1u << 0
+	};
+
+	struct MaterialRecord {
+
+		uint32_t pass;
+		int32_t image[SLOT_COUNT];
+		int32_t sampler[SLOT_COUNT];
+		uint32_t flags; // MaterialFlags
+		uint64_t constantsOffset; // materialStride bytes
+	};
+
+	struct SurfaceRecord {
+
+		uint32_t startIndex;
+		uint32_t count;
+		int32_t material;
+		uint32_t firstMeshlet; // into the file's meshlet table (into Mesh::meshlets while baking), every lod's clusters
+		uint32_t meshletCount;
+		uint32_t firstLod;     // into the file's lod table (into Mesh::lods while baking). LodLevel::firstMeshlet is relative to firstMeshlet
+		uint32_t lodCount;
+		float uvDensity;        // SurfaceDetail::uvDensity
+		glm::vec4 sphere;      // SurfaceDetail center + radius
+	};
+
+	struct MeshRecord {
+
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t firstSurface;
+		uint32_t surfaceCount;
+	};
+
+	struct NodeRecord {
+
+		glm::mat4 transform; // world transform, same as what iterateSceneNodes hands back
+		int32_t mesh;
+		uint32_t firstChild;
+		uint32_t childCount;
+		uint32_t firstInstance; // EXT_mesh_gpu_instancing transforms (already multiplied by the node's), 0 count = just the node
+		uint32_t instanceCount;
+		uint32_t pad[3];
+	};
+
+	// cpu side copy of a scene, filled in by the loaders on a cold load and then written out
+	struct SceneData {
+
+		struct Image {
+
+			ImageRecord record{};
+			std::vector<uint8_t> pixels;
+		};
+
+		struct Material {
+
+			MaterialRecord record{};
+			std::vector<uint8_t> constants;
+		};
+
+		struct Mesh {
+
+			std::vector<uint8_t> vertices;
+			std::vector<uint32_t> indices;
+			uint32_t vertexCount = 0;
+			std::vector<SurfaceRecord> surfaces;
+			std::vector<MeshUtils::Meshlet> meshlets;
+			std::vector<MeshUtils::LodLevel> lods;
+		};
+
+		struct Node {
+
+			NodeRecord record{};
+			std::vector<uint32_t> children;
+			std::vector<glm::mat4> instances;
+		};
+
+		uint32_t vertexStride = 0;
+		uint32_t materialStride = 0;
+
+		std::vector<SamplerRecord> samplers;
+		std::vector<Image> images;
+		std::vector<Material> materials;
+		std::vector<Mesh> meshes;
+		std::vector<Node> nodes;
+	};
+
+	// read side, validates the header against the expected hash and strides and hands out pointers into the mapping
+	class SceneView {
+
+	public:
+
+		bool open(const std::filesystem::path& path, uint64_t expectedHash, uint32_t vertexStride, uint32_t materialStride);
+
+		const Header& header() const { return *_header; }
+
+		const SamplerRecord* samplers() const { return at<SamplerRecord>(_header->samplerOffset); }
+		const ImageRecord* images() const { return at<ImageRecord>(_header->imageOffset); }
+		const MaterialRecord* materials() const { return at<MaterialRecord>(_header->materialOffset); }
+		const MeshRecord* meshes() const { return at<MeshRecord>(_header->meshOffset); }
+		const SurfaceRecord* surfaces() const { return at<SurfaceRecord>(_header->surfaceOffset); }
+		const NodeRecord* nodes() const { return at<NodeRecord>(_header->nodeOffset); }
+		const uint32_t* children() const { return at<uint32_t>(_header->childOffset); }
+		const glm::mat4* instances() const { return at<glm::mat4>(_header->instanceOffset); }
+		const MeshUtils::Meshlet* meshlets() const { return at<MeshUtils::Meshlet>(_header->meshletOffset); }
+		const MeshUtils::LodLevel* lods() const { return at<MeshUtils::LodLevel>(_header->lodOffset); }
+
+		// copies a surface's lods + clusters back out into the form the loaders build on a cold load
+		MeshUtils::SurfaceDetail surfaceDetail(const SurfaceRecord& surf) const;
+
+		const uint8_t* bytes(uint64_t offset) const { return _file.data() + offset; }
+
+	private:
+
+		// everything open checks once the file is mapped, open drops the mapping again when this fails
+		bool validate(uint64_t expectedHash, uint32_t vertexStride, uint32_t materialStride);
+
+		template<typename T>
+		const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(_file.data() + offset); }
+
+		Utils::File::MappedFile _file;
+		const Header* _header = nullptr;
+	};
+
+	// the loader settings that change what gets baked (as opposed to how it's uploaded). part of the cache key so
+	// flipping one of them rebakes instead of silently loading the old bake
+	struct BakeSettings {
+
+		bool optimizeMeshes = true;
+		float overdrawThreshold = 1.0f;
+		bool generateLods = true;
+		uint32_t maxLods = 0;
+		std::vector<float> lodErrorTargets;
+		bool compressTextures = true;
+	};
+
+	// <dir>/<stem>.<backend>.acrscene, one per backend since the vertex layouts differ
+	std::filesystem::path cachePathFor(const std::filesystem::path& source, const char* backendTag);
+
+	// content hash of the source file mixed with the format version, the layout strides and the bake settings, so
+	// editing the glb, changing Vertex / the material constants or the settings all invalidate the cache
+	uint64_t hashSource(const std::filesystem::path& source, uint32_t vertexStride, uint32_t materialStride, const BakeSettings& bake);
+
+	bool write(const std::filesystem::path& path, uint64_t sourceHash, const SceneData& scene);
+
+	// appends detail's lods + clusters to mesh and points surf at them
+	void addSurfaceDetail(SceneData::Mesh& mesh, SurfaceRecord& surf, const MeshUtils::SurfaceDetail& detail);
+
+	// box filtered rgba8 mip chain down to 1x1, largest level first. returns the level count
+	uint32_t buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+}
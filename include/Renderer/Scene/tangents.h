@@ -0,0 +1,51 @@
+#pragma once
+#include "Renderer/Scene/mesh_optimizer.h"
+
+// per vertex tangents (lengyel, gram-schmidt against the normal, w = bitangent sign) for primitives that don't ship TANGENT.
+// the kernel works on soa copies in fixed size triangle blocks so the maths vectorises, and every vertex sums its
+// triangles in index order no matter how the work was split, so results are identical with or without the job pool
+namespace MeshUtils {
+
+	struct TangentSettings {
+
+		bool parallel = true;
+		uint32_t trianglesPerJob = 8192; // also the vertex count per job for the passes that run over vertices
+	};
+
+	// writes a vec4 tangent at tangentOffset for every vertex referenced by the ranges, nothing else is touched
+	void generateTangents(const uint32_t* indices, const std::vector<IndexRange>& ranges, uint8_t* vertices, size_t vertexCount,
+		size_t vertexStride, const VertexAttribs& attribs, size_t tangentOffset, const TangentSettings& settings = {});
+
+	template<typename V>
+	void generateTangents(const std::vector<uint32_t>& indices, std::vector<V>& vertices, const std::vector<IndexRange>& ranges, const TangentSettings& settings = {}) {
+
+		VertexAttribs attribs{ offsetof(V, pos), offsetof(V, normal), offsetof(V, texCoord) };
+		generateTangents(indices.data(), ranges, reinterpret_cast<uint8_t*>(vertices.data()), vertices.size(), sizeof(V), attribs, offsetof(V, tangent), settings);
+	}
+
+	// the old scalar aos version the loaders used to run on the whole mesh, kept as the benchmark baseline
+	std::vector<glm::vec4> calculateTangents(
+		const std::vector<glm::vec3>& positions,
+		const std::vector<uint32_t>& indices,
+		const std::vector<glm::vec2>& texCoords,
+		const std::vector<glm::vec3>& normals);
+
+	struct TangentBenchmark {
+
+		double referenceMs = 0.0; // calculateTangents incl. the aos -> vector copies the loaders did around it
+		double serialMs = 0.0;    // generateTangents without the job pool
+		double parallelMs = 0.0;
+		float maxDifference = 0.0f; // largest component difference between the two outputs
+	};
+
+	// times both implementations on a copy of the mesh, best of `iterations` runs each. the mesh itself isn't modified
+	TangentBenchmark benchmarkTangents(const std::vector<uint32_t>& indices, const std::vector<IndexRange>& ranges, const uint8_t* vertices,
+		size_t vertexCount, size_t vertexStride, const VertexAttribs& attribs, size_t tangentOffset, uint32_t iterations = 5);
+
+	template<typename V>
+	TangentBenchmark benchmarkTangents(const std::vector<uint32_t>& indices, const std::vector<V>& vertices, const std::vector<IndexRange>& ranges, uint32_t iterations = 5) {
+
+		VertexAttribs attribs{ offsetof(V, pos), offsetof(V, normal), offsetof(V, texCoord) };
+		return benchmarkTangents(indices, ranges, reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size(), sizeof(V), attribs, offsetof(V, tangent), iterations);
+	}
+}
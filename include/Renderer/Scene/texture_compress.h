@@ -0,0 +1,43 @@
+#pragma once
+
+// load/bake time block compression of the rgba8 mip chains the loaders build (SceneCache::buildMipChain layout).
+// plain cpu encoders, nothing fancy: pca endpoints + one least squares refit. BC7 only uses mode 6 (one subset, 4 bit indices)
+// which is plenty for textures that come out of a jpeg/png. compressed chains are what the scene cache stores, so a warm
+// start never runs any of this
+namespace TextureCompress {
+
+	// stored in SceneCache::ImageRecord::format
+	enum Format : uint32_t {
+
+		RGBA8 = 0,
+		BC1,  // rgb 565 endpoints, 4 bpp
+		BC4,  // one channel, 4 bpp. samples as (r, r, r, 1), backends set the swizzle
+		BC5,  // two channels, 8 bpp. normal maps, z is rebuilt in the shader
+		BC7   // rgba, 8 bpp
+	};
+
+	struct Choice {
+
+		Format format = RGBA8;
+		uint32_t channel = 0; // which rgba channel a BC4 encode keeps
+	};
+
+	// slotMask = bit per SceneCache::TextureSlot that samples the image across every material.
+	// base color and anything with real alpha get BC7, normal maps BC5, single channel maps (occlusion/transmission r,
+	// thickness g) BC4 and the rest (metal-rough, packed orm) BC1
+	Choice chooseFormat(uint32_t slotMask, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	bool isCompressed(Format format);
+	size_t levelSize(Format format, uint32_t width, uint32_t height);
+	size_t chainSize(Format format, uint32_t width, uint32_t height, uint32_t mipCount);
+
+	// one 4x4 block, texels row major rgba8
+	void encodeBC1(const uint8_t texels[64], uint8_t out[8]);
+	void encodeBC4(const uint8_t texels[64], uint32_t channel, uint8_t out[8]);
+	void encodeBC5(const uint8_t texels[64], uint8_t out[16]);
+	void encodeBC7(const uint8_t texels[64], uint8_t out[16]);
+
+	// rgba8 chain in, the same levels in choice.format out (copied as is for RGBA8). block rows go out over the job pool,
+	// fine to call from a worker since parallelFor has the caller help
+	std::vector<uint8_t> compressChain(const uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipCount, Choice choice);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Renderer/Scene/mesh_lod.h"
+#include "Renderer/Scene/texture_compress.h"
+
+// backend agnostic half of texture mip streaming. every frame each texture gets asked for the finest level any visible surface
+// using it needs (projected size * uv density), the requests are coarsened until they fit the memory budget, and plan() turns
+// the difference to what's on the gpu into a few load/evict steps. a texture's residency is just its finest level on the gpu,
+// every level coarser than that is always there too. sizes follow the texture's TextureCompress::Format
+namespace TextureStreaming {
+
+	struct Settings {
+
+		size_t budgetBytes = size_t(256) << 20;
+		// levels with a larger side at or under this go up at load and never get evicted
+		uint32_t residentSize = 64;
+		// bytes of new levels uploaded per frame, the first level of the first pick always goes through
+		size_t uploadBytesPerFrame = size_t(8) << 20;
+		// frames a texture has to sit finer than it needs before its extra levels go while under budget
+		uint32_t evictFrames = 120;
+		// added to every estimate, positive = blurrier
+		float mipBias = 0.0f;
+	};
+
+	uint32_t mipCount(uint32_t width, uint32_t height);
+	// size of levels base.. of the chain
+	size_t chainBytes(TextureCompress::Format format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t base);
+
+	struct Texture {
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipCount = 1;
+		TextureCompress::Format format = TextureCompress::RGBA8;
+		uint32_t coarseBase = 0;    // first level at or under Settings::residentSize, always resident
+		uint32_t residentBase = 0;  // finest level on the gpu
+		uint32_t requestedBase = 0; // finest level anything on screen asked for this frame
+		uint32_t targetBase = 0;    // requestedBase after the budget
+		uint32_t overFrames = 0;    // frames residentBase has been finer than targetBase
+
+		size_t residentBytes() const { return chainBytes(format, width, height, mipCount, residentBase); }
+		size_t requestedBytes() const { return chainBytes(format, width, height, mipCount, requestedBase); }
+	};
+
+	Texture makeTexture(uint32_t width, uint32_t height, TextureCompress::Format format, const Settings& settings);
+
+	// fractional level where one texel lands on one pixel for a surface drawn with model, seen from cameraPos.
+	// lodScale is pixels per unit at distance 1 (MeshUtils::ClusterCullParams). negative means magnified
+	float requiredMip(const MeshUtils::SurfaceDetail& detail, const glm::mat4& model, const glm::vec3& cameraPos, float lodScale, uint32_t textureSize);
+
+	// everything back to coarseBase, then request() per visible use
+	void beginFrame(std::vector<Texture>& textures);
+	void request(Texture& texture, float mip, const Settings& settings);
+
+	struct Stats {
+
+		size_t residentBytes = 0;
+		size_t requestedBytes = 0;
+		size_t targetBytes = 0;
+		uint32_t budgetBias = 0; // levels every request got coarsened by to fit
+		uint32_t loads = 0;
+		uint32_t evictions = 0;
+	};
+
+	// a texture to reallocate at a new residentBase, coarser levels carry over, finer ones come from the cpu chain
+	struct Change {
+
+		uint32_t texture;
+		uint32_t base;
+	};
+
+	// picks targetBase (requests pushed one level coarser at a time until the total fits) and returns this frame's changes.
+	// evictions come first, loads go most-levels-missing first and one level at a time under uploadBytesPerFrame.
+	// the caller applies each change and sets residentBase
+	std::vector<Change> plan(std::vector<Texture>& textures, const Settings& settings, Stats& stats);
+}
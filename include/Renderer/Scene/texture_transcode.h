@@ -0,0 +1,25 @@
+#pragma once
+#include "Renderer/Scene/texture_compress.h"
+
+// KHR_texture_basisu ingestion through libktx. a ktx2 image (basis universal etc1s/uastc, or already stored as one of the
+// TextureCompress formats) comes out as a whole chain in the SceneCache::buildMipChain layout, so it goes through the same
+// upload / streaming / scene cache paths as a compressed png. levels are taken from the file as they are; a file that stops
+// short of 1x1 only gives up level 0 (as rgba8) and gets the usual buildMipChain + compressChain on top
+namespace TextureTranscode {
+
+	bool isKtx2(const uint8_t* bytes, size_t size);
+
+	struct Image {
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t channels = 4;
+		uint32_t mipCount = 0;
+		TextureCompress::Format format = TextureCompress::RGBA8;
+		std::vector<uint8_t> chain;
+	};
+
+	// slotMask is the same bit per SceneCache::TextureSlot TextureCompress::chooseFormat takes. blockFormats = the backend can
+	// sample BC1-BC7, without it everything lands as rgba8. false when libktx can't read or transcode the file
+	bool transcode(const uint8_t* bytes, size_t size, uint32_t slotMask, bool blockFormats, Image& out);
+}
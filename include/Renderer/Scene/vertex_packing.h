@@ -0,0 +1,44 @@
+#pragma once
+
+// opt-in compact vertex layout, 20 bytes instead of 48 (gl) / 60 (vk). packing happens right before upload
+// so the loaders and the scene cache keep working on the float layout
+namespace MeshUtils {
+
+	struct PackedVertex {
+
+		uint16_t position[4]; // unorm16 xyz inside the mesh bounds, w = tangent sign (0 -> -1, 65535 -> +1)
+		int16_t normal[2];    // octahedral, snorm16
+		int16_t tangent[2];   // octahedral, snorm16
+		uint16_t uv[2];       // half float
+	};
+	static_assert(sizeof(PackedVertex) == 20, "PackedVertex layout is mirrored in the shaders and attribute setup");
+
+	struct PackedMesh {
+
+		std::vector<PackedVertex> vertices;
+		std::vector<uint8_t> indices; // tightly packed, indexSize bytes each
+		uint32_t indexSize = 4;       // 2 when every index fits in a uint16_t
+
+		// object position = posOffset + posScale * unorm position, goes to the shader with each instance
+		glm::vec4 posOffset = glm::vec4(0.0f);
+		glm::vec4 posScale = glm::vec4(1.0f);
+	};
+
+	glm::vec2 octEncode(const glm::vec3& n);
+	uint16_t floatToHalf(float f);
+
+	void packVertices(const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		size_t positionOffset, size_t normalOffset, size_t uvOffset, size_t tangentOffset, PackedMesh& out);
+
+	// narrows to uint16_t when vertexCount allows it
+	void packIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount, PackedMesh& out);
+
+	// V needs pos (vec3), normal (vec3), texCoord (vec2) and tangent (vec4, w = handedness)
+	template<typename V>
+	void packMesh(const uint32_t* indices, size_t indexCount, const V* vertices, size_t vertexCount, PackedMesh& out) {
+
+		packVertices(reinterpret_cast<const uint8_t*>(vertices), vertexCount, sizeof(V),
+			offsetof(V, pos), offsetof(V, normal), offsetof(V, texCoord), offsetof(V, tangent), out);
+		packIndices(indices, indexCount, vertexCount, out);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "glEng/gltf_loader.h"
+#include "glEng/dynamic_ring.h"
+
+// layout fixed by the spec
+struct DrawElementsIndirectCommand {
+
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// this frame's indirect commands, written straight into the DynamicRing. offsets into the command list have to be
+// rebased by offset() before they go to glMultiDrawElementsIndirect
+class DynamicIndirectBuffer {
+
+public:
+
+	void upload(const std::vector<DrawElementsIndirectCommand>& commands);
+	GLuint id() const { return _alloc.buffer; }
+	GLintptr offset() const { return _alloc.offset; }
+
+private:
+
+	DynamicRing::Allocation _alloc;
+};
+
+// per frame cpu lod pick + cluster culling (Renderer/Scene/mesh_lod.h) for the per object gltf path. every instance of an object
+// turns into one indirect command per run of surviving clusters of its lod, drawn with a single glMultiDrawElementsIndirect per object.
+// the multi draw path reuses appendCommands() with its own rebasing
+class ClusterCullPass {
+
+public:
+
+	// lodScale: pixels per unit at distance 1, see MeshUtils::ClusterCullParams
+	void beginFrame(const glm::mat4& viewProj, const glm::vec3& cameraPos, float lodScale);
+	void cullObjects(const GltfDrawContext& ctx);
+	void drawObject(const RenderObject& obj);
+
+	// appends obj's visible runs for each of its instances. firstIndexBase/baseVertex rebase the commands for callers
+	// drawing out of a shared buffer. returns the number of commands added
+	static GLsizei appendCommands(const RenderObject& obj, const std::vector<GPUInstance>& instances, const MeshUtils::ClusterCullParams& params,
+		GLuint firstIndexBase, GLint baseVertex, std::vector<DrawElementsIndirectCommand>& out, MeshUtils::CullStats& stats);
+
+	const MeshUtils::ClusterCullParams& params() const { return _params; }
+	MeshUtils::CullStats& stats() { return _stats; }
+
+	bool frustumCull = true;
+	bool coneCull = true;
+	bool lodSelect = true;
+	float lodErrorPixels = 1.0f;
+	int32_t forceLod = -1;
+
+private:
+
+	struct CommandRange {
+
+		GLintptr offset;
+		GLsizei count;
+	};
+
+	MeshUtils::ClusterCullParams _params;
+	MeshUtils::CullStats _stats;
+
+	std::vector<DrawElementsIndirectCommand> _commands;
+	std::unordered_map<const RenderObject*, CommandRange> _ranges;
+	DynamicIndirectBuffer _indirect;
+};
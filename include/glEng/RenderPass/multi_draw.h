@@ -0,0 +1,118 @@
+#pragma once
+#include "glEng/gltf_loader.h"
+#include "glEng/RenderPass/cluster_cull.h"
+
+class glEngine;
+
+enum class GltfPass : uint8_t {
+
+	Opaque,
+	Transmission,
+	Transparent
+};
+
+// alternative gltf path: every mesh copied into one vertex + one index buffer, per draw data in ssbos
+// and each pass submitted as a handful of glMultiDrawElementsIndirect calls. built once for a static scene. while one streams in, every
+// commit appends just the new meshes' geometry (the packed buffers grow by doubling) and redoes the per draw tables.
+// there's no bindless here so commands are batched by texture set, one multi draw per batch.
+// packed meshes can come with 16 or 32 bit indices, each width gets its own index buffer + vao
+class MultiDrawPass {
+
+public:
+
+	explicit MultiDrawPass(glEngine* engine) : _engine(engine) {}
+
+	// from scratch, drops whatever was packed before
+	void build(const GltfDrawContext& ctx);
+	// streaming commit: packs meshes that aren't in yet, rebuilds materials and commands for everything
+	void update(const GltfDrawContext& ctx);
+	// per frame, before cull: re-batches every pass in the given order (indices into the matching list, glEngine::sortDrawQueues).
+	// opaque comes grouped by material + index width and front to back inside a group, so it keeps its batches and gets early z,
+	// the blended passes come back to front for blending. their commands come from the dynamic ring after
+	void sortPasses(const GltfDrawContext& ctx, const std::vector<uint32_t>& opaqueOrder, const std::vector<uint32_t>& transmissionOrder,
+		const std::vector<uint32_t>& transparentOrder);
+	// rebuilds every batch's commands from the clusters that survive this frame, drawPass(pass, true) then uses those
+	void cull(const GltfDrawContext& ctx, const MeshUtils::ClusterCullParams& params, MeshUtils::CullStats& stats);
+	void drawPass(GltfPass pass, bool culled = false);
+
+private:
+
+	// same fields as the MaterialBuffer ubo minus the padding MaterialPBRConstants carries for ubo offset alignment
+	struct alignas(16) MaterialRecord {
+
+		glm::vec4 colorFactors;
+		glm::vec4 metalRoughFactors;
+		glm::vec4 volume;
+		glm::vec4 attenuationColor;
+		glm::vec4 transmission;
+	};
+
+	// run of commands that share one material's textures and index width
+	struct Batch {
+
+		const gltfMaterial* material;
+		GLenum indexType;
+		GLintptr commandOffset;
+		GLsizei drawCount;
+
+		// same batch after cluster culling, rewritten every frame from objects
+		std::vector<const RenderObject*> objects;
+		GLintptr culledOffset = 0;
+		GLsizei culledCount = 0;
+	};
+
+	struct MeshRange {
+
+		GLint baseVertex;
+		GLuint firstIndex;
+	};
+
+	// immutable buffer that's only ever appended to. outgrowing it means a twice as big one plus a gpu side copy of what's
+	// used, so packing a streamed scene stays linear in its size
+	struct PackedBuffer {
+
+		GLuint buffer = 0;
+		GLsizeiptr size = 0;
+		GLsizeiptr capacity = 0;
+	};
+
+	// one shared index buffer per index width
+	struct IndexPool {
+
+		GLuint vao = 0;
+		PackedBuffer indices;
+	};
+
+	void release();
+	// per draw tables only, the packed geometry stays
+	void releaseTables();
+	// appends meshes not packed yet
+	void packGeometry(const GltfDrawContext& ctx);
+	static bool reserve(PackedBuffer& packed, GLsizeiptr bytes);
+	void buildMaterials(const GltfDrawContext& ctx);
+	// objects in draw order, opaque-ish passes get grouped by material + index width first (see build)
+	std::vector<const RenderObject*> batchOrder(const std::vector<RenderObject>& objects, bool keepOrder);
+	// merges neighbours that share a material and index width into one batch
+	void buildPass(const std::vector<const RenderObject*>& order, std::vector<Batch>& out, std::vector<DrawElementsIndirectCommand>& commands);
+
+	glEngine* _engine = nullptr;
+
+	PackedBuffer _vertices;
+	GLsizei _stride = 0;
+	IndexPool _indices16;
+	IndexPool _indices32;
+	GLuint _indirectBuffer = 0;
+	DynamicIndirectBuffer _culledIndirect;
+	std::vector<DrawElementsIndirectCommand> _culledCommands;
+	// sortPasses' commands, and which passes currently draw from them instead of _indirectBuffer
+	DynamicIndirectBuffer _sortedIndirect;
+	std::vector<DrawElementsIndirectCommand> _sortedCommands;
+	std::array<bool, 3> _sorted{};
+	GLuint _materialBuffer = 0;         // MaterialRecord[], binding 2
+	GLuint _instanceMaterialBuffer = 0; // uint per instance slot, binding 3
+
+	std::unordered_map<GLuint, MeshRange> _meshRanges; // keyed on the mesh's original vao
+	std::unordered_map<const gltfMaterial*, uint32_t> _materialIndex;
+
+	std::array<std::vector<Batch>, 3> _passes;
+};
@@ -50,6 +50,7 @@ private:
 };
 
 
+static ShaderProgram& fullscreenProgram();
 static void drawFullscreen(GLuint texture);
 static void blitTextureToBackbuffer(GLuint srcColorTex, GLuint srcFramebuffer);
 static void setDepthSampleParams(GLuint tex);
\ No newline at end of file
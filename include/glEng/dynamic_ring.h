@@ -0,0 +1,75 @@
+#pragma once
+
+// per frame gpu data (camera, per draw constants, culled indirect commands, anything animated later) without the
+// implicit sync glBufferSubData does on a buffer the gpu may still be reading. one immutable buffer, mapped persistent +
+// coherent for good, split into REGIONS regions: a frame only writes its own region and fences it in endFrame, the region
+// comes round again REGIONS frames later and beginFrame waits on that fence first, normally long signalled by then.
+// allocations are only good until endFrame, bind them with glBindBufferRange (or as an offset for indirect draws)
+class DynamicRing {
+
+public:
+
+	struct Allocation {
+
+		GLuint buffer = 0;
+		GLintptr offset = 0; // from the start of buffer, what glBindBufferRange / the indirect offset wants
+		GLsizeiptr size = 0;
+		void* data = nullptr;
+	};
+
+	struct Stats {
+
+		GLsizeiptr usedBytes = 0; // this frame so far
+		GLsizeiptr regionBytes = 0;
+		uint32_t waits = 0; // since init, times beginFrame found the region's fence not signalled yet (gpu REGIONS frames behind)
+	};
+
+	static constexpr uint32_t REGIONS = 3;
+
+	static DynamicRing& Get() {
+
+		static DynamicRing instance;
+		return instance;
+	}
+
+	// needs a context, reads the offset alignments
+	void init(GLsizeiptr regionSize = 2 * 1024 * 1024);
+	void beginFrame();
+	void endFrame();
+
+	// size bytes in this frame's region, offset aligned for target (uniform / storage alignment, 16 for anything else).
+	// a full region is replaced by a bigger buffer on the spot, see grow
+	Allocation allocate(GLsizeiptr size, GLenum target = GL_UNIFORM_BUFFER);
+	Allocation upload(const void* data, GLsizeiptr size, GLenum target = GL_UNIFORM_BUFFER);
+	template<typename T>
+	Allocation upload(const T& value, GLenum target = GL_UNIFORM_BUFFER) { return upload(&value, sizeof(T), target); }
+
+	const Stats& stats() const { return _stats; }
+
+private:
+
+	struct Retired {
+
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	void create(GLsizeiptr regionSize);
+	void grow(GLsizeiptr minRegionSize);
+	GLsizeiptr alignment(GLenum target) const;
+
+	GLuint _buffer = 0;
+	uint8_t* _mapped = nullptr;
+	GLsizeiptr _regionSize = 0;
+	uint32_t _region = 0;
+	GLsizeiptr _head = 0;
+	std::array<GLsync, REGIONS> _fences{};
+	// buffers swapped out by grow, deleted once the frame that last used them is done
+	std::vector<Retired> _retired;
+
+	GLsizeiptr _uniformAlign = 256;
+	GLsizeiptr _storageAlign = 256;
+	Stats _stats;
+
+	DynamicRing() = default;
+};
@@ -2,10 +2,14 @@
 #include "Core/IRenderEngine.h"
 #include "glEng/gl_types.h"
 #include "glEng/gltf_loader.h"
+#include "glEng/texture_streamer.h"
 #include "glEng/Debug/debug_light.h"
 #include "glEng/RenderPass/transmission.h"
+#include "glEng/RenderPass/multi_draw.h"
+#include "glEng/RenderPass/cluster_cull.h"
 #include "glEng/shader_prog.h"
 #include "glEng/RenderPass/cubemap.h"
+#include "Core/Utils/coherent_sort.h"
 
 class glEngine : public IRenderEngine {
 public:
@@ -28,8 +32,10 @@ public:
 
 		ShaderProgram prog;
 		GLuint VBO, VAO, EBO;
-		GLint modelLoc;
 		GltfDrawContext ctx;
+		// prog's sampler units in bindMaterialTextures order, looked up by name once after it links
+		std::array<int, 7> textureUnits;
+		bool textureUnitsResolved = false;
 	} _gltfData;
 
 	// fbo = framebuffer object
@@ -38,14 +44,32 @@ public:
 	GLFWwindow* _window;
 	Renderer* _renderer;
 	GLImage _whiteImage;
+	GLImage _flatNormalImage;
 	GLSampler _defaultSamplerLinear;
-	GLuint _cameraUBO;
 	void setupEngine() override;
 	void drawFrame() override;
 	void setWindow(GLFWwindow* w) override { _window = w; }
 	void passCameraData(glm::mat4 view, glm::mat4 proj, glm::vec4 viewPos);
 
 	void drawGltfMesh(const RenderObject& submesh); // publkic for transmission
+	void drawGltfPass(GltfPass pass);
+	void bindMaterialTextures(const gltfMaterial& mat);
+
+	// one packed buffer + glMultiDrawElementsIndirect per pass instead of a draw per object. false = old per object path
+	bool _useMultiDraw = true;
+	// upload meshes as MeshUtils::PackedVertex (20 bytes) + 16 bit indices where they fit
+	bool _usePackedVertices = false;
+	// frustum + backface cone test per cluster on the cpu every frame, works with either path above
+	bool _useClusterCulling = true;
+	// pick a lod per instance from its projected size, rides the same per frame pass as the culling
+	bool _useLods = true;
+	int _forceLod = -1; // debug, -1 = by screen size
+	float _lodErrorPixels = 1.0f;
+	// load the scene on the job pool and let it fill in while rendering instead of blocking setupEngine
+	bool _streamScene = true;
+	// textures start at their coarse mips and stream finer ones in/out per frame by on screen size, under _textureStreamer.settings
+	bool _streamTextures = true;
+	TextureStreamer _textureStreamer;
 
 	Cubemap _cubeMap;
 
@@ -67,23 +91,54 @@ private:
 	void setDefaultValues();
 	void setDebugDefaults();
 	GLSampler createDefaultLinearSampler();
-	GLImage createDefaultWhiteTexture();
+	GLImage createDefaultTexture(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
-	void bindCameraUBO();
+	void uploadCameraData();
+	void uploadInstanceBuffer();
+	void streamScene();
+	void streamTextures();
 	void drawDebugMesh();
 	void drawGltf();
 	void drawNoExtensions();
+	void cullClusters();
+	// once a frame before any pass draws, the per object path walks _drawQueues instead of the lists directly and the
+	// multi draw path re-batches its passes from them (MultiDrawPass::sortPasses)
+	void sortDrawQueues();
+	uint64_t drawKey(const RenderObject& obj, GltfPass pass);
+	bool perInstanceDraws() const { return _useClusterCulling || _useLods; }
 
 	struct DebugSphere {
 
 		ShaderProgram prog;
-		GLint modelLoc;
-		GLint colorLoc;
 		DebugMesh mesh;
 	};
 
+	// DebugDraw block in light_debug_*.glsl, binding 9
+	struct alignas(16) DebugDrawUBO {
+
+		glm::mat4 model;
+		glm::vec4 color;
+	};
+
 	DebugSphere _lightSphere;
 	TransmissionPass _transmissionPass;
+	MultiDrawPass _multiDraw;
+	ClusterCullPass _clusterCull;
+
+	std::shared_ptr<gltfData> _scene;
+
+	// draw order per GltfPass, indices into the matching GltfDrawContext list. opaque is grouped by material + vao (index
+	// width on the multi draw path) and front to back inside a group, transmission / transparent are back to front
+	std::array<Utils::Sort::CoherentSort, 3> _drawQueues;
+	std::vector<uint64_t> _drawKeys;
+	std::unordered_map<const gltfMaterial*, uint32_t> _materialIds;
+
+	// kept from passCameraData, goes into the dynamic ring once the frame's region is open (uploadCameraData)
+	CameraUBO _camData{};
+	// kept from passCameraData for culling
+	glm::mat4 _viewProj = glm::mat4(1.0f);
+	glm::vec3 _cameraPos = glm::vec3(0.0f);
+	float _lodScale = 0.0f;
 
 };
 
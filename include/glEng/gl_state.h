@@ -0,0 +1,69 @@
+#pragma once
+
+// shadow of the GL bindings the draw loops keep touching: program, texture units, samplers, vao and indexed
+// uniform / storage buffer ranges. binds go through here and only reach GL when they change something, issued vs
+// elided is counted per frame. code that binds around it has to invalidate() after, beginFrame() does it once a frame
+// because uploads (scene / texture streaming) and imgui bind behind its back between frames
+class GLState {
+
+public:
+
+	struct Counters {
+
+		uint32_t issued = 0;
+		uint32_t elided = 0;
+	};
+
+	static GLState& Get() {
+
+		static GLState instance;
+		return instance;
+	}
+
+	void useProgram(GLuint program);
+	// glBindTextureUnit, so the active texture selector is never touched
+	void bindTexture(GLuint unit, GLuint texture);
+	void bindSampler(GLuint unit, GLuint sampler);
+	void bindVertexArray(GLuint vao);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// forgets everything, the next bind of each kind always goes out
+	void invalidate();
+	// invalidate + zero the counters
+	void beginFrame();
+	const Counters& counters() const { return _counters; }
+
+private:
+
+	static constexpr GLuint MAX_UNITS = 32;
+	static constexpr GLuint MAX_BUFFER_BINDINGS = 16;
+	static constexpr GLuint UNKNOWN = ~0u;
+	static constexpr GLsizeiptr WHOLE_BUFFER = -1; // bindBufferBase
+
+	struct BufferRange {
+
+		GLuint buffer = UNKNOWN;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	// true when the call has to go out, counts either way
+	bool changed(bool differs) {
+
+		differs ? _counters.issued++ : _counters.elided++;
+		return differs;
+	}
+	BufferRange* rangeSlot(GLenum target, GLuint index);
+
+	GLuint _program = UNKNOWN;
+	GLuint _vao = UNKNOWN;
+	std::array<GLuint, MAX_UNITS> _textures;
+	std::array<GLuint, MAX_UNITS> _samplers;
+	std::array<BufferRange, MAX_BUFFER_BINDINGS> _uniformBuffers;
+	std::array<BufferRange, MAX_BUFFER_BINDINGS> _storageBuffers;
+
+	Counters _counters;
+
+	GLState() { invalidate(); }
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include "glEng/pbr_pipeline.h"
 #include "glEng/gl_types.h"
+#include "Renderer/Scene/scene_cache.h"
+#include "Renderer/Scene/vertex_packing.h"
+#include "Renderer/Scene/mesh_lod.h"
 
 struct Node;
 
@@ -9,6 +12,7 @@ struct gltfMaterial {
 	GLuint dataBuffer;
 	GLintptr dataBufferOffset;
 	PBRSystem::MaterialInstance data;
+	bool doubleSided = false; // cluster backface culling only applies to single sided materials
 };
 
 
@@ -17,6 +21,9 @@ struct SubMesh {
 	uint32_t startIndex;
 	uint32_t count;
 	std::shared_ptr<gltfMaterial> material;
+
+	// lod chain (extra index ranges further down the same ebo) + clusters of every level, for per frame lod pick and culling
+	std::shared_ptr<const MeshUtils::SurfaceDetail> detail;
 };
 
 struct GPUMeshBuffers {
@@ -25,19 +32,29 @@ struct GPUMeshBuffers {
 	GLuint vbo = 0; // vtx obj
 	GLuint ebo = 0; // indices (called element buffer ?>????:<><><>
 	GLsizei indexCount = 0;
+	GLsizei vertexCount = 0;
+
+	// float Vertex or MeshUtils::PackedVertex, see LoadSettings::packedVertices
+	GLsizei vertexStride = sizeof(Vertex);
+	GLenum indexType = GL_UNSIGNED_INT;
+	// packed positions are unorm inside the mesh bounds, object pos = posOffset + posScale * pos. identity for float vertices
+	glm::vec4 posOffset = glm::vec4(0.0f);
+	glm::vec4 posScale = glm::vec4(1.0f);
+};
+
+// one per instance slot in the Instances ssbo, layout mirrored in pbr_v.glsl
+struct GPUInstance {
+
+	glm::mat4 model;
+	glm::vec4 posOffset;
+	glm::vec4 posScale;
 };
 
+// shared between every node that references it, the per node transform lives on the node
 struct MeshAsset {
 
 	std::vector<SubMesh> submeshes;
 	GPUMeshBuffers meshBuffers;
-	glm::mat4 transform;
-
-	std::shared_ptr<MeshAsset> clone() const {
-
-		auto copy = std::make_shared<MeshAsset>(*this);
-		return copy;
-	}
 };
 
 struct RenderObject {
@@ -48,7 +65,11 @@ struct RenderObject {
 	GPUMeshBuffers meshBuffers;
 	glm::mat4 transform;
 	std::shared_ptr<gltfMaterial> material;
+	std::shared_ptr<const MeshUtils::SurfaceDetail> detail;
 
+	// range into GltfDrawContext::instances, filled in by buildInstances()
+	uint32_t firstInstance = 0;
+	uint32_t instanceCount = 1;
 };
 
 struct GltfDrawContext {
@@ -57,7 +78,21 @@ struct GltfDrawContext {
 	std::vector<RenderObject> transparentSubmeshes;
 	std::vector<RenderObject> transmissionSubmeshes;
 
+	// per instance model matrix + position dequant, read in the vertex shader through gl_BaseInstance + gl_InstanceID
+	std::vector<GPUInstance> instances;
+	GLuint instanceBuffer = 0;
+	// slots allocated in instanceBuffer / already written, so a streaming scene only uploads the new tail
+	size_t instanceCapacity = 0;
+	size_t uploadedInstances = 0;
+
 	bool isTransmissionEnabled = false;
+
+	// collapses opaque/transmission objects that share (geometry, submesh, material) into one instanced object each.
+	// transparent stays one object per instance since those get depth sorted
+	void buildInstances();
+	// streaming: groups just batch's objects the same way and appends them + their instances.
+	// nothing already in here moves, so firstInstance ranges handed out earlier stay valid
+	void append(GltfDrawContext& batch);
 };
 
 struct Node {
@@ -85,11 +120,16 @@ struct Node {
 struct MeshNode : public Node {
 
 	std::shared_ptr<MeshAsset> mesh;
-	RenderObject createRenderObject(const SubMesh& submesh);
+	// EXT_mesh_gpu_instancing, already multiplied by worldTransform. empty means draw once at worldTransform
+	std::vector<glm::mat4> instanceTransforms;
+
+	RenderObject createRenderObject(const SubMesh& submesh, const glm::mat4& transform);
+	// just this node's objects, no children. a mesh that hasn't streamed in yet has no submeshes so this pushes nothing
+	void pushRenderObjects(GltfDrawContext& ctx);
 	virtual void Draw(GltfDrawContext& ctx) override;
 };
 
-class gltfData {
+class gltfData : public std::enable_shared_from_this<gltfData> {
 public:
 
 	struct GltfLoadContext {
@@ -99,14 +139,67 @@ public:
 		glEngine* engine;
 	};
 
+	// knobs for how a file gets loaded, defaults are the fast path
+	struct LoadSettings {
+
+		// upload MeshUtils::PackedVertex + 16 bit indices where they fit instead of the float layout.
+		// the pbr shaders have to be built with PACKED_VERTEX to match
+		bool packedVertices = false;
+
+		// decode + tangent gen each mesh on the job pool, uploads stay on the calling thread
+		bool parallelMeshDecode = true;
+
+		// vertex cache / overdraw / fetch reordering after tangent gen (Renderer/Scene/mesh_optimizer.h)
+		bool optimizeMeshes = true;
+		// how much acmr the overdraw sort may cost as a ratio, 1.0 = only where it costs nothing
+		float overdrawThreshold = 1.05f;
+		// print acmr/atvr before and after per mesh
+		bool reportMeshStats = true;
+		// time the old scalar tangent pass against Renderer/Scene/tangents.h on every mesh that needs generating and print both
+		bool benchmarkTangents = false;
+
+		// simplified copies of every surface appended to its index buffer (Renderer/Scene/mesh_lod.h), picked per instance by screen size
+		bool generateLods = true;
+		uint32_t maxLods = 4;
+		// simplification error per level relative to the surface radius, last one repeats
+		std::vector<float> lodErrorTargets = { 0.01f, 0.02f, 0.05f };
+
+		// decode images on the job pool and upload them from the calling thread as they come in
+		bool parallelImageDecode = true;
+		// max decoded-but-not-uploaded images held at once
+		uint32_t imageQueueDepth = 8;
+		// hand every image to the engine's TextureStreamer (glEng/texture_streamer.h) with just its coarse mips up,
+		// finer ones come and go per frame with on screen size. off = full chains in linear + srgb copies
+		bool streamTextures = false;
+		// block compress every image on the job pool after decode (Renderer/Scene/texture_compress.h), format per the slots
+		// sampling it. the scene cache keeps the compressed chains so this only runs on a cold load
+		bool compressTextures = true;
+
+		// load from / bake to <name>.gl.acrscene next to the file, rebuilt automatically when the hash goes stale
+		bool useSceneCache = true;
+
+		// LoadAsync only: main thread time pump() may spend uploading per frame (always at least one item),
+		// and how often newly visible objects get handed to the draw context
+		float streamBudgetMs = 4.0f;
+		float streamCommitMs = 100.0f;
+	};
+
 	gltfData() = default;
+	~gltfData();
 
 	// nodes that dont have a parent, for iterating through the file in tree order
 	std::vector<std::shared_ptr<Node>> topNodes;
 
-	static std::shared_ptr<gltfData> Load(glEngine* engine, std::filesystem::path path);
+	static std::shared_ptr<gltfData> Load(glEngine* engine, std::filesystem::path path, LoadSettings settings = {});
 	void drawNodes(GltfDrawContext& ctx);
 
+	// returns straight away, hashing/parsing/decoding runs on the job pool and pump() brings the results in a bit per frame.
+	// nodes show up once their mesh is uploaded, materials start on the engine's white placeholder and pick up textures as they land
+	static std::shared_ptr<gltfData> LoadAsync(glEngine* engine, std::filesystem::path path, LoadSettings settings = {});
+	// gl thread, once per frame. returns true when objects were appended to ctx (instance buffer / mdi need refreshing)
+	bool pump(GltfDrawContext& ctx);
+	bool streaming() const { return stream != nullptr; }
+
 	GLuint materialDataBuffer;
 
 	//~gltfData() { destroyAll(); };
@@ -120,11 +213,27 @@ private:
 	void fetchPBRTextures(fastgltf::Material& mat, GltfLoadContext ctx, PBRSystem::MaterialResources& materialResources, std::vector<GLSampler>& samplers, std::vector<GLImage>& images);
 	std::vector<std::shared_ptr<MeshAsset>> loadMeshes(GltfLoadContext ctx, std::vector<std::shared_ptr<gltfMaterial>> materials);
 	std::vector<std::shared_ptr<Node>> loadNodes(GltfLoadContext ctx, std::vector<std::shared_ptr<MeshAsset>> vecMeshes);
+	void loadFromCache(GltfLoadContext ctx, const std::shared_ptr<const SceneCache::SceneView>& view);
+	std::vector<std::shared_ptr<gltfMaterial>> loadCachedMaterials(GltfLoadContext ctx, const SceneCache::SceneView& view, std::vector<GLSampler>& samplers, std::vector<GLImage>& images);
+	std::vector<std::shared_ptr<Node>> loadCachedNodes(GltfLoadContext ctx, const SceneCache::SceneView& view, const std::vector<std::shared_ptr<MeshAsset>>& vecMeshes);
+	void trackStreamedSlots(glEngine* engine, const std::shared_ptr<gltfMaterial>& mat, const SceneCache::MaterialRecord& rec, int32_t image = SceneCache::NONE);
+
+	struct StreamState;
+	void beginStream();
+	bool uploadNextMesh();
+	bool uploadNextImage();
 
 	PBRSystem pbrSystem;
+	LoadSettings settings;
+	std::unique_ptr<SceneCache::SceneData> bake; // only alive during a cold load that's writing the cache
+	std::vector<int32_t> streamedImages; // TextureStreamer index per gltf image, NONE when streamTextures is off or the image failed
+	std::unique_ptr<StreamState> stream; // only alive while a LoadAsync scene is still coming in, last so it goes first
 
 };
 
+// attribute formats for either vertex layout on a vao, vertex buffer goes on binding 0
+void setVertexFormat(GLuint vao, bool packed);
+
 GLenum extract_filter(fastgltf::Filter f);
 GLenum extract_mipmap_filter(fastgltf::Filter f);
 GLenum extract_wrap(fastgltf::Wrap w);
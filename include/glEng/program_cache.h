@@ -0,0 +1,62 @@
+#pragma once
+
+// program binaries on disk so startup links each program once per driver instead of every run. entries are keyed by
+// both stages' final source plus GL_RENDERER / GL_VERSION, so a driver update just misses and relinks from source.
+// with KHR_parallel_shader_compile begin() only hands the work to the driver's compiler threads and the link status
+// isn't asked for until finish(), which ShaderProgram calls the first time the program is actually used
+class ProgramCache {
+
+public:
+
+	struct Pending {
+
+		GLuint program = 0;
+		GLuint vs = 0;
+		GLuint fs = 0;
+		uint64_t key = 0;
+		bool fromBinary = false;
+		// kept around for the source fallback when the driver rejects a binary
+		std::string vsSource;
+		std::string fsSource;
+	};
+
+	static ProgramCache& Get() {
+
+		static ProgramCache instance;
+		return instance;
+	}
+
+	// needs a current context, call right after glad is loaded
+	void init(std::filesystem::path dir);
+
+	Pending begin(std::string vsSource, std::string fsSource);
+	// blocks until the program is linked and returns it. throws on compile / link errors
+	GLuint finish(Pending& pending);
+
+	bool parallelCompile() const { return _parallel; }
+
+private:
+
+	static constexpr uint32_t MAGIC = 0x50474341; // "ACGP"
+	static constexpr uint32_t VERSION = 1;
+
+	struct FileHeader {
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;
+		uint32_t size;
+		uint64_t hash;
+	};
+
+	void compileFromSource(Pending& pending);
+	GLuint linkFromSource(Pending& pending);
+	bool loadBinary(Pending& pending);
+	void storeBinary(const Pending& pending);
+	std::filesystem::path entryPath(uint64_t key) const;
+
+	std::filesystem::path _dir;
+	std::string _driver; // GL_RENDERER + GL_VERSION, part of every key
+	bool _binaries = false;
+	bool _parallel = false;
+};
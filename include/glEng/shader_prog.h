@@ -1,12 +1,21 @@
 #pragma once
+#include "glEng/program_cache.h"
 
 class ShaderProgram {
 public:
 
-	GLuint makeShaderProgram(const char* vsPath, const char* fsPath);
-	const void setTexture(const std::string& uniformName, GLuint texture, GLint sampler = -1, GLuint texFormat = GL_TEXTURE_2D);
-	GLuint getID() { return _programID; }
-	GLuint getUniformAddress(const std::string& uniformName);
+	// defines get injected as "#define X" lines right after #version in both stages
+	GLuint makeShaderProgram(const char* vsPath, const char* fsPath, const std::vector<std::string>& defines = {});
+	// goes through ProgramCache. with parallel compile the link is only waited on the first time the program is used
+	GLuint makeShaderProgramFromSource(std::string vsSource, std::string fsSource);
+	// every sampler uniform gets its own unit when the program links, binds go through GLState so repeats are dropped
+	void setTexture(const std::string& uniformName, GLuint texture, GLint sampler = -1);
+	void bindTextureUnit(int unit, GLuint texture, GLint sampler = -1);
+	// -1 if the program has no such sampler. stable after link, hot paths look it up once and use bindTextureUnit
+	int textureUnit(const std::string& uniformName) const;
+	GLuint getID() { return id(); }
+	// from the table built at link time, no glGetUniformLocation
+	GLint getUniformAddress(const std::string& uniformName) const;
 	void useProg();
 
 	void setInt(const std::string& name, int value) const;
@@ -19,11 +28,14 @@ public:
 
 private:
 
-	GLuint _programID;
-	GLuint compileShader(GLenum type, const std::string& src);
-	GLuint linkProgram(GLuint vs, GLuint fs);
+	GLuint _programID = 0;
+	// _programID is valid right away, the pending part is still linking while program is non zero and gets resolved by the first id()
+	mutable ProgramCache::Pending _pending;
+	GLuint id() const;
+	// fills the tables below from the active uniforms and points each sampler at its unit
+	void reflect() const;
 
-	int _nextTexUnit = 0;
-	std::unordered_map<std::string, int> _textureUnits;
+	mutable std::unordered_map<std::string, GLint> _locations;
+	mutable std::unordered_map<std::string, int> _textureUnits;
 };
 std::string loadFile(const char* path);
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "glEng/gl_types.h"
+#include "Renderer/Scene/texture_streaming.h"
+
+struct gltfMaterial;
+struct GltfDrawContext;
+
+// internal formats for a TextureCompress::Format. srgb is 0 where there's no srgb variant (bc4/bc5, never base color)
+struct GLTextureFormat {
+
+	GLenum linear;
+	GLenum srgb;
+};
+
+GLTextureFormat glTextureFormat(TextureCompress::Format format);
+// bc4 is a lone red channel, read it back as (r, r, r, 1) so every slot sees the value whichever channel it samples
+void setFormatSwizzle(GLuint texture, TextureCompress::Format format);
+
+// gl side of Renderer/Scene/texture_streaming.h. a streamed image is one immutable texture holding levels residentBase..
+// plus an srgb view of the same storage, so base color no longer needs its own copy. changing residency swaps in a new texture:
+// levels both have get copied on the gpu, new ones come from the full cpu chain kept here (the cache mapping or the decoded mips)
+class TextureStreamer {
+
+public:
+
+	TextureStreaming::Settings settings;
+
+	// pixels = the whole chain level 0 first (SceneCache::buildMipChain layout, or its TextureCompress blocks), kept alive by owner.
+	// only the coarse levels go up now
+	uint32_t add(std::shared_ptr<const void> owner, const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompress::Format format);
+	const GLImage& image(uint32_t texture) const { return _images[texture]; }
+	// slot gets rewritten on every reallocation, srgb picks the view. holding the material keeps slot valid
+	void addUser(uint32_t texture, std::shared_ptr<gltfMaterial> material, GLTexture* slot, bool srgb);
+
+	// gl thread, once per frame before drawing. requests from every visible instance, then loads/evictions under the budget
+	void update(const GltfDrawContext& ctx, const glm::mat4& viewProj, const glm::vec3& cameraPos, float lodScale);
+
+	// residentBytes() / requestedBytes() per texture, indexed like add() returned
+	const std::vector<TextureStreaming::Texture>& textures() const { return _textures; }
+	const TextureStreaming::Stats& stats() const { return _stats; }
+
+private:
+
+	struct Source {
+
+		std::shared_ptr<const void> owner;
+		const uint8_t* pixels;
+		std::vector<size_t> levelOffsets;
+	};
+
+	struct User {
+
+		std::shared_ptr<gltfMaterial> material;
+		GLTexture* slot;
+		bool srgb;
+	};
+
+	void reallocate(uint32_t texture, uint32_t base);
+
+	std::vector<TextureStreaming::Texture> _textures;
+	std::vector<Source> _sources;
+	std::vector<GLImage> _images;
+	std::vector<std::vector<User>> _users;
+	std::unordered_map<const gltfMaterial*, std::vector<uint32_t>> _materialTextures;
+	TextureStreaming::Stats _stats;
+};
@@ -34,7 +34,9 @@ public:
 	VkDescriptorPool _descriptorPool;
 
 	VkDescriptorSetLayoutBinding createLayoutBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, int binding);
-	void createDescriptorLayout(std::vector<VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayout& layout);
+	// bindingFlags is empty or one entry per binding (update after bind etc)
+	void createDescriptorLayout(std::vector<VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayout& layout,
+		VkDescriptorSetLayoutCreateFlags flags = 0, const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
 	
 	void init(VkEngine* engine) {
 
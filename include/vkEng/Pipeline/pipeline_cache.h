@@ -0,0 +1,88 @@
+#pragma once
+#include "vk_types.h"
+
+// vertex + fragment module pair, destroyed once the last pipeline description holding it goes away
+// (so a permutation still compiling on a worker keeps its modules alive)
+struct ShaderModules {
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkShaderModule vert = VK_NULL_HANDLE;
+    VkShaderModule frag = VK_NULL_HANDLE;
+
+    ShaderModules(VkDevice device, VkShaderModule vert, VkShaderModule frag) : device(device), vert(vert), frag(frag) {}
+    ~ShaderModules();
+
+    ShaderModules(const ShaderModules&) = delete;
+    ShaderModules& operator=(const ShaderModules&) = delete;
+};
+
+// everything a graphics pipeline is made of, by value. a permutation is a copy with a few fields changed,
+// PipelineCache::build points the create info structs at it right before compiling
+struct GraphicsPipelineDesc {
+
+    std::shared_ptr<const ShaderModules> shaders;
+    VkBool32 packedVertex = VK_FALSE; // constant_id 0 in vPBR.vert
+
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    std::vector<VkDynamicState> dynamicStates;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+};
+
+// VkPipelineCache that survives restarts. the file is keyed to the gpu + driver (vendor, device, driver version, cache
+// uuid) and checksummed, anything that doesn't match is thrown away and the cache starts empty. pipelines compile through
+// it either right away or on the job pool, vkCreateGraphicsPipelines is fine with several threads sharing one cache
+class PipelineCache {
+
+public:
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, std::filesystem::path path);
+    // waits out background builds, writes the cache and destroys it
+    void cleanup();
+
+    VkPipeline build(const GraphicsPipelineDesc& desc);
+    // compiles on the job pool, out stays VK_NULL_HANDLE until it's done so callers draw with a fallback meanwhile
+    void buildAsync(GraphicsPipelineDesc desc, std::atomic<VkPipeline>& out);
+    // once per frame: collects finished builds (rethrowing their errors here) and saves once the queue drains
+    void retire();
+    void waitIdle();
+
+    bool save();
+    VkPipelineCache handle() const { return _cache; }
+
+private:
+
+    static constexpr uint32_t MAGIC = 0x50524341; // "ACRP"
+    static constexpr uint32_t VERSION = 1;
+
+    struct FileHeader {
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    FileHeader expectedHeader() const;
+    std::vector<uint8_t> loadValidated();
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties _props{};
+    std::filesystem::path _path;
+    VkPipelineCache _cache = VK_NULL_HANDLE;
+
+    std::vector<std::future<void>> _pending;
+    std::atomic<bool> _dirty{ false }; // something compiled since the last save, set from workers
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "vk_types.h"
+
+// GLSL -> SPIR-V in process through shaderc, no glslc / temp files. every result is cached on disk under a hash of
+// the source, its defines and the compile options, and the entry remembers each file it #included along with that
+// file's hash, so touching a shared header recompiles exactly the shaders that use it
+class ShaderCompiler {
+
+public:
+
+    struct Source {
+
+        std::filesystem::path path; // stage comes from the extension (.vert, .frag, .comp, ...)
+        std::vector<std::pair<std::string, std::string>> defines;
+    };
+
+    // includeDir is where <...> includes resolve, "..." ones are relative to the including file first
+    void init(std::filesystem::path cacheDir, std::filesystem::path includeDir = "shaders/vk");
+
+    // one module per source in the same order, stages compile in parallel on the job pool.
+    // throws with the compiler log if any of them fails
+    std::vector<std::vector<uint32_t>> compile(const std::vector<Source>& sources) const;
+    std::vector<uint32_t> compile(const Source& source) const;
+
+private:
+
+    static constexpr uint32_t MAGIC = 0x53524341; // "ACRS"
+    static constexpr uint32_t VERSION = 1;
+
+    struct Dependency {
+
+        std::string path;
+        uint64_t hash;
+    };
+    class Includer;
+
+    uint64_t cacheKey(const Source& source, const std::string& text) const;
+    std::filesystem::path entryPath(uint64_t key) const;
+    bool loadCached(uint64_t key, std::vector<uint32_t>& spirv) const;
+    void storeCached(uint64_t key, const std::vector<Dependency>& deps, const std::vector<uint32_t>& spirv) const;
+
+    std::filesystem::path _cacheDir;
+    std::filesystem::path _includeDir;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include "Renderer/Scene/texture_compress.h"
 
 struct ImageCreateInfoProperties {
 
@@ -18,3 +19,7 @@ struct ImageViewCreateInfoProperties {
 	VkImage image;
 	VkImageAspectFlags aspectFlags;
 };
+
+// block formats for TextureCompress chains and back, unorm like the rgba8 path. anything else maps to RGBA8
+VkFormat vkTextureFormat(TextureCompress::Format format);
+TextureCompress::Format textureCompressFormat(VkFormat format);
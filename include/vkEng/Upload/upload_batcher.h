@@ -0,0 +1,68 @@
+#pragma once
+#include "vk_types.h"
+
+class VkEngine;
+
+// asset uploads without a round trip each. data gets copied into one persistently mapped staging ring, the copies /
+// layout transitions are recorded into an open batch and the batch goes out as a single submit that bumps a timeline
+// semaphore. the frame submit waits on the last value flushed, ring space comes back as each batch's value is reached.
+// main thread only, same as the queue it submits to
+class UploadBatcher {
+
+public:
+
+    struct Staging {
+
+        VkBuffer buffer;
+        VkDeviceSize offset;
+    };
+
+    void init(VkEngine* engine, VkDeviceSize ringSize = 64ull << 20);
+    void cleanup();
+
+    // copies data into staging, valid until the batch it lands in retires. anything bigger than the ring gets a buffer of
+    // its own. a full ring flushes the open batch, so stage before asking for commands() and record right after.
+    // staging the ring can't fit while an earlier stage still hasn't been followed by commands() throws
+    Staging stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+    // the open batch's command buffer, begun on first use
+    VkCommandBuffer commands();
+
+    // submits the open batch (no-op if nothing was recorded), returns the value everything so far signals
+    uint64_t flush();
+    void wait(uint64_t value);
+    // gives back the staging of every batch the gpu is done with
+    void retire();
+
+    VkSemaphore semaphore() const { return _timeline; }
+    uint64_t lastFlushed() const { return _flushed; }
+
+private:
+
+    struct Batch {
+
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        uint64_t value = 0;
+        uint64_t ringEnd = 0; // ring head when it went out, tail moves here once it retires
+        std::vector<AllocatedBuffer> dedicated;
+    };
+
+    VkEngine* _engine = nullptr;
+    VkCommandPool _pool = VK_NULL_HANDLE;
+    VkSemaphore _timeline = VK_NULL_HANDLE;
+
+    AllocatedBuffer _ring{};
+    uint8_t* _mapped = nullptr;
+    VkDeviceSize _ringSize = 0;
+    // monotonic byte counters, position in the ring is counter % _ringSize
+    uint64_t _head = 0;
+    uint64_t _tail = 0;
+    // ring staging handed out since the last commands(), not in any batch yet so it can't be flushed or reclaimed
+    bool _pending = false;
+
+    Batch _open;
+    bool _recording = false;
+    std::deque<Batch> _inFlight;
+    std::vector<VkCommandBuffer> _freeCommands;
+
+    uint64_t _flushed = 0;
+};
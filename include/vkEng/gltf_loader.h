@@ -3,6 +3,7 @@
 #include "vkEng/vk_helper_funcs.h"
 #include "vkEng/Descriptor/vk_descriptor.h"
 #include "vkEng/pbr_pipeline.h"
+#include "Renderer/Scene/scene_cache.h"
 
 // forward decs
 class VkEngine;
@@ -10,7 +11,7 @@ struct VertexData;
 std::optional<AllocatedImage> loadImage(VkEngine* engine, fastgltf::Asset& asset, fastgltf::Image& image);
 
 struct Node;
-class gltfData {
+class gltfData : public std::enable_shared_from_this<gltfData> {
 public:
 
 	struct GltfLoadContext {
@@ -20,15 +21,64 @@ public:
 		VkEngine* engine;
 	};
 
+	// knobs for how a file gets loaded, defaults are the fast path
+	struct LoadSettings {
+
+		// decode + tangent gen each mesh on the job pool, uploads stay on the calling thread
+		bool parallelMeshDecode = true;
+
+		// vertex cache / overdraw / fetch reordering after tangent gen (Renderer/Scene/mesh_optimizer.h)
+		bool optimizeMeshes = true;
+		// how much acmr the overdraw sort may cost as a ratio, 1.0 = only where it costs nothing
+		float overdrawThreshold = 1.05f;
+		// print acmr/atvr before and after per mesh
+		bool reportMeshStats = true;
+		// time the old scalar tangent pass against Renderer/Scene/tangents.h on every mesh that needs generating and print both
+		bool benchmarkTangents = false;
+
+		// simplified copies of every surface appended to its index buffer (Renderer/Scene/mesh_lod.h), picked per instance by screen size
+		bool generateLods = true;
+		uint32_t maxLods = 4;
+		// simplification error per level relative to the surface radius, last one repeats
+		std::vector<float> lodErrorTargets = { 0.01f, 0.02f, 0.05f };
+
+		// upload MeshUtils::PackedVertex + 16 bit indices where they fit, needs VkEngine::usePackedVertices to match
+		bool packedVertices = false;
+
+		// decode images on the job pool and upload them from the calling thread as they come in
+		bool parallelImageDecode = true;
+		// max decoded-but-not-uploaded images held at once
+		uint32_t imageQueueDepth = 8;
+		// block compress every image on the job pool after decode (Renderer/Scene/texture_compress.h), format per the slots
+		// sampling it. the scene cache keeps the compressed chains so this only runs on a cold load
+		bool compressTextures = true;
+
+		// load from / bake to <name>.vk.acrscene next to the file, rebuilt automatically when the hash goes stale
+		bool useSceneCache = true;
+
+		// LoadAsync only: render thread time pump() may spend uploading per frame (always at least one item),
+		// and how often newly visible objects get handed to the draw context
+		float streamBudgetMs = 4.0f;
+		float streamCommitMs = 100.0f;
+	};
+
 	gltfData() = default;
+	~gltfData();
 
 	// nodes that dont have a parent, for iterating through the file in tree order
 	std::vector<std::shared_ptr<Node>> topNodes;
-	AllocatedBuffer materialDataBuffer;
 
-	static std::shared_ptr<gltfData> Load(VkEngine* engine, std::filesystem::path path);
+	static std::shared_ptr<gltfData> Load(VkEngine* engine, std::filesystem::path path, LoadSettings settings = {});
 	void drawNodes(DrawContext& ctx);
 
+	// returns straight away, hashing/parsing/decoding runs on the job pool and pump() brings the results in a bit per frame.
+	// nodes show up once their mesh is uploaded, materials start on the engine's white placeholder and pick up textures as they land
+	static std::shared_ptr<gltfData> LoadAsync(VkEngine* engine, std::filesystem::path path, LoadSettings settings = {});
+	// render thread, once per frame right after frame's fence wait: that frame's copy of each material picks up its new textures then.
+	// returns true when surfaces were appended to ctx (instance buffer needs the new tail)
+	bool pump(DrawContext& ctx, uint32_t frame);
+	bool streaming() const { return stream != nullptr; }
+
 	//~gltfData() { destroyAll(); };
 
 private:
@@ -40,9 +90,21 @@ private:
 	void fetchPBRTextures(fastgltf::Material& mat, GltfLoadContext ctx, PBRMaterialSystem::MaterialResources& materialResources, std::vector<VkSampler>& samplers, std::vector<AllocatedImage>& images);
 	std::vector<std::shared_ptr<MeshAsset>> loadMeshes(GltfLoadContext ctx, std::vector<std::shared_ptr<gltfMaterial>> materials);
 	std::vector<std::shared_ptr<Node>> loadNodes(GltfLoadContext ctx, std::vector<std::shared_ptr<MeshAsset>> vecMeshes);
+	void loadFromCache(GltfLoadContext ctx, const SceneCache::SceneView& view);
+	std::vector<std::shared_ptr<gltfMaterial>> loadCachedMaterials(GltfLoadContext ctx, const SceneCache::SceneView& view, std::vector<VkSampler>& samplers, std::vector<AllocatedImage>& images);
+	std::vector<std::shared_ptr<Node>> loadCachedNodes(GltfLoadContext ctx, const SceneCache::SceneView& view, const std::vector<std::shared_ptr<MeshAsset>>& vecMeshes);
+
+	struct StreamState;
+	void beginStream();
+	bool uploadNextMesh();
+	bool uploadNextImage();
 
 	//void destroyAll();
 
+	LoadSettings settings;
+	std::unique_ptr<SceneCache::SceneData> bake; // only alive during a cold load that's writing the cache
+	std::unique_ptr<StreamState> stream; // only alive while a LoadAsync scene is still coming in, last so it goes first
+
 	
 };
 
@@ -69,7 +131,12 @@ struct Node {
 struct MeshNode : public Node {
 
 	std::shared_ptr<MeshAsset> mesh;
-	RenderObject createRenderObject(const GeoSurface& surface);
+	// EXT_mesh_gpu_instancing, already multiplied by worldTransform. empty means draw once at worldTransform
+	std::vector<glm::mat4> instanceTransforms;
+
+	RenderObject createRenderObject(const GeoSurface& surface, const glm::mat4& transform);
+	// just this node's surfaces, no children. a mesh that hasn't streamed in yet has no surfaces so this pushes nothing
+	void pushRenderObjects(DrawContext& ctx);
 	virtual void Draw(DrawContext& ctx) override;
 };
 
@@ -1,5 +1,7 @@
 #pragma once
 #include "vk_types.h"
+#include "Renderer/Scene/mesh_lod.h"
+#include <map>
 
 // GPU buffers and stores GPU memory address for shaders
 struct GPUMeshBuffers {
@@ -7,6 +9,12 @@ struct GPUMeshBuffers {
     AllocatedBuffer indexBuffer;
     AllocatedBuffer vertexBuffer;
     VkDeviceAddress vertexBufferAddress;
+
+    // UINT16 when the mesh was packed and every index fits
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    // dequant for packed positions, identity for float vertices
+    glm::vec4 posOffset = glm::vec4(0.0f);
+    glm::vec4 posScale = glm::vec4(1.0f);
 };
 
 // geometry bounding 
@@ -45,7 +53,7 @@ struct MaterialPipeline {
 struct MaterialInstance {
 
     MaterialPipeline matPipeline;
-    std::vector<VkDescriptorSet> materialSet;
+    uint32_t materialIndex = 0; // slot in PBRMaterialSystem's bindless material table
     MaterialPass type;
     VkDescriptorSet imageSamplerSet;
 };
@@ -53,6 +61,7 @@ struct MaterialInstance {
 struct gltfMaterial {
 
     MaterialInstance data;
+    bool doubleSided = false; // cluster backface culling only applies to single sided materials
 };
 
 
@@ -63,22 +72,18 @@ struct GeoSurface {
     uint32_t count;
     Bounds bounds;
     std::shared_ptr<gltfMaterial> material;
+
+    // lod chain (extra index ranges further down the same buffer) + clusters of every level, for per frame lod pick and culling
+    std::shared_ptr<const MeshUtils::SurfaceDetail> detail;
 };
 
 
-// complete mesh
+// complete mesh, shared by every node that references it (the transform lives on the node)
 struct MeshAsset {
 
     std::string name;
     std::vector<GeoSurface> surfaces;
     GPUMeshBuffers meshBuffers;
-    glm::mat4 transform;
-
-    std::shared_ptr<MeshAsset> clone() const {
-
-        auto copy = std::make_shared<MeshAsset>(*this);
-        return copy;
-    }
 };
 
 struct RenderObject {
@@ -89,17 +94,38 @@ struct RenderObject {
     VkBuffer indexBuffer;
     VkBuffer vertexBuffer;
     VkDeviceAddress vertexBufferAddress; // do i even use this . (the answer is no)
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    glm::vec4 posOffset = glm::vec4(0.0f);
+    glm::vec4 posScale = glm::vec4(1.0f);
     
     glm::mat4 transform; // probably should be part of matinstance
 
     std::shared_ptr<gltfMaterial> material;
-    std::vector<VkDescriptorSet> materialSet;
+    uint32_t materialIndex = 0;
+    std::shared_ptr<const MeshUtils::SurfaceDetail> detail;
+
+    // range into DrawContext::instances / instanceBuffer, filled in by buildInstances()
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 1;
 };
 
 struct DrawContext {
 
     std::vector<RenderObject> surfaces;
     // differential between opaque and transparent later.
+
+    // per instance model matrix + dequant, bound as vertex binding 1
+    std::vector<InstanceData> instances;
+    AllocatedBuffer instanceBuffer{};
+    // slots allocated in instanceBuffer / already copied in, so a streaming scene only writes the new tail
+    size_t instanceCapacity = 0;
+    size_t uploadedInstances = 0;
+
+    // merges surfaces that share (geometry, index range, material) into one instanced draw.
+    // transparent ones are left alone so they can still be depth sorted
+    void buildInstances();
+    // streaming: groups just batch's surfaces the same way and appends them + their instances, nothing already in here moves
+    void append(DrawContext& batch);
 };
 
 class PBRMaterialSystem {
@@ -130,6 +156,19 @@ public:
         glm::vec4 extra[11];           // pad to 256 bytes if you need
     };
 
+    // bindless: every texture is one slot of a single sampler2D array and every material one entry of a storage buffer
+    // (set 1), a draw only pushes its material's index. the table has a copy per frame in flight so a streamed texture
+    // can be swapped into one frame's copy while the other is still being read
+    static const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+    static const uint32_t MAX_MATERIALS = 4096;
+
+    // one material table entry, std430 Material in fPBR.frag. textures are bindless slots in SceneCache::TextureSlot order
+    struct alignas(16) GPUMaterial {
+
+        MaterialPBRConstants constants;
+        uint32_t textures[8];
+    };
+
     struct TextureBinding {
 
         AllocatedImage image;
@@ -145,18 +184,25 @@ public:
         TextureBinding transmission;
         TextureBinding volumeThickness;
 
-        VkBuffer dataBuffer;
-        uint32_t dataBufferOffset;
+        MaterialPBRConstants constants;
     };
 
     void initDescriptorSetLayouts();
+    // pool, the one bindless set and the material table. needs the allocator
+    void initBindless(VkEngine* engine);
+    void cleanupBindless(VkDevice device, VmaAllocator allocator);
     VkDescriptorSetLayout buildPipelines(VkEngine* engine);
+    // takes the next material table slot and fills every frame's copy (nothing can be drawing with a fresh slot yet)
     MaterialInstance writeMaterial(MaterialPass pass, const PBRMaterialSystem::MaterialResources& resources, VkEngine* engine);
-    VkWriteDescriptorSet makeImageWrite(VkDescriptorSet dstSet, uint32_t dstBinding, const TextureBinding& tb, VkDescriptorImageInfo& outInfo);
+    // rewrites only the texture slots of one frame's copy of a material. that frame has to be off the gpu (streamed textures swap in this way)
+    void writeTextures(uint32_t frame, uint32_t materialIndex, const MaterialResources& resources, VkEngine* engine);
+    // bindless slot for an image + sampler pair, written into the array the first time the pair shows up
+    uint32_t textureIndex(const TextureBinding& tb, VkEngine* engine);
     MaterialPipeline getPipeline(MaterialPass pass, VkEngine* engine);
 
     VkDescriptorSetLayout _descriptorSetLayoutCamera;
-    VkDescriptorSetLayout _descriptorSetLayoutMat;
+    VkDescriptorSetLayout _descriptorSetLayoutMat; // the bindless set
+    VkDescriptorSet bindlessSet = VK_NULL_HANDLE;
 
     // TODO: implement clearResources()
 
@@ -170,7 +216,7 @@ public:
         VkRenderPass renderPass;
         AllocatedImage sceneColorImage;
         VkSampler sampler;
-        VkPipeline pipeline;
+        std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE }; // built in the background
 
         bool isValid() const { return renderPass != VK_NULL_HANDLE && sceneColorImage.image != VK_NULL_HANDLE; }
     };
@@ -182,14 +228,20 @@ private:
 
     DescriptorManager* _descriptorManager;
 
-    enum MaterialTextureSlot {
+    VkDescriptorPool _bindlessPool = VK_NULL_HANDLE;
+    AllocatedBuffer _materialTable{};
+    uint32_t _materialCount = 0;
+    std::map<std::pair<VkImageView, VkSampler>, uint32_t> _textureSlots;
+
+    enum BindlessBinding {
 
-        MATERIAL_TEX_ALBEDO = 0,
-        MATERIAL_TEX_METAL_ROUGH = 1,
-        MATERIAL_TEX_OCCLUSION = 2,
-        MATERIAL_TEX_NORMAL = 3,
-        MATERIAL_TEX_TRANSMISSION = 4,
-        MATERIAL_TEX_THICKNESS = 5,
-        UBO_INDEX = 6
+        BINDLESS_TEXTURES = 0,
+        BINDLESS_MATERIALS = 1
     };
+
+    GPUMaterial* tableEntry(uint32_t frame, uint32_t materialIndex) {
+
+        return reinterpret_cast<GPUMaterial*>(_materialTable.info.pMappedData) + frame * MAX_MATERIALS + materialIndex;
+    }
+    void fillTextures(GPUMaterial& dst, const MaterialResources& resources, VkEngine* engine);
 };
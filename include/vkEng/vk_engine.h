@@ -4,6 +4,9 @@
 #include "vkEng/gltf_loader.h"
 #include "vk_types.h"
 #include "vkEng/Texture/texture_utils.h"
+#include "vkEng/Upload/upload_batcher.h"
+#include "vkEng/Pipeline/pipeline_cache.h"
+#include "vkEng/Pipeline/shader_compiler.h"
 #include "Editor/editor_context.h"
 #include "Core/IRenderEngine.h"
 class VkEngine : public IRenderEngine {
@@ -47,6 +50,30 @@ public:
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
 
+    // the scene is recorded in slices on the job pool, each slice into a secondary buffer from a pool only that slice's
+    // job touches. one set per frame in flight, a frame's pools are reset once its fence has been waited on
+    struct SceneRecorder {
+
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+        // what cmd has bound right now, bindDraw skips anything that already matches
+        struct BoundState {
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkBuffer vertexBuffer = VK_NULL_HANDLE;
+            VkBuffer indexBuffer = VK_NULL_HANDLE;
+            VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+            uint32_t material = UINT32_MAX;
+        } bound;
+        uint32_t bindsIssued = 0;
+        uint32_t bindsSkipped = 0;
+        MeshUtils::CullStats cullStats;
+        std::vector<MeshUtils::IndexRange> visibleClusters; // scratch, reused across objects
+    };
+    // sized to the job pool's concurrency
+    std::array<std::vector<SceneRecorder>, MAX_FRAMES_IN_FLIGHT> sceneRecorders;
+
     // Synchronization-related variables
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
@@ -58,6 +85,9 @@ public:
     VkCommandBuffer immCommandBuffer;
     VkCommandPool immCommandPool;
 
+    // mesh/texture uploads, batched into few submits instead of one blocking round trip each. frames wait on its timeline
+    UploadBatcher uploader;
+
     // Camera UBO for vulkan (storing this here and not in camera manager since vulkan is directly looking at this)
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
@@ -78,6 +108,7 @@ public:
 
     // default images
     AllocatedImage _whiteImage;
+    AllocatedImage _flatNormalImage;
     AllocatedImage _blackImage;
     AllocatedImage _errorImage;
 
@@ -87,7 +118,9 @@ public:
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
-    GPUMeshBuffers uploadMesh(std::vector<uint32_t> indices, std::vector<Vertex> vertices);
+    // packed = convert to MeshUtils::PackedVertex + 16 bit indices where they fit before uploading
+    GPUMeshBuffers uploadMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, bool packed = false);
+    GPUMeshBuffers uploadMesh(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, bool packed = false);
 
     void recreateSwapChain();
     void cleanupVkObjects();
@@ -99,6 +132,7 @@ public:
 
     AllocatedImage createImage(VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, bool mipmapped);
     AllocatedImage createImage(void* data, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, bool mipmapped);
+    AllocatedImage createImageWithMips(const void* data, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, uint32_t mipCount);
 
     gltfData loadedGltf;
     DescriptorManager descriptorManager;
@@ -108,13 +142,40 @@ public:
 
     DrawContext ctx;
 
+    // PackedVertexInput layout for the pbr pipeline + packed mesh uploads, 20 byte vertices instead of 60
+    bool usePackedVertices = false;
+
+    // frustum + backface cone test per cluster on the cpu while recording, survivors go out as one draw per run
+    bool useClusterCulling = true;
+    // pick a lod per instance from its projected size (Renderer/Scene/mesh_lod.h), goes through the same per instance loop
+    bool useLods = true;
+    int32_t forceLod = -1; // debug, -1 = by screen size
+    float lodErrorPixels = 1.0f;
+    // load the scene on the job pool and let it fill in while rendering instead of blocking setupEngine
+    bool streamScene = true;
+    // textureCompressionBC got enabled, set during device selection
+    bool supportsBlockCompression = false;
+    // set by the camera manager alongside the ubo
+    glm::mat4 cullViewProj = glm::mat4(1.0f);
+    glm::vec3 cullCameraPos = glm::vec3(0.0f);
+    float cullProjScale = 1.0f; // |proj[1][1]|, recordScene turns it into pixels with the swapchain height
+
     struct Pipelines {
 
         VkPipeline opaque;
-        VkPipeline transparent;
-        VkPipeline transmission;
+        // permutations compile in the background, null until they're ready
+        // transmission draws go through this one too (pipelineFor), there's no separate permutation for them
+        std::atomic<VkPipeline> transparent{ VK_NULL_HANDLE };
         VkPipelineLayout layout;
     } pipelines;
+    // on disk between runs, every pipeline above goes through it
+    PipelineCache pipelineCache;
+    // spirv for SHADER_SOURCES, kicked off in setupEngine so it overlaps device creation, createGraphicsPipeline waits on it
+    ShaderCompiler shaderCompiler;
+    std::future<std::vector<std::vector<uint32_t>>> shaderModules;
+
+    // the pass's pipeline, or opaque while that permutation is still compiling
+    VkPipeline pipelineFor(MaterialPass pass) const;
 
     // Pipeline-related variables
     VkRenderPass renderPass;
@@ -127,15 +188,44 @@ private:
 
     void cleanupSwapChain();
     void loadGltfFile();
+    void uploadInstances();
+    void streamSceneFrame();
     void drawGUI(VkCommandBuffer cb, VkImageView imageView);
     void presentFrame(uint32_t imageIndex);
     void submitFrame(VkCommandBuffer cmd);
-    void recordScene(VkCommandBuffer cmd);
-    void bindDraw(RenderObject& obj, VkCommandBuffer cmd);
+    // records the sorted draw list as secondaries and executes them, cmd has to be inside the scene render pass
+    void recordScene(VkCommandBuffer cmd, uint32_t imageIndex);
+    // draws [first, last) of _drawOrder into rec.cmd
+    void recordSlice(SceneRecorder& rec, size_t first, size_t last, uint32_t imageIndex);
+    void bindDraw(const RenderObject& obj, SceneRecorder& rec);
+    // fills _drawOrder with every surface sorted by drawKey
+    void sortDraws();
+    uint64_t drawKey(const RenderObject& obj);
+
+    // draw list order for this frame, sorted by key: pass, pipeline, material, mesh buffers, depth.
+    // transparent draws put depth (back to front) right after the pass instead so blending stays correct
+    struct SortedDraw {
+
+        uint64_t key;
+        uint32_t surface; // index into ctx.surfaces
+    };
+    std::vector<SortedDraw> _drawOrder;
+    // small stable ids for the key's pipeline / mesh fields, handed out on first sight
+    std::unordered_map<VkPipeline, uint32_t> _pipelineIds;
+    std::unordered_map<VkBuffer, uint32_t> _meshIds;
+    // below this many draws a slice isn't worth a job of its own
+    static constexpr size_t MIN_DRAWS_PER_SLICE = 256;
+
+    MeshUtils::ClusterCullParams _cullParams;
+
+    std::shared_ptr<gltfData> _scene;
+    // outgrown instance buffers + how many more frame starts until nothing can be reading them
+    std::vector<std::pair<AllocatedBuffer, uint32_t>> _retiredBuffers;
 
-    std::vector<std::string> SHADER_FILE_PATHS_TO_COMPILE = {
+    // vertex, fragment. createGraphicsPipeline relies on the order
+    std::vector<ShaderCompiler::Source> SHADER_SOURCES = {
 
-    "shaders/vk/vPBR.vert", "shaders/vk/fPBR.frag"
+    { "shaders/vk/vPBR.vert" }, { "shaders/vk/fPBR.frag" }
     };
 
 
@@ -7,7 +7,7 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice* device, VkSurfac
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 VkExtent2D chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
-VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice& device);
+VkShaderModule createShaderModule(const std::vector<uint32_t>& code, VkDevice& device);
 VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features, VkPhysicalDevice& physicalDevice);
 VkFormat findDepthFormat(VkPhysicalDevice& physicalDevice);
 bool hasStencilComponent(VkFormat format);
@@ -1,4 +1,5 @@
 #pragma once
+#include "Renderer/Scene/vertex_packing.h"
 #ifndef NDEBUG
 const bool enableValidationLayers = true;
 #else
@@ -81,6 +82,78 @@ struct Vertex {
 };
 
 
+// MeshUtils::PackedVertex on binding 0, same locations as Vertex so one shader handles both.
+// the formats fill in missing components (normal.z = 0, tangent.zw = 0/1), the vertex shader decodes
+// with the PACKED_VERTEX specialization constant. location 1 (color) isn't read by the shader so it's left out
+struct PackedVertexInput {
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(MeshUtils::PackedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(MeshUtils::PackedVertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 2;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(MeshUtils::PackedVertex, uv);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 3;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[2].offset = offsetof(MeshUtils::PackedVertex, normal);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 4;
+        attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[3].offset = offsetof(MeshUtils::PackedVertex, tangent);
+
+        return attributeDescriptions;
+    }
+};
+
+// per instance model matrix + position dequant, fed from a second vertex binding at instance rate.
+// a mat4 attribute takes 4 locations so this sits at 5..8 right after Vertex, posOffset/posScale at 9 and 10
+struct InstanceData {
+
+    glm::mat4 model;
+    glm::vec4 posOffset; // object pos = posOffset + posScale * pos, identity for float vertices
+    glm::vec4 posScale;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 6> getAttributeDescriptions() {
+
+        std::array<VkVertexInputAttributeDescription, 6> attributeDescriptions{};
+        for (uint32_t i = 0; i < 6; i++) {
+
+            attributeDescriptions[i].binding = 1;
+            attributeDescriptions[i].location = 5 + i;
+            attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[i].offset = sizeof(glm::vec4) * i;
+        }
+        return attributeDescriptions;
+    }
+};
+
 // These 2 structs are "helper" structs for initialization functions
 
 struct QueueFamilyIndices {
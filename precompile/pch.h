@@ -53,6 +53,13 @@
 #include <iomanip> 
 #include <filesystem>
 #include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <deque>
 
 #include "Core/Debug/debug_timer.h"
 #include "Core/Debug/logger.h"
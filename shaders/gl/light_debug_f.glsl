@@ -1,9 +1,13 @@
 #version 420 core
 out vec4 FragColor;
 
-uniform vec3 lightColor;
+layout(std140, binding = 9) uniform DebugDraw {
+
+    mat4 model;
+    vec4 lightColor;
+};
 
 void main()
 {
-    FragColor = vec4(lightColor, 1.0); // emissive sphere
+    FragColor = vec4(lightColor.rgb, 1.0); // emissive sphere
 }
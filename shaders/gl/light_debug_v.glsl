@@ -8,7 +8,12 @@ layout(std140, binding = 0) uniform Camera {
     vec4 viewPos;
 };
 
-uniform mat4 model;
+// one per sphere, sub allocated from the engine's dynamic ring
+layout(std140, binding = 9) uniform DebugDraw {
+
+    mat4 model;
+    vec4 lightColor;
+};
 
 void main()
 {
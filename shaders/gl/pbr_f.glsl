@@ -27,6 +27,23 @@ uniform sampler2D uPrevDepth;
 uniform sampler2D uSceneColor;
 
 
+#ifdef USE_MDI
+// multi draw path, one compact record per material picked through the instance's material index
+struct Material {
+    vec4 colorFactors;
+    vec4 metalRoughFactors;
+    vec4 volume;
+    vec4 attenuationColor;
+    vec4 transmission;
+};
+
+layout(std430, binding = 2) readonly buffer Materials {
+    Material materials[];
+};
+
+flat in uint vMaterial;
+#define material materials[vMaterial]
+#else
 layout(std140, binding = 8) uniform MaterialBuffer {
     vec4 colorFactors;
     vec4 metalRoughFactors; // x = metallic, y = roughness
@@ -36,6 +53,7 @@ layout(std140, binding = 8) uniform MaterialBuffer {
 
     vec4 transmission;       // x=usesTransmission, y=transmissionFactor
 } material;
+#endif
 
 //vec3 baseColor = (texture(albedoTex, TexCoord) * material.colorFactors).rgb;
 const float PI = 3.1415926;
@@ -136,8 +154,10 @@ vec3 getWorldNormal() {
 
     mat3 TBN = mat3(T, B, N);
 
-    // [0, 1] -> [-1, 1] (cuz its gltf!)
-    vec3 n_ts = texture(normalTex, TexCoord).xyz * 2.0 - 1.0;
+    // [0, 1] -> [-1, 1] (cuz its gltf!). only xy is stored (bc5), z comes back from unit length
+    vec3 n_ts;
+    n_ts.xy = texture(normalTex, TexCoord).rg * 2.0 - 1.0;
+    n_ts.z = sqrt(max(1.0 - dot(n_ts.xy, n_ts.xy), 0.0));
     return normalize(TBN * n_ts);
 }
 
@@ -1,8 +1,16 @@
-#version 430 core
+#version 460 core
+#ifdef PACKED_VERTEX
+// MeshUtils::PackedVertex: unorm16 pos + tangent sign in w, octahedral snorm16 normal/tangent, half uv
+layout(location = 0) in vec4 aPos;
+layout(location = 1) in vec2 aNormal;
+layout(location = 2) in vec2 aUV;
+layout(location = 3) in vec2 aTangent;
+#else
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aUV;
 layout(location = 3) in vec4 aTangent;
+#endif
 
 layout(std140, binding = 0) uniform Camera {
 
@@ -11,7 +19,27 @@ layout(std140, binding = 0) uniform Camera {
     vec4 viewPos;
 };
 
-uniform mat4 model;
+// one per instance slot, see GPUInstance / GltfDrawContext::buildInstances
+struct Instance {
+
+    mat4 model;
+    vec4 posOffset; // object pos = posOffset + posScale * aPos, identity for float vertices
+    vec4 posScale;
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+
+    Instance instances[];
+};
+
+#ifdef USE_MDI
+// material index per instance slot, same indexing as instances (see MultiDrawPass::buildMaterials)
+layout(std430, binding = 3) readonly buffer InstanceMaterials {
+
+    uint instanceMaterial[];
+};
+flat out uint vMaterial;
+#endif
 
 out vec2 TexCoord;
 out vec3 Normal;
@@ -26,27 +54,54 @@ out vec3 vT; // world space tangent
 out vec3 vN; // world space normal
 out float vTSign; // tangent.w sign
 
+#ifdef PACKED_VERTEX
+// inverse of MeshUtils::octEncode
+vec3 octDecode(vec2 e) {
+
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
+
 void main() {
 
+    Instance inst = instances[gl_BaseInstance + gl_InstanceID];
+    mat4 model = inst.model;
+#ifdef USE_MDI
+    vMaterial = instanceMaterial[gl_BaseInstance + gl_InstanceID];
+#endif
+
+#ifdef PACKED_VERTEX
+    vec3 objPos = inst.posOffset.xyz + inst.posScale.xyz * aPos.xyz;
+    vec3 objNormal = octDecode(aNormal);
+    vec4 objTangent = vec4(octDecode(aTangent), aPos.w * 2.0 - 1.0);
+#else
+    vec3 objPos = inst.posOffset.xyz + inst.posScale.xyz * aPos;
+    vec3 objNormal = aNormal;
+    vec4 objTangent = aTangent;
+#endif
+
     TexCoord = aUV;
-    Normal = aNormal;
+    Normal = objNormal;
     ViewPos = viewPos.xyz;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
+    WorldPos = vec3(model * vec4(objPos, 1.0));
     m_Model = model;
     m_Projection = proj;
     m_View = view;
 
-    gl_Position = proj * view * model * vec4(aPos, 1.0);
+    gl_Position = proj * view * model * vec4(objPos, 1.0);
 
     // normals
     mat3 nMat = transpose(inverse(mat3(model)));
-    vec3 N = normalize(nMat * aNormal);
-    vec3 T = normalize(mat3(model) * aTangent.xyz);
+    vec3 N = normalize(nMat * objNormal);
+    vec3 T = normalize(mat3(model) * objTangent.xyz);
     T = normalize(T - N * dot(N, T)); // make T orthogonal to N
 
     vN = N;
     vT = T;
-    vTSign = aTangent.w;
+    vTSign = objTangent.w;
 
 
 
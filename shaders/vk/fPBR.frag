@@ -1,5 +1,6 @@
 #version 450
-#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 1) in vec2 TexCoord;
 layout(location = 2) in vec3 Normal;
@@ -9,14 +10,19 @@ layout(location = 5) in mat3 TBN;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
-layout(set = 1, binding = 1) uniform sampler2D metalRoughSampler;
-layout(set = 1, binding = 2) uniform sampler2D occSampler;
-layout(set = 1, binding = 3) uniform sampler2D normalSampler;
-layout(set = 1, binding = 4) uniform sampler2D trSampler;
-layout(set = 1, binding = 5) uniform sampler2D thicknessSampler;
+// bindless, every texture in the scene. only slots some material points at are written
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
-layout(set = 1, binding = 6, std140) uniform MaterialBuffer {
+// texture slots in scene cache order
+const uint TEX_ALBEDO = 0u;
+const uint TEX_METAL_ROUGH = 1u;
+const uint TEX_OCCLUSION = 2u;
+const uint TEX_NORMAL = 3u;
+const uint TEX_TRANSMISSION = 4u;
+const uint TEX_THICKNESS = 5u;
+
+// PBRMaterialSystem::GPUMaterial
+struct Material {
     vec4 colorFactors;
     vec4 metalRoughFactors;
 
@@ -24,14 +30,21 @@ layout(set = 1, binding = 6, std140) uniform MaterialBuffer {
     vec4 attenuationColor;   // rgb=attenuationColor
 
     vec4 transmission;       // x=usesTransmission, y=transmissionFactor
-} material;
+    vec4 extra[11];
+
+    uint textures[8];
+};
+
+layout(set = 1, binding = 1, std430) readonly buffer MaterialTable {
+    Material materials[];
+};
 
-layout(set = 0, binding = 0) uniform FrameUBO {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-    vec3 viewPos;
-} frame;
+// already offset to this frame's copy of the table
+layout(push_constant) uniform DrawConstants {
+    uint material;
+} draw;
+
+#include "frame.glsl"
 
 const float PI = 3.1415926;
 
@@ -82,13 +95,21 @@ void main() {
     vec3 lightPos[2] = { vec3(2.0, 0.4, 0.5), vec3(0.5, 1.2, 0.2) };
     vec3 lightColor[2] = { vec3(5.0, 4.75, 4.0), vec3(3.0, 4.0, 5.0) };
 
-    vec3 albedo = texture(texSampler, TexCoord).rgb * material.colorFactors.rgb;
-    float metallic = texture(metalRoughSampler, TexCoord).r * material.metalRoughFactors.x;
-    float roughness = texture(metalRoughSampler, TexCoord).g * material.metalRoughFactors.y;
-    float ao = texture(occSampler, TexCoord).r;
+    // the index is the same for the whole draw, so no nonuniformEXT needed
+    Material material = materials[draw.material];
+
+    vec4 albedoSample = texture(textures[material.textures[TEX_ALBEDO]], TexCoord) * material.colorFactors;
+    vec3 albedo = albedoSample.rgb;
+    vec4 metalRough = texture(textures[material.textures[TEX_METAL_ROUGH]], TexCoord);
+    float metallic = metalRough.r * material.metalRoughFactors.x;
+    float roughness = metalRough.g * material.metalRoughFactors.y;
+    float ao = texture(textures[material.textures[TEX_OCCLUSION]], TexCoord).r;
 
-    vec3 normal = texture(normalSampler, TexCoord).rgb;
-    normal = normalize(TBN * (normal * 2.0 - 1.0));
+    // only xy is stored (bc5), z comes back from unit length
+    vec3 normal;
+    normal.xy = texture(textures[material.textures[TEX_NORMAL]], TexCoord).rg * 2.0 - 1.0;
+    normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+    normal = normalize(TBN * normal);
 
     vec3 F0 = mix(vec3(0.04), albedo, metallic);
 
@@ -132,7 +153,8 @@ void main() {
         return;
     }
 
-   outColor = vec4(color, 1.0);
+   // only the transparent pipeline blends, opaque ignores alpha
+   outColor = vec4(color, albedoSample.a);
    //outColor = vec4(TexCoord, 0.0, 1.0);
 
     //outColor = vec4(normal * 0.5 + 0.5, 1.0);
@@ -0,0 +1,7 @@
+// set 0, shared by every stage. matches FrameUBO in camera_manager.h
+layout(set = 0, binding = 0) uniform FrameUBO {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec3 viewPos;
+} frame;
@@ -1,2 +0,0 @@
-glslc vPBRTemp.vert -o vPBR.spv
-glslc fPBRTemp.frag -o fPBR.spv
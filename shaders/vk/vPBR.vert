@@ -1,21 +1,20 @@
 #version 450
-#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(set = 0, binding = 0) uniform FrameUBO {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-    vec3 viewPos;
-} frame;
+#include "frame.glsl"
 
-layout(push_constant) uniform PushConstants { mat4 model; } pc;
 
+// set from VkEngine::usePackedVertices. packed: pos is unorm in the mesh bounds with the tangent sign in w,
+// normal/tangent are octahedral in xy (see MeshUtils::PackedVertex)
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
+layout(location = 0) in vec4 inPosition;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 layout(location = 4) in vec4 inTangent;
+layout(location = 5) in mat4 inModel; // per instance, takes 5..8
+layout(location = 9) in vec4 inPosOffset;
+layout(location = 10) in vec4 inPosScale;
 //layout(location = 4) in uint isEmissive;
 
 //layout(location = 0) out vec3 fragColor;
@@ -26,18 +25,32 @@ layout(location = 4) out vec3 viewPos;
 layout(location = 5) out mat3 outTBN;
 //layout(location = 4) flat out uint fragEmissive;
 
+// inverse of MeshUtils::octEncode
+vec3 octDecode(vec2 e) {
+
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
 
-    gl_Position = frame.proj * frame.view * pc.model * vec4(inPosition, 1.0);
-    fragPos = vec3(pc.model * vec4(inPosition, 1.0));
-    fragNormal = inNormal;
+    vec3 objPos = inPosOffset.xyz + inPosScale.xyz * inPosition.xyz;
+    vec3 normal = PACKED_VERTEX ? octDecode(inNormal.xy) : inNormal;
+    vec4 objTangent = PACKED_VERTEX ? vec4(octDecode(inTangent.xy), inPosition.w * 2.0 - 1.0) : inTangent;
+
+    gl_Position = frame.proj * frame.view * inModel * vec4(objPos, 1.0);
+    fragPos = vec3(inModel * vec4(objPos, 1.0));
+    fragNormal = normal;
     fragTexCoord = inTexCoord;
     viewPos = frame.viewPos;
 
     // normal map calculation
 
-    vec3 T = normalize(mat3(pc.model) * vec3(1, 0, 0));//inTangent.xyz); //* vec3(1, 0, 0));
-    vec3 N = normalize(mat3(pc.model) * inNormal);
-    vec3 B = cross(N, T);// * inTangent.w;
+    vec3 N = normalize(mat3(inModel) * normal);
+    vec3 T = normalize(mat3(inModel) * objTangent.xyz);
+    T = normalize(T - N * dot(N, T)); // make T orthogonal to N
+    vec3 B = cross(N, T) * objTangent.w;
     outTBN = mat3(T, B, N);
 }
\ No newline at end of file
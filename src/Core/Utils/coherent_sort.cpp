@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "Core/Utils/coherent_sort.h"
+
+namespace Utils::Sort {
+
+	void radixSort(std::vector<KeyIndex>& items, std::vector<KeyIndex>& scratch) {
+
+		size_t n = items.size();
+		if (n < 2) return;
+
+		// a bit that's the same everywhere shows up as 0 here, a whole byte of those is a pass that can't move anything
+		uint64_t allOr = 0, allAnd = ~0ull;
+		for (const auto& item : items) {
+
+			allOr |= item.key;
+			allAnd &= item.key;
+		}
+		uint64_t varying = allOr ^ allAnd;
+
+		scratch.resize(n);
+		KeyIndex* src = items.data();
+		KeyIndex* dst = scratch.data();
+
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+
+			if (((varying >> shift) & 0xFF) == 0) continue;
+
+			uint32_t offsets[256] = {};
+			for (size_t i = 0; i < n; i++) offsets[(src[i].key >> shift) & 0xFF]++;
+
+			uint32_t sum = 0;
+			for (uint32_t& offset : offsets) {
+
+				uint32_t count = offset;
+				offset = sum;
+				sum += count;
+			}
+
+			for (size_t i = 0; i < n; i++) dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+			std::swap(src, dst);
+		}
+
+		if (src != items.data()) std::copy(src, src + n, items.data());
+	}
+
+	bool CoherentSort::insertionSort(size_t moveBudget) {
+
+		size_t moves = 0;
+		for (size_t i = 1; i < _items.size(); i++) {
+
+			KeyIndex item = _items[i];
+			size_t j = i;
+			while (j > 0 && _items[j - 1].key > item.key) {
+
+				_items[j] = _items[j - 1];
+				j--;
+				// gave up half way, the list is still a permutation so the radix sort can take it from here
+				if (++moves > moveBudget) {
+
+					_items[j] = item;
+					return false;
+				}
+			}
+			_items[j] = item;
+		}
+		return true;
+	}
+
+	const std::vector<uint32_t>& CoherentSort::sort(const std::vector<uint64_t>& keys) {
+
+		size_t n = keys.size();
+
+		// the list only ever grows while a scene streams in, new items go on the end. a smaller one is a different list
+		if (_order.size() > n) _order.clear();
+		for (uint32_t i = static_cast<uint32_t>(_order.size()); i < n; i++) _order.push_back(i);
+
+		_items.resize(n);
+		size_t descents = 0;
+		for (size_t i = 0; i < n; i++) {
+
+			_items[i] = { keys[_order[i]], _order[i] };
+			if (i > 0 && _items[i].key < _items[i - 1].key) descents++;
+		}
+
+		if (descents == 0) {
+
+			_method = Method::Unchanged;
+			return _order;
+		}
+
+		// a few objects crossing each other costs a few moves each, the budget keeps a camera cut from going quadratic
+		_method = Method::Insertion;
+		if (descents > n / 16 + 1 || !insertionSort(n * 2)) {
+
+			_method = Method::Radix;
+			radixSort(_items, _scratch);
+		}
+
+		for (size_t i = 0; i < n; i++) _order[i] = _items[i].index;
+		return _order;
+	}
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "Core/Utils/mapped_file.h"
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Utils::File {
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+
+		if (this == &other) return *this;
+		close();
+
+		_data = std::exchange(other._data, nullptr);
+		_size = std::exchange(other._size, 0);
+#if defined(_WIN32)
+		_file = std::exchange(other._file, nullptr);
+		_mapping = std::exchange(other._mapping, nullptr);
+#else
+		_fd = std::exchange(other._fd, -1);
+#endif
+		return *this;
+	}
+
+#if defined(_WIN32)
+
+	bool MappedFile::open(const std::filesystem::path& path) {
+
+		close();
+
+		HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) {
+
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		_file = file;
+		_mapping = mapping;
+		_data = static_cast<const uint8_t*>(view);
+		_size = static_cast<size_t>(fileSize.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close() {
+
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file) CloseHandle(_file);
+
+		_data = nullptr;
+		_size = 0;
+		_mapping = nullptr;
+		_file = nullptr;
+	}
+
+#else
+
+	bool MappedFile::open(const std::filesystem::path& path) {
+
+		close();
+
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) {
+
+			::close(fd);
+			return false;
+		}
+		madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+		_fd = fd;
+		_data = static_cast<const uint8_t*>(view);
+		_size = static_cast<size_t>(st.st_size);
+		return true;
+	}
+
+	void MappedFile::close() {
+
+		if (_data) munmap(const_cast<uint8_t*>(_data), _size);
+		if (_fd >= 0) ::close(_fd);
+
+		_data = nullptr;
+		_size = 0;
+		_fd = -1;
+	}
+
+#endif
+}
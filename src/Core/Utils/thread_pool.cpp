@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "Core/Utils/thread_pool.h"
+
+namespace Utils::Jobs {
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+
+		if (threadCount == 0) {
+
+			// leave one core for the main thread, it joins in on parallelFor anyways
+			uint32_t hw = std::thread::hardware_concurrency();
+			threadCount = hw > 1 ? hw - 1 : 1;
+		}
+
+		_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+
+			_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_cv.notify_all();
+
+		for (auto& w : _workers) {
+
+			if (w.joinable()) w.join();
+		}
+	}
+
+	void ThreadPool::enqueue(std::function<void()> job) {
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push_back(std::move(job));
+		}
+		_cv.notify_one();
+	}
+
+	void ThreadPool::workerLoop() {
+
+		while (true) {
+
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cv.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+				if (_stopping && _jobs.empty()) return;
+
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+
+		if (count == 0) return;
+		if (count == 1) { fn(0); return; }
+
+		// shared between the caller and helpers, helpers can outlive this call (they just find no work)
+		struct ForState {
+
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> done{ 0 };
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::exception_ptr error;
+		};
+		auto state = std::make_shared<ForState>();
+		const std::function<void(size_t)>* body = &fn;
+
+		auto run = [state, body, count]() {
+
+			size_t finished = 0;
+			for (size_t i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1)) {
+
+				try {
+
+					(*body)(i);
+				}
+				catch (...) {
+
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (!state->error) state->error = std::current_exception();
+				}
+				finished++;
+			}
+
+			if (finished && state->done.fetch_add(finished) + finished == count) {
+
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->cv.notify_all();
+			}
+		};
+
+		size_t helpers = std::min<size_t>(_workers.size(), count - 1);
+		for (size_t i = 0; i < helpers; i++) enqueue(run);
+
+		run();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->cv.wait(lock, [&]() { return state->done.load() == count; });
+
+		if (state->error) std::rethrow_exception(state->error);
+	}
+}
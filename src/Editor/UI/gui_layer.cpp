@@ -38,6 +38,11 @@ void GuiLayer::DrawFPSCounter() {
     if (ImGui::Begin("FPSOverlay", nullptr, flags)) {
         ImGui::Text("FPS: %.1f", fps);
         ImGui::Text("Frame: %.3f ms", 1000.0f / fps);
+        ImGui::Text("Clusters: %u tested, %u culled", editorContext.clustersTested, editorContext.clustersCulled);
+        ImGui::Text("Triangles: %u", editorContext.trianglesSubmitted);
+        ImGui::Text("Binds: %u issued, %u skipped (record %.3f ms)", editorContext.bindsIssued, editorContext.bindsSkipped, editorContext.recordMs);
+        ImGui::Text("Textures: %.1f MB resident, %.1f MB requested, %.1f MB budget", editorContext.textureResidentBytes / 1048576.0,
+            editorContext.textureRequestedBytes / 1048576.0, editorContext.textureBudgetBytes / 1048576.0);
     }
     ImGui::End();
 }
\ No newline at end of file
@@ -113,6 +113,9 @@ void CameraManager::passToEngine() {
     if (auto* vk = dynamic_cast<VkEngine*>(_engine)) {
 
         memcpy(vk->uniformBuffersMapped[vk->currentFrame], &ubo, sizeof(FrameUBO));
+        vk->cullViewProj = ubo.proj * ubo.view;
+        vk->cullCameraPos = ubo.viewPos;
+        vk->cullProjScale = std::abs(ubo.proj[1][1]);
         return;
     }
 #endif
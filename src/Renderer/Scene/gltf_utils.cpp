@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "Renderer/Scene/gltf_utils.h"
+#include "Renderer/Scene/meshopt_codec.h"
+#include "Core/Utils/thread_pool.h"
+#include <glm/gtc/quaternion.hpp>
+
+namespace GltfUtils {
+
+	bool bufferBytes(const fastgltf::Buffer& buffer, std::vector<uint8_t>& storage, const uint8_t*& bytes) {
+
+		if (std::holds_alternative<fastgltf::sources::Array>(buffer.data)) {
+
+			bytes = reinterpret_cast<const uint8_t*>(std::get<fastgltf::sources::Array>(buffer.data).bytes.data());
+			return true;
+		}
+		if (std::holds_alternative<fastgltf::sources::Vector>(buffer.data)) {
+
+			bytes = reinterpret_cast<const uint8_t*>(std::get<fastgltf::sources::Vector>(buffer.data).bytes.data());
+			return true;
+		}
+		if (std::holds_alternative<fastgltf::sources::ByteView>(buffer.data)) {
+
+			bytes = reinterpret_cast<const uint8_t*>(std::get<fastgltf::sources::ByteView>(buffer.data).bytes.data());
+			return true;
+		}
+		if (std::holds_alternative<fastgltf::sources::URI>(buffer.data)) {
+
+			auto& filePath = std::get<fastgltf::sources::URI>(buffer.data);
+			std::string path(filePath.uri.path().begin(), filePath.uri.path().end());
+			std::ifstream file(path, std::ios::binary);
+			if (!file) return false;
+
+			storage.resize(buffer.byteLength);
+			file.read(reinterpret_cast<char*>(storage.data()), std::streamsize(storage.size()));
+			bytes = storage.data();
+			return bool(file);
+		}
+		return false;
+	}
+
+	bool imageBytes(const fastgltf::Asset& asset, const fastgltf::Image& image, std::vector<uint8_t>& storage, const uint8_t*& bytes, size_t& size) {
+
+		if (std::holds_alternative<fastgltf::sources::URI>(image.data)) {
+
+			auto& filePath = std::get<fastgltf::sources::URI>(image.data);
+			std::string path(filePath.uri.path().begin(), filePath.uri.path().end());
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file) return false;
+
+			storage.resize(size_t(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(storage.data()), std::streamsize(storage.size()));
+			bytes = storage.data();
+			size = storage.size();
+			return bool(file);
+		}
+		if (std::holds_alternative<fastgltf::sources::Vector>(image.data)) {
+
+			auto& vector = std::get<fastgltf::sources::Vector>(image.data);
+			bytes = reinterpret_cast<const uint8_t*>(vector.bytes.data());
+			size = vector.bytes.size();
+			return true;
+		}
+		if (std::holds_alternative<fastgltf::sources::BufferView>(image.data)) {
+
+			auto& view = std::get<fastgltf::sources::BufferView>(image.data);
+			auto& bufView = asset.bufferViews[view.bufferViewIndex];
+			const uint8_t* rawBytes = nullptr;
+			if (!bufferBytes(asset.buffers[bufView.bufferIndex], storage, rawBytes)) return false;
+
+			bytes = rawBytes + bufView.byteOffset;
+			size = bufView.byteLength;
+			return true;
+		}
+		return false;
+	}
+
+	void decompressMeshopt(fastgltf::Asset& gltf) {
+
+		std::vector<size_t> views;
+		for (size_t i = 0; i < gltf.bufferViews.size(); i++) {
+
+			if (gltf.bufferViews[i].meshoptCompression) views.push_back(i);
+		}
+		if (views.empty()) return;
+
+		// uri buffers are read once up front, the decodes only ever read
+		std::vector<std::vector<uint8_t>> storage(gltf.buffers.size());
+		std::vector<const uint8_t*> sources(gltf.buffers.size(), nullptr);
+		for (size_t view : views) {
+
+			size_t buffer = gltf.bufferViews[view].meshoptCompression->bufferIndex;
+			if (!sources[buffer]) bufferBytes(gltf.buffers[buffer], storage[buffer], sources[buffer]);
+		}
+
+		std::vector<std::vector<std::byte>> decoded(views.size());
+		std::vector<char> ok(views.size(), 0);
+		Utils::Jobs::get().parallelFor(views.size(), [&](size_t i) {
+
+			const fastgltf::CompressedBufferView& c = *gltf.bufferViews[views[i]].meshoptCompression;
+			if (!sources[c.bufferIndex]) return;
+
+			MeshUtils::MeshoptMode mode = c.mode == fastgltf::MeshoptCompressionMode::Triangles ? MeshUtils::MeshoptMode::Triangles
+				: c.mode == fastgltf::MeshoptCompressionMode::Indices ? MeshUtils::MeshoptMode::Indices
+				: MeshUtils::MeshoptMode::Attributes;
+			MeshUtils::MeshoptFilter filter = c.filter == fastgltf::MeshoptCompressionFilter::Octahedral ? MeshUtils::MeshoptFilter::Octahedral
+				: c.filter == fastgltf::MeshoptCompressionFilter::Quaternion ? MeshUtils::MeshoptFilter::Quaternion
+				: c.filter == fastgltf::MeshoptCompressionFilter::Exponential ? MeshUtils::MeshoptFilter::Exponential
+				: MeshUtils::MeshoptFilter::None;
+
+			decoded[i].resize(c.count * c.byteStride);
+			ok[i] = MeshUtils::decodeMeshopt(reinterpret_cast<uint8_t*>(decoded[i].data()), c.count, c.byteStride, mode, filter,
+				sources[c.bufferIndex] + c.byteOffset, c.byteLength);
+		});
+
+		// buffers can't be added while the pool is still reading them, so the views get patched afterwards
+		for (size_t i = 0; i < views.size(); i++) {
+
+			fastgltf::BufferView& view = gltf.bufferViews[views[i]];
+			if (!ok[i]) {
+
+				std::cerr << "Failed to decode meshopt buffer view " << views[i] << '\n';
+				continue;
+			}
+
+			fastgltf::Buffer buffer;
+			buffer.byteLength = decoded[i].size();
+			buffer.data = fastgltf::sources::Vector{ std::move(decoded[i]), fastgltf::MimeType::None };
+			gltf.buffers.push_back(std::move(buffer));
+
+			view.bufferIndex = gltf.buffers.size() - 1;
+			view.byteOffset = 0;
+			view.byteLength = gltf.buffers.back().byteLength;
+			view.meshoptCompression.reset();
+		}
+	}
+
+	std::vector<glm::mat4> loadInstanceTransforms(const fastgltf::Asset& gltf, fastgltf::Node& node, const glm::mat4& world) {
+
+		std::vector<glm::mat4> out;
+		if (node.instancingAttributes.empty()) return out;
+
+		std::vector<glm::vec3> translations, scales;
+		std::vector<glm::quat> rotations;
+
+		auto translation = node.findInstancingAttribute("TRANSLATION");
+		if (translation != node.instancingAttributes.end()) {
+
+			fastgltf::iterateAccessor<glm::vec3>(gltf, gltf.accessors[translation->accessorIndex],
+				[&](glm::vec3 t) { translations.push_back(t); });
+		}
+		auto rotation = node.findInstancingAttribute("ROTATION");
+		if (rotation != node.instancingAttributes.end()) {
+
+			// gltf stores xyzw, glm::quat wants wxyz
+			fastgltf::iterateAccessor<glm::vec4>(gltf, gltf.accessors[rotation->accessorIndex],
+				[&](glm::vec4 r) { rotations.push_back(glm::quat(r.w, r.x, r.y, r.z)); });
+		}
+		auto scale = node.findInstancingAttribute("SCALE");
+		if (scale != node.instancingAttributes.end()) {
+
+			fastgltf::iterateAccessor<glm::vec3>(gltf, gltf.accessors[scale->accessorIndex],
+				[&](glm::vec3 s) { scales.push_back(s); });
+		}
+
+		size_t count = std::max({ translations.size(), rotations.size(), scales.size() });
+		out.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+
+			glm::mat4 t = glm::translate(glm::mat4(1.0f), i < translations.size() ? translations[i] : glm::vec3(0.0f));
+			glm::mat4 r = glm::mat4_cast(i < rotations.size() ? rotations[i] : glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+			glm::mat4 s = glm::scale(glm::mat4(1.0f), i < scales.size() ? scales[i] : glm::vec3(1.0f));
+			out.push_back(world * t * r * s);
+		}
+		return out;
+	}
+}
@@ -0,0 +1,390 @@
+#include "pch.h"
+#include "Renderer/Scene/mesh_lod.h"
+
+namespace MeshUtils {
+
+	template<typename T>
+	static T readAttrib(const uint8_t* vertices, size_t stride, size_t offset, uint32_t v) {
+
+		T r;
+		std::memcpy(&r, vertices + size_t(v) * stride + offset, sizeof(r));
+		return r;
+	}
+
+	// symmetric 4x4 plane quadric, area weighted. error() is the weighted mean squared distance to the planes
+	struct Quadric {
+
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0;
+		double w = 0;
+
+		void addPlane(const glm::vec3& n, float d, double weight) {
+
+			a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+			a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+			b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+			c += weight * double(d) * d;
+			w += weight;
+		}
+
+		void add(const Quadric& o) {
+
+			a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+			b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c; w += o.w;
+		}
+
+		double error(const glm::vec3& p) const {
+
+			double x = p.x, y = p.y, z = p.z;
+			double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + a11 * y * y + 2 * a12 * y * z + a22 * z * z
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return w > 0 ? std::max(e, 0.0) / w : 0.0;
+		}
+	};
+
+	struct PositionKey {
+
+		uint32_t x, y, z;
+		bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+	};
+
+	struct PositionKeyHash {
+
+		size_t operator()(const PositionKey& k) const { return (size_t(k.x) * 73856093u) ^ (size_t(k.y) * 19349663u) ^ (size_t(k.z) * 83492791u); }
+	};
+
+	std::vector<uint32_t> simplify(const uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, size_t targetIndexCount, float targetError, float attributeWeight, float* resultError) {
+
+		std::vector<uint32_t> out(indices, indices + indexCount);
+		if (resultError) *resultError = 0.0f;
+		if (indexCount < 3 || vertexCount == 0) return out;
+
+		auto pos = [&](uint32_t v) { return readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, v); };
+
+		// error is reported relative to the radius so levels of different sized meshes compare
+		glm::vec3 lo(std::numeric_limits<float>::max());
+		glm::vec3 hi(std::numeric_limits<float>::lowest());
+		for (size_t i = 0; i < indexCount; i++) {
+
+			glm::vec3 p = pos(indices[i]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		float scale = glm::length(hi - lo) * 0.5f;
+		if (scale <= 0.0f) return out;
+
+		// weld by position so uv/normal seams show up as vertex groups instead of borders
+		std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+		std::vector<uint32_t> canon(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> groupSize;
+		for (size_t i = 0; i < indexCount; i++) {
+
+			uint32_t v = indices[i];
+			if (canon[v] != UINT32_MAX) continue;
+
+			PositionKey key;
+			std::memcpy(&key, vertices + size_t(v) * vertexStride + attribs.position, sizeof(key));
+			auto [it, inserted] = welded.try_emplace(key, uint32_t(groupSize.size()));
+			if (inserted) groupSize.push_back(0);
+			canon[v] = it->second;
+			groupSize[it->second]++;
+		}
+
+		// anything on a seam, an open border or a non manifold edge stays put
+		std::vector<uint8_t> locked(vertexCount, 0);
+		std::unordered_map<uint64_t, uint32_t> edgeUse;
+		auto edgeKey = [&](uint32_t a, uint32_t b) {
+
+			uint64_t ca = canon[a], cb = canon[b];
+			return ca < cb ? (ca << 32) | cb : (cb << 32) | ca;
+		};
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+
+			for (int e = 0; e < 3; e++) edgeUse[edgeKey(out[i + e], out[i + (e + 1) % 3])]++;
+		}
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+
+			for (int e = 0; e < 3; e++) {
+
+				uint32_t a = out[i + e], b = out[i + (e + 1) % 3];
+				if (edgeUse[edgeKey(a, b)] != 2) locked[a] = locked[b] = 1;
+			}
+		}
+		for (size_t i = 0; i < indexCount; i++) {
+
+			if (groupSize[canon[indices[i]]] > 1) locked[indices[i]] = 1;
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+
+			glm::vec3 p0 = pos(out[i]), p1 = pos(out[i + 1]), p2 = pos(out[i + 2]);
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float len = glm::length(n);
+			if (len <= 0.0f) continue;
+
+			n /= len;
+			float d = -glm::dot(n, p0);
+			for (int c = 0; c < 3; c++) quadrics[out[i + c]].addPlane(n, d, len * 0.5);
+		}
+
+		// attribute distance gets the same units as the squared geometric error
+		double attribScale = double(attributeWeight) * scale * scale;
+		auto attribError = [&](uint32_t a, uint32_t b) {
+
+			glm::vec3 na = readAttrib<glm::vec3>(vertices, vertexStride, attribs.normal, a);
+			glm::vec3 nb = readAttrib<glm::vec3>(vertices, vertexStride, attribs.normal, b);
+			glm::vec2 ua = readAttrib<glm::vec2>(vertices, vertexStride, attribs.uv, a);
+			glm::vec2 ub = readAttrib<glm::vec2>(vertices, vertexStride, attribs.uv, b);
+			glm::vec3 dn = na - nb;
+			glm::vec2 du = ua - ub;
+			return attribScale * (0.25 * glm::dot(dn, dn) + double(du.x) * du.x + double(du.y) * du.y);
+		};
+
+		struct Collapse {
+
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		double errorLimit = double(targetError) * scale * double(targetError) * scale;
+		double maxCost = 0.0;
+
+		std::vector<uint32_t> adjOffset(vertexCount + 1);
+		std::vector<uint32_t> adjTris;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<Collapse> candidates;
+
+		// collapse in passes: cheapest first, each vertex's neighbourhood frozen after it moves so adjacency stays valid
+		while (out.size() > targetIndexCount) {
+
+			size_t triCount = out.size() / 3;
+
+			std::fill(adjOffset.begin(), adjOffset.end(), 0);
+			for (uint32_t v : out) adjOffset[v + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) adjOffset[v + 1] += adjOffset[v];
+			adjTris.resize(out.size());
+			{
+				std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+				for (size_t i = 0; i < out.size(); i++) adjTris[fill[out[i]]++] = uint32_t(i / 3);
+			}
+
+			candidates.clear();
+			for (size_t t = 0; t < triCount; t++) {
+
+				for (int e = 0; e < 3; e++) {
+
+					uint32_t a = out[t * 3 + e], b = out[t * 3 + (e + 1) % 3];
+					for (int dir = 0; dir < 2; dir++) {
+
+						uint32_t from = dir ? b : a, to = dir ? a : b;
+						if (locked[from] || canon[from] == canon[to]) continue;
+
+						Quadric q = quadrics[from];
+						q.add(quadrics[to]);
+						candidates.push_back({ from, to, q.error(pos(to)) + attribError(from, to) });
+					}
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			size_t removeGoal = (out.size() - targetIndexCount + 2) / 3;
+			size_t removed = 0;
+			size_t collapses = 0;
+			std::fill(touched.begin(), touched.end(), 0);
+			for (size_t v = 0; v < vertexCount; v++) remap[v] = uint32_t(v);
+
+			for (const Collapse& c : candidates) {
+
+				if (c.cost > errorLimit) break;
+				if (touched[c.from] || touched[c.to]) continue;
+
+				// moving from onto to must not fold any remaining triangle over
+				bool flips = false;
+				size_t dying = 0;
+				for (uint32_t k = adjOffset[c.from]; k < adjOffset[c.from + 1] && !flips; k++) {
+
+					const uint32_t* tri = &out[size_t(adjTris[k]) * 3];
+					if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+
+						dying++;
+						continue;
+					}
+
+					glm::vec3 p[3], q[3];
+					for (int i = 0; i < 3; i++) {
+
+						p[i] = pos(tri[i]);
+						q[i] = tri[i] == c.from ? pos(c.to) : p[i];
+					}
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					float lb = glm::length(before), la = glm::length(after);
+					flips = la <= 1e-12f || glm::dot(before, after) < 0.25f * lb * la;
+				}
+				if (flips) continue;
+
+				remap[c.from] = c.to;
+				quadrics[c.to].add(quadrics[c.from]);
+				maxCost = std::max(maxCost, c.cost);
+
+				for (uint32_t k = adjOffset[c.from]; k < adjOffset[c.from + 1]; k++) {
+
+					const uint32_t* tri = &out[size_t(adjTris[k]) * 3];
+					touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+				}
+				touched[c.to] = 1;
+
+				collapses++;
+				removed += dying;
+				if (removed >= removeGoal) break;
+			}
+			if (collapses == 0) break;
+
+			size_t write = 0;
+			for (size_t t = 0; t < triCount; t++) {
+
+				uint32_t a = remap[out[t * 3]], b = remap[out[t * 3 + 1]], c = remap[out[t * 3 + 2]];
+				if (a == b || b == c || a == c) continue;
+				out[write++] = a;
+				out[write++] = b;
+				out[write++] = c;
+			}
+			out.resize(write);
+		}
+
+		if (resultError) *resultError = float(std::sqrt(maxCost)) / scale;
+		return out;
+	}
+
+	std::vector<LodLevel> buildLodChain(std::vector<uint32_t>& indices, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, IndexRange base, const LodSettings& settings) {
+
+		std::vector<LodLevel> levels;
+		levels.push_back({ base.start, base.count, 0, 0, 0.0f });
+
+		std::vector<uint32_t> previous(indices.begin() + base.start, indices.begin() + base.start + base.count);
+		float accumulated = 0.0f;
+
+		for (uint32_t level = 1; level < settings.maxLevels && previous.size() / 3 > settings.minTriangles; level++) {
+
+			float target = settings.errorTargets.empty() ? 0.01f : settings.errorTargets[std::min<size_t>(level - 1, settings.errorTargets.size() - 1)];
+			size_t targetCount = size_t(previous.size() / 3 * settings.reduction) * 3;
+
+			float error = 0.0f;
+			std::vector<uint32_t> next = simplify(previous.data(), previous.size(), vertices, vertexCount, vertexStride, attribs,
+				targetCount, target, settings.attributeWeight, &error);
+
+			// a level that barely shrinks costs memory and buys nothing
+			if (next.empty() || next.size() * 10 > previous.size() * 9) break;
+
+			optimizeVertexCache(next.data(), next.size(), vertexCount);
+			accumulated += error;
+
+			levels.push_back({ uint32_t(indices.size()), uint32_t(next.size()), 0, 0, accumulated });
+			indices.insert(indices.end(), next.begin(), next.end());
+			previous = std::move(next);
+		}
+		return levels;
+	}
+
+	SurfaceDetail buildSurfaceDetail(std::vector<uint32_t>& indices, const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		const VertexAttribs& attribs, IndexRange range, const LodSettings* lodSettings, const MeshletSettings& meshletSettings) {
+
+		SurfaceDetail detail;
+		if (lodSettings) detail.lods = buildLodChain(indices, vertices, vertexCount, vertexStride, attribs, range, *lodSettings);
+		else detail.lods.push_back({ range.start, range.count, 0, 0, 0.0f });
+
+		for (auto& level : detail.lods) {
+
+			std::vector<Meshlet> clusters = buildMeshlets(indices.data(), { level.indexStart, level.indexCount }, vertices, vertexCount,
+				vertexStride, attribs.position, meshletSettings);
+			level.firstMeshlet = uint32_t(detail.meshlets.size());
+			level.meshletCount = uint32_t(clusters.size());
+			detail.meshlets.insert(detail.meshlets.end(), clusters.begin(), clusters.end());
+		}
+
+		// level 0 bounds, every level lives inside them give or take the simplification error
+		glm::vec3 lo(std::numeric_limits<float>::max());
+		glm::vec3 hi(std::numeric_limits<float>::lowest());
+		for (uint32_t i = 0; i < range.count; i++) {
+
+			glm::vec3 p = readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, indices[range.start + i]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		if (range.count == 0) return detail;
+
+		detail.center = (lo + hi) * 0.5f;
+		for (uint32_t i = 0; i < range.count; i++) {
+
+			glm::vec3 p = readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, indices[range.start + i]);
+			detail.radius = std::max(detail.radius, glm::length(p - detail.center));
+		}
+
+		// how many uv units one object unit covers on average, texels per unit is this * the texture's size
+		double uvArea = 0.0;
+		double posArea = 0.0;
+		for (uint32_t i = 0; i + 2 < range.count; i += 3) {
+
+			uint32_t a = indices[range.start + i], b = indices[range.start + i + 1], c = indices[range.start + i + 2];
+			glm::vec3 pa = readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, a);
+			glm::vec2 ta = readAttrib<glm::vec2>(vertices, vertexStride, attribs.uv, a);
+			glm::vec2 tb = readAttrib<glm::vec2>(vertices, vertexStride, attribs.uv, b) - ta;
+			glm::vec2 tc = readAttrib<glm::vec2>(vertices, vertexStride, attribs.uv, c) - ta;
+			posArea += 0.5 * glm::length(glm::cross(readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, b) - pa,
+				readAttrib<glm::vec3>(vertices, vertexStride, attribs.position, c) - pa));
+			uvArea += 0.5 * std::abs(tb.x * tc.y - tb.y * tc.x);
+		}
+		if (posArea > 0.0) detail.uvDensity = float(std::sqrt(uvArea / posArea));
+		return detail;
+	}
+
+	uint32_t selectLod(const SurfaceDetail& detail, const glm::mat4& model, const ClusterCullParams& params) {
+
+		uint32_t last = uint32_t(detail.lods.size()) - 1;
+		if (detail.lods.size() <= 1) return 0;
+		if (params.forceLod >= 0) return std::min(uint32_t(params.forceLod), last);
+		if (!params.lodSelect || params.lodScale <= 0.0f) return 0;
+
+		glm::mat3 linear(model);
+		float maxScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+		glm::vec3 center = glm::vec3(model * glm::vec4(detail.center, 1.0f));
+		float radius = detail.radius * maxScale;
+
+		// camera inside the sphere, nothing sensible to project
+		float dist = glm::length(center - params.cameraPos);
+		if (dist <= radius) return 0;
+
+		// lod error is relative to the radius, so projected radius in pixels * error = error in pixels
+		float projectedRadius = radius * params.lodScale / dist;
+		for (uint32_t level = last; level > 0; level--) {
+
+			if (detail.lods[level].error * projectedRadius <= params.lodErrorPixels) return level;
+		}
+		return 0;
+	}
+
+	uint32_t cullSurface(const SurfaceDetail& detail, const glm::mat4& model, const ClusterCullParams& params, bool backface,
+		std::vector<IndexRange>& visible, CullStats& stats) {
+
+		if (detail.lods.empty()) return 0;
+
+		uint32_t level = selectLod(detail, model, params);
+		const LodLevel& lod = detail.lods[level];
+
+		// too small to have been split, draw the level whole
+		if (lod.meshletCount == 0) {
+
+			stats.trianglesSubmitted += lod.indexCount / 3;
+			visible.push_back({ lod.indexStart, lod.indexCount });
+			return level;
+		}
+
+		cullMeshlets(detail.meshlets.data() + lod.firstMeshlet, lod.meshletCount, model, params, backface, visible, stats);
+		return level;
+	}
+}
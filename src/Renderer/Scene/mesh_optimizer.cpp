@@ -0,0 +1,369 @@
+#include "pch.h"
+#include "Renderer/Scene/mesh_optimizer.h"
+
+namespace MeshUtils {
+
+	// fifo cache using timestamps, a vertex is a hit if it was loaded less than cacheSize misses ago
+	class FifoCache {
+
+	public:
+
+		FifoCache(size_t vertexCount, uint32_t cacheSize) : _stamps(vertexCount, 0), _size(cacheSize), _time(cacheSize + 1) {}
+
+		uint32_t touch(uint32_t v) {
+
+			if (_time - _stamps[v] > _size) {
+
+				_stamps[v] = _time++;
+				return 1;
+			}
+			return 0;
+		}
+
+		uint32_t touchTriangle(const uint32_t* tri) { return touch(tri[0]) + touch(tri[1]) + touch(tri[2]); }
+
+		void reset() { _time += _size + 1; }
+
+	private:
+
+		std::vector<uint32_t> _stamps;
+		uint32_t _size;
+		uint32_t _time;
+	};
+
+	VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+
+		VertexCacheStats stats;
+		size_t triCount = indexCount / 3;
+		if (triCount == 0 || vertexCount == 0) return stats;
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<uint8_t> seen(vertexCount, 0);
+		size_t misses = 0;
+		size_t unique = 0;
+
+		for (size_t i = 0; i < triCount * 3; i++) {
+
+			misses += cache.touch(indices[i]);
+			if (!seen[indices[i]]) {
+
+				seen[indices[i]] = 1;
+				unique++;
+			}
+		}
+
+		stats.acmr = float(misses) / float(triCount);
+		stats.atvr = float(misses) / float(unique);
+		return stats;
+	}
+
+	// tuning values straight from the paper (tomforsyth1.googlepages.com/vertexcacheoptimisation.htm)
+	constexpr int FORSYTH_CACHE_SIZE = 32;
+	constexpr float FORSYTH_DECAY_POWER = 1.5f;
+	constexpr float FORSYTH_LAST_TRI_SCORE = 0.75f;
+	constexpr float FORSYTH_VALENCE_SCALE = 2.0f;
+	constexpr float FORSYTH_VALENCE_POWER = 0.5f;
+
+	static float forsythScore(int cachePosition, uint32_t remainingValence) {
+
+		if (remainingValence == 0) return -1.0f; // nothing left to draw with it
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+
+			// the last triangle's verts get a fixed score so the next pick doesn't just fan around them
+			if (cachePosition < 3) score = FORSYTH_LAST_TRI_SCORE;
+			else {
+
+				float scale = 1.0f / float(FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(1.0f - float(cachePosition - 3) * scale, FORSYTH_DECAY_POWER);
+			}
+		}
+		// boost verts with few triangles left so lone triangles get finished off instead of stranded
+		score += FORSYTH_VALENCE_SCALE * std::pow(float(remainingValence), -FORSYTH_VALENCE_POWER);
+		return score;
+	}
+
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+
+		size_t triCount = indexCount / 3;
+		if (triCount < 2) return;
+
+		// vertex -> triangles adjacency, flattened
+		std::vector<uint32_t> valence(vertexCount, 0);
+		for (size_t i = 0; i < triCount * 3; i++) valence[indices[i]]++;
+
+		std::vector<uint32_t> adjOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) adjOffset[v + 1] = adjOffset[v] + valence[v];
+
+		std::vector<uint32_t> adjacency(adjOffset[vertexCount]);
+		{
+			std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+			for (size_t t = 0; t < triCount; t++) {
+
+				for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = uint32_t(t);
+			}
+		}
+
+		std::vector<int> cachePos(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = forsythScore(-1, valence[v]);
+
+		std::vector<float> triScore(triCount);
+		std::vector<uint8_t> emitted(triCount, 0);
+
+		auto scoreTriangle = [&](size_t t) {
+
+			const uint32_t* tri = indices + t * 3;
+			return vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		};
+
+		int64_t best = 0;
+		for (size_t t = 0; t < triCount; t++) {
+
+			triScore[t] = scoreTriangle(t);
+			if (triScore[t] > triScore[best]) best = int64_t(t);
+		}
+
+		std::vector<uint32_t> out;
+		out.reserve(triCount * 3);
+
+		std::vector<uint32_t> cache, nextCache, evicted;
+		cache.reserve(FORSYTH_CACHE_SIZE + 3);
+		nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+		size_t scanCursor = 0;
+
+		while (out.size() < triCount * 3) {
+
+			// nothing in cache has triangles left, restart from the next unemitted one in index order
+			if (best < 0) {
+
+				while (emitted[scanCursor]) scanCursor++;
+				best = int64_t(scanCursor);
+			}
+
+			const uint32_t* tri = indices + best * 3;
+			emitted[best] = 1;
+			for (int k = 0; k < 3; k++) {
+
+				out.push_back(tri[k]);
+				valence[tri[k]]--;
+			}
+
+			// lru: this triangle's verts to the front, everything else shifts back
+			nextCache.assign(tri, tri + 3);
+			for (uint32_t v : cache) {
+
+				if (v != tri[0] && v != tri[1] && v != tri[2]) nextCache.push_back(v);
+			}
+
+			evicted.clear();
+			for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++) {
+
+				cachePos[nextCache[i]] = -1;
+				vertexScore[nextCache[i]] = forsythScore(-1, valence[nextCache[i]]);
+				evicted.push_back(nextCache[i]);
+			}
+			if (nextCache.size() > FORSYTH_CACHE_SIZE) nextCache.resize(FORSYTH_CACHE_SIZE);
+			cache.swap(nextCache);
+
+			for (size_t i = 0; i < cache.size(); i++) {
+
+				cachePos[cache[i]] = int(i);
+				vertexScore[cache[i]] = forsythScore(int(i), valence[cache[i]]);
+			}
+
+			// only triangles touching the cache can have changed, and the next pick comes from those
+			best = -1;
+			float bestScore = -1.0f;
+			for (uint32_t v : cache) {
+
+				for (uint32_t a = adjOffset[v]; a < adjOffset[v + 1]; a++) {
+
+					uint32_t t = adjacency[a];
+					if (emitted[t]) continue;
+
+					triScore[t] = scoreTriangle(t);
+					if (triScore[t] > bestScore) {
+
+						bestScore = triScore[t];
+						best = int64_t(t);
+					}
+				}
+			}
+			for (uint32_t v : evicted) {
+
+				for (uint32_t a = adjOffset[v]; a < adjOffset[v + 1]; a++) {
+
+					if (!emitted[adjacency[a]]) triScore[adjacency[a]] = scoreTriangle(adjacency[a]);
+				}
+			}
+		}
+
+		std::memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+	}
+
+	void optimizeOverdraw(uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset, float threshold) {
+
+		size_t triCount = indexCount / 3;
+		if (triCount < 2) return;
+
+		constexpr uint32_t CACHE_SIZE = 16;
+
+		// hard boundaries, where the cache order already restarts (all three verts missed)
+		std::vector<size_t> hard;
+		{
+			FifoCache cache(vertexCount, CACHE_SIZE);
+			for (size_t t = 0; t < triCount; t++) {
+
+				if (cache.touchTriangle(indices + t * 3) == 3 || t == 0) hard.push_back(t);
+			}
+		}
+		hard.push_back(triCount);
+
+		// soft boundaries, split each hard cluster again as soon as the running acmr is within threshold of the whole cluster's
+		std::vector<size_t> clusters;
+		FifoCache cache(vertexCount, CACHE_SIZE);
+		for (size_t c = 0; c + 1 < hard.size(); c++) {
+
+			size_t begin = hard[c], end = hard[c + 1];
+
+			cache.reset();
+			uint32_t clusterMisses = 0;
+			for (size_t t = begin; t < end; t++) clusterMisses += cache.touchTriangle(indices + t * 3);
+			float clusterAcmr = float(clusterMisses) / float(end - begin);
+
+			cache.reset();
+			clusters.push_back(begin);
+			size_t start = begin;
+			uint32_t misses = 0;
+			for (size_t t = begin; t < end; t++) {
+
+				misses += cache.touchTriangle(indices + t * 3);
+				float runningAcmr = float(misses) / float(t - start + 1);
+
+				if (t + 1 < end && runningAcmr <= threshold * clusterAcmr) {
+
+					clusters.push_back(t + 1);
+					cache.reset();
+					start = t + 1;
+					misses = 0;
+				}
+			}
+		}
+		clusters.push_back(triCount);
+
+		auto position = [&](uint32_t v) {
+
+			glm::vec3 p;
+			std::memcpy(&p, vertices + size_t(v) * vertexStride + positionOffset, sizeof(glm::vec3));
+			return p;
+		};
+
+		// area weighted centroid + normal per cluster
+		size_t clusterCount = clusters.size() - 1;
+		std::vector<glm::vec3> centroid(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> normal(clusterCount, glm::vec3(0.0f));
+		std::vector<float> area(clusterCount, 0.0f);
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusterCount; c++) {
+
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+
+				glm::vec3 p0 = position(indices[t * 3 + 0]);
+				glm::vec3 p1 = position(indices[t * 3 + 1]);
+				glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0); // length is 2x area
+				float a = glm::length(n);
+
+				centroid[c] += (p0 + p1 + p2) * (a / 3.0f);
+				normal[c] += n;
+				area[c] += a;
+			}
+			meshCentroid += centroid[c];
+			meshArea += area[c];
+		}
+		if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+		// clusters facing away from the middle of the mesh are likely to occlude the rest, draw those first
+		std::vector<float> sortKey(clusterCount, 0.0f);
+		for (size_t c = 0; c < clusterCount; c++) {
+
+			if (area[c] <= 0.0f) continue;
+			glm::vec3 cc = centroid[c] / area[c];
+			float nl = glm::length(normal[c]);
+			if (nl > 0.0f) sortKey[c] = glm::dot(cc - meshCentroid, normal[c] / nl);
+		}
+
+		std::vector<size_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<uint32_t> out;
+		out.reserve(triCount * 3);
+		for (size_t c : order) {
+
+			out.insert(out.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+		}
+		std::memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+	}
+
+	size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, uint8_t* vertices, size_t vertexCount, size_t vertexStride) {
+
+		constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+
+		std::vector<uint32_t> remap(vertexCount, UNUSED);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+
+			uint32_t& r = remap[indices[i]];
+			if (r == UNUSED) r = next++;
+			indices[i] = r;
+		}
+
+		std::vector<uint8_t> source(vertices, vertices + vertexCount * vertexStride);
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			if (remap[v] != UNUSED) std::memcpy(vertices + size_t(remap[v]) * vertexStride, source.data() + v * vertexStride, vertexStride);
+		}
+		return next;
+	}
+
+	size_t optimizeMesh(std::vector<uint32_t>& indices, uint8_t* vertices, size_t vertexCount, size_t vertexStride, size_t positionOffset,
+		const std::vector<IndexRange>& ranges, const OptimizeSettings& settings, const std::string& name) {
+
+		if (indices.empty() || vertexCount == 0) return vertexCount;
+
+		VertexCacheStats before;
+		if (settings.report) before = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		for (const IndexRange& r : ranges) {
+
+			if (size_t(r.start) + r.count > indices.size()) continue;
+
+			if (settings.vertexCache) optimizeVertexCache(indices.data() + r.start, r.count, vertexCount);
+			if (settings.overdraw) optimizeOverdraw(indices.data() + r.start, r.count, vertices, vertexCount, vertexStride, positionOffset, settings.overdrawThreshold);
+		}
+
+		size_t newCount = vertexCount;
+		if (settings.vertexFetch) newCount = optimizeVertexFetch(indices.data(), indices.size(), vertices, vertexCount, vertexStride);
+
+		if (settings.report) {
+
+			VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), newCount);
+
+			// built up front so lines from different decode threads don't interleave
+			std::ostringstream line;
+			line << std::fixed << std::setprecision(3)
+				<< "mesh opt '" << name << "': acmr " << before.acmr << " -> " << after.acmr
+				<< ", atvr " << before.atvr << " -> " << after.atvr
+				<< ", verts " << vertexCount << " -> " << newCount << '\n';
+			std::cout << line.str();
+		}
+		return newCount;
+	}
+}
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "Renderer/Scene/meshlet.h"
+
+namespace MeshUtils {
+
+	static glm::vec3 readPosition(const uint8_t* vertices, size_t stride, size_t offset, uint32_t v) {
+
+		glm::vec3 p;
+		std::memcpy(&p, vertices + size_t(v) * stride + offset, sizeof(p));
+		return p;
+	}
+
+	// sphere around the aabb centre and a normal cone (same construction as meshoptimizer's cluster bounds)
+	static void computeBounds(Meshlet& m, const uint32_t* indices, const uint8_t* vertices, size_t stride, size_t offset) {
+
+		glm::vec3 lo(std::numeric_limits<float>::max());
+		glm::vec3 hi(std::numeric_limits<float>::lowest());
+		for (uint32_t i = 0; i < m.indexCount; i++) {
+
+			glm::vec3 p = readPosition(vertices, stride, offset, indices[m.indexStart + i]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+
+		m.center = (lo + hi) * 0.5f;
+		m.radius = 0.0f;
+		for (uint32_t i = 0; i < m.indexCount; i++) {
+
+			glm::vec3 p = readPosition(vertices, stride, offset, indices[m.indexStart + i]);
+			m.radius = std::max(m.radius, glm::length(p - m.center));
+		}
+
+		// unit triangle normals, degenerate ones don't get a say in the cone
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> corners;
+		normals.reserve(m.indexCount / 3);
+		corners.reserve(m.indexCount / 3);
+
+		glm::vec3 sum(0.0f);
+		for (uint32_t i = 0; i + 2 < m.indexCount; i += 3) {
+
+			const uint32_t* tri = indices + m.indexStart + i;
+			glm::vec3 p0 = readPosition(vertices, stride, offset, tri[0]);
+			glm::vec3 p1 = readPosition(vertices, stride, offset, tri[1]);
+			glm::vec3 p2 = readPosition(vertices, stride, offset, tri[2]);
+
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float len = glm::length(n);
+			if (len <= 1e-12f) continue;
+
+			n /= len;
+			normals.push_back(n);
+			corners.push_back(p0);
+			sum += n;
+		}
+
+		m.coneApex = m.center;
+		m.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		m.coneCutoff = 1.0f;
+
+		float sumLen = glm::length(sum);
+		if (normals.empty() || sumLen <= 1e-6f) return;
+
+		glm::vec3 axis = sum / sumLen;
+		float minDot = 1.0f;
+		for (auto& n : normals) minDot = std::min(minDot, glm::dot(n, axis));
+
+		// past ~84 degrees the test almost never fires and the apex below blows up, not worth it
+		if (minDot <= 0.1f) return;
+
+		// push the apex back along the axis until every triangle plane is in front of it
+		float maxT = 0.0f;
+		for (size_t t = 0; t < normals.size(); t++) {
+
+			float dc = glm::dot(m.center - corners[t], normals[t]);
+			float dn = glm::dot(axis, normals[t]);
+			maxT = std::max(maxT, dc / dn);
+		}
+
+		m.coneApex = m.center - axis * maxT;
+		m.coneAxis = axis;
+		m.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	std::vector<Meshlet> buildMeshlets(const uint32_t* indices, IndexRange range, const uint8_t* vertices, size_t vertexCount,
+		size_t vertexStride, size_t positionOffset, const MeshletSettings& settings) {
+
+		std::vector<Meshlet> out;
+		if (range.count < 3 || vertexCount == 0) return out;
+
+		// which cluster last used each vertex, so counting unique vertices is O(1) per corner
+		std::vector<uint32_t> owner(vertexCount, UINT32_MAX);
+		uint32_t uniqueVerts = 0;
+
+		Meshlet current{};
+		current.indexStart = range.start;
+
+		auto flush = [&]() {
+
+			if (current.indexCount == 0) return;
+			computeBounds(current, indices, vertices, vertexStride, positionOffset);
+			out.push_back(current);
+
+			current = {};
+			current.indexStart = out.back().indexStart + out.back().indexCount;
+			uniqueVerts = 0;
+		};
+
+		// greedy in index order, the cache optimiser already put neighbouring triangles next to each other
+		uint32_t triCount = range.count / 3;
+		for (uint32_t t = 0; t < triCount; t++) {
+
+			const uint32_t* tri = indices + range.start + t * 3;
+			uint32_t id = static_cast<uint32_t>(out.size());
+
+			uint32_t newVerts = 0;
+			for (int c = 0; c < 3; c++) {
+
+				bool repeat = (c > 0 && tri[c] == tri[0]) || (c > 1 && tri[c] == tri[1]);
+				if (owner[tri[c]] != id && !repeat) newVerts++;
+			}
+
+			if (uniqueVerts + newVerts > settings.maxVertices || current.indexCount / 3 >= settings.maxTriangles) {
+
+				flush();
+				id = static_cast<uint32_t>(out.size());
+				newVerts = 0;
+				for (int c = 0; c < 3; c++) {
+
+					bool repeat = (c > 0 && tri[c] == tri[0]) || (c > 1 && tri[c] == tri[1]);
+					if (!repeat) newVerts++;
+				}
+			}
+
+			for (int c = 0; c < 3; c++) owner[tri[c]] = id;
+			uniqueVerts += newVerts;
+			current.indexCount += 3;
+		}
+		flush();
+
+		return out;
+	}
+
+	Frustum extractFrustum(const glm::mat4& m) {
+
+		// glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+		Frustum f;
+		f.planes[0] = row(3) + row(0); // left
+		f.planes[1] = row(3) - row(0); // right
+		f.planes[2] = row(3) + row(1); // bottom
+		f.planes[3] = row(3) - row(1); // top
+		f.planes[4] = row(3) + row(2); // near
+		f.planes[5] = row(3) - row(2); // far
+
+		for (auto& p : f.planes) {
+
+			float len = glm::length(glm::vec3(p));
+			if (len > 0.0f) p /= len;
+		}
+		return f;
+	}
+
+	void cullMeshlets(const Meshlet* meshlets, size_t count, const glm::mat4& model, const ClusterCullParams& params, bool backface,
+		std::vector<IndexRange>& visible, CullStats& stats) {
+
+		glm::mat3 linear(model);
+		glm::vec3 scale(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+		float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+		float minScale = std::min(scale.x, std::min(scale.y, scale.z));
+
+		// cones only survive rotation + uniform scale, mirroring flips which side is the front
+		bool coneValid = params.coneCull && backface && maxScale > 0.0f && (maxScale - minScale) <= maxScale * 0.01f;
+		float facing = glm::determinant(linear) < 0.0f ? -1.0f : 1.0f;
+
+		for (size_t i = 0; i < count; i++) {
+
+			const Meshlet& m = meshlets[i];
+			stats.clustersTested++;
+
+			bool culled = false;
+			if (params.frustumCull) {
+
+				glm::vec3 center = glm::vec3(model * glm::vec4(m.center, 1.0f));
+				float radius = m.radius * maxScale;
+				for (const auto& p : params.frustum.planes) {
+
+					if (glm::dot(glm::vec3(p), center) + p.w < -radius) {
+
+						culled = true;
+						break;
+					}
+				}
+			}
+
+			if (!culled && coneValid && m.coneCutoff < 1.0f) {
+
+				glm::vec3 apex = glm::vec3(model * glm::vec4(m.coneApex, 1.0f));
+				glm::vec3 axis = glm::normalize(linear * m.coneAxis) * facing;
+				glm::vec3 toApex = apex - params.cameraPos;
+				float dist = glm::length(toApex);
+				culled = dist > 0.0f && glm::dot(toApex / dist, axis) >= m.coneCutoff;
+			}
+
+			if (culled) {
+
+				stats.clustersCulled++;
+				continue;
+			}
+
+			stats.trianglesSubmitted += m.indexCount / 3;
+			if (!visible.empty() && visible.back().start + visible.back().count == m.indexStart) visible.back().count += m.indexCount;
+			else visible.push_back({ m.indexStart, m.indexCount });
+		}
+	}
+}
@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "Renderer/Scene/meshopt_codec.h"
+
+namespace MeshUtils {
+
+	static const uint8_t VERTEX_HEADER = 0xa0;
+	static const uint8_t INDEX_HEADER = 0xe0;
+	static const uint8_t SEQUENCE_HEADER = 0xd0;
+
+	static const size_t BYTE_GROUP = 16;
+	// worst case one byte group reads: 4 header-sized packs + 16 overflow bytes, checked once per group instead of per byte
+	static const size_t BYTE_GROUP_LIMIT = 24;
+	static const size_t VERTEX_BLOCK_BYTES = 8192;
+	static const size_t VERTEX_BLOCK_MAX = 256;
+	static const size_t TAIL_MIN = 32;
+
+	// ---- attributes ----
+
+	static uint8_t unzigzag8(uint8_t v) {
+
+		return uint8_t(-(v & 1) ^ (v >> 1));
+	}
+
+	// 16 values of 2^bitsLog2 bits each, msb first. an all ones value means the real byte follows the packed bits
+	static const uint8_t* decodeByteGroup(const uint8_t* data, uint8_t* out, int bitsLog2) {
+
+		if (bitsLog2 == 0) {
+
+			std::memset(out, 0, BYTE_GROUP);
+			return data;
+		}
+		if (bitsLog2 == 3) {
+
+			std::memcpy(out, data, BYTE_GROUP);
+			return data + BYTE_GROUP;
+		}
+
+		uint32_t bits = 1u << bitsLog2;
+		uint32_t sentinel = (1u << bits) - 1;
+		const uint8_t* extra = data + bits * 2; // 16 values * bits / 8
+
+		for (size_t i = 0; i < BYTE_GROUP; i++) {
+
+			uint32_t perByte = 8 / bits;
+			uint8_t packed = data[i / perByte];
+			uint32_t shift = 8 - bits * uint32_t(i % perByte + 1);
+			uint8_t value = uint8_t((packed >> shift) & sentinel);
+			out[i] = value == sentinel ? *extra++ : value;
+		}
+		return extra;
+	}
+
+	// one byte column of a block: 2 bit mode per group up front, then the groups
+	static const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t count) {
+
+		size_t groups = count / BYTE_GROUP;
+		size_t headerSize = (groups + 3) / 4;
+		if (size_t(end - data) < headerSize) return nullptr;
+
+		const uint8_t* header = data;
+		data += headerSize;
+		for (size_t g = 0; g < groups; g++) {
+
+			if (size_t(end - data) < BYTE_GROUP_LIMIT) return nullptr;
+			int bitsLog2 = (header[g / 4] >> ((g % 4) * 2)) & 3;
+			data = decodeByteGroup(data, out + g * BYTE_GROUP, bitsLog2);
+		}
+		return data;
+	}
+
+	// bytes are zigzag deltas against the same byte of the previous element, carried across blocks in last
+	static const uint8_t* decodeVertexBlock(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t count, size_t stride, uint8_t* last) {
+
+		uint8_t column[VERTEX_BLOCK_MAX];
+		size_t aligned = (count + BYTE_GROUP - 1) & ~(BYTE_GROUP - 1);
+
+		for (size_t k = 0; k < stride; k++) {
+
+			data = decodeBytes(data, end, column, aligned);
+			if (!data) return nullptr;
+
+			uint8_t p = last[k];
+			for (size_t i = 0; i < count; i++) {
+
+				p = uint8_t(unzigzag8(column[i]) + p);
+				out[i * stride + k] = p;
+			}
+			last[k] = p;
+		}
+		return data;
+	}
+
+	bool decodeMeshoptVertices(uint8_t* out, size_t count, size_t byteStride, const uint8_t* data, size_t size) {
+
+		if (byteStride == 0 || byteStride > 256 || byteStride % 4 != 0) return false;
+
+		const uint8_t* end = data + size;
+		size_t tail = std::max(byteStride, TAIL_MIN);
+		if (size < 1 + tail) return false;
+		// only version 0 is allowed in the extension
+		if (*data++ != VERTEX_HEADER) return false;
+
+		// the tail holds the first element's baseline
+		uint8_t last[256];
+		std::memcpy(last, end - byteStride, byteStride);
+
+		size_t blockSize = std::min((VERTEX_BLOCK_BYTES / byteStride) & ~(BYTE_GROUP - 1), VERTEX_BLOCK_MAX);
+		for (size_t offset = 0; offset < count; offset += blockSize) {
+
+			size_t n = std::min(blockSize, count - offset);
+			data = decodeVertexBlock(data, end, out + offset * byteStride, n, byteStride, last);
+			if (!data) return false;
+		}
+		return size_t(end - data) == tail;
+	}
+
+	// ---- indices ----
+
+	static uint32_t decodeVByte(const uint8_t*& data) {
+
+		uint8_t lead = *data++;
+		if (lead < 128) return lead;
+
+		uint32_t result = lead & 127;
+		uint32_t shift = 7;
+		for (int i = 0; i < 4; i++) {
+
+			uint8_t group = *data++;
+			result |= uint32_t(group & 127) << shift;
+			shift += 7;
+			if (group < 128) break;
+		}
+		return result;
+	}
+
+	static uint32_t decodeIndex(const uint8_t*& data, uint32_t last) {
+
+		uint32_t v = decodeVByte(data);
+		return last + ((v >> 1) ^ uint32_t(-int32_t(v & 1)));
+	}
+
+	static void writeIndex(uint8_t* out, size_t i, size_t indexSize, uint32_t value) {
+
+		if (indexSize == 2) reinterpret_cast<uint16_t*>(out)[i] = uint16_t(value);
+		else reinterpret_cast<uint32_t*>(out)[i] = value;
+	}
+
+	bool decodeMeshoptTriangles(uint8_t* out, size_t count, size_t indexSize, const uint8_t* data, size_t size) {
+
+		if (count % 3 != 0 || (indexSize != 2 && indexSize != 4)) return false;
+		// header, a code byte per triangle and the 16 byte aux table at the end
+		if (size < 1 + count / 3 + 16) return false;
+		if ((data[0] & 0xf0) != INDEX_HEADER) return false;
+		int version = data[0] & 0x0f;
+		if (version > 1) return false;
+
+		// recently seen edges/vertices, a code refers back into these
+		uint32_t edges[16][2];
+		uint32_t vertices[16];
+		std::memset(edges, -1, sizeof(edges));
+		std::memset(vertices, -1, sizeof(vertices));
+		size_t edgeOffset = 0;
+		size_t vertexOffset = 0;
+
+		auto pushEdge = [&](uint32_t a, uint32_t b) {
+
+			edges[edgeOffset][0] = a;
+			edges[edgeOffset][1] = b;
+			edgeOffset = (edgeOffset + 1) & 15;
+		};
+		auto pushVertex = [&](uint32_t v, bool push = true) {
+
+			vertices[vertexOffset] = v;
+			vertexOffset = (vertexOffset + (push ? 1 : 0)) & 15;
+		};
+		auto emit = [&](size_t i, uint32_t a, uint32_t b, uint32_t c) {
+
+			writeIndex(out, i + 0, indexSize, a);
+			writeIndex(out, i + 1, indexSize, b);
+			writeIndex(out, i + 2, indexSize, c);
+		};
+
+		uint32_t next = 0;
+		uint32_t last = 0;
+		int fecMax = version >= 1 ? 13 : 15;
+
+		const uint8_t* code = data + 1;
+		const uint8_t* stream = code + count / 3;
+		const uint8_t* safeEnd = data + size - 16;
+		const uint8_t* auxTable = safeEnd;
+
+		for (size_t i = 0; i < count; i += 3) {
+
+			// a triangle reads at most 16 bytes, the aux table behind safeEnd covers the overrun
+			if (stream > safeEnd) return false;
+			uint8_t codeTri = *code++;
+
+			if (codeTri < 0xf0) {
+
+				// shares an edge from the fifo, third vertex is new, from the vertex fifo, or explicit
+				int fe = codeTri >> 4;
+				uint32_t a = edges[(edgeOffset - 1 - fe) & 15][0];
+				uint32_t b = edges[(edgeOffset - 1 - fe) & 15][1];
+				int fec = codeTri & 15;
+
+				uint32_t c;
+				bool pushC = true;
+				if (fec < fecMax) {
+
+					c = fec == 0 ? next++ : vertices[(vertexOffset - 1 - fec) & 15];
+					pushC = fec == 0;
+				}
+				else {
+
+					// 13/14 are -1/+1 from the last explicit index (version 1), 15 is a full delta
+					c = last = fec != 15 ? last + uint32_t(fec - (fec ^ 3)) : decodeIndex(stream, last);
+				}
+
+				emit(i, a, b, c);
+				pushVertex(c, pushC);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+			else {
+
+				// no shared edge. the common cases come from the aux table, fe/ff read the codes from the stream
+				int fea, feb, fec;
+				if (codeTri < 0xfe) {
+
+					uint8_t aux = auxTable[codeTri & 15];
+					fea = 0;
+					feb = aux >> 4;
+					fec = aux & 15;
+				}
+				else {
+
+					uint8_t aux = *stream++;
+					if (aux == 0) next = 0;
+					fea = codeTri == 0xfe ? 0 : 15;
+					feb = aux >> 4;
+					fec = aux & 15;
+				}
+
+				uint32_t a = fea == 0 ? next++ : 0;
+				uint32_t b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+				uint32_t c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+
+				if (fea == 15) last = a = decodeIndex(stream, last);
+				if (feb == 15) last = b = decodeIndex(stream, last);
+				if (fec == 15) last = c = decodeIndex(stream, last);
+
+				emit(i, a, b, c);
+				pushVertex(a);
+				pushVertex(b, feb == 0 || feb == 15);
+				pushVertex(c, fec == 0 || fec == 15);
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+		}
+		return stream == safeEnd;
+	}
+
+	bool decodeMeshoptIndices(uint8_t* out, size_t count, size_t indexSize, const uint8_t* data, size_t size) {
+
+		if (indexSize != 2 && indexSize != 4) return false;
+		// header, at least a byte per index and a 4 byte tail
+		if (size < 1 + count + 4) return false;
+		if ((data[0] & 0xf0) != SEQUENCE_HEADER) return false;
+		if ((data[0] & 0x0f) > 1) return false;
+
+		const uint8_t* stream = data + 1;
+		const uint8_t* safeEnd = data + size - 4;
+
+		// two baselines, the low bit of every value picks which one its delta is against
+		uint32_t last[2] = {};
+		for (size_t i = 0; i < count; i++) {
+
+			if (stream >= safeEnd) return false;
+			uint32_t v = decodeVByte(stream);
+			uint32_t baseline = v & 1;
+			v >>= 1;
+
+			uint32_t index = last[baseline] + ((v >> 1) ^ uint32_t(-int32_t(v & 1)));
+			last[baseline] = index;
+			writeIndex(out, i, indexSize, index);
+		}
+		return stream == safeEnd;
+	}
+
+	// ---- filters ----
+
+	static int roundToInt(float v) {
+
+		return int(v + (v >= 0.0f ? 0.5f : -0.5f));
+	}
+
+	// octahedral xy + a z that stores 1.0 at the same scale, back to a full snorm vector. w is left alone
+	template<typename T>
+	static void decodeOctahedral(T* data, size_t count) {
+
+		const float maxValue = float((1 << (sizeof(T) * 8 - 1)) - 1);
+		for (size_t i = 0; i < count; i++) {
+
+			T* v = data + i * 4;
+			float x = float(v[0]);
+			float y = float(v[1]);
+			float z = float(v[2]) - std::fabs(x) - std::fabs(y);
+
+			float t = std::min(z, 0.0f);
+			x += x >= 0.0f ? t : -t;
+			y += y >= 0.0f ? t : -t;
+
+			float s = maxValue / std::sqrt(x * x + y * y + z * z);
+			v[0] = T(roundToInt(x * s));
+			v[1] = T(roundToInt(y * s));
+			v[2] = T(roundToInt(z * s));
+		}
+	}
+
+	// three smallest components + which one was dropped (low 2 bits of w, the rest of w is the scale)
+	static void decodeQuaternion(int16_t* data, size_t count) {
+
+		const float scale = 1.0f / std::sqrt(2.0f);
+		for (size_t i = 0; i < count; i++) {
+
+			int16_t* q = data + i * 4;
+			float s = scale / float(q[3] | 3);
+			float x = float(q[0]) * s;
+			float y = float(q[1]) * s;
+			float z = float(q[2]) * s;
+			float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+			int dropped = q[3] & 3;
+			q[(dropped + 1) & 3] = int16_t(roundToInt(x * 32767.0f));
+			q[(dropped + 2) & 3] = int16_t(roundToInt(y * 32767.0f));
+			q[(dropped + 3) & 3] = int16_t(roundToInt(z * 32767.0f));
+			q[(dropped + 0) & 3] = int16_t(roundToInt(w * 32767.0f));
+		}
+	}
+
+	// 24 bit signed mantissa + 8 bit signed exponent per float
+	static void decodeExponential(uint32_t* data, size_t count) {
+
+		for (size_t i = 0; i < count; i++) {
+
+			int32_t m = int32_t(data[i] << 8) >> 8;
+			int32_t e = int32_t(data[i]) >> 24;
+			float f = std::ldexp(float(m), e);
+			std::memcpy(&data[i], &f, sizeof(float));
+		}
+	}
+
+	void applyMeshoptFilter(uint8_t* data, size_t count, size_t byteStride, MeshoptFilter filter) {
+
+		switch (filter) {
+
+		case MeshoptFilter::Octahedral:
+			if (byteStride == 4) decodeOctahedral(reinterpret_cast<int8_t*>(data), count);
+			else if (byteStride == 8) decodeOctahedral(reinterpret_cast<int16_t*>(data), count);
+			break;
+		case MeshoptFilter::Quaternion:
+			if (byteStride == 8) decodeQuaternion(reinterpret_cast<int16_t*>(data), count);
+			break;
+		case MeshoptFilter::Exponential:
+			decodeExponential(reinterpret_cast<uint32_t*>(data), count * byteStride / 4);
+			break;
+		default:
+			break;
+		}
+	}
+
+	bool decodeMeshopt(uint8_t* out, size_t count, size_t byteStride, MeshoptMode mode, MeshoptFilter filter, const uint8_t* data, size_t size) {
+
+		switch (mode) {
+
+		case MeshoptMode::Attributes:
+			if (!decodeMeshoptVertices(out, count, byteStride, data, size)) return false;
+			applyMeshoptFilter(out, count, byteStride, filter);
+			return true;
+		case MeshoptMode::Triangles:
+			return decodeMeshoptTriangles(out, count, byteStride, data, size);
+		case MeshoptMode::Indices:
+			return decodeMeshoptIndices(out, count, byteStride, data, size);
+		}
+		return false;
+	}
+}
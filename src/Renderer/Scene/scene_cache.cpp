@@ -0,0 +1,407 @@
+#include "pch.h"
+#include "Renderer/Scene/scene_cache.h"
+#include "Renderer/Scene/texture_compress.h"
+#include "Renderer/Scene/texture_streaming.h"
+#include "Core/Utils/thread_pool.h"
+
+namespace SceneCache {
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+	constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+	static uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = FNV_OFFSET) {
+
+		for (size_t i = 0; i < size; i++) {
+
+			hash ^= data[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	static uint64_t fnv1a(const T& value, uint64_t hash) {
+
+		return fnv1a(reinterpret_cast<const uint8_t*>(&value), sizeof(T), hash);
+	}
+
+	std::filesystem::path cachePathFor(const std::filesystem::path& source, const char* backendTag) {
+
+		std::filesystem::path out = source;
+		out.replace_extension(std::string(".") + backendTag + ".acrscene");
+		return out;
+	}
+
+	uint64_t hashSource(const std::filesystem::path& source, uint32_t vertexStride, uint32_t materialStride, const BakeSettings& bake) {
+
+		Utils::File::MappedFile file;
+		if (!file.open(source)) return 0;
+
+		// hash fixed size chunks on the pool then hash the chunk hashes, the glb is the only big read on a warm start
+		constexpr size_t CHUNK = 4 * 1024 * 1024;
+		size_t chunkCount = (file.size() + CHUNK - 1) / CHUNK;
+		std::vector<uint64_t> chunkHashes(chunkCount);
+
+		Utils::Jobs::get().parallelFor(chunkCount, [&](size_t i) {
+
+			size_t begin = i * CHUNK;
+			size_t size = std::min(CHUNK, file.size() - begin);
+			chunkHashes[i] = fnv1a(file.data() + begin, size);
+		});
+
+		uint64_t hash = fnv1a(reinterpret_cast<const uint8_t*>(chunkHashes.data()), chunkHashes.size() * sizeof(uint64_t));
+		uint64_t size = file.size();
+		hash = fnv1a(size, hash);
+		hash = fnv1a(VERSION, hash);
+		hash = fnv1a(vertexStride, hash);
+		hash = fnv1a(materialStride, hash);
+
+		hash = fnv1a(uint8_t(bake.optimizeMeshes), hash);
+		hash = fnv1a(bake.overdrawThreshold, hash);
+		hash = fnv1a(uint8_t(bake.generateLods), hash);
+		hash = fnv1a(bake.maxLods, hash);
+		hash = fnv1a(uint32_t(bake.lodErrorTargets.size()), hash);
+		for (float target : bake.lodErrorTargets) hash = fnv1a(target, hash);
+		hash = fnv1a(uint8_t(bake.compressTextures), hash);
+		return hash;
+	}
+
+	bool SceneView::open(const std::filesystem::path& path, uint64_t expectedHash, uint32_t vertexStride, uint32_t materialStride) {
+
+		_header = nullptr;
+		if (!_file.open(path)) return false;
+		if (validate(expectedHash, vertexStride, materialStride)) return true;
+
+		// a stale cache gets rewritten over this same path by the cold load, and windows won't replace a mapped file
+		_file.close();
+		return false;
+	}
+
+	bool SceneView::validate(uint64_t expectedHash, uint32_t vertexStride, uint32_t materialStride) {
+
+		if (_file.size() < sizeof(Header)) return false;
+
+		const Header* h = reinterpret_cast<const Header*>(_file.data());
+		if (h->magic != MAGIC || h->version != VERSION) return false;
+		if (h->sourceHash != expectedHash || h->fileSize != _file.size()) return false;
+		if (h->vertexStride != vertexStride || h->materialStride != materialStride) return false;
+
+		uint64_t size = _file.size();
+		auto fits = [size](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+		if (!fits(h->samplerOffset, uint64_t(h->samplerCount) * sizeof(SamplerRecord))) return false;
+		if (!fits(h->imageOffset, uint64_t(h->imageCount) * sizeof(ImageRecord))) return false;
+		if (!fits(h->materialOffset, uint64_t(h->materialCount) * sizeof(MaterialRecord))) return false;
+		if (!fits(h->meshOffset, uint64_t(h->meshCount) * sizeof(MeshRecord))) return false;
+		if (!fits(h->surfaceOffset, uint64_t(h->surfaceCount) * sizeof(SurfaceRecord))) return false;
+		if (!fits(h->nodeOffset, uint64_t(h->nodeCount) * sizeof(NodeRecord))) return false;
+		if (!fits(h->childOffset, uint64_t(h->childCount) * sizeof(uint32_t))) return false;
+		if (!fits(h->instanceOffset, uint64_t(h->instanceCount) * sizeof(glm::mat4))) return false;
+		if (!fits(h->meshletOffset, uint64_t(h->meshletCount) * sizeof(MeshUtils::Meshlet))) return false;
+		if (!fits(h->lodOffset, uint64_t(h->lodCount) * sizeof(MeshUtils::LodLevel))) return false;
+
+		auto table = [&](uint64_t offset) { return _file.data() + offset; };
+		const ImageRecord* imgs = reinterpret_cast<const ImageRecord*>(table(h->imageOffset));
+		const MaterialRecord* mats = reinterpret_cast<const MaterialRecord*>(table(h->materialOffset));
+		const MeshRecord* meshRecs = reinterpret_cast<const MeshRecord*>(table(h->meshOffset));
+		const SurfaceRecord* surfRecs = reinterpret_cast<const SurfaceRecord*>(table(h->surfaceOffset));
+		const MeshUtils::Meshlet* meshletRecs = reinterpret_cast<const MeshUtils::Meshlet*>(table(h->meshletOffset));
+		const MeshUtils::LodLevel* lodRecs = reinterpret_cast<const MeshUtils::LodLevel*>(table(h->lodOffset));
+		const NodeRecord* nodeRecs = reinterpret_cast<const NodeRecord*>(table(h->nodeOffset));
+
+		// blobs get checked up front too so the loaders can trust every offset they read
+		for (uint32_t i = 0; i < h->imageCount; i++) {
+
+			if (!fits(imgs[i].dataOffset, imgs[i].dataSize)) return false;
+			// chainSize / levelSize shift the size by the level, a chain longer than the image allows would shift past 31
+			if (imgs[i].mipCount > TextureStreaming::mipCount(imgs[i].width, imgs[i].height)) return false;
+			if (imgs[i].dataSize < TextureCompress::chainSize(TextureCompress::Format(imgs[i].format), imgs[i].width, imgs[i].height, imgs[i].mipCount)) return false;
+		}
+		for (uint32_t i = 0; i < h->materialCount; i++) {
+
+			if (!fits(mats[i].constantsOffset, materialStride)) return false;
+		}
+		for (uint32_t i = 0; i < h->meshCount; i++) {
+
+			const MeshRecord& m = meshRecs[i];
+			if (!fits(m.vertexOffset, uint64_t(m.vertexCount) * vertexStride)) return false;
+			if (!fits(m.indexOffset, uint64_t(m.indexCount) * sizeof(uint32_t))) return false;
+			if (uint64_t(m.firstSurface) + m.surfaceCount > h->surfaceCount) return false;
+
+			// meshlet and lod ranges get drawn straight from the index buffer so they have to stay inside it
+			for (uint32_t s = 0; s < m.surfaceCount; s++) {
+
+				const SurfaceRecord& surf = surfRecs[m.firstSurface + s];
+				if (uint64_t(surf.firstMeshlet) + surf.meshletCount > h->meshletCount) return false;
+				for (uint32_t c = 0; c < surf.meshletCount; c++) {
+
+					const MeshUtils::Meshlet& ml = meshletRecs[surf.firstMeshlet + c];
+					if (uint64_t(ml.indexStart) + ml.indexCount > m.indexCount) return false;
+				}
+
+				if (uint64_t(surf.firstLod) + surf.lodCount > h->lodCount) return false;
+				for (uint32_t l = 0; l < surf.lodCount; l++) {
+
+					const MeshUtils::LodLevel& lod = lodRecs[surf.firstLod + l];
+					if (uint64_t(lod.indexStart) + lod.indexCount > m.indexCount) return false;
+					if (uint64_t(lod.firstMeshlet) + lod.meshletCount > surf.meshletCount) return false;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < h->nodeCount; i++) {
+
+			const NodeRecord& n = nodeRecs[i];
+			if (uint64_t(n.firstChild) + n.childCount > h->childCount) return false;
+			if (uint64_t(n.firstInstance) + n.instanceCount > h->instanceCount) return false;
+			if (n.mesh != NONE && (n.mesh < 0 || uint32_t(n.mesh) >= h->meshCount)) return false;
+		}
+
+		_header = h;
+		return true;
+	}
+
+	MeshUtils::SurfaceDetail SceneView::surfaceDetail(const SurfaceRecord& surf) const {
+
+		MeshUtils::SurfaceDetail detail;
+		detail.center = glm::vec3(surf.sphere);
+		detail.radius = surf.sphere.w;
+		detail.uvDensity = surf.uvDensity;
+		detail.lods.assign(lods() + surf.firstLod, lods() + surf.firstLod + surf.lodCount);
+		detail.meshlets.assign(meshlets() + surf.firstMeshlet, meshlets() + surf.firstMeshlet + surf.meshletCount);
+		return detail;
+	}
+
+	void addSurfaceDetail(SceneData::Mesh& mesh, SurfaceRecord& surf, const MeshUtils::SurfaceDetail& detail) {
+
+		surf.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+		surf.meshletCount = static_cast<uint32_t>(detail.meshlets.size());
+		surf.firstLod = static_cast<uint32_t>(mesh.lods.size());
+		surf.lodCount = static_cast<uint32_t>(detail.lods.size());
+		surf.sphere = glm::vec4(detail.center, detail.radius);
+		surf.uvDensity = detail.uvDensity;
+		mesh.meshlets.insert(mesh.meshlets.end(), detail.meshlets.begin(), detail.meshlets.end());
+		mesh.lods.insert(mesh.lods.end(), detail.lods.begin(), detail.lods.end());
+	}
+
+	bool write(const std::filesystem::path& path, uint64_t sourceHash, const SceneData& scene) {
+
+		// lay out the tables first so every offset is known before anything hits the disk
+		Header header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.sourceHash = sourceHash;
+		header.vertexStride = scene.vertexStride;
+		header.materialStride = scene.materialStride;
+
+		std::vector<SamplerRecord> samplers = scene.samplers;
+		std::vector<ImageRecord> images;
+		std::vector<MaterialRecord> materials;
+		std::vector<MeshRecord> meshes;
+		std::vector<SurfaceRecord> surfaces;
+		std::vector<NodeRecord> nodes;
+		std::vector<uint32_t> children;
+		std::vector<glm::mat4> instances;
+		std::vector<MeshUtils::Meshlet> meshlets;
+		std::vector<MeshUtils::LodLevel> lods;
+
+		for (auto& img : scene.images) images.push_back(img.record);
+		for (auto& mat : scene.materials) materials.push_back(mat.record);
+		for (auto& mesh : scene.meshes) {
+
+			MeshRecord rec{};
+			rec.vertexCount = mesh.vertexCount;
+			rec.indexCount = static_cast<uint32_t>(mesh.indices.size());
+			rec.firstSurface = static_cast<uint32_t>(surfaces.size());
+			rec.surfaceCount = static_cast<uint32_t>(mesh.surfaces.size());
+
+			// surface meshlet / lod ranges are per mesh while baking, rebase them onto the shared tables
+			uint32_t meshletBase = static_cast<uint32_t>(meshlets.size());
+			uint32_t lodBase = static_cast<uint32_t>(lods.size());
+			for (SurfaceRecord surf : mesh.surfaces) {
+
+				surf.firstMeshlet += meshletBase;
+				surf.firstLod += lodBase;
+				surfaces.push_back(surf);
+			}
+			meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+			lods.insert(lods.end(), mesh.lods.begin(), mesh.lods.end());
+			meshes.push_back(rec);
+		}
+		for (auto& node : scene.nodes) {
+
+			NodeRecord rec = node.record;
+			rec.firstChild = static_cast<uint32_t>(children.size());
+			rec.childCount = static_cast<uint32_t>(node.children.size());
+			children.insert(children.end(), node.children.begin(), node.children.end());
+			rec.firstInstance = static_cast<uint32_t>(instances.size());
+			rec.instanceCount = static_cast<uint32_t>(node.instances.size());
+			instances.insert(instances.end(), node.instances.begin(), node.instances.end());
+			nodes.push_back(rec);
+		}
+
+		header.samplerCount = static_cast<uint32_t>(samplers.size());
+		header.imageCount = static_cast<uint32_t>(images.size());
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.surfaceCount = static_cast<uint32_t>(surfaces.size());
+		header.nodeCount = static_cast<uint32_t>(nodes.size());
+		header.childCount = static_cast<uint32_t>(children.size());
+		header.instanceCount = static_cast<uint32_t>(instances.size());
+		header.meshletCount = static_cast<uint32_t>(meshlets.size());
+		header.lodCount = static_cast<uint32_t>(lods.size());
+
+		uint64_t offset = alignUp(sizeof(Header), 16);
+		auto place = [&](uint64_t bytes) { uint64_t at = offset; offset = alignUp(offset + bytes, 16); return at; };
+
+		header.samplerOffset = place(samplers.size() * sizeof(SamplerRecord));
+		header.imageOffset = place(images.size() * sizeof(ImageRecord));
+		header.materialOffset = place(materials.size() * sizeof(MaterialRecord));
+		header.meshOffset = place(meshes.size() * sizeof(MeshRecord));
+		header.surfaceOffset = place(surfaces.size() * sizeof(SurfaceRecord));
+		header.nodeOffset = place(nodes.size() * sizeof(NodeRecord));
+		header.childOffset = place(children.size() * sizeof(uint32_t));
+		header.instanceOffset = place(instances.size() * sizeof(glm::mat4));
+		header.meshletOffset = place(meshlets.size() * sizeof(MeshUtils::Meshlet));
+		header.lodOffset = place(lods.size() * sizeof(MeshUtils::LodLevel));
+
+		// material constants are packed back to back so a loader can upload them in one go
+		for (size_t i = 0; i < materials.size(); i++) materials[i].constantsOffset = place(scene.materialStride);
+		for (size_t i = 0; i < meshes.size(); i++) {
+
+			meshes[i].vertexOffset = place(scene.meshes[i].vertices.size());
+			meshes[i].indexOffset = place(scene.meshes[i].indices.size() * sizeof(uint32_t));
+		}
+		for (size_t i = 0; i < images.size(); i++) {
+
+			images[i].dataSize = scene.images[i].pixels.size();
+			images[i].dataOffset = place(images[i].dataSize);
+		}
+		header.fileSize = offset;
+
+		// write to a temp file and swap it in so a crash mid write never leaves a cache that looks valid
+		std::filesystem::path tmpPath = path;
+		tmpPath += ".tmp";
+
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+
+			std::cerr << "failed to open scene cache for writing: " << tmpPath << std::endl;
+			return false;
+		}
+
+		uint64_t written = 0;
+		auto emit = [&](uint64_t at, const void* data, uint64_t bytes) {
+
+			static const char zeros[16] = {};
+			while (written < at) {
+
+				uint64_t pad = std::min<uint64_t>(at - written, sizeof(zeros));
+				out.write(zeros, static_cast<std::streamsize>(pad));
+				written += pad;
+			}
+			if (bytes) out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+			written += bytes;
+		};
+
+		emit(0, &header, sizeof(Header));
+		emit(header.samplerOffset, samplers.data(), samplers.size() * sizeof(SamplerRecord));
+		emit(header.imageOffset, images.data(), images.size() * sizeof(ImageRecord));
+		emit(header.materialOffset, materials.data(), materials.size() * sizeof(MaterialRecord));
+		emit(header.meshOffset, meshes.data(), meshes.size() * sizeof(MeshRecord));
+		emit(header.surfaceOffset, surfaces.data(), surfaces.size() * sizeof(SurfaceRecord));
+		emit(header.nodeOffset, nodes.data(), nodes.size() * sizeof(NodeRecord));
+		emit(header.childOffset, children.data(), children.size() * sizeof(uint32_t));
+		emit(header.instanceOffset, instances.data(), instances.size() * sizeof(glm::mat4));
+		emit(header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(MeshUtils::Meshlet));
+		emit(header.lodOffset, lods.data(), lods.size() * sizeof(MeshUtils::LodLevel));
+
+		for (size_t i = 0; i < materials.size(); i++) emit(materials[i].constantsOffset, scene.materials[i].constants.data(), scene.materialStride);
+		for (size_t i = 0; i < meshes.size(); i++) {
+
+			emit(meshes[i].vertexOffset, scene.meshes[i].vertices.data(), scene.meshes[i].vertices.size());
+			emit(meshes[i].indexOffset, scene.meshes[i].indices.data(), scene.meshes[i].indices.size() * sizeof(uint32_t));
+		}
+		for (size_t i = 0; i < images.size(); i++) emit(images[i].dataOffset, scene.images[i].pixels.data(), images[i].dataSize);
+		emit(header.fileSize, nullptr, 0);
+
+		out.close();
+		if (!out) {
+
+			std::cerr << "failed writing scene cache: " << tmpPath << std::endl;
+			std::filesystem::remove(tmpPath);
+			return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, path, ec);
+		if (ec) {
+
+			std::cerr << "failed to move scene cache into place: " << path << ": " << ec.message() << std::endl;
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+
+		std::cout << "wrote scene cache " << path << " (" << header.fileSize / (1024 * 1024) << " MB)" << std::endl;
+		return true;
+	}
+
+	uint32_t buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+
+		out.clear();
+		if (!rgba || width == 0 || height == 0) return 0;
+
+		uint32_t mipCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+		size_t total = 0;
+		for (uint32_t l = 0; l < mipCount; l++) {
+
+			total += size_t(std::max(1u, width >> l)) * std::max(1u, height >> l) * 4;
+		}
+		out.resize(total);
+		std::memcpy(out.data(), rgba, size_t(width) * height * 4);
+
+		size_t srcOffset = 0;
+		size_t dstOffset = size_t(width) * height * 4;
+		uint32_t srcW = width;
+		uint32_t srcH = height;
+
+		for (uint32_t l = 1; l < mipCount; l++) {
+
+			uint32_t dstW = std::max(1u, srcW >> 1);
+			uint32_t dstH = std::max(1u, srcH >> 1);
+			const uint8_t* src = out.data() + srcOffset;
+			uint8_t* dst = out.data() + dstOffset;
+
+			// 2x2 box, clamps on the odd edge when one axis has already hit 1
+			for (uint32_t y = 0; y < dstH; y++) {
+
+				uint32_t y0 = std::min(y * 2, srcH - 1);
+				uint32_t y1 = std::min(y * 2 + 1, srcH - 1);
+
+				for (uint32_t x = 0; x < dstW; x++) {
+
+					uint32_t x0 = std::min(x * 2, srcW - 1);
+					uint32_t x1 = std::min(x * 2 + 1, srcW - 1);
+
+					for (uint32_t c = 0; c < 4; c++) {
+
+						uint32_t sum = src[(size_t(y0) * srcW + x0) * 4 + c] + src[(size_t(y0) * srcW + x1) * 4 + c]
+							+ src[(size_t(y1) * srcW + x0) * 4 + c] + src[(size_t(y1) * srcW + x1) * 4 + c];
+						dst[(size_t(y) * dstW + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+
+			srcOffset = dstOffset;
+			dstOffset += size_t(dstW) * dstH * 4;
+			srcW = dstW;
+			srcH = dstH;
+		}
+		return mipCount;
+	}
+}
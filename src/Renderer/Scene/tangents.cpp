@@ -0,0 +1,340 @@
+#include "pch.h"
+#include "Renderer/Scene/tangents.h"
+#include "Core/Utils/thread_pool.h"
+
+namespace MeshUtils {
+
+	// triangles per inner block, small enough that the block's soa scratch stays in l1
+	static constexpr size_t TANGENT_BLOCK = 64;
+
+	struct TangentCorner {
+
+		float x, y, z, u, v;
+	};
+
+	struct TangentFace {
+
+		glm::vec3 s;
+		glm::vec3 t;
+	};
+
+	// kept per thread between calls, a scene is a lot of meshes in a row and faulting fresh pages in for every one
+	// of them cost about as much as the face pass itself
+	struct TangentScratch {
+
+		std::vector<uint32_t> tris;
+		std::vector<TangentCorner> corners;
+		std::vector<TangentFace> faces;
+		std::vector<TangentFace> sums;
+		std::vector<uint8_t> used;
+		// vertex -> face csr, offsets is vertexCount + 1 long. cursors count and then hand out slots from any thread
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> adjacency;
+		std::unique_ptr<std::atomic<uint32_t>[]> cursors;
+		size_t cursorCapacity = 0;
+	};
+	static thread_local TangentScratch tangentScratch;
+
+	// splits [0, count) into jobSize pieces. the split only decides who does the work, never the order things get summed in
+	static void forChunks(size_t count, size_t jobSize, bool parallel, const std::function<void(size_t, size_t)>& fn) {
+
+		jobSize = std::max<size_t>(jobSize, 1);
+		size_t jobs = (count + jobSize - 1) / jobSize;
+		auto run = [&](size_t j) { fn(j * jobSize, std::min(count, (j + 1) * jobSize)); };
+
+		if (parallel && jobs > 1) Utils::Jobs::get().parallelFor(jobs, run);
+		else for (size_t j = 0; j < jobs; j++) run(j);
+	}
+
+	void generateTangents(const uint32_t* indices, const std::vector<IndexRange>& ranges, uint8_t* vertices, size_t vertexCount,
+		size_t vertexStride, const VertexAttribs& attribs, size_t tangentOffset, const TangentSettings& settings) {
+
+		TangentScratch& scratch = tangentScratch;
+		std::vector<uint32_t>& tris = scratch.tris;
+		tris.clear();
+		for (auto& r : ranges) tris.insert(tris.end(), indices + r.start, indices + r.start + r.count / 3 * 3);
+
+		size_t triCount = tris.size() / 3;
+		if (triCount == 0 || vertexCount == 0) return;
+
+		// compact copy of what the face pass reads, one line per corner instead of a full vertex
+		std::vector<TangentCorner>& corners = scratch.corners;
+		corners.resize(vertexCount);
+		forChunks(vertexCount, settings.trianglesPerJob, settings.parallel, [&](size_t begin, size_t end) {
+
+			for (size_t v = begin; v < end; v++) {
+
+				std::memcpy(&corners[v].x, vertices + v * vertexStride + attribs.position, sizeof(glm::vec3));
+				std::memcpy(&corners[v].u, vertices + v * vertexStride + attribs.uv, sizeof(glm::vec2));
+			}
+		});
+
+		// per face sdir / tdir, degenerate uvs come out as zero so they drop out of the sums like the old `continue`
+		std::vector<TangentFace>& faces = scratch.faces;
+		faces.resize(triCount);
+		forChunks(triCount, settings.trianglesPerJob, settings.parallel, [&](size_t begin, size_t end) {
+
+			float e1x[TANGENT_BLOCK], e1y[TANGENT_BLOCK], e1z[TANGENT_BLOCK];
+			float e2x[TANGENT_BLOCK], e2y[TANGENT_BLOCK], e2z[TANGENT_BLOCK];
+			float d1u[TANGENT_BLOCK], d1v[TANGENT_BLOCK], d2u[TANGENT_BLOCK], d2v[TANGENT_BLOCK];
+			float sx[TANGENT_BLOCK], sy[TANGENT_BLOCK], sz[TANGENT_BLOCK];
+			float tx[TANGENT_BLOCK], ty[TANGENT_BLOCK], tz[TANGENT_BLOCK];
+
+			for (size_t base = begin; base < end; base += TANGENT_BLOCK) {
+
+				size_t n = std::min(TANGENT_BLOCK, end - base);
+
+				// gathers in their own loop so the maths below runs on contiguous soa lanes
+				for (size_t k = 0; k < n; k++) {
+
+					const uint32_t* t = &tris[(base + k) * 3];
+					const TangentCorner& c0 = corners[t[0]];
+					const TangentCorner& c1 = corners[t[1]];
+					const TangentCorner& c2 = corners[t[2]];
+					e1x[k] = c1.x - c0.x; e1y[k] = c1.y - c0.y; e1z[k] = c1.z - c0.z;
+					e2x[k] = c2.x - c0.x; e2y[k] = c2.y - c0.y; e2z[k] = c2.z - c0.z;
+					d1u[k] = c1.u - c0.u; d1v[k] = c1.v - c0.v;
+					d2u[k] = c2.u - c0.u; d2v[k] = c2.v - c0.v;
+				}
+
+				for (size_t k = 0; k < n; k++) {
+
+					float denom = d1u[k] * d2v[k] - d2u[k] * d1v[k];
+					float r = std::fabs(denom) < 1e-8f ? 0.0f : 1.0f / denom;
+
+					sx[k] = (e1x[k] * d2v[k] - e2x[k] * d1v[k]) * r;
+					sy[k] = (e1y[k] * d2v[k] - e2y[k] * d1v[k]) * r;
+					sz[k] = (e1z[k] * d2v[k] - e2z[k] * d1v[k]) * r;
+					tx[k] = (e2x[k] * d1u[k] - e1x[k] * d2u[k]) * r;
+					ty[k] = (e2y[k] * d1u[k] - e1y[k] * d2u[k]) * r;
+					tz[k] = (e2z[k] * d1u[k] - e1z[k] * d2u[k]) * r;
+				}
+
+				for (size_t k = 0; k < n; k++) faces[base + k] = { glm::vec3(sx[k], sy[k], sz[k]), glm::vec3(tx[k], ty[k], tz[k]) };
+			}
+		});
+
+		auto resolve = [&](size_t v, const TangentFace& sum) {
+
+			uint8_t* vert = vertices + v * vertexStride;
+			glm::vec3 n;
+			std::memcpy(&n, vert + attribs.normal, sizeof(n));
+			n = glm::normalize(n);
+
+			// gram-schmidt
+			glm::vec3 tangent = glm::normalize(sum.s - n * glm::dot(n, sum.s));
+			float w = (glm::dot(glm::cross(n, tangent), sum.t) < 0.0f) ? -1.0f : 1.0f;
+
+			glm::vec4 result(tangent, w);
+			std::memcpy(vert + tangentOffset, &result, sizeof(result));
+		};
+
+		// nothing to split the sums over: scatter them in triangle order, it's only adds and about a third of the
+		// memory traffic of building the csr below
+		bool gather = settings.parallel && triCount > settings.trianglesPerJob && Utils::Jobs::get().concurrency() > 1;
+		if (!gather) {
+
+			std::vector<TangentFace>& sums = scratch.sums;
+			std::vector<uint8_t>& used = scratch.used;
+			sums.assign(vertexCount, TangentFace{ glm::vec3(0.0f), glm::vec3(0.0f) });
+			used.assign(vertexCount, 0);
+			for (size_t f = 0; f < triCount; f++) {
+
+				for (int c = 0; c < 3; c++) {
+
+					uint32_t v = tris[f * 3 + c];
+					sums[v].s += faces[f].s;
+					sums[v].t += faces[f].t;
+					used[v] = 1;
+				}
+			}
+
+			forChunks(vertexCount, settings.trianglesPerJob, settings.parallel, [&](size_t begin, size_t end) {
+
+				for (size_t v = begin; v < end; v++) {
+
+					if (used[v]) resolve(v, sums[v]);
+				}
+			});
+			return;
+		}
+
+		// on the pool the sums are gathered per vertex out of a vertex -> face csr, so they split over vertex ranges with
+		// no two jobs writing the same vertex. which slot a face lands in depends on the threads, every list gets sorted
+		// before it's summed so each vertex still adds its faces in triangle order: same bits as the scatter above
+		if (scratch.cursorCapacity < vertexCount) {
+
+			scratch.cursors.reset(new std::atomic<uint32_t>[vertexCount]);
+			scratch.cursorCapacity = vertexCount;
+		}
+		std::atomic<uint32_t>* cursors = scratch.cursors.get();
+		forChunks(vertexCount, settings.trianglesPerJob, true, [&](size_t begin, size_t end) {
+
+			for (size_t v = begin; v < end; v++) cursors[v].store(0, std::memory_order_relaxed);
+		});
+		forChunks(triCount, settings.trianglesPerJob, true, [&](size_t begin, size_t end) {
+
+			for (size_t i = begin * 3; i < end * 3; i++) cursors[tris[i]].fetch_add(1, std::memory_order_relaxed);
+		});
+
+		// one add per vertex, not worth a parallel scan
+		std::vector<uint32_t>& offsets = scratch.offsets;
+		offsets.resize(vertexCount + 1);
+		offsets[0] = 0;
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			offsets[v + 1] = offsets[v] + cursors[v].load(std::memory_order_relaxed);
+			cursors[v].store(offsets[v], std::memory_order_relaxed);
+		}
+
+		std::vector<uint32_t>& adjacency = scratch.adjacency;
+		adjacency.resize(triCount * 3);
+		forChunks(triCount, settings.trianglesPerJob, true, [&](size_t begin, size_t end) {
+
+			for (size_t f = begin; f < end; f++) {
+
+				for (int c = 0; c < 3; c++) adjacency[cursors[tris[f * 3 + c]].fetch_add(1, std::memory_order_relaxed)] = uint32_t(f);
+			}
+		});
+
+		forChunks(vertexCount, settings.trianglesPerJob, true, [&](size_t begin, size_t end) {
+
+			for (size_t v = begin; v < end; v++) {
+
+				uint32_t* first = adjacency.data() + offsets[v];
+				uint32_t* last = adjacency.data() + offsets[v + 1];
+				if (first == last) continue;
+
+				// a handful of faces per vertex, insertion sort territory
+				std::sort(first, last);
+				TangentFace sum{ glm::vec3(0.0f), glm::vec3(0.0f) };
+				for (const uint32_t* f = first; f != last; f++) {
+
+					sum.s += faces[*f].s;
+					sum.t += faces[*f].t;
+				}
+				resolve(v, sum);
+			}
+		});
+	}
+
+	std::vector<glm::vec4> calculateTangents(
+		const std::vector<glm::vec3>& positions,
+		const std::vector<uint32_t>& indices,
+		const std::vector<glm::vec2>& texCoords,
+		const std::vector<glm::vec3>& normals) {
+
+		std::vector<glm::vec3> tan1(positions.size(), glm::vec3(0.0f));
+		std::vector<glm::vec3> tan2(positions.size(), glm::vec3(0.0f));
+
+		for (size_t i = 0; i < indices.size(); i += 3) {
+
+			uint32_t i0 = indices[i];
+			uint32_t i1 = indices[i + 1];
+			uint32_t i2 = indices[i + 2];
+
+			glm::vec3 p0 = positions[i0];
+			glm::vec3 p1 = positions[i1];
+			glm::vec3 p2 = positions[i2];
+
+			glm::vec2 uv0 = texCoords[i0];
+			glm::vec2 uv1 = texCoords[i1];
+			glm::vec2 uv2 = texCoords[i2];
+
+			glm::vec3 e1 = p1 - p0;
+			glm::vec3 e2 = p2 - p0;
+			glm::vec2 d1 = uv1 - uv0;
+			glm::vec2 d2 = uv2 - uv0;
+
+			float denom = d1.x * d2.y - d2.x * d1.y;
+			if (fabs(denom) < 1e-8f) continue;
+
+			float r = 1.0f / denom;
+			glm::vec3 sdir = (e1 * d2.y - e2 * d1.y) * r;
+			glm::vec3 tdir = (e2 * d1.x - e1 * d2.x) * r;
+
+			tan1[i0] += sdir; tan1[i1] += sdir; tan1[i2] += sdir;
+			tan2[i0] += tdir; tan2[i1] += tdir; tan2[i2] += tdir;
+		}
+
+		std::vector<glm::vec4> result(positions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+
+			glm::vec3 n = glm::normalize(normals[i]);
+			glm::vec3 t = tan1[i];
+
+			// Gram-Schmidt
+			t = glm::normalize(t - n * glm::dot(n, t));
+
+			float w = (glm::dot(glm::cross(n, t), tan2[i]) < 0.0f) ? -1.0f : 1.0f;
+			result[i] = glm::vec4(t, w);
+		}
+		return result;
+	}
+
+	TangentBenchmark benchmarkTangents(const std::vector<uint32_t>& indices, const std::vector<IndexRange>& ranges, const uint8_t* vertices,
+		size_t vertexCount, size_t vertexStride, const VertexAttribs& attribs, size_t tangentOffset, uint32_t iterations) {
+
+		TangentBenchmark result;
+
+		std::vector<uint32_t> rangeIndices;
+		for (auto& r : ranges) rangeIndices.insert(rangeIndices.end(), indices.begin() + r.start, indices.begin() + r.start + r.count / 3 * 3);
+		if (rangeIndices.empty()) return result;
+
+		auto time = [](auto&& fn) {
+
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+		auto best = [&](auto&& fn) {
+
+			double ms = std::numeric_limits<double>::max();
+			for (uint32_t i = 0; i < std::max(iterations, 1u); i++) ms = std::min(ms, time(fn));
+			return ms;
+		};
+
+		// baseline, same shape as the loaders' old loadTangents: copy out to vectors, run, copy back
+		std::vector<uint8_t> reference(vertices, vertices + vertexCount * vertexStride);
+		result.referenceMs = best([&]() {
+
+			std::vector<glm::vec3> positions, normals;
+			std::vector<glm::vec2> texCoords;
+			positions.reserve(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++) {
+
+				const uint8_t* vert = reference.data() + v * vertexStride;
+				glm::vec3 p, n;
+				glm::vec2 uv;
+				std::memcpy(&p, vert + attribs.position, sizeof(p));
+				std::memcpy(&n, vert + attribs.normal, sizeof(n));
+				std::memcpy(&uv, vert + attribs.uv, sizeof(uv));
+				positions.push_back(p);
+				normals.push_back(n);
+				texCoords.push_back(uv);
+			}
+			std::vector<glm::vec4> tangents = calculateTangents(positions, rangeIndices, texCoords, normals);
+			for (size_t v = 0; v < vertexCount; v++) std::memcpy(reference.data() + v * vertexStride + tangentOffset, &tangents[v], sizeof(glm::vec4));
+		});
+
+		std::vector<uint8_t> kernel(vertices, vertices + vertexCount * vertexStride);
+		TangentSettings serial;
+		serial.parallel = false;
+		result.serialMs = best([&]() { generateTangents(indices.data(), ranges, kernel.data(), vertexCount, vertexStride, attribs, tangentOffset, serial); });
+		result.parallelMs = best([&]() { generateTangents(indices.data(), ranges, kernel.data(), vertexCount, vertexStride, attribs, tangentOffset); });
+
+		// unreferenced vertices are garbage in the baseline (normalize of zero), only compare what both wrote
+		std::vector<uint8_t> used(vertexCount, 0);
+		for (uint32_t v : rangeIndices) used[v] = 1;
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			if (!used[v]) continue;
+
+			glm::vec4 a, b;
+			std::memcpy(&a, reference.data() + v * vertexStride + tangentOffset, sizeof(a));
+			std::memcpy(&b, kernel.data() + v * vertexStride + tangentOffset, sizeof(b));
+			for (int c = 0; c < 4; c++) result.maxDifference = std::max(result.maxDifference, std::fabs(a[c] - b[c]));
+		}
+		return result;
+	}
+}
@@ -0,0 +1,442 @@
+#include "pch.h"
+#include "Renderer/Scene/texture_compress.h"
+#include "Renderer/Scene/scene_cache.h"
+#include "Core/Utils/thread_pool.h"
+
+namespace TextureCompress {
+
+	// lsb first, the order every bc format packs its fields in
+	struct BitWriter {
+
+		uint8_t* out;
+		uint32_t pos = 0;
+
+		void put(uint32_t value, uint32_t bits) {
+
+			for (uint32_t i = 0; i < bits; i++, pos++) {
+
+				if ((value >> i) & 1u) out[pos >> 3] |= uint8_t(1u << (pos & 7));
+			}
+		}
+	};
+
+	// dominant direction of the block's colours, a few power iterations on the covariance are plenty for 16 points
+	template<int N>
+	static glm::vec<N, float> principalAxis(const glm::vec<N, float>* points, const glm::vec<N, float>& mean) {
+
+		using Vec = glm::vec<N, float>;
+		float cov[N][N] = {};
+		for (int p = 0; p < 16; p++) {
+
+			Vec d = points[p] - mean;
+			for (int i = 0; i < N; i++) for (int j = 0; j < N; j++) cov[i][j] += d[i] * d[j];
+		}
+
+		Vec axis(1.0f);
+		for (int iter = 0; iter < 8; iter++) {
+
+			Vec next(0.0f);
+			for (int i = 0; i < N; i++) for (int j = 0; j < N; j++) next[i] += cov[i][j] * axis[j];
+			float len = glm::length(next);
+			if (len < 1e-6f) break;
+			axis = next / len;
+		}
+		return axis;
+	}
+
+	// least squares endpoints for fixed indices, weights[i] = how far texel i sits from e0 towards e1.
+	// false when every texel got the same weight (nothing to solve)
+	template<int N>
+	static bool refitEndpoints(const glm::vec<N, float>* points, const float* weights, glm::vec<N, float>& e0, glm::vec<N, float>& e1) {
+
+		using Vec = glm::vec<N, float>;
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		Vec ax(0.0f), bx(0.0f);
+		for (int i = 0; i < 16; i++) {
+
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ax += a * points[i];
+			bx += b * points[i];
+		}
+		float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f) return false;
+
+		e0 = glm::clamp((ax * bb - bx * ab) / det, Vec(0.0f), Vec(255.0f));
+		e1 = glm::clamp((bx * aa - ax * ab) / det, Vec(0.0f), Vec(255.0f));
+		return true;
+	}
+
+	// ---- BC1 ----
+
+	static uint16_t to565(const glm::vec3& c) {
+
+		uint32_t r = uint32_t(std::clamp(c.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+		uint32_t g = uint32_t(std::clamp(c.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+		uint32_t b = uint32_t(std::clamp(c.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	static glm::vec3 from565(uint16_t c) {
+
+		uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		return glm::vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+	}
+
+	// 4 colour mode only (c0 > c1), returns the squared error. indices in palette order c0, c1, 2/3 c0, 1/3 c0
+	static float bc1Indices(const glm::vec3* points, uint16_t c0, uint16_t c1, uint8_t* indices) {
+
+		glm::vec3 palette[4] = { from565(c0), from565(c1) };
+		palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+		palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+		float error = 0.0f;
+		for (int i = 0; i < 16; i++) {
+
+			float best = std::numeric_limits<float>::max();
+			for (uint8_t p = 0; p < 4; p++) {
+
+				glm::vec3 d = points[i] - palette[p];
+				float e = glm::dot(d, d);
+				if (e < best) {
+
+					best = e;
+					indices[i] = p;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	void encodeBC1(const uint8_t texels[64], uint8_t out[8]) {
+
+		glm::vec3 points[16];
+		glm::vec3 mean(0.0f);
+		for (int i = 0; i < 16; i++) {
+
+			points[i] = glm::vec3(texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2]);
+			mean += points[i] / 16.0f;
+		}
+
+		glm::vec3 axis = principalAxis<3>(points, mean);
+		float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+		for (const auto& p : points) {
+
+			float t = glm::dot(p - mean, axis);
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+
+		uint16_t c0 = to565(mean + axis * hi);
+		uint16_t c1 = to565(mean + axis * lo);
+		uint8_t indices[16] = {};
+		float error = 0.0f;
+		if (c0 != c1) {
+
+			if (c0 < c1) std::swap(c0, c1);
+			error = bc1Indices(points, c0, c1, indices);
+
+			// one refit against the picked indices, kept only if it actually helps
+			const float weight[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			float weights[16];
+			for (int i = 0; i < 16; i++) weights[i] = weight[indices[i]];
+
+			glm::vec3 e0, e1;
+			if (refitEndpoints<3>(points, weights, e0, e1)) {
+
+				uint16_t r0 = to565(e0), r1 = to565(e1);
+				if (r0 < r1) std::swap(r0, r1);
+				uint8_t refit[16];
+				if (r0 != r1) {
+
+					float refitError = bc1Indices(points, r0, r1, refit);
+					if (refitError < error) {
+
+						c0 = r0;
+						c1 = r1;
+						std::memcpy(indices, refit, sizeof(indices));
+					}
+				}
+			}
+		}
+
+		// c0 == c1 drops into 3 colour mode where index 0 is still c0
+		std::memset(out, 0, 8);
+		BitWriter bits{ out };
+		bits.put(c0, 16);
+		bits.put(c1, 16);
+		for (int i = 0; i < 16; i++) bits.put(c0 == c1 ? 0 : indices[i], 2);
+	}
+
+	// ---- BC4 / BC5 ----
+
+	void encodeBC4(const uint8_t texels[64], uint32_t channel, uint8_t out[8]) {
+
+		uint8_t lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++) {
+
+			lo = std::min(lo, texels[i * 4 + channel]);
+			hi = std::max(hi, texels[i * 4 + channel]);
+		}
+
+		// r0 > r1 is the 8 value mode, palette r0, r1 then 6 evenly spaced steps from r0 to r1
+		float palette[8] = { float(hi), float(lo) };
+		for (int k = 2; k < 8; k++) palette[k] = (float(8 - k) * hi + float(k - 1) * lo) / 7.0f;
+
+		std::memset(out, 0, 8);
+		BitWriter bits{ out };
+		bits.put(hi, 8);
+		bits.put(lo, 8);
+		for (int i = 0; i < 16; i++) {
+
+			uint32_t bestIndex = 0;
+			if (hi != lo) {
+
+				float best = std::numeric_limits<float>::max();
+				for (uint32_t k = 0; k < 8; k++) {
+
+					float e = std::abs(float(texels[i * 4 + channel]) - palette[k]);
+					if (e < best) {
+
+						best = e;
+						bestIndex = k;
+					}
+				}
+			}
+			bits.put(bestIndex, 3);
+		}
+	}
+
+	void encodeBC5(const uint8_t texels[64], uint8_t out[16]) {
+
+		encodeBC4(texels, 0, out);
+		encodeBC4(texels, 1, out + 8);
+	}
+
+	// ---- BC7 mode 6 ----
+
+	static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// 7 bit endpoint + shared p bit per endpoint, so each endpoint lands on a full 8 bit value. picks the p bit
+	// that loses the least across all four channels
+	static void quantizeMode6(const glm::vec4& e, glm::ivec4& q, uint32_t& pbit) {
+
+		float bestError = std::numeric_limits<float>::max();
+		for (uint32_t p = 0; p < 2; p++) {
+
+			glm::ivec4 candidate;
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+
+				candidate[c] = std::clamp(int(std::round((e[c] - float(p)) * 0.5f)), 0, 127);
+				float d = e[c] - float(candidate[c] * 2 + int(p));
+				error += d * d;
+			}
+			if (error < bestError) {
+
+				bestError = error;
+				q = candidate;
+				pbit = p;
+			}
+		}
+	}
+
+	static float mode6Indices(const glm::vec4* points, const glm::ivec4& q0, uint32_t p0, const glm::ivec4& q1, uint32_t p1, uint8_t* indices) {
+
+		glm::ivec4 e0 = q0 * 2 + int(p0);
+		glm::ivec4 e1 = q1 * 2 + int(p1);
+		glm::vec4 palette[16];
+		for (int k = 0; k < 16; k++) {
+
+			palette[k] = glm::vec4(((64 - bc7Weights[k]) * e0 + bc7Weights[k] * e1 + 32) / 64);
+		}
+
+		float error = 0.0f;
+		for (int i = 0; i < 16; i++) {
+
+			float best = std::numeric_limits<float>::max();
+			for (uint8_t k = 0; k < 16; k++) {
+
+				glm::vec4 d = points[i] - palette[k];
+				float e = glm::dot(d, d);
+				if (e < best) {
+
+					best = e;
+					indices[i] = k;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	void encodeBC7(const uint8_t texels[64], uint8_t out[16]) {
+
+		glm::vec4 points[16];
+		glm::vec4 mean(0.0f);
+		for (int i = 0; i < 16; i++) {
+
+			points[i] = glm::vec4(texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2], texels[i * 4 + 3]);
+			mean += points[i] / 16.0f;
+		}
+
+		glm::vec4 axis = principalAxis<4>(points, mean);
+		float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+		for (const auto& p : points) {
+
+			float t = glm::dot(p - mean, axis);
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+
+		glm::ivec4 q0, q1;
+		uint32_t p0, p1;
+		quantizeMode6(glm::clamp(mean + axis * lo, glm::vec4(0.0f), glm::vec4(255.0f)), q0, p0);
+		quantizeMode6(glm::clamp(mean + axis * hi, glm::vec4(0.0f), glm::vec4(255.0f)), q1, p1);
+		uint8_t indices[16];
+		float error = mode6Indices(points, q0, p0, q1, p1, indices);
+
+		float weights[16];
+		for (int i = 0; i < 16; i++) weights[i] = float(bc7Weights[indices[i]]) / 64.0f;
+
+		glm::vec4 e0, e1;
+		if (refitEndpoints<4>(points, weights, e0, e1)) {
+
+			glm::ivec4 r0, r1;
+			uint32_t rp0, rp1;
+			quantizeMode6(e0, r0, rp0);
+			quantizeMode6(e1, r1, rp1);
+			uint8_t refit[16];
+			float refitError = mode6Indices(points, r0, rp0, r1, rp1, refit);
+			if (refitError < error) {
+
+				q0 = r0, q1 = r1, p0 = rp0, p1 = rp1;
+				std::memcpy(indices, refit, sizeof(indices));
+			}
+		}
+
+		// the anchor (texel 0) index is stored without its top bit, so it has to be < 8
+		if (indices[0] & 8) {
+
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (auto& index : indices) index = uint8_t(15 - index);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter bits{ out };
+		bits.put(1u << 6, 7); // mode 6
+		for (int c = 0; c < 4; c++) {
+
+			bits.put(uint32_t(q0[c]), 7);
+			bits.put(uint32_t(q1[c]), 7);
+		}
+		bits.put(p0, 1);
+		bits.put(p1, 1);
+		bits.put(indices[0], 3);
+		for (int i = 1; i < 16; i++) bits.put(indices[i], 4);
+	}
+
+	// ---- chains ----
+
+	Choice chooseFormat(uint32_t slotMask, const uint8_t* rgba, uint32_t width, uint32_t height) {
+
+		auto only = [&](uint32_t mask) { return slotMask != 0 && (slotMask & ~mask) == 0; };
+		const uint32_t albedo = 1u << SceneCache::SLOT_ALBEDO;
+		const uint32_t normal = 1u << SceneCache::SLOT_NORMAL;
+		const uint32_t red = (1u << SceneCache::SLOT_OCCLUSION) | (1u << SceneCache::SLOT_TRANSMISSION);
+		const uint32_t green = 1u << SceneCache::SLOT_THICKNESS;
+
+		if (only(normal)) return { BC5 };
+		if (only(red)) return { BC4, 0 };
+		if (only(green)) return { BC4, 1 };
+		if (slotMask & albedo) return { BC7 };
+
+		bool alpha = false;
+		for (size_t i = 0; i < size_t(width) * height && !alpha; i++) alpha = rgba[i * 4 + 3] < 255;
+		return { alpha ? BC7 : BC1 };
+	}
+
+	bool isCompressed(Format format) {
+
+		return format != RGBA8;
+	}
+
+	size_t levelSize(Format format, uint32_t width, uint32_t height) {
+
+		if (format == RGBA8) return size_t(std::max(1u, width)) * std::max(1u, height) * 4;
+
+		size_t blocks = size_t((std::max(1u, width) + 3) / 4) * ((std::max(1u, height) + 3) / 4);
+		return blocks * ((format == BC1 || format == BC4) ? 8 : 16);
+	}
+
+	size_t chainSize(Format format, uint32_t width, uint32_t height, uint32_t mipCount) {
+
+		size_t bytes = 0;
+		for (uint32_t level = 0; level < mipCount; level++) bytes += levelSize(format, width >> level, height >> level);
+		return bytes;
+	}
+
+	std::vector<uint8_t> compressChain(const uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipCount, Choice choice) {
+
+		if (choice.format == RGBA8) return std::vector<uint8_t>(chain, chain + chainSize(RGBA8, width, height, mipCount));
+
+		struct Row {
+
+			uint32_t level;
+			uint32_t blockY;
+			size_t src;
+			size_t dst;
+		};
+
+		// one job per block row across every level, small levels would leave workers idle otherwise
+		std::vector<Row> rows;
+		size_t src = 0, dst = 0;
+		for (uint32_t level = 0; level < mipCount; level++) {
+
+			uint32_t w = std::max(1u, width >> level), h = std::max(1u, height >> level);
+			size_t rowBytes = levelSize(choice.format, w, 4);
+			for (uint32_t by = 0; by < (h + 3) / 4; by++) rows.push_back({ level, by, src, dst + by * rowBytes });
+			src += levelSize(RGBA8, w, h);
+			dst += levelSize(choice.format, w, h);
+		}
+
+		std::vector<uint8_t> out(dst);
+		size_t blockBytes = (choice.format == BC1 || choice.format == BC4) ? 8 : 16;
+
+		Utils::Jobs::get().parallelFor(rows.size(), [&](size_t r) {
+
+			const Row& row = rows[r];
+			uint32_t w = std::max(1u, width >> row.level), h = std::max(1u, height >> row.level);
+			const uint8_t* pixels = chain + row.src;
+
+			for (uint32_t bx = 0; bx < (w + 3) / 4; bx++) {
+
+				// edge blocks repeat the last row/column
+				uint8_t texels[64];
+				for (uint32_t y = 0; y < 4; y++) {
+
+					for (uint32_t x = 0; x < 4; x++) {
+
+						uint32_t sx = std::min(bx * 4 + x, w - 1), sy = std::min(row.blockY * 4 + y, h - 1);
+						std::memcpy(texels + (y * 4 + x) * 4, pixels + (size_t(sy) * w + sx) * 4, 4);
+					}
+				}
+
+				uint8_t* block = out.data() + row.dst + bx * blockBytes;
+				switch (choice.format) {
+
+				case BC1: encodeBC1(texels, block); break;
+				case BC4: encodeBC4(texels, choice.channel, block); break;
+				case BC5: encodeBC5(texels, block); break;
+				default: encodeBC7(texels, block); break;
+				}
+			}
+		});
+		return out;
+	}
+}
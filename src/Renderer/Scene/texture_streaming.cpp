@@ -0,0 +1,145 @@
+#include "pch.h"
+#include "Renderer/Scene/texture_streaming.h"
+
+namespace TextureStreaming {
+
+	static size_t levelBytes(const Texture& t, uint32_t level) {
+
+		return TextureCompress::levelSize(t.format, t.width >> level, t.height >> level);
+	}
+
+	uint32_t mipCount(uint32_t width, uint32_t height) {
+
+		uint32_t count = 1;
+		while ((width >> count) > 0 || (height >> count) > 0) count++;
+		return count;
+	}
+
+	size_t chainBytes(TextureCompress::Format format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t base) {
+
+		size_t bytes = 0;
+		for (uint32_t level = base; level < mipCount; level++) bytes += TextureCompress::levelSize(format, width >> level, height >> level);
+		return bytes;
+	}
+
+	Texture makeTexture(uint32_t width, uint32_t height, TextureCompress::Format format, const Settings& settings) {
+
+		Texture t;
+		t.width = width;
+		t.height = height;
+		t.format = format;
+		t.mipCount = mipCount(width, height);
+		while (t.coarseBase + 1 < t.mipCount && std::max(width >> t.coarseBase, height >> t.coarseBase) > settings.residentSize) t.coarseBase++;
+		t.residentBase = t.coarseBase;
+		t.requestedBase = t.coarseBase;
+		t.targetBase = t.coarseBase;
+		return t;
+	}
+
+	float requiredMip(const MeshUtils::SurfaceDetail& detail, const glm::mat4& model, const glm::vec3& cameraPos, float lodScale, uint32_t textureSize) {
+
+		// constant uvs sample one texel whatever the distance
+		if (detail.uvDensity <= 0.0f) return std::numeric_limits<float>::max();
+
+		glm::mat3 linear(model);
+		float maxScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+		if (maxScale <= 0.0f) return std::numeric_limits<float>::max();
+
+		// closest point of the bounds, the near side of a big surface is what needs the detail
+		glm::vec3 center = glm::vec3(model * glm::vec4(detail.center, 1.0f));
+		float dist = glm::length(center - cameraPos) - detail.radius * maxScale;
+		if (dist <= 0.0f || lodScale <= 0.0f) return 0.0f;
+
+		float pixelsPerUnit = lodScale / dist;
+		float texelsPerUnit = detail.uvDensity / maxScale * float(textureSize);
+		return std::log2(texelsPerUnit / pixelsPerUnit);
+	}
+
+	void beginFrame(std::vector<Texture>& textures) {
+
+		for (auto& t : textures) t.requestedBase = t.coarseBase;
+	}
+
+	void request(Texture& texture, float mip, const Settings& settings) {
+
+		mip += settings.mipBias;
+		if (!(mip < float(texture.requestedBase))) return;
+
+		texture.requestedBase = mip <= 0.0f ? 0 : uint32_t(mip);
+	}
+
+	std::vector<Change> plan(std::vector<Texture>& textures, const Settings& settings, Stats& stats) {
+
+		stats = {};
+		for (const auto& t : textures) {
+
+			stats.residentBytes += t.residentBytes();
+			stats.requestedBytes += t.requestedBytes();
+		}
+
+		// coarsen every request by the same amount until it fits, the coarse levels stay even if they alone don't
+		for (uint32_t bias = 0;; bias++) {
+
+			size_t total = 0;
+			bool coarsest = true;
+			for (auto& t : textures) {
+
+				t.targetBase = std::min(t.requestedBase + bias, t.coarseBase);
+				total += chainBytes(t.format, t.width, t.height, t.mipCount, t.targetBase);
+				coarsest = coarsest && t.targetBase == t.coarseBase;
+			}
+			stats.targetBytes = total;
+			stats.budgetBias = bias;
+			if (total <= settings.budgetBytes || coarsest) break;
+		}
+
+		std::vector<Change> changes;
+		bool overBudget = stats.residentBytes > settings.budgetBytes;
+		std::vector<uint32_t> loads;
+
+		for (uint32_t i = 0; i < textures.size(); i++) {
+
+			Texture& t = textures[i];
+			if (t.residentBase > t.targetBase) loads.push_back(i);
+			if (t.residentBase >= t.targetBase) {
+
+				t.overFrames = 0;
+				continue;
+			}
+
+			// finer than needed, hang on to it for a while in case the camera comes back unless memory is short
+			if (overBudget || ++t.overFrames >= settings.evictFrames) {
+
+				changes.push_back({ i, t.targetBase });
+				t.overFrames = 0;
+				stats.evictions++;
+			}
+		}
+
+		std::stable_sort(loads.begin(), loads.end(), [&](uint32_t a, uint32_t b) {
+
+			return textures[a].residentBase - textures[a].targetBase > textures[b].residentBase - textures[b].targetBase;
+		});
+
+		size_t spent = 0;
+		for (uint32_t i : loads) {
+
+			const Texture& t = textures[i];
+			uint32_t base = t.residentBase;
+			while (base > t.targetBase) {
+
+				size_t cost = levelBytes(t, base - 1);
+				if (spent > 0 && spent + cost > settings.uploadBytesPerFrame) break;
+				spent += cost;
+				base--;
+			}
+			if (base != t.residentBase) {
+
+				changes.push_back({ i, base });
+				stats.loads++;
+			}
+			if (spent >= settings.uploadBytesPerFrame) break;
+		}
+		return changes;
+	}
+}
@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "Renderer/Scene/texture_transcode.h"
+#include "Renderer/Scene/scene_cache.h"
+#include <ktx.h>
+
+namespace TextureTranscode {
+
+	using TextureCompress::Format;
+
+	static const uint8_t KTX2_MAGIC[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// VkFormat values a non basis ktx2 can already be stored in, ktx.h only hands vkFormat over as a number
+	enum StoredFormat : uint32_t {
+
+		VK_R8G8B8A8_UNORM = 37,
+		VK_R8G8B8A8_SRGB = 43,
+		VK_BC1_RGBA_UNORM = 133,
+		VK_BC1_RGBA_SRGB = 134,
+		VK_BC4_UNORM = 139,
+		VK_BC5_UNORM = 141,
+		VK_BC7_UNORM = 145,
+		VK_BC7_SRGB = 146
+	};
+
+	bool isKtx2(const uint8_t* bytes, size_t size) {
+
+		return size >= sizeof(KTX2_MAGIC) && std::memcmp(bytes, KTX2_MAGIC, sizeof(KTX2_MAGIC)) == 0;
+	}
+
+	static uint32_t fullMipCount(uint32_t width, uint32_t height) {
+
+		uint32_t count = 1;
+		while ((width >> count) > 0 || (height >> count) > 0) count++;
+		return count;
+	}
+
+	// same split as TextureCompress::chooseFormat, except alpha comes from the file instead of a pixel scan.
+	// etc1s keeps a normal map's y in the alpha slice as far as bc5 is concerned, so only uastc normals go to bc5
+	static Format pickTarget(uint32_t slotMask, bool alpha, bool uastc) {
+
+		auto only = [&](uint32_t mask) { return slotMask != 0 && (slotMask & ~mask) == 0; };
+		const uint32_t albedo = 1u << SceneCache::SLOT_ALBEDO;
+		const uint32_t normal = 1u << SceneCache::SLOT_NORMAL;
+		const uint32_t red = (1u << SceneCache::SLOT_OCCLUSION) | (1u << SceneCache::SLOT_TRANSMISSION);
+
+		if (only(normal)) return uastc ? TextureCompress::BC5 : TextureCompress::BC7;
+		if (only(red)) return TextureCompress::BC4;
+		if ((slotMask & albedo) || alpha) return TextureCompress::BC7;
+		return TextureCompress::BC1;
+	}
+
+	static ktx_transcode_fmt_e transcodeFormat(Format format) {
+
+		switch (format) {
+
+		case TextureCompress::BC1: return KTX_TTF_BC1_RGB;
+		case TextureCompress::BC4: return KTX_TTF_BC4_R;
+		case TextureCompress::BC5: return KTX_TTF_BC5_RG;
+		case TextureCompress::BC7: return KTX_TTF_BC7_RGBA;
+		default: return KTX_TTF_RGBA32;
+		}
+	}
+
+	// srgb and unorm land in the same format, the backends pick the view per slot
+	static bool storedFormat(uint32_t vkFormat, Format& out) {
+
+		switch (vkFormat) {
+
+		case VK_R8G8B8A8_UNORM: case VK_R8G8B8A8_SRGB: out = TextureCompress::RGBA8; return true;
+		case VK_BC1_RGBA_UNORM: case VK_BC1_RGBA_SRGB: out = TextureCompress::BC1; return true;
+		case VK_BC4_UNORM: out = TextureCompress::BC4; return true;
+		case VK_BC5_UNORM: out = TextureCompress::BC5; return true;
+		case VK_BC7_UNORM: case VK_BC7_SRGB: out = TextureCompress::BC7; return true;
+		default: return false;
+		}
+	}
+
+	// the first levels of tex in the chain layout, false if libktx disagrees on a level's size
+	static bool copyLevels(ktxTexture2* tex, Format format, uint32_t levels, std::vector<uint8_t>& out) {
+
+		ktxTexture* base = ktxTexture(tex);
+		const uint8_t* data = ktxTexture_GetData(base);
+
+		out.clear();
+		out.reserve(TextureCompress::chainSize(format, tex->baseWidth, tex->baseHeight, levels));
+		for (uint32_t level = 0; level < levels; level++) {
+
+			ktx_size_t offset = 0;
+			if (ktxTexture_GetImageOffset(base, level, 0, 0, &offset) != KTX_SUCCESS) return false;
+
+			size_t size = TextureCompress::levelSize(format, tex->baseWidth >> level, tex->baseHeight >> level);
+			if (ktxTexture_GetImageSize(base, level) != size) return false;
+			out.insert(out.end(), data + offset, data + offset + size);
+		}
+		return true;
+	}
+
+	bool transcode(const uint8_t* bytes, size_t size, uint32_t slotMask, bool blockFormats, Image& out) {
+
+		ktxTexture2* tex = nullptr;
+		if (ktxTexture2_CreateFromMemory(bytes, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &tex) != KTX_SUCCESS) return false;
+
+		// plain 2d only, that's all a gltf texture can be
+		bool ok = tex->numDimensions == 2 && tex->numLayers == 1 && tex->numFaces == 1;
+		uint32_t components = ktxTexture2_GetNumComponents(tex);
+		bool fullChain = tex->numLevels == fullMipCount(tex->baseWidth, tex->baseHeight);
+
+		// without every level there's nothing to fill the gap with except our own box filter, which wants rgba8
+		Format format = TextureCompress::RGBA8;
+		if (ok && ktxTexture2_NeedsTranscoding(tex)) {
+
+			bool uastc = tex->supercompressionScheme != KTX_SS_BASIS_LZ;
+			bool alpha = components == 2 || components == 4;
+			if (blockFormats && fullChain) format = pickTarget(slotMask, alpha, uastc);
+			ok = ktxTexture2_TranscodeBasis(tex, transcodeFormat(format), 0) == KTX_SUCCESS;
+		}
+		else if (ok) {
+
+			ok = storedFormat(tex->vkFormat, format) && (format == TextureCompress::RGBA8 || (blockFormats && fullChain));
+		}
+
+		if (ok) {
+
+			out.width = tex->baseWidth;
+			out.height = tex->baseHeight;
+			out.channels = components;
+			out.format = format;
+			out.mipCount = fullChain ? tex->numLevels : 1;
+			ok = copyLevels(tex, format, out.mipCount, out.chain);
+		}
+		ktxTexture_Destroy(ktxTexture(tex));
+		if (!ok) return false;
+
+		if (!fullChain) {
+
+			std::vector<uint8_t> level0 = std::move(out.chain);
+			out.mipCount = SceneCache::buildMipChain(level0.data(), out.width, out.height, out.chain);
+		}
+
+		// still rgba8 here (short chain or stored uncompressed), same encode a png gets. level 0 leads the chain
+		if (blockFormats && out.format == TextureCompress::RGBA8) {
+
+			TextureCompress::Choice choice = TextureCompress::chooseFormat(slotMask, out.chain.data(), out.width, out.height);
+			out.chain = TextureCompress::compressChain(out.chain.data(), out.width, out.height, out.mipCount, choice);
+			out.format = choice.format;
+		}
+		return true;
+	}
+}
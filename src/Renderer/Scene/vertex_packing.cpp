@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "Renderer/Scene/vertex_packing.h"
+#include <cmath>
+
+namespace MeshUtils {
+
+	static int16_t toSnorm16(float v) {
+
+		return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	static uint16_t toUnorm16(float v) {
+
+		return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	// project onto the octahedron, then fold the lower half over the diagonals
+	glm::vec2 octEncode(const glm::vec3& n) {
+
+		float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (l1 <= 0.0f) return glm::vec2(0.0f, 0.0f);
+
+		glm::vec2 p(n.x / l1, n.y / l1);
+		if (n.z < 0.0f) {
+
+			glm::vec2 folded((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+			p = folded;
+		}
+		return p;
+	}
+
+	// round to nearest even, clamps to the largest half instead of going to inf, flushes tiny values to zero
+	uint16_t floatToHalf(float f) {
+
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		uint32_t absBits = bits & 0x7fffffffu;
+
+		if (absBits >= 0x7f800000u) return static_cast<uint16_t>(sign | (absBits > 0x7f800000u ? 0x7e00u : 0x7c00u)); // nan / inf
+		if (absBits >= 0x477ff000u) return static_cast<uint16_t>(sign | 0x7bffu); // >= 65520 rounds past the max half
+		if (absBits < 0x33000000u) return static_cast<uint16_t>(sign); // below half the smallest denormal
+
+		int32_t exponent = int32_t(absBits >> 23) - 127 + 15;
+		uint32_t mantissa = absBits & 0x7fffffu;
+
+		if (exponent <= 0) {
+
+			// denormal half
+			mantissa |= 0x800000u;
+			uint32_t shift = uint32_t(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t midpoint = 1u << (shift - 1);
+			if (rest > midpoint || (rest == midpoint && (half & 1u))) half++;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fffu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++; // a carry into the exponent is still correct
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	void packVertices(const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		size_t positionOffset, size_t normalOffset, size_t uvOffset, size_t tangentOffset, PackedMesh& out) {
+
+		auto read3 = [&](size_t v, size_t offset) {
+
+			glm::vec3 r;
+			std::memcpy(&r, vertices + v * vertexStride + offset, sizeof(r));
+			return r;
+		};
+
+		glm::vec3 lo(std::numeric_limits<float>::max());
+		glm::vec3 hi(std::numeric_limits<float>::lowest());
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			glm::vec3 p = read3(v, positionOffset);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		if (vertexCount == 0) lo = hi = glm::vec3(0.0f);
+
+		// flat axes still need a non zero scale to divide by
+		glm::vec3 extent = hi - lo;
+		for (int a = 0; a < 3; a++) if (extent[a] <= 0.0f) extent[a] = 1.0f;
+
+		out.posOffset = glm::vec4(lo, 0.0f);
+		out.posScale = glm::vec4(extent, 0.0f);
+		out.vertices.resize(vertexCount);
+
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			const uint8_t* src = vertices + v * vertexStride;
+			glm::vec3 p = read3(v, positionOffset);
+			glm::vec3 n = read3(v, normalOffset);
+			glm::vec2 uv;
+			glm::vec4 t;
+			std::memcpy(&uv, src + uvOffset, sizeof(uv));
+			std::memcpy(&t, src + tangentOffset, sizeof(t));
+
+			PackedVertex& dst = out.vertices[v];
+			for (int a = 0; a < 3; a++) dst.position[a] = toUnorm16((p[a] - lo[a]) / extent[a]);
+			dst.position[3] = t.w < 0.0f ? 0 : 65535;
+
+			glm::vec2 on = octEncode(n);
+			glm::vec2 ot = octEncode(glm::vec3(t.x, t.y, t.z));
+			dst.normal[0] = toSnorm16(on.x);
+			dst.normal[1] = toSnorm16(on.y);
+			dst.tangent[0] = toSnorm16(ot.x);
+			dst.tangent[1] = toSnorm16(ot.y);
+
+			dst.uv[0] = floatToHalf(uv.x);
+			dst.uv[1] = floatToHalf(uv.y);
+		}
+	}
+
+	void packIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount, PackedMesh& out) {
+
+		// 0xffff is left alone so primitive restart can never bite
+		out.indexSize = vertexCount < 0xffff ? 2 : 4;
+		out.indices.resize(indexCount * out.indexSize);
+
+		if (out.indexSize == 4) {
+
+			std::memcpy(out.indices.data(), indices, indexCount * sizeof(uint32_t));
+			return;
+		}
+
+		uint16_t* dst = reinterpret_cast<uint16_t*>(out.indices.data());
+		for (size_t i = 0; i < indexCount; i++) dst[i] = static_cast<uint16_t>(indices[i]);
+	}
+}
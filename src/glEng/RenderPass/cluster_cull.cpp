@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "glEng/RenderPass/cluster_cull.h"
+#include "glEng/gl_state.h"
+
+void DynamicIndirectBuffer::upload(const std::vector<DrawElementsIndirectCommand>& commands) {
+
+	_alloc = DynamicRing::Get().upload(commands.data(), GLsizeiptr(commands.size() * sizeof(DrawElementsIndirectCommand)), GL_DRAW_INDIRECT_BUFFER);
+}
+
+void ClusterCullPass::beginFrame(const glm::mat4& viewProj, const glm::vec3& cameraPos, float lodScale) {
+
+	_params.frustum = MeshUtils::extractFrustum(viewProj);
+	_params.cameraPos = cameraPos;
+	_params.frustumCull = frustumCull;
+	_params.coneCull = coneCull;
+	_params.lodSelect = lodSelect;
+	_params.lodScale = lodScale;
+	_params.lodErrorPixels = lodErrorPixels;
+	_params.forceLod = forceLod;
+	_stats = {};
+}
+
+GLsizei ClusterCullPass::appendCommands(const RenderObject& obj, const std::vector<GPUInstance>& instances, const MeshUtils::ClusterCullParams& params,
+	GLuint firstIndexBase, GLint baseVertex, std::vector<DrawElementsIndirectCommand>& out, MeshUtils::CullStats& stats) {
+
+	size_t before = out.size();
+
+	// nothing to cull with, draw it whole
+	if (!obj.detail) {
+
+		out.push_back({ obj.numIndices, obj.instanceCount, firstIndexBase + obj.idxStart, baseVertex, obj.firstInstance });
+		stats.trianglesSubmitted += obj.numIndices / 3 * obj.instanceCount;
+		return GLsizei(out.size() - before);
+	}
+
+	bool backface = params.coneCull && !obj.material->doubleSided;
+	std::vector<MeshUtils::IndexRange> visible;
+	for (uint32_t i = 0; i < obj.instanceCount; i++) {
+
+		uint32_t slot = obj.firstInstance + i;
+		visible.clear();
+		MeshUtils::cullSurface(*obj.detail, instances[slot].model, params, backface, visible, stats);
+
+		for (auto& range : visible) out.push_back({ range.count, 1, firstIndexBase + range.start, baseVertex, slot });
+	}
+	return GLsizei(out.size() - before);
+}
+
+void ClusterCullPass::cullObjects(const GltfDrawContext& ctx) {
+
+	_commands.clear();
+	_ranges.clear();
+
+	for (auto* objects : { &ctx.opaqueSubmeshes, &ctx.transmissionSubmeshes, &ctx.transparentSubmeshes }) {
+
+		for (auto& obj : *objects) {
+
+			GLintptr offset = GLintptr(_commands.size() * sizeof(DrawElementsIndirectCommand));
+			GLsizei count = appendCommands(obj, ctx.instances, _params, 0, 0, _commands, _stats);
+			_ranges[&obj] = { offset, count };
+		}
+	}
+	_indirect.upload(_commands);
+}
+
+void ClusterCullPass::drawObject(const RenderObject& obj) {
+
+	auto it = _ranges.find(&obj);
+	if (it == _ranges.end() || it->second.count == 0) return;
+
+	GLState::Get().bindVertexArray(obj.meshBuffers.vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect.id());
+	glMultiDrawElementsIndirect(GL_TRIANGLES, obj.meshBuffers.indexType, (void*)(_indirect.offset() + it->second.offset), it->second.count, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "glEng/RenderPass/cubemap.h"
+#include "glEng/gl_state.h"
 #include "stb_image.h"
 #include "core/window.h"
 
@@ -243,12 +244,12 @@ void Cubemap::Draw() {
 
 
 	// Bind cubemap texture
-	_skyboxProg->setTexture("environmentMap", _cubemapTex, 0, GL_TEXTURE_CUBE_MAP);
+	_skyboxProg->setTexture("environmentMap", _cubemapTex, 0);
 
 	// Draw cube
-	glBindVertexArray(_cubeVAO);
+	GLState::Get().bindVertexArray(_cubeVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	GLState::Get().bindVertexArray(0);
 
 	glDepthFunc(GL_LESS);
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "pch.h"
+#include "glEng/gl_engine.h"
+#include "glEng/RenderPass/multi_draw.h"
+#include "glEng/gl_state.h"
+
+void MultiDrawPass::build(const GltfDrawContext& ctx) {
+
+	release();
+	update(ctx);
+}
+
+void MultiDrawPass::update(const GltfDrawContext& ctx) {
+
+	releaseTables();
+	packGeometry(ctx);
+	buildMaterials(ctx);
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	buildPass(batchOrder(ctx.opaqueSubmeshes, false), _passes[size_t(GltfPass::Opaque)], commands);
+	buildPass(batchOrder(ctx.transmissionSubmeshes, false), _passes[size_t(GltfPass::Transmission)], commands);
+	buildPass(batchOrder(ctx.transparentSubmeshes, true), _passes[size_t(GltfPass::Transparent)], commands);
+
+	glCreateBuffers(1, &_indirectBuffer);
+	glNamedBufferStorage(_indirectBuffer, std::max<size_t>(commands.size(), 1) * sizeof(DrawElementsIndirectCommand), commands.data(), 0);
+
+	size_t batchCount = 0;
+	for (auto& p : _passes) batchCount += p.size();
+	std::cout << "multi draw: " << commands.size() << " commands in " << batchCount << " batches, " << _meshRanges.size() << " meshes packed" << std::endl;
+}
+
+void MultiDrawPass::release() {
+
+	releaseTables();
+
+	GLuint buffers[] = { _vertices.buffer, _indices16.indices.buffer, _indices32.indices.buffer };
+	for (GLuint buffer : buffers) if (buffer) glDeleteBuffers(1, &buffer);
+	for (IndexPool* pool : { &_indices16, &_indices32 }) if (pool->vao) glDeleteVertexArrays(1, &pool->vao);
+
+	_vertices = {};
+	_stride = 0;
+	_indices16 = {};
+	_indices32 = {};
+	_meshRanges.clear();
+}
+
+// materials, the instance -> material table and the commands all cover every object, they're redone on each update
+void MultiDrawPass::releaseTables() {
+
+	GLuint buffers[] = { _indirectBuffer, _materialBuffer, _instanceMaterialBuffer };
+	for (GLuint buffer : buffers) if (buffer) glDeleteBuffers(1, &buffer);
+
+	_indirectBuffer = _materialBuffer = _instanceMaterialBuffer = 0;
+	_materialIndex.clear();
+	for (auto& pass : _passes) pass.clear();
+	_sorted.fill(false);
+}
+
+bool MultiDrawPass::reserve(PackedBuffer& packed, GLsizeiptr bytes) {
+
+	if (packed.buffer && packed.size + bytes <= packed.capacity) return false;
+
+	GLsizeiptr capacity = std::max({ packed.size + bytes, packed.capacity * 2, GLsizeiptr(64 * 1024) });
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, capacity, nullptr, 0);
+
+	// draws already submitted keep the old one alive on the driver side, deleting it right away is fine
+	if (packed.size) glCopyNamedBufferSubData(packed.buffer, buffer, 0, 0, packed.size);
+	if (packed.buffer) glDeleteBuffers(1, &packed.buffer);
+
+	packed.buffer = buffer;
+	packed.capacity = capacity;
+	return true;
+}
+
+// copies every mesh the context references that isn't packed yet onto the end of the shared vertex + index buffers, gpu side only
+void MultiDrawPass::packGeometry(const GltfDrawContext& ctx) {
+
+	std::vector<GPUMeshBuffers> meshes;
+	auto collect = [&](const std::vector<RenderObject>& objects) {
+
+		for (auto& obj : objects) {
+
+			if (_meshRanges.count(obj.meshBuffers.vao)) continue;
+			_meshRanges[obj.meshBuffers.vao] = {};
+			meshes.push_back(obj.meshBuffers);
+		}
+	};
+	collect(ctx.opaqueSubmeshes);
+	collect(ctx.transmissionSubmeshes);
+	collect(ctx.transparentSubmeshes);
+
+	// nothing new, or nothing at all yet (no objects means no batches, so the missing vaos never get bound)
+	if (meshes.empty()) return;
+
+	// every mesh of a scene is uploaded with the same layout, so the first one decides the stride
+	if (_stride == 0) _stride = meshes.front().vertexStride;
+
+	GLsizeiptr vertexBytes = 0;
+	GLsizeiptr index16Bytes = 0;
+	GLsizeiptr index32Bytes = 0;
+	for (auto& m : meshes) {
+
+		vertexBytes += GLsizeiptr(m.vertexCount) * _stride;
+		if (m.indexType == GL_UNSIGNED_SHORT) index16Bytes += GLsizeiptr(m.indexCount) * sizeof(uint16_t);
+		else index32Bytes += GLsizeiptr(m.indexCount) * sizeof(uint32_t);
+	}
+
+	bool newVertices = reserve(_vertices, vertexBytes);
+	bool new16 = reserve(_indices16.indices, index16Bytes);
+	bool new32 = reserve(_indices32.indices, index32Bytes);
+
+	for (auto& m : meshes) {
+
+		bool narrow = m.indexType == GL_UNSIGNED_SHORT;
+		GLsizeiptr indexSize = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+		PackedBuffer& indices = narrow ? _indices16.indices : _indices32.indices;
+
+		GLsizeiptr vb = GLsizeiptr(m.vertexCount) * _stride;
+		GLsizeiptr ib = GLsizeiptr(m.indexCount) * indexSize;
+		glCopyNamedBufferSubData(m.vbo, _vertices.buffer, 0, _vertices.size, vb);
+		glCopyNamedBufferSubData(m.ebo, indices.buffer, 0, indices.size, ib);
+
+		// indices stay local to their mesh, baseVertex does the rebasing
+		_meshRanges[m.vao] = { GLint(_vertices.size / _stride), GLuint(indices.size / indexSize) };
+		_vertices.size += vb;
+		indices.size += ib;
+	}
+
+	// same attribute layout as uploadMesh. the vaos only need pointing again when a buffer was swapped for a bigger one
+	bool packed = _stride == GLsizei(sizeof(MeshUtils::PackedVertex));
+	for (IndexPool* pool : { &_indices16, &_indices32 }) {
+
+		bool created = !pool->vao;
+		if (created) {
+
+			glCreateVertexArrays(1, &pool->vao);
+			setVertexFormat(pool->vao, packed);
+		}
+		if (created || newVertices) glVertexArrayVertexBuffer(pool->vao, 0, _vertices.buffer, 0, _stride);
+		if (created || (pool == &_indices16 ? new16 : new32)) glVertexArrayElementBuffer(pool->vao, pool->indices.buffer);
+	}
+}
+
+// compact material table + a material index per instance slot so the shader can go instance -> material
+void MultiDrawPass::buildMaterials(const GltfDrawContext& ctx) {
+
+	std::vector<const gltfMaterial*> materials;
+	std::vector<uint32_t> instanceMaterial(ctx.instances.size(), 0);
+
+	auto collect = [&](const std::vector<RenderObject>& objects) {
+
+		for (auto& obj : objects) {
+
+			auto [it, inserted] = _materialIndex.try_emplace(obj.material.get(), uint32_t(materials.size()));
+			if (inserted) materials.push_back(obj.material.get());
+
+			for (uint32_t i = 0; i < obj.instanceCount; i++) instanceMaterial[obj.firstInstance + i] = it->second;
+		}
+	};
+	collect(ctx.opaqueSubmeshes);
+	collect(ctx.transmissionSubmeshes);
+	collect(ctx.transparentSubmeshes);
+
+	// the constants are already on the gpu in the loader's ubo, just pull the used part of each one across
+	glCreateBuffers(1, &_materialBuffer);
+	glNamedBufferStorage(_materialBuffer, std::max<size_t>(materials.size(), 1) * sizeof(MaterialRecord), nullptr, 0);
+	for (size_t i = 0; i < materials.size(); i++) {
+
+		const auto& res = materials[i]->data.resources;
+		glCopyNamedBufferSubData(res.dataBuffer, _materialBuffer, res.dataBufferOffset, i * sizeof(MaterialRecord), sizeof(MaterialRecord));
+	}
+
+	glCreateBuffers(1, &_instanceMaterialBuffer);
+	glNamedBufferStorage(_instanceMaterialBuffer, std::max<size_t>(instanceMaterial.size(), 1) * sizeof(uint32_t), instanceMaterial.data(), 0);
+}
+
+std::vector<const RenderObject*> MultiDrawPass::batchOrder(const std::vector<RenderObject>& objects, bool keepOrder) {
+
+	std::vector<const RenderObject*> order;
+	order.reserve(objects.size());
+	for (auto& obj : objects) order.push_back(&obj);
+
+	// opaque-ish passes can be reordered freely so everything with the same textures and index width ends up in one batch.
+	// transparent keeps submission order and only merges neighbours
+	if (!keepOrder) {
+
+		std::stable_sort(order.begin(), order.end(), [&](const RenderObject* a, const RenderObject* b) {
+
+			uint32_t ma = _materialIndex[a->material.get()];
+			uint32_t mb = _materialIndex[b->material.get()];
+			if (ma != mb) return ma < mb;
+			return a->meshBuffers.indexType < b->meshBuffers.indexType;
+		});
+	}
+	return order;
+}
+
+void MultiDrawPass::buildPass(const std::vector<const RenderObject*>& order, std::vector<Batch>& out, std::vector<DrawElementsIndirectCommand>& commands) {
+
+	for (const RenderObject* obj : order) {
+
+		const MeshRange& range = _meshRanges[obj->meshBuffers.vao];
+
+		DrawElementsIndirectCommand cmd{};
+		cmd.count = obj->numIndices;
+		cmd.instanceCount = obj->instanceCount;
+		cmd.firstIndex = range.firstIndex + obj->idxStart;
+		cmd.baseVertex = range.baseVertex;
+		cmd.baseInstance = obj->firstInstance;
+
+		GLenum indexType = obj->meshBuffers.indexType;
+		if (out.empty() || out.back().material != obj->material.get() || out.back().indexType != indexType) {
+
+			out.push_back({ obj->material.get(), indexType, GLintptr(commands.size() * sizeof(DrawElementsIndirectCommand)), 0 });
+		}
+		out.back().drawCount++;
+		out.back().objects.push_back(obj);
+		commands.push_back(cmd);
+	}
+}
+
+void MultiDrawPass::sortPasses(const GltfDrawContext& ctx, const std::vector<uint32_t>& opaqueOrder, const std::vector<uint32_t>& transmissionOrder,
+	const std::vector<uint32_t>& transparentOrder) {
+
+	_sortedCommands.clear();
+	auto sortPass = [&](GltfPass pass, const std::vector<RenderObject>& objects, const std::vector<uint32_t>& order) {
+
+		// an order for a different list (queues not sorted yet) falls back to the order update batched in
+		std::vector<const RenderObject*> sorted;
+		if (order.size() == objects.size()) {
+
+			sorted.reserve(objects.size());
+			for (uint32_t i : order) sorted.push_back(&objects[i]);
+		}
+		else sorted = batchOrder(objects, pass == GltfPass::Transparent);
+
+		// sorted back to front the neighbours rarely share a material, so the blended passes cost batches. blending needs the order though
+		std::vector<Batch>& batches = _passes[size_t(pass)];
+		batches.clear();
+		buildPass(sorted, batches, _sortedCommands);
+		_sorted[size_t(pass)] = true;
+	};
+	sortPass(GltfPass::Opaque, ctx.opaqueSubmeshes, opaqueOrder);
+	sortPass(GltfPass::Transmission, ctx.transmissionSubmeshes, transmissionOrder);
+	sortPass(GltfPass::Transparent, ctx.transparentSubmeshes, transparentOrder);
+	_sortedIndirect.upload(_sortedCommands);
+}
+
+void MultiDrawPass::cull(const GltfDrawContext& ctx, const MeshUtils::ClusterCullParams& params, MeshUtils::CullStats& stats) {
+
+	_culledCommands.clear();
+	for (auto& pass : _passes) {
+
+		for (auto& batch : pass) {
+
+			batch.culledOffset = GLintptr(_culledCommands.size() * sizeof(DrawElementsIndirectCommand));
+			batch.culledCount = 0;
+			for (const RenderObject* obj : batch.objects) {
+
+				const MeshRange& range = _meshRanges[obj->meshBuffers.vao];
+				batch.culledCount += ClusterCullPass::appendCommands(*obj, ctx.instances, params, range.firstIndex, range.baseVertex, _culledCommands, stats);
+			}
+		}
+	}
+	_culledIndirect.upload(_culledCommands);
+}
+
+void MultiDrawPass::drawPass(GltfPass pass, bool culled) {
+
+	bool sorted = _sorted[size_t(pass)];
+	const DynamicIndirectBuffer& dynamic = culled ? _culledIndirect : _sortedIndirect;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, (culled || sorted) ? dynamic.id() : _indirectBuffer);
+	GLState& state = GLState::Get();
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _materialBuffer);
+	state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _instanceMaterialBuffer);
+
+	for (auto& batch : _passes[size_t(pass)]) {
+
+		GLintptr offset = culled ? dynamic.offset() + batch.culledOffset : sorted ? dynamic.offset() + batch.commandOffset : batch.commandOffset;
+		GLsizei count = culled ? batch.culledCount : batch.drawCount;
+		if (count == 0) continue;
+
+		state.bindVertexArray(batch.indexType == GL_UNSIGNED_SHORT ? _indices16.vao : _indices32.vao);
+		_engine->bindMaterialTextures(*batch.material);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType, (void*)offset, count, 0);
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	state.bindVertexArray(0);
+}
@@ -2,6 +2,7 @@
 #include "glEng/gl_engine.h"
 #include "glEng/RenderPass/transmission.h"
 #include "glEng/gltf_loader.h"
+#include "glEng/gl_state.h"
 
 TransmissionPass::TransmissionPass(glEngine* engine) : _engine(engine) {
 
@@ -25,9 +26,9 @@ void TransmissionPass::drawTransmission() {
 void TransmissionPass::initPrevDepthFromScene() {
 
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, _gPeel.sceneFBO);
-	glBindTexture(GL_TEXTURE_2D, _gPeel.prevDepthTex);
 
-	glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, 0, 0, Window::getResWidth(), Window::getResHeight(), 0);
+	// dsa copy into the storage createTransmissionTargets made, leaves the texture units to GLState
+	glCopyTextureSubImage2D(_gPeel.prevDepthTex, 0, 0, 0, 0, 0, Window::getResWidth(), Window::getResHeight());
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 }
 
@@ -49,13 +50,10 @@ void TransmissionPass::renderOpaqueToSceneFBO() {
 	_prog->useProg();
 
 	// make this into a method (below)
-	for (const auto& submesh : _engine->_gltfData.ctx.opaqueSubmeshes) _engine->drawGltfMesh(submesh);
+	_engine->drawGltfPass(GltfPass::Opaque);
 
 	// generate mips for sceneColor
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, _gPeel.sceneColor);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenerateTextureMipmap(_gPeel.sceneColor);
 
 	initPrevDepthFromScene();
 
@@ -87,34 +85,19 @@ void TransmissionPass::renderPeelLayer(int i) {
 
 	_prog->useProg();
 
-	GLint uPrevDepthLoc = _prog->getUniformAddress("uPrevDepth");
-	GLint uSceneColorLoc = _prog->getUniformAddress("uSceneColor");
-	//GLint uPrevDepthLoc = glGetUniformLocation(_engine->_gltfData.prog.getID(), "uPrevDepth");
-	//GLint uSceneColorLoc = glGetUniformLocation(_engine->_gltfData.prog.getID(), "uSceneColor");
-
-	// bind depth texture
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, _gPeel.prevDepthTex);
-	glUniform1i(uPrevDepthLoc, 7);
+	// both samplers have units of their own since link, no more sharing 6/7 with the material textures
+	// bind depth texture, sampled with its own compare-free params (setDepthSampleParams)
+	_prog->setTexture("uPrevDepth", _gPeel.prevDepthTex, 0);
 
 	// bind scene color texture
 	// first pass, opaque, after look at prev one
-	glActiveTexture(GL_TEXTURE6);
-	if (i == 0) {
-
-		glBindTexture(GL_TEXTURE_2D, _gPeel.sceneColor);
-	}
-	else {
-
-		glBindTexture(GL_TEXTURE_2D, _gPeel.layerColor[i - 1]);
-	}
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glUniform1i(uSceneColorLoc, 6); // set the int value of the uniform at location uSceneColorLoc to 6
+	GLuint sceneColor = i == 0 ? _gPeel.sceneColor : _gPeel.layerColor[i - 1];
+	glGenerateTextureMipmap(sceneColor);
+	_prog->setTexture("uSceneColor", sceneColor, _gPeel.samp6);
 
 	GLuint query = beginOcclusionQuery();
 
-	for (const auto& submesh : _engine->_gltfData.ctx.transmissionSubmeshes) _engine->drawGltfMesh(submesh);
+	_engine->drawGltfPass(GltfPass::Transmission);
 
 	GLuint any = getOcclusionQueryResults(query);
 
@@ -199,13 +182,13 @@ void TransmissionPass::createTex2D(GLuint& id, GLenum internal, int w, int h, GL
 
 void TransmissionPass::createTransmissionTargets(int width, int height, int K) {
 
-	// sampler for reading each peeled layer
+	// sampler for reading each peeled layer, bound with uSceneColor in renderPeelLayer
 	GLuint samp6; glGenSamplers(1, &samp6);
 	glSamplerParameteri(samp6, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glSamplerParameteri(samp6, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glSamplerParameteri(samp6, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glSamplerParameteri(samp6, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glBindSampler(6, samp6);
+	_gPeel.samp6 = samp6;
 
 	// scene FBO
 	glGenFramebuffers(1, &_gPeel.sceneFBO);
@@ -246,6 +229,8 @@ void TransmissionPass::createTransmissionTargets(int width, int height, int K) {
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	// only started here, the link is waited on by the first composite
+	fullscreenProgram();
 }
 
 
@@ -286,12 +271,13 @@ void blitTextureToBackbuffer(GLuint srcColorTex, GLuint srcFramebuffer) {
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void drawFullscreen(GLuint texture) {
+// drawFullscreen's blit program. createTransmissionTargets starts it so it compiles next to the rest at startup
+static ShaderProgram& fullscreenProgram() {
 
-	static GLuint sVAO = 0, sVBO = 0, sEBO = 0, sProg = 0;
-	static GLint  sLocTex = -1;
+	static ShaderProgram prog;
+	static bool started = false;
 
-	if (sProg == 0) {
+	if (!started) {
 
 		const char* vsSrc = R"(#version 330 core
             layout (location = 0) in vec2 aPos;      
@@ -312,27 +298,18 @@ void drawFullscreen(GLuint texture) {
             }
         )";
 
-		auto compile = [](GLenum type, const char* src)->GLuint {
-
-			GLuint s = glCreateShader(type);
-			glShaderSource(s, 1, &src, nullptr);
-			glCompileShader(s);
-			GLint ok = GL_FALSE; glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-			if (!ok) { char log[2048]; GLsizei n = 0; glGetShaderInfoLog(s, 2048, &n, log); fprintf(stderr, "%s\n", log); }
-			return s;
-			};
+		prog.makeShaderProgramFromSource(vsSrc, fsSrc);
+		started = true;
+	}
+	return prog;
+}
 
-		GLuint vs = compile(GL_VERTEX_SHADER, vsSrc);
-		GLuint fs = compile(GL_FRAGMENT_SHADER, fsSrc);
+void drawFullscreen(GLuint texture) {
 
-		sProg = glCreateProgram();
-		glAttachShader(sProg, vs);
-		glAttachShader(sProg, fs);
-		glLinkProgram(sProg);
-		glDeleteShader(vs);
-		glDeleteShader(fs);
+	static GLuint sVAO = 0, sVBO = 0, sEBO = 0;
+	GLState& state = GLState::Get();
 
-		sLocTex = glGetUniformLocation(sProg, "uTex");
+	if (sVAO == 0) {
 
 		// verts in screen/NDC order: BL, BR, TR, TL
 		const float quad[] = {
@@ -347,7 +324,7 @@ void drawFullscreen(GLuint texture) {
 		glGenBuffers(1, &sVBO);
 		glGenBuffers(1, &sEBO);
 
-		glBindVertexArray(sVAO);
+		state.bindVertexArray(sVAO);
 
 		glBindBuffer(GL_ARRAY_BUFFER, sVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
@@ -361,14 +338,14 @@ void drawFullscreen(GLuint texture) {
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-		glBindVertexArray(0);
+		state.bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	GLboolean cullOn = glIsEnabled(GL_CULL_FACE);
 	if (cullOn) glDisable(GL_CULL_FACE);
 
-	glUseProgram(sProg);
+	fullscreenProgram().useProg();
 
 	static GLuint sNoMip = 0;
 	if (!sNoMip) {
@@ -380,18 +357,12 @@ void drawFullscreen(GLuint texture) {
 	}
 
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glBindSampler(0, sNoMip);//bufvfxi
-	glUniform1i(sLocTex, 0);
+	fullscreenProgram().setTexture("uTex", texture, sNoMip);
 
-	glBindVertexArray(sVAO);
+	// left bound, the next layer binds the same vao + program and GLState drops both
+	state.bindVertexArray(sVAO);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUseProgram(0);
-
 	if (cullOn) glEnable(GL_CULL_FACE);
 
 }
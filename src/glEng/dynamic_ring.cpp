@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "glEng/dynamic_ring.h"
+
+static bool signalled(GLsync fence) {
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+void DynamicRing::init(GLsizeiptr regionSize) {
+
+	GLint uniformAlign = 0, storageAlign = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlign);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlign);
+	_uniformAlign = std::max<GLsizeiptr>(uniformAlign, 16);
+	_storageAlign = std::max<GLsizeiptr>(storageAlign, 16);
+
+	create(regionSize);
+}
+
+void DynamicRing::create(GLsizeiptr regionSize) {
+
+	// every region has to start on an offset any target can bind at
+	GLsizeiptr align = std::max(_uniformAlign, _storageAlign);
+	_regionSize = (regionSize + align - 1) / align * align;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &_buffer);
+	glNamedBufferStorage(_buffer, _regionSize * REGIONS, nullptr, flags);
+	_mapped = static_cast<uint8_t*>(glMapNamedBufferRange(_buffer, 0, _regionSize * REGIONS, flags));
+	if (!_mapped) throw std::runtime_error("failed to map dynamic ring buffer");
+
+	_stats.regionBytes = _regionSize;
+}
+
+void DynamicRing::beginFrame() {
+
+	_region = (_region + 1) % REGIONS;
+	_head = 0;
+	_stats.usedBytes = 0;
+
+	GLsync& fence = _fences[_region];
+	if (fence) {
+
+		if (!signalled(fence)) {
+
+			_stats.waits++;
+			// the flush makes sure the fence actually gets submitted, then block until the gpu is past it
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED) {}
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	for (size_t i = 0; i < _retired.size();) {
+
+		Retired& retired = _retired[i];
+		if (!retired.fence || !signalled(retired.fence)) {
+
+			i++;
+			continue;
+		}
+		glDeleteSync(retired.fence);
+		glDeleteBuffers(1, &retired.buffer);
+		_retired[i] = _retired.back();
+		_retired.pop_back();
+	}
+}
+
+void DynamicRing::endFrame() {
+
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	for (Retired& retired : _retired) {
+
+		if (!retired.fence) retired.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void DynamicRing::grow(GLsizeiptr minRegionSize) {
+
+	// draws recorded earlier this frame still read the old buffer, it's retired and fenced in endFrame. the old regions'
+	// fences can go, frames finish in order so the new fence covers them too
+	_retired.push_back({ _buffer, nullptr });
+	for (GLsync& fence : _fences) {
+
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	create(std::max(_regionSize * 2, minRegionSize));
+	_head = 0;
+	std::cout << "dynamic ring grown to " << _regionSize << " bytes per frame" << std::endl;
+}
+
+GLsizeiptr DynamicRing::alignment(GLenum target) const {
+
+	if (target == GL_UNIFORM_BUFFER) return _uniformAlign;
+	if (target == GL_SHADER_STORAGE_BUFFER) return _storageAlign;
+	// indirect commands only need 4, 16 keeps vec4 data happy
+	return 16;
+}
+
+DynamicRing::Allocation DynamicRing::allocate(GLsizeiptr size, GLenum target) {
+
+	GLsizeiptr align = alignment(target);
+	GLsizeiptr offset = (_head + align - 1) / align * align;
+	if (offset + size > _regionSize) {
+
+		grow(size);
+		offset = 0;
+	}
+	_head = offset + size;
+	_stats.usedBytes += size;
+
+	GLintptr start = GLintptr(_region) * _regionSize + offset;
+	return { _buffer, start, size, _mapped + start };
+}
+
+DynamicRing::Allocation DynamicRing::upload(const void* data, GLsizeiptr size, GLenum target) {
+
+	Allocation alloc = allocate(size, target);
+	if (size) std::memcpy(alloc.data, data, size);
+	return alloc;
+}
@@ -1,26 +1,92 @@
 #include "pch.h"
 #include "glEng/gl_engine.h"
 #include "Core/window.h"
+#include "Editor/editor_context.h"
+#include "glEng/gl_state.h"
+#include "glEng/dynamic_ring.h"
 
-glEngine::glEngine() : _transmissionPass(this) {}
+glEngine::glEngine() : _transmissionPass(this), _multiDraw(this) {}
 
 void glEngine::setupEngine() {
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) throw std::runtime_error("failed to create window");
+	// before anything builds a ShaderProgram
+	ProgramCache::Get().init("cache/gl_programs");
 	glViewport(0, 0, Window::getResWidth(), Window::getResHeight());
 	glEnable(GL_FRAMEBUFFER_SRGB);
 
-	bindCameraUBO();
+	// camera, per draw constants and culled indirect commands, rewritten every frame
+	DynamicRing::Get().init();
 	setDefaultValues();
 	_transmissionPass.createTransmissionTargets(Window::getResWidth(), Window::getResHeight(), 4);
 	_cubeMap.init("assets/christmas.hdr");
 
 	glEnable(GL_DEPTH_TEST);
 
-	std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/Chess_Edit.glb");
-	//std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/DragonAttenuation.glb");
-	//std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/Duck.glb");
-	scene->drawNodes(_gltfData.ctx);
+	gltfData::LoadSettings settings;
+	settings.packedVertices = _usePackedVertices;
+	settings.streamTextures = _streamTextures;
+
+	// streamed: first frame goes out right away and the scene fills in over the next ones (streamScene)
+	if (_streamScene) {
+
+		_scene = gltfData::LoadAsync(this, "assets/Chess_Edit.glb", settings);
+		return;
+	}
+
+	_scene = gltfData::Load(this, "assets/Chess_Edit.glb", settings);
+	//_scene = gltfData::Load(this, "assets/DragonAttenuation.glb", settings);
+	//_scene = gltfData::Load(this, "assets/Duck.glb", settings);
+	_scene->drawNodes(_gltfData.ctx);
+	uploadInstanceBuffer();
+	if (_useMultiDraw) _multiDraw.build(_gltfData.ctx);
+}
+
+// whatever finished loading since last frame gets appended to the draw context, nothing to do once the scene is in
+void glEngine::streamScene() {
+
+	if (!_scene || !_scene->streaming()) return;
+	if (!_scene->pump(_gltfData.ctx)) return;
+
+	uploadInstanceBuffer();
+	// only the newly committed meshes get packed, the rest is already in
+	if (_useMultiDraw) _multiDraw.update(_gltfData.ctx);
+}
+
+// finer mips for whatever got closer, evictions for what's far away or off screen
+void glEngine::streamTextures() {
+
+	if (!_streamTextures) return;
+	_textureStreamer.update(_gltfData.ctx, _viewProj, _cameraPos, _lodScale);
+
+	const TextureStreaming::Stats& stats = _textureStreamer.stats();
+	EditorContext& editor = EditorContext::Get();
+	editor.textureResidentBytes = stats.residentBytes;
+	editor.textureRequestedBytes = stats.requestedBytes;
+	editor.textureBudgetBytes = _textureStreamer.settings.budgetBytes;
+}
+
+// instances only ever get appended, so just the new tail goes up unless the buffer has to grow
+void glEngine::uploadInstanceBuffer() {
+
+	GltfDrawContext& ctx = _gltfData.ctx;
+	if (!ctx.instanceBuffer) glGenBuffers(1, &ctx.instanceBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ctx.instanceBuffer);
+	if (ctx.instanceCapacity == 0 || ctx.instances.size() > ctx.instanceCapacity) {
+
+		// doubling keeps a streaming scene from reallocating on every commit
+		ctx.instanceCapacity = std::max({ ctx.instances.size(), ctx.instanceCapacity * 2, size_t(1) });
+		glBufferData(GL_SHADER_STORAGE_BUFFER, ctx.instanceCapacity * sizeof(GPUInstance), nullptr, GL_DYNAMIC_DRAW);
+		ctx.uploadedInstances = 0;
+	}
+	if (ctx.instances.size() > ctx.uploadedInstances) {
+
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, ctx.uploadedInstances * sizeof(GPUInstance),
+			(ctx.instances.size() - ctx.uploadedInstances) * sizeof(GPUInstance), ctx.instances.data() + ctx.uploadedInstances);
+	}
+	ctx.uploadedInstances = ctx.instances.size();
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
 //void setPBRLoc()
@@ -28,11 +94,16 @@ void glEngine::setupEngine() {
 void glEngine::setDefaultValues() {
 
 	_defaultSamplerLinear = createDefaultLinearSampler();
-	_whiteImage = createDefaultWhiteTexture();
-
-	_gltfData.prog.makeShaderProgram("shaders/gl/pbr_v.glsl", "shaders/gl/pbr_f.glsl");
+	_whiteImage = createDefaultTexture(255, 255, 255, 255);
+	// tangent space +z, what a missing normal map has to read as now that the shaders rebuild z from xy
+	_flatNormalImage = createDefaultTexture(128, 128, 255, 255);
 
-	_gltfData.modelLoc = glGetUniformLocation(_gltfData.prog.getID(), "model");
+	// USE_MDI switches the shaders over to reading materials from ssbos instead of the per draw ubo,
+	// PACKED_VERTEX to the MeshUtils::PackedVertex attribute layout
+	std::vector<std::string> defines;
+	if (_useMultiDraw) defines.push_back("USE_MDI");
+	if (_usePackedVertices) defines.push_back("PACKED_VERTEX");
+	_gltfData.prog.makeShaderProgram("shaders/gl/pbr_v.glsl", "shaders/gl/pbr_f.glsl", defines);
 
 	setDebugDefaults();
 }
@@ -42,20 +113,13 @@ void glEngine::setDebugDefaults() {
 	auto [sphereVerts, sphereIndices] = generateDebugSphere();
 	_lightSphere.mesh = createDebugMesh(sphereVerts, sphereIndices);
 	_lightSphere.prog.makeShaderProgram("shaders/gl/light_debug_v.glsl", "shaders/gl/light_debug_f.glsl");
-	_lightSphere.modelLoc = glGetUniformLocation(_lightSphere.prog.getID(), "model");
-	_lightSphere.colorLoc = glGetUniformLocation(_lightSphere.prog.getID(), "lightColor");
-	
 }
 
-void glEngine::bindCameraUBO() {
-
-	glGenBuffers(1, &_cameraUBO);
-	glBindBuffer(GL_UNIFORM_BUFFER, _cameraUBO);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUBO), nullptr, GL_DYNAMIC_DRAW);
+// binding 0 moves every frame with the region, so it's rebound here rather than once at setup
+void glEngine::uploadCameraData() {
 
-	// bind the buffer to binding point 0 (for example)
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, _cameraUBO);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	DynamicRing::Allocation cam = DynamicRing::Get().upload(_camData);
+	GLState::Get().bindBufferRange(GL_UNIFORM_BUFFER, 0, cam.buffer, cam.offset, cam.size);
 }
 
 
@@ -65,17 +129,42 @@ void glEngine::drawFrame() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glClear(GL_DEPTH_BUFFER_BIT);
 
+	streamScene();
+	streamTextures();
+
+	// streaming above binds whatever it likes, the shadow starts clean from here
+	GLState& state = GLState::Get();
+	state.beginFrame();
+	DynamicRing& ring = DynamicRing::Get();
+	ring.beginFrame();
+	uploadCameraData();
+	auto start = std::chrono::high_resolution_clock::now();
+
 	_cubeMap.Draw();
 	drawGltf();
 	drawDebugMesh();
+	ring.endFrame();
+
+	EditorContext& editor = EditorContext::Get();
+	editor.bindsIssued = state.counters().issued;
+	editor.bindsSkipped = state.counters().elided;
+	editor.recordMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 }
 
 void glEngine::drawGltf() {
 
-	glUseProgram(_gltfData.prog.getID());
-	GLuint irTexMap = _cubeMap.getIRTex();
-	_gltfData.prog.setTexture("iradianceMap", irTexMap); // try (, 0)
+	_gltfData.prog.useProg();
+	GLState::Get().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _gltfData.ctx.instanceBuffer);
 
+	// once per frame, the transmission pass redraws the same objects several times. sorting goes first: the multi draw
+	// path re-batches its passes from the order and culling then walks those batches
+	sortDrawQueues();
+	if (_useMultiDraw) {
+
+		_multiDraw.sortPasses(_gltfData.ctx, _drawQueues[size_t(GltfPass::Opaque)].order(),
+			_drawQueues[size_t(GltfPass::Transmission)].order(), _drawQueues[size_t(GltfPass::Transparent)].order());
+	}
+	if (perInstanceDraws()) cullClusters();
 
 	if (_gltfData.ctx.isTransmissionEnabled) {
 
@@ -88,63 +177,154 @@ void glEngine::drawGltf() {
 
 }
 
+void glEngine::cullClusters() {
+
+	_clusterCull.frustumCull = _useClusterCulling;
+	_clusterCull.coneCull = _useClusterCulling;
+	_clusterCull.lodSelect = _useLods;
+	_clusterCull.lodErrorPixels = _lodErrorPixels;
+	_clusterCull.forceLod = _useLods ? _forceLod : 0;
+	_clusterCull.beginFrame(_viewProj, _cameraPos, _lodScale);
+	if (_useMultiDraw) _multiDraw.cull(_gltfData.ctx, _clusterCull.params(), _clusterCull.stats());
+	else _clusterCull.cullObjects(_gltfData.ctx);
+
+	const MeshUtils::CullStats& stats = _clusterCull.stats();
+	EditorContext& editor = EditorContext::Get();
+	editor.clustersTested = stats.clustersTested;
+	editor.clustersCulled = stats.clustersCulled;
+	editor.trianglesSubmitted = stats.trianglesSubmitted;
+}
+
 void glEngine::drawNoExtensions() {
 
 	//glUseProgram(_gltfData.prog.getID());
-	for (const auto& submesh : _gltfData.ctx.opaqueSubmeshes) {
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	drawGltfPass(GltfPass::Opaque);
 
-		glDisable(GL_BLEND);
-		glDepthMask(GL_TRUE);
-		drawGltfMesh(submesh);
-	}
 	// same settings as opaque but needs to be drawn after them anyways.
-	for (const auto& submesh : _gltfData.ctx.transmissionSubmeshes) {
+	drawGltfPass(GltfPass::Transmission);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	drawGltfPass(GltfPass::Transparent);
+}
+
+void glEngine::drawGltfPass(GltfPass pass) {
 
-		drawGltfMesh(submesh);
+	if (_useMultiDraw) {
+
+		_multiDraw.drawPass(pass, perInstanceDraws());
+		return;
 	}
 
-	for (const auto& submesh : _gltfData.ctx.transparentSubmeshes) {
+	const std::vector<RenderObject>& objects =
+		pass == GltfPass::Opaque ? _gltfData.ctx.opaqueSubmeshes :
+		pass == GltfPass::Transmission ? _gltfData.ctx.transmissionSubmeshes :
+		_gltfData.ctx.transparentSubmeshes;
+
+	const std::vector<uint32_t>& order = _drawQueues[size_t(pass)].order();
+	if (order.size() != objects.size()) {
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDepthMask(GL_FALSE);
-		drawGltfMesh(submesh);
+		for (const auto& submesh : objects) drawGltfMesh(submesh);
+		return;
 	}
+	for (uint32_t i : order) drawGltfMesh(objects[i]);
 }
 
-void glEngine::drawGltfMesh(const RenderObject& submesh) {
+uint64_t glEngine::drawKey(const RenderObject& obj, GltfPass pass) {
+
+	// ids are only for grouping, they just wrap if a scene ever has more than fit
+	uint64_t material = _materialIds.try_emplace(obj.material.get(), uint32_t(_materialIds.size())).first->second & 0xFFFF;
+	// multi draw packs everything into one vao per index width and batches on material + width, so that's the state there
+	uint64_t vao = _useMultiDraw ? uint64_t(obj.meshBuffers.indexType == GL_UNSIGNED_INT) : obj.meshBuffers.vao & 0xFFFF;
+
+	// distance to the nearest instance's bounds centre, the node origin can sit well away from the geometry it places.
+	// a positive float's bits sort like its value
+	glm::vec3 center = obj.detail ? obj.detail->center : glm::vec3(0.0f);
+	float dist = std::numeric_limits<float>::max();
+	for (uint32_t i = 0; i < obj.instanceCount; i++) {
+
+		glm::vec3 pos = glm::vec3(_gltfData.ctx.instances[obj.firstInstance + i].model * glm::vec4(center, 1.0f));
+		dist = std::min(dist, glm::length(pos - _cameraPos));
+	}
+	uint32_t depth;
+	std::memcpy(&depth, &dist, sizeof(depth));
+
+	// | material 16 | vao 16 | near to far 32 |
+	if (pass == GltfPass::Opaque) return (material << 48) | (vao << 32) | depth;
+
+	// | far to near 32 | material 16 | vao 16 |
+	return (uint64_t(~depth) << 32) | (material << 16) | vao;
+}
 
-	glm::mat4 model = submesh.transform;
+void glEngine::sortDrawQueues() {
 
-	glUniformMatrix4fv(_gltfData.modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+	const GltfDrawContext& ctx = _gltfData.ctx;
+	const std::vector<RenderObject>* lists[] = { &ctx.opaqueSubmeshes, &ctx.transmissionSubmeshes, &ctx.transparentSubmeshes };
+
+	for (size_t p = 0; p < _drawQueues.size(); p++) {
+
+		const std::vector<RenderObject>& objects = *lists[p];
+		_drawKeys.resize(objects.size());
+		for (size_t i = 0; i < objects.size(); i++) _drawKeys[i] = drawKey(objects[i], GltfPass(p));
+		_drawQueues[p].sort(_drawKeys);
+	}
+}
+
+void glEngine::bindMaterialTextures(const gltfMaterial& mat) {
+
+	ShaderProgram& prog = _gltfData.prog;
+	std::array<int, 7>& units = _gltfData.textureUnits;
+	if (!_gltfData.textureUnitsResolved) {
+
+		const char* names[] = { "irradianceMap", "albedoTex", "metalRoughTex", "occlusionTex", "normalTex", "transmissionTex", "thicknessTex" };
+		for (size_t i = 0; i < units.size(); i++) units[i] = prog.textureUnit(names[i]);
+		_gltfData.textureUnitsResolved = true;
+	}
+
+	// same material as the last draw = nothing but elided binds
+	const auto& res = mat.data.resources;
+	prog.bindTextureUnit(units[0], _cubeMap.getIRTex(), 0);
+	prog.bindTextureUnit(units[1], res.albedo.image.id, res.albedo.sampler.id);
+	prog.bindTextureUnit(units[2], res.metalRough.image.id, res.metalRough.sampler.id);
+	prog.bindTextureUnit(units[3], res.occlusion.image.id, res.occlusion.sampler.id);
+	prog.bindTextureUnit(units[4], res.normalMap.image.id, res.normalMap.sampler.id);
+	prog.bindTextureUnit(units[5], res.transmission.image.id, res.transmission.sampler.id);
+	prog.bindTextureUnit(units[6], res.volumeThickness.image.id, res.volumeThickness.sampler.id);
+}
+
+void glEngine::drawGltfMesh(const RenderObject& submesh) {
 
 	auto& mat = submesh.material;
-	auto& res = mat->data.resources;
+	bindMaterialTextures(*mat);
 
-	GLuint irTexMap = _cubeMap.getIRTex();
-	_gltfData.prog.setTexture("irradianceMap", irTexMap, 0, GL_TEXTURE_CUBE_MAP); // try (, 0)
+	GLState::Get().bindBufferRange(GL_UNIFORM_BUFFER, 8, mat->data.resources.dataBuffer, mat->data.resources.dataBufferOffset, sizeof(PBRSystem::MaterialPBRConstants));
 
-	_gltfData.prog.setTexture("albedoTex", mat->data.resources.albedo.image.id, mat->data.resources.albedo.sampler.id);
-	_gltfData.prog.setTexture("metalRoughTex", mat->data.resources.metalRough.image.id, mat->data.resources.metalRough.sampler.id);
-	_gltfData.prog.setTexture("occlusionTex", mat->data.resources.occlusion.image.id, mat->data.resources.occlusion.sampler.id);
-	_gltfData.prog.setTexture("normalTex", mat->data.resources.normalMap.image.id, mat->data.resources.normalMap.sampler.id);
-	_gltfData.prog.setTexture("transmissionTex", mat->data.resources.transmission.image.id, mat->data.resources.transmission.sampler.id);
-	_gltfData.prog.setTexture("thicknessTex", mat->data.resources.volumeThickness.image.id, mat->data.resources.volumeThickness.sampler.id);
+	// picked lod's surviving cluster runs for every instance, as indirect commands
+	if (perInstanceDraws()) {
 
+		_clusterCull.drawObject(submesh);
+		return;
+	}
 
-	glBindBufferRange(GL_UNIFORM_BUFFER, 8, mat->data.resources.dataBuffer, mat->data.resources.dataBufferOffset, sizeof(PBRSystem::MaterialPBRConstants));
-	glBindVertexArray(submesh.meshBuffers.vao);
-	glDrawElements(
+	GLState::Get().bindVertexArray(submesh.meshBuffers.vao);
+	// model matrices come from the instance ssbo (binding 1), base instance is where this object's run starts
+	size_t indexSize = submesh.meshBuffers.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	glDrawElementsInstancedBaseInstance(
 		GL_TRIANGLES,
 		submesh.numIndices,
-		GL_UNSIGNED_INT,
-		(void*)(sizeof(uint32_t) * submesh.idxStart)
+		submesh.meshBuffers.indexType,
+		(void*)(indexSize * submesh.idxStart),
+		submesh.instanceCount,
+		submesh.firstInstance
 	);
 }
 
 void glEngine::drawDebugMesh() {
 
-	glUseProgram(_lightSphere.prog.getID());
+	_lightSphere.prog.useProg();
 
 	std::vector<glm::vec3> lightPos = { glm::vec3(0.6f, 1.2f, 0.5f), glm::vec3(1.0f, 1.2f, -0.8f) };
 
@@ -154,17 +334,18 @@ void glEngine::drawDebugMesh() {
 
 		lightModel = glm::scale(lightModel, glm::vec3(0.1f)); // make it small
 
-		glUniformMatrix4fv(_lightSphere.modelLoc, 1, GL_FALSE, glm::value_ptr(lightModel));
-
-		glm::vec3 debugColor = glm::vec3(1.0f, 1.0f, 0.5f); // yellowish sphere
-		glUniform3fv(_lightSphere.colorLoc, 1, glm::value_ptr(debugColor));
+		DebugDrawUBO draw;
+		draw.model = lightModel;
+		draw.color = glm::vec4(1.0f, 1.0f, 0.5f, 1.0f); // yellowish sphere
 
-		glBindVertexArray(_lightSphere.mesh.vao);
+		DynamicRing::Allocation alloc = DynamicRing::Get().upload(draw);
+		GLState::Get().bindBufferRange(GL_UNIFORM_BUFFER, 9, alloc.buffer, alloc.offset, alloc.size);
+		GLState::Get().bindVertexArray(_lightSphere.mesh.vao);
 		glDrawElements(GL_TRIANGLES, _lightSphere.mesh.indexCount, GL_UNSIGNED_INT, 0);
 	}
 }
 
-GLImage glEngine::createDefaultWhiteTexture() {
+GLImage glEngine::createDefaultTexture(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
 
 	GLImage img{};
 	img.width = 1;
@@ -175,7 +356,7 @@ GLImage glEngine::createDefaultWhiteTexture() {
 	glGenTextures(1, &texID);
 	glBindTexture(GL_TEXTURE_2D, texID);
 
-	uint8_t whitePixel[4] = { 255, 255, 255, 255 };
+	uint8_t pixel[4] = { r, g, b, a };
 	glTexImage2D(GL_TEXTURE_2D,
 		0,
 		GL_RGBA8,
@@ -183,7 +364,7 @@ GLImage glEngine::createDefaultWhiteTexture() {
 		0,
 		GL_RGBA,
 		GL_UNSIGNED_BYTE,
-		whitePixel);
+		pixel);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -217,14 +398,13 @@ GLSampler glEngine::createDefaultLinearSampler() {
 
 void glEngine::passCameraData(glm::mat4 view, glm::mat4 proj, glm::vec4 viewPos) {
 
-	CameraUBO camData;
-	camData.view = view;
-	camData.proj = proj;
-	camData.viewPos = viewPos;
+	_camData.view = view;
+	_camData.proj = proj;
+	_camData.viewPos = viewPos;
+	_viewProj = proj * view;
+	_cameraPos = glm::vec3(viewPos);
+	_lodScale = std::abs(proj[1][1]) * float(Window::getResHeight()) * 0.5f;
 
-	glBindBuffer(GL_UNIFORM_BUFFER, _cameraUBO);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUBO), &camData);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	_cubeMap.updateCam(view, proj);
 }
 
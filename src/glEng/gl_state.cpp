@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "glEng/gl_state.h"
+
+void GLState::useProgram(GLuint program) {
+
+	if (changed(program != _program)) {
+
+		glUseProgram(program);
+		_program = program;
+	}
+}
+
+void GLState::bindTexture(GLuint unit, GLuint texture) {
+
+	// past what's shadowed just goes straight through
+	if (unit >= MAX_UNITS) {
+
+		changed(true);
+		glBindTextureUnit(unit, texture);
+		return;
+	}
+	if (changed(_textures[unit] != texture)) {
+
+		glBindTextureUnit(unit, texture);
+		_textures[unit] = texture;
+	}
+}
+
+void GLState::bindSampler(GLuint unit, GLuint sampler) {
+
+	if (unit >= MAX_UNITS) {
+
+		changed(true);
+		glBindSampler(unit, sampler);
+		return;
+	}
+	if (changed(_samplers[unit] != sampler)) {
+
+		glBindSampler(unit, sampler);
+		_samplers[unit] = sampler;
+	}
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+
+	if (changed(vao != _vao)) {
+
+		glBindVertexArray(vao);
+		_vao = vao;
+	}
+}
+
+GLState::BufferRange* GLState::rangeSlot(GLenum target, GLuint index) {
+
+	if (index >= MAX_BUFFER_BINDINGS) return nullptr;
+	if (target == GL_UNIFORM_BUFFER) return &_uniformBuffers[index];
+	if (target == GL_SHADER_STORAGE_BUFFER) return &_storageBuffers[index];
+	return nullptr;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+
+	BufferRange* slot = rangeSlot(target, index);
+	if (!changed(!slot || slot->buffer != buffer || slot->size != WHOLE_BUFFER)) return;
+
+	glBindBufferBase(target, index, buffer);
+	if (slot) *slot = { buffer, 0, WHOLE_BUFFER };
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+
+	BufferRange* slot = rangeSlot(target, index);
+	if (!changed(!slot || slot->buffer != buffer || slot->offset != offset || slot->size != size)) return;
+
+	glBindBufferRange(target, index, buffer, offset, size);
+	if (slot) *slot = { buffer, offset, size };
+}
+
+void GLState::invalidate() {
+
+	_program = UNKNOWN;
+	_vao = UNKNOWN;
+	_textures.fill(UNKNOWN);
+	_samplers.fill(UNKNOWN);
+	_uniformBuffers.fill(BufferRange{});
+	_storageBuffers.fill(BufferRange{});
+}
+
+void GLState::beginFrame() {
+
+	invalidate();
+	_counters = Counters{};
+}
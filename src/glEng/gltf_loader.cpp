@@ -1,14 +1,60 @@
 #include "pch.h"
 #include "glEng/gl_engine.h"
 #include "glEng/gltf_loader.h"
-#include "glEng/mesh_utils.h"
+#include "Renderer/Scene/mesh_optimizer.h"
+#include "Renderer/Scene/tangents.h"
 #include <cmath>
+#include <map>
 #include "stb_image.h"
+#include "Core/Utils/thread_pool.h"
+#include "Core/Utils/bounded_queue.h"
+#include "Renderer/Scene/scene_cache.h"
+#include "Renderer/Scene/texture_compress.h"
+#include "Renderer/Scene/texture_transcode.h"
+#include "Renderer/Scene/gltf_utils.h"
+
+// the part of settings that changes the bake, goes into the cache key
+static SceneCache::BakeSettings bakeSettings(const gltfData::LoadSettings& settings) {
+
+    SceneCache::BakeSettings bake;
+    bake.optimizeMeshes = settings.optimizeMeshes;
+    bake.overdrawThreshold = settings.overdrawThreshold;
+    bake.generateLods = settings.generateLods;
+    bake.maxLods = settings.maxLods;
+    bake.lodErrorTargets = settings.lodErrorTargets;
+    bake.compressTextures = settings.compressTextures;
+    return bake;
+}
 
-std::shared_ptr<gltfData> gltfData::Load(glEngine* engine, std::filesystem::path path) {
+std::shared_ptr<gltfData> gltfData::Load(glEngine* engine, std::filesystem::path path, LoadSettings settings) {
 
     std::shared_ptr<gltfData> scene = std::make_shared<gltfData>();
     gltfData& file = *scene;
+    file.settings = settings;
+
+    std::filesystem::path cachePath;
+    uint64_t sourceHash = 0;
+
+    if (settings.useSceneCache) {
+
+        cachePath = SceneCache::cachePathFor(path, "gl");
+        sourceHash = SceneCache::hashSource(path, sizeof(Vertex), sizeof(PBRSystem::MaterialPBRConstants), bakeSettings(settings));
+
+        // warm start, everything comes straight out of the mapped cache and fastgltf never runs
+        auto view = std::make_shared<SceneCache::SceneView>();
+        if (sourceHash && view->open(cachePath, sourceHash, sizeof(Vertex), sizeof(PBRSystem::MaterialPBRConstants))) {
+
+            std::cout << "loading scene cache " << cachePath << std::endl;
+            file.loadFromCache({ scene, nullptr, engine }, view);
+            return scene;
+        }
+
+        // missing or stale, record everything on the way through so it can be rebuilt
+        file.bake = std::make_unique<SceneCache::SceneData>();
+        file.bake->vertexStride = sizeof(Vertex);
+        file.bake->materialStride = sizeof(PBRSystem::MaterialPBRConstants);
+    }
+
     fastgltf::Asset gltf = file.getGltfAsset(path);
     GltfLoadContext ctx = { scene, &gltf, engine };
 
@@ -18,6 +64,12 @@ std::shared_ptr<gltfData> gltfData::Load(glEngine* engine, std::filesystem::path
     std::vector<std::shared_ptr<gltfMaterial>> materials = file.loadMaterials(ctx, samplers, images);
     std::vector<std::shared_ptr<MeshAsset>> vecMeshes = file.loadMeshes(ctx, materials);
     std::vector<std::shared_ptr<Node>> nodes = file.loadNodes(ctx, vecMeshes);
+
+    if (file.bake) {
+
+        if (sourceHash) SceneCache::write(cachePath, sourceHash, *file.bake);
+        file.bake.reset();
+    }
     return scene;
 }
 
@@ -28,6 +80,10 @@ fastgltf::Asset gltfData::getGltfAsset(std::filesystem::path path) {
 
         fastgltf::Extensions::KHR_materials_volume
       | fastgltf::Extensions::KHR_materials_transmission 
+      | fastgltf::Extensions::EXT_mesh_gpu_instancing
+      | fastgltf::Extensions::KHR_texture_basisu
+      | fastgltf::Extensions::KHR_mesh_quantization
+      | fastgltf::Extensions::EXT_meshopt_compression
     };
 
     constexpr auto gltfOptions =
@@ -42,81 +98,162 @@ fastgltf::Asset gltfData::getGltfAsset(std::filesystem::path path) {
         std::cerr << "Failed to load glTF: " << fastgltf::getErrorMessage(asset.error()) << '\n';
     }
     fastgltf::Asset gltf = std::move(asset.get());
+    GltfUtils::decompressMeshopt(gltf);
     return gltf;
 }
 
+static GLSampler makeSampler(fastgltf::Filter mag, fastgltf::Filter min, fastgltf::Wrap wrapS, fastgltf::Wrap wrapT) {
+
+    GLSampler s{};
+    glGenSamplers(1, &s.id);
+
+    s.magFilter = extract_filter(mag);
+    s.minFilter = extract_mipmap_filter(min);
+
+    s.wrapS = extract_wrap(wrapS);
+    s.wrapT = extract_wrap(wrapT);
+
+    // Apply to GL
+    glSamplerParameteri(s.id, GL_TEXTURE_MAG_FILTER, s.magFilter);
+    glSamplerParameteri(s.id, GL_TEXTURE_MIN_FILTER, s.minFilter);
+    glSamplerParameteri(s.id, GL_TEXTURE_WRAP_S, s.wrapS);
+    glSamplerParameteri(s.id, GL_TEXTURE_WRAP_T, s.wrapT);
+
+    return s;
+}
+
 std::vector<GLSampler> gltfData::createSamplers(GltfLoadContext ctx) {
 
     std::vector<GLSampler> samplers;
 
     for (fastgltf::Sampler& sampler : ctx.gltf->samplers) {
-        GLSampler s{};
-        glGenSamplers(1, &s.id);
-
-        s.magFilter = extract_filter(sampler.magFilter.value_or(fastgltf::Filter::Nearest));
-        s.minFilter = extract_mipmap_filter(sampler.minFilter.value_or(fastgltf::Filter::Nearest));
 
-        s.wrapS = extract_wrap(sampler.wrapS);
-        s.wrapT = extract_wrap(sampler.wrapT);
+        samplers.push_back(makeSampler(
+            sampler.magFilter.value_or(fastgltf::Filter::Nearest),
+            sampler.minFilter.value_or(fastgltf::Filter::Nearest),
+            sampler.wrapS, sampler.wrapT));
 
-        // Apply to GL
-        glSamplerParameteri(s.id, GL_TEXTURE_MAG_FILTER, s.magFilter);
-        glSamplerParameteri(s.id, GL_TEXTURE_MIN_FILTER, s.minFilter);
-        glSamplerParameteri(s.id, GL_TEXTURE_WRAP_S, s.wrapS);
-        glSamplerParameteri(s.id, GL_TEXTURE_WRAP_T, s.wrapT);
+        if (bake) {
 
-        samplers.push_back(s);
+            bake->samplers.push_back({
+                sampler.magFilter ? int32_t(*sampler.magFilter) : SceneCache::NONE,
+                sampler.minFilter ? int32_t(*sampler.minFilter) : SceneCache::NONE,
+                int32_t(sampler.wrapS), int32_t(sampler.wrapT) });
+        }
     }
     return samplers;
 }
 
-std::optional<GLImage> loadImage(const fastgltf::Asset& asset, const fastgltf::Image& image) {
+// KHR_texture_basisu puts the ktx2 image next to the regular one (which can be left out), the ktx2 wins when it's there
+static std::optional<size_t> textureImage(const fastgltf::Texture& tex) {
 
-    int width, height, nrChannels;
-    unsigned char* data = nullptr;
+    if (tex.basisuImageIndex.has_value()) return tex.basisuImageIndex.value();
+    if (tex.imageIndex.has_value()) return tex.imageIndex.value();
+    return {};
+}
 
+// same texture/sampler lookup fetchPBRTextures does, kept as indices for the scene cache
+static void recordTextureSlots(fastgltf::Material& mat, const fastgltf::Asset& gltf, SceneCache::MaterialRecord& rec) {
 
-    if (std::holds_alternative<fastgltf::sources::URI>(image.data)) {
+    for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
 
-        auto& filePath = std::get<fastgltf::sources::URI>(image.data);
-        std::string path(filePath.uri.path().begin(), filePath.uri.path().end());
-        data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
+        rec.image[slot] = SceneCache::NONE;
+        rec.sampler[slot] = SceneCache::NONE;
     }
-    else if (std::holds_alternative<fastgltf::sources::Vector>(image.data)) {
 
-        auto& vector = std::get<fastgltf::sources::Vector>(image.data);
-        data = stbi_load_from_memory(
-            reinterpret_cast<const stbi_uc*>(vector.bytes.data()),
-            int(vector.bytes.size()), &width, &height, &nrChannels, 4);
-    }
-    else if (std::holds_alternative<fastgltf::sources::BufferView>(image.data)) {
+    auto slotTex = [&](SceneCache::TextureSlot slot, auto& texOpt) {
+
+        if (!texOpt.has_value()) return;
 
-        auto& view = std::get<fastgltf::sources::BufferView>(image.data);
-        auto& bufView = asset.bufferViews[view.bufferViewIndex];
-        auto& buffer = asset.buffers[bufView.bufferIndex];
+        auto& tex = gltf.textures[texOpt.value().textureIndex];
+        std::optional<size_t> image = textureImage(tex);
+        if (!image.has_value() || !tex.samplerIndex.has_value()) return;
 
-        const stbi_uc* rawBytes = nullptr;
+        rec.image[slot] = int32_t(*image);
+        rec.sampler[slot] = int32_t(tex.samplerIndex.value());
+    };
 
-        if (std::holds_alternative<fastgltf::sources::Vector>(buffer.data)) {
+    slotTex(SceneCache::SLOT_ALBEDO, mat.pbrData.baseColorTexture);
+    slotTex(SceneCache::SLOT_METAL_ROUGH, mat.pbrData.metallicRoughnessTexture);
+    slotTex(SceneCache::SLOT_OCCLUSION, mat.occlusionTexture);
+    slotTex(SceneCache::SLOT_NORMAL, mat.normalTexture);
 
-            auto& vector2 = std::get<fastgltf::sources::Vector>(buffer.data);
-            rawBytes = reinterpret_cast<const stbi_uc*>(vector2.bytes.data());
-        }
-        else if (std::holds_alternative<fastgltf::sources::Array>(buffer.data)) {
+    if (mat.transmission) slotTex(SceneCache::SLOT_TRANSMISSION, mat.transmission->transmissionTexture);
+    if (mat.volume) slotTex(SceneCache::SLOT_THICKNESS, mat.volume->thicknessTexture);
+}
 
-            auto& array2 = std::get<fastgltf::sources::Array>(buffer.data);
-            rawBytes = reinterpret_cast<const stbi_uc*>(array2.bytes.data());
-        }
+// bit per SceneCache::TextureSlot for every image, what TextureCompress::chooseFormat picks from
+static std::vector<uint32_t> imageSlotMasks(const std::vector<SceneCache::MaterialRecord>& materials, size_t imageCount) {
+
+    std::vector<uint32_t> masks(imageCount, 0);
+    for (const auto& rec : materials) {
 
-        if (rawBytes) {
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
 
-            data = stbi_load_from_memory(rawBytes + bufView.byteOffset,
-                int(bufView.byteLength),
-                &width, &height, &nrChannels, 4);
+            if (rec.image[slot] != SceneCache::NONE && size_t(rec.image[slot]) < imageCount) masks[rec.image[slot]] |= 1u << slot;
         }
     }
+    return masks;
+}
 
-    if (!data) return {};
+static std::vector<uint32_t> imageSlotMasks(fastgltf::Asset& gltf) {
+
+    std::vector<SceneCache::MaterialRecord> records(gltf.materials.size());
+    for (size_t i = 0; i < records.size(); i++) recordTextureSlots(gltf.materials[i], gltf, records[i]);
+    return imageSlotMasks(records, gltf.images.size());
+}
+
+// raw rgba8 pixels straight from stb (or a transcoded ktx2 chain), safe to produce off the gl thread
+struct DecodedImage {
+
+    unsigned char* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int nrChannels = 0;
+
+    // only filled when baking a scene cache, streaming or compressing textures. format is what mips holds
+    std::vector<uint8_t> mips;
+    uint32_t mipCount = 0;
+    TextureCompress::Format format = TextureCompress::RGBA8;
+};
+
+// stb for png/jpeg. KHR_texture_basisu ktx2 goes through libktx instead and comes back as a whole chain in mips (data stays null),
+// already in the format slotMask asks for when the backend takes block formats
+static DecodedImage decodeImage(const fastgltf::Asset& asset, const fastgltf::Image& image, uint32_t slotMask = 0, bool blockFormats = false) {
+
+    DecodedImage out;
+    std::vector<uint8_t> storage;
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    if (!GltfUtils::imageBytes(asset, image, storage, bytes, size)) return out;
+
+    if (TextureTranscode::isKtx2(bytes, size)) {
+
+        TextureTranscode::Image ktx;
+        if (!TextureTranscode::transcode(bytes, size, slotMask, blockFormats, ktx)) return out;
+
+        out.width = int(ktx.width);
+        out.height = int(ktx.height);
+        out.nrChannels = int(ktx.channels);
+        out.mips = std::move(ktx.chain);
+        out.mipCount = ktx.mipCount;
+        out.format = ktx.format;
+        return out;
+    }
+
+    out.data = stbi_load_from_memory(bytes, int(size), &out.width, &out.height, &out.nrChannels, 4);
+    return out;
+}
+
+// gl thread only. takes ownership of the decoded pixels
+static std::optional<GLImage> uploadImage(DecodedImage& decoded) {
+
+    if (!decoded.data) return {};
+
+    int width = decoded.width;
+    int height = decoded.height;
+    int nrChannels = decoded.nrChannels;
+    unsigned char* data = decoded.data;
 
     GLenum external = GL_RGBA;
     GLuint linearId;
@@ -152,38 +289,205 @@ std::optional<GLImage> loadImage(const fastgltf::Asset& asset, const fastgltf::I
     */
     
     stbi_image_free(data);
+    decoded.data = nullptr;
 
     return GLImage{ 0, width, height, external, linearId, sRGBID };
 }
 
-std::vector<GLImage> gltfData::createImages(GltfLoadContext ctx) {
+std::optional<GLImage> loadImage(const fastgltf::Asset& asset, const fastgltf::Image& image) {
 
-    std::vector<GLImage> images;
+    DecodedImage decoded = decodeImage(asset, image);
+    return uploadImage(decoded);
+}
+
+// whole chain already built (cache or a bake/compress on the way in), each level just gets copied in.
+// formats without an srgb variant (bc4/bc5) only get the one texture, linearID == sRGBID
+static GLImage uploadImageMips(const SceneCache::ImageRecord& rec, const uint8_t* pixels) {
+
+    GLenum external = GL_RGBA;
+    TextureCompress::Format format = TextureCompress::Format(rec.format);
+    GLTextureFormat glFormat = glTextureFormat(format);
+    bool compressed = TextureCompress::isCompressed(format);
+
+    GLuint ids[2];
+    GLint internals[2] = {
+        compressed ? GLint(glFormat.linear) : (rec.channels == 4) ? GL_RGBA8 : GL_RGB8,
+        compressed ? GLint(glFormat.srgb) : (rec.channels == 4) ? GL_SRGB8_ALPHA8 : GL_SRGB8
+    };
+    int count = internals[1] ? 2 : 1;
+
+    glGenTextures(count, ids);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    // *potential bug make sure the line   materialResources.colorImage = vecImages[img];   the images are in the same order as this enhanced for loop
-    /* Load images */
-    for (fastgltf::Image& image : ctx.gltf->images) {
+    for (int t = 0; t < count; t++) {
 
-        auto img = loadImage(*ctx.gltf, image);
+        glBindTexture(GL_TEXTURE_2D, ids[t]);
 
-        if (img.has_value()) {
+        size_t offset = 0;
+        for (uint32_t level = 0; level < rec.mipCount; level++) {
 
-            images.push_back(*img);
+            GLsizei w = std::max(1u, rec.width >> level);
+            GLsizei h = std::max(1u, rec.height >> level);
+            size_t size = TextureCompress::levelSize(format, rec.width >> level, rec.height >> level);
+
+            if (compressed) glCompressedTexImage2D(GL_TEXTURE_2D, level, internals[t], w, h, 0, GLsizei(size), pixels + offset);
+            else glTexImage2D(GL_TEXTURE_2D, level, internals[t], w, h, 0, external, GL_UNSIGNED_BYTE, pixels + offset);
+            offset += size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(rec.mipCount) - 1);
+        setFormatSwizzle(ids[t], format);
+    }
+    if (count == 1) ids[1] = ids[0];
+
+    return GLImage{ 0, int(rec.width), int(rec.height), external, ids[0], ids[1] };
+}
+
+static GLImage fallbackImage() {
+
+    std::cout << "glTF failed image loading\n";
+
+    // Push fallback 1x1 magenta
+    GLuint texID;
+    glGenTextures(1, &texID);
+    glBindTexture(GL_TEXTURE_2D, texID);
+    uint32_t magenta = 0xFF00FFFF;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &magenta);
+
+    return { texID, 1, 1, GL_RGBA };
+}
+
+// worker side, the mip chain for the cache / the texture streamer gets built right after decode and block compressed
+// for the slots sampling it (slotMask, see imageSlotMasks) when compress is on
+static DecodedImage decodeForUpload(const fastgltf::Asset& asset, const fastgltf::Image& image, bool buildMips, bool compress, uint32_t slotMask) {
+
+    DecodedImage decoded;
+    try {
+
+        decoded = decodeImage(asset, image, slotMask, compress);
+        if ((buildMips || compress) && decoded.data) {
+
+            decoded.mipCount = SceneCache::buildMipChain(decoded.data, decoded.width, decoded.height, decoded.mips);
+        }
+        if (compress && decoded.data && decoded.mipCount) {
+
+            uint32_t width = uint32_t(decoded.width);
+            uint32_t height = uint32_t(decoded.height);
+            TextureCompress::Choice choice = TextureCompress::chooseFormat(slotMask, decoded.data, width, height);
+            decoded.mips = TextureCompress::compressChain(decoded.mips.data(), width, height, decoded.mipCount, choice);
+            decoded.format = choice.format;
+        }
+    }
+    catch (const std::exception& e) {
+
+        // the upload side pops one result per image, a throw on a worker would leave it waiting forever.
+        // comes back as a failed decode instead so the image gets the fallback
+        std::cerr << "failed to decode image " << image.name << ": " << e.what() << std::endl;
+        stbi_image_free(decoded.data);
+        return DecodedImage{};
+    }
+    return decoded;
+}
+
+// gl thread, records the image for the cache when baking (bake->images already sized to the file).
+// with a streamer the chain is handed over instead of uploaded whole, streamed[index] gets its texture index
+static GLImage storeImage(SceneCache::SceneData* bake, TextureStreamer* streamer, size_t index, DecodedImage& decoded, std::vector<int32_t>& streamed) {
+
+    SceneCache::ImageRecord rec{};
+    bool decodedOk = decoded.data || decoded.mipCount;
+    rec.width = decodedOk ? uint32_t(decoded.width) : 0;
+    rec.height = decodedOk ? uint32_t(decoded.height) : 0;
+    rec.channels = uint32_t(decoded.nrChannels);
+    rec.mipCount = decoded.mipCount;
+    rec.format = decoded.format;
+
+    std::shared_ptr<std::vector<uint8_t>> chain;
+    std::optional<GLImage> img;
+
+    if (decoded.mipCount) {
+
+        stbi_image_free(decoded.data);
+        decoded.data = nullptr;
+
+        if (streamer) {
+
+            chain = std::make_shared<std::vector<uint8_t>>(std::move(decoded.mips));
+            uint32_t texture = streamer->add(chain, chain->data(), rec.width, rec.height, decoded.format);
+            streamed[index] = int32_t(texture);
+            img = streamer->image(texture);
         }
         else {
 
-            std::cout << "glTF failed image loading\n";
+            img = uploadImageMips(rec, decoded.mips.data());
+        }
+    }
+    else {
+
+        img = uploadImage(decoded);
+    }
+
+    if (bake) {
+
+        SceneCache::SceneData::Image& baked = bake->images[index];
+        baked.record = rec;
+        baked.pixels = chain ? *chain : std::move(decoded.mips);
+    }
+    return img.has_value() ? *img : fallbackImage();
+}
+
+std::vector<GLImage> gltfData::createImages(GltfLoadContext ctx) {
+
+    // indexed by gltf image index, fetchPBRTextures looks images up by that so order has to match the file
+    std::vector<GLImage> images(ctx.gltf->images.size());
+
+    TextureStreamer* streamer = settings.streamTextures ? &ctx.engine->_textureStreamer : nullptr;
+    if (streamer) streamedImages.assign(images.size(), SceneCache::NONE);
 
-            // Push fallback 1x1 magenta
-            GLuint texID;
-            glGenTextures(1, &texID);
-            glBindTexture(GL_TEXTURE_2D, texID);
-            uint32_t magenta = 0xFF00FFFF;
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &magenta);
+    auto upload = [&](size_t index, DecodedImage& decoded) {
 
-            images.push_back({ texID, 1, 1, GL_RGBA });
+        images[index] = storeImage(bake.get(), streamer, index, decoded, streamedImages);
+    };
+
+    bool baking = bake != nullptr;
+    if (baking) bake->images.resize(images.size());
+
+    bool buildMips = baking || streamer;
+    bool compress = settings.compressTextures;
+    std::vector<uint32_t> slotMasks = imageSlotMasks(*ctx.gltf);
+    auto decode = [buildMips, compress, &slotMasks](const fastgltf::Asset& asset, const fastgltf::Image& image, size_t index) {
+
+        return decodeForUpload(asset, image, buildMips, compress, slotMasks[index]);
+    };
+
+    if (!settings.parallelImageDecode) {
+
+        for (size_t i = 0; i < images.size(); i++) {
+
+            DecodedImage decoded = decode(*ctx.gltf, ctx.gltf->images[i], i);
+            upload(i, decoded);
         }
+        return images;
     }
+
+    // workers decode in whatever order they finish and push into the queue, this thread uploads.
+    // the queue depth caps how many decoded images can be sitting in memory at once
+    Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>> ready(settings.imageQueueDepth);
+    const fastgltf::Asset& asset = *ctx.gltf;
+
+    std::future<void> decoding = Utils::Jobs::get().submit([&]() {
+
+        Utils::Jobs::get().parallelFor(asset.images.size(), [&](size_t i) {
+
+            ready.push({ i, decode(asset, asset.images[i], i) });
+        });
+    });
+
+    for (size_t n = 0; n < images.size(); n++) {
+
+        auto [index, decoded] = ready.pop();
+        upload(index, decoded);
+    }
+    decoding.get();
+
     return images;
 }
 
@@ -194,9 +498,10 @@ void gltfData::fetchPBRTextures(fastgltf::Material& mat, GltfLoadContext ctx, PB
         if (!texOpt.has_value()) return;
 
         auto& tex = ctx.gltf->textures[texOpt.value().textureIndex];
-        if (!tex.imageIndex.has_value() || !tex.samplerIndex.has_value()) return;
+        std::optional<size_t> image = textureImage(tex);
+        if (!image.has_value() || !tex.samplerIndex.has_value()) return;
 
-        dst.image = images[tex.imageIndex.value()];
+        dst.image = images[*image];
         dst.sampler = samplers[tex.samplerIndex.value()];
 
         if (isSRGB) { dst.image.id = dst.image.sRGBID; }
@@ -279,13 +584,11 @@ std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadMaterials(GltfLoadConte
 
     /* Load materials */
 
+    // constants never change after load: gathered here and uploaded once into an immutable buffer at the end
+    // instead of a glBufferSubData per material
     GLuint materialUBO;
-    glGenBuffers(1, &materialUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, materialUBO);
-
-    GLsizeiptr totalSize = sizeof(PBRSystem::MaterialPBRConstants) * ctx.gltf->materials.size();
-
-    glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_DYNAMIC_DRAW);
+    glCreateBuffers(1, &materialUBO);
+    std::vector<PBRSystem::MaterialPBRConstants> constants(std::max<size_t>(ctx.gltf->materials.size(), 1));
 
     ctx.scene->materialDataBuffer = materialUBO;
 
@@ -324,7 +627,7 @@ std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadMaterials(GltfLoadConte
         materialResources.metalRough.sampler = ctx.engine->_defaultSamplerLinear;
         materialResources.occlusion.image = ctx.engine->_whiteImage;
         materialResources.occlusion.sampler = ctx.engine->_defaultSamplerLinear;
-        materialResources.normalMap.image = ctx.engine->_whiteImage;
+        materialResources.normalMap.image = ctx.engine->_flatNormalImage;
         materialResources.normalMap.sampler = ctx.engine->_defaultSamplerLinear;
         materialResources.transmission.image = ctx.engine->_whiteImage;
         materialResources.transmission.sampler = ctx.engine->_defaultSamplerLinear;
@@ -337,12 +640,30 @@ std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadMaterials(GltfLoadConte
 
         fetchPBRTextures(mat, ctx, materialResources, samplers, images);
 
-        glBindBuffer(GL_UNIFORM_BUFFER, ctx.scene->materialDataBuffer);
-        glBufferSubData(GL_UNIFORM_BUFFER, dataIdx * sizeof(PBRSystem::MaterialPBRConstants), sizeof(PBRSystem::MaterialPBRConstants), &pbrConstants);
+        constants[dataIdx] = pbrConstants;
+
+        newMat->doubleSided = mat.doubleSided;
+
+        SceneCache::MaterialRecord slots{};
+        recordTextureSlots(mat, *ctx.gltf, slots);
+
+        if (bake) {
+
+            SceneCache::SceneData::Material baked;
+            baked.record = slots;
+            baked.record.pass = uint32_t(passType);
+            baked.record.flags = mat.doubleSided ? SceneCache::MATERIAL_DOUBLE_SIDED : 0;
+            baked.constants.resize(sizeof(PBRSystem::MaterialPBRConstants));
+            std::memcpy(baked.constants.data(), &pbrConstants, sizeof(PBRSystem::MaterialPBRConstants));
+            bake->materials.push_back(std::move(baked));
+        }
 
         newMat->data = pbrSystem.writeMaterial(passType, materialResources, ctx.engine);
+        trackStreamedSlots(ctx.engine, newMat, slots);
         dataIdx++;
     }
+
+    glNamedBufferStorage(materialUBO, constants.size() * sizeof(PBRSystem::MaterialPBRConstants), constants.data(), 0);
     return materials;
 }
 
@@ -381,9 +702,12 @@ static void loadNormals(fastgltf::Primitive& p, fastgltf::Asset* gltf, std::vect
 
     auto normals = p.findAttribute("NORMAL");
     if (normals != p.attributes.end()) {
-        fastgltf::iterateAccessorWithIndex<glm::vec3>(*gltf, gltf->accessors[(*normals).accessorIndex],
+        // KHR_mesh_quantization normals are snorm8/16, fastgltf dequantizes them but they come out slightly off unit length
+        auto& accessor = gltf->accessors[(*normals).accessorIndex];
+        bool quantized = accessor.componentType != fastgltf::ComponentType::Float;
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(*gltf, accessor,
             [&](glm::vec3 v, size_t index) {
-                vertices[initial_vtx + index].normal = v;
+                vertices[initial_vtx + index].normal = quantized ? glm::normalize(v) : v;
             });
     }
 }
@@ -437,101 +761,214 @@ static SubMesh buildSurface(fastgltf::Primitive& p, fastgltf::Asset* gltf, std::
     return newSurface;
 }
 
-static void loadTangents(const std::vector<uint32_t>& indices, std::vector<Vertex>& vertices) {
+// returns false when the primitive has no TANGENT, those get generated once the whole mesh is in
+static bool loadTangents(fastgltf::Primitive& p, fastgltf::Asset* gltf, std::vector<Vertex>& vertices, size_t initial_vtx) {
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    positions.reserve(vertices.size());
+    auto tangents = p.findAttribute("TANGENT");
+    if (tangents == p.attributes.end()) return false;
 
-    for (auto& v : vertices) {
+    auto& accessor = gltf->accessors[(*tangents).accessorIndex];
+    bool quantized = accessor.componentType != fastgltf::ComponentType::Float;
+    fastgltf::iterateAccessorWithIndex<glm::vec4>(*gltf, accessor,
+        [&](glm::vec4 v, size_t index) {
+            if (quantized) v = glm::vec4(glm::normalize(glm::vec3(v)), v.w < 0.0f ? -1.0f : 1.0f);
+            vertices[initial_vtx + index].tangent = v;
+        });
+    return true;
+}
 
-        positions.push_back(v.pos);
-        texCoords.push_back(v.texCoord);
-        normals.push_back(v.normal);
-    }
+void setVertexFormat(GLuint vao, bool packed) {
+
+    auto attrib = [&](GLuint loc, GLint size, GLenum type, GLboolean normalized, GLuint offset) {
 
-    std::vector<glm::vec4> tangents = MeshUtils::calculateTangents(positions, indices, texCoords, normals);
+        glEnableVertexArrayAttrib(vao, loc);
+        glVertexArrayAttribFormat(vao, loc, size, type, normalized, offset);
+        glVertexArrayAttribBinding(vao, loc, 0);
+    };
 
-    for (int i = 0; i < tangents.size(); i++) {
+    if (packed) {
 
-        vertices[i].tangent = tangents[i];
+        // (pos + tangent sign, oct normal, half uv, oct tangent)
+        attrib(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(MeshUtils::PackedVertex, position));
+        attrib(1, 2, GL_SHORT, GL_TRUE, offsetof(MeshUtils::PackedVertex, normal));
+        attrib(2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(MeshUtils::PackedVertex, uv));
+        attrib(3, 2, GL_SHORT, GL_TRUE, offsetof(MeshUtils::PackedVertex, tangent));
+        return;
     }
+
+    // (pos, normal, uv, tangent)
+    attrib(0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+    attrib(1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+    attrib(2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoord));
+    attrib(3, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, tangent));
 }
 
-GPUMeshBuffers uploadMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices) {
+// pointer version so the scene cache can hand over mapped memory without copying into vectors first
+GPUMeshBuffers uploadMesh(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, bool packed) {
 
     GPUMeshBuffers gpu;
 
-    glGenVertexArrays(1, &gpu.vao);
-    glGenBuffers(1, &gpu.vbo);
-    glGenBuffers(1, &gpu.ebo);
+    const void* vertexData = vertices;
+    const void* indexData = indices;
+    size_t indexSize = sizeof(uint32_t);
 
-    glBindVertexArray(gpu.vao);
+    MeshUtils::PackedMesh packedMesh;
+    if (packed) {
 
-    // vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        vertices.size() * sizeof(Vertex),
-        vertices.data(),
-        GL_STATIC_DRAW);
+        MeshUtils::packMesh(indices, indexCount, vertices, vertexCount, packedMesh);
+        vertexData = packedMesh.vertices.data();
+        indexData = packedMesh.indices.data();
+        indexSize = packedMesh.indexSize;
 
-    // index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        indices.size() * sizeof(uint32_t),
-        indices.data(),
-        GL_STATIC_DRAW);
+        gpu.vertexStride = sizeof(MeshUtils::PackedVertex);
+        gpu.indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        gpu.posOffset = packedMesh.posOffset;
+        gpu.posScale = packedMesh.posScale;
+    }
 
-    // (pos, normal, uv)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-        sizeof(Vertex), (void*)offsetof(Vertex, pos));
+    glCreateVertexArrays(1, &gpu.vao);
+    glCreateBuffers(1, &gpu.vbo);
+    glCreateBuffers(1, &gpu.ebo);
 
-    glEnableVertexAttribArray(1); 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-        sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glNamedBufferData(gpu.vbo, vertexCount * gpu.vertexStride, vertexData, GL_STATIC_DRAW);
+    glNamedBufferData(gpu.ebo, indexCount * indexSize, indexData, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(2); 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-        sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    glVertexArrayVertexBuffer(gpu.vao, 0, gpu.vbo, 0, gpu.vertexStride);
+    glVertexArrayElementBuffer(gpu.vao, gpu.ebo);
+    setVertexFormat(gpu.vao, packed);
 
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE,
-        sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+    gpu.indexCount = static_cast<GLsizei>(indexCount);
+    gpu.vertexCount = static_cast<GLsizei>(vertexCount);
+    return gpu;
+}
 
-    glBindVertexArray(0);
+GPUMeshBuffers uploadMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, bool packed) {
 
-    gpu.indexCount = static_cast<GLsizei>(indices.size());
-    return gpu;
+    return uploadMesh(indices.data(), indices.size(), vertices.data(), vertices.size(), packed);
+}
+
+
+// cpu side result of decoding one fastgltf::Mesh, filled on a worker and uploaded later
+struct MeshStaging {
+
+    std::vector<uint32_t> indices;
+    std::vector<Vertex> vertices;
+    std::vector<SubMesh> surfaces;
+};
+
+static void decodeMesh(fastgltf::Mesh& mesh, fastgltf::Asset* gltf, std::vector<std::shared_ptr<gltfMaterial>>& materials, MeshStaging& out,
+    const MeshUtils::OptimizeSettings* optimize, const MeshUtils::LodSettings* lods, bool benchmarkTangents) {
+
+    // primitives that ship TANGENT keep them, only the rest go through the generator
+    std::vector<MeshUtils::IndexRange> missingTangents;
+    for (auto& p : mesh.primitives) {
+
+        size_t firstVertex = out.vertices.size();
+        out.surfaces.push_back(buildSurface(p, gltf, out.indices, out.vertices, materials));
+        if (!loadTangents(p, gltf, out.vertices, firstVertex)) missingTangents.push_back({ out.surfaces.back().startIndex, out.surfaces.back().count });
+    }
+
+    if (benchmarkTangents && !missingTangents.empty()) {
+
+        MeshUtils::TangentBenchmark bench = MeshUtils::benchmarkTangents(out.indices, out.vertices, missingTangents);
+        std::cout << "tangents " << mesh.name << " (" << out.vertices.size() << " verts): old " << bench.referenceMs << " ms, soa "
+            << bench.serialMs << " ms, soa parallel " << bench.parallelMs << " ms, max diff " << bench.maxDifference << std::endl;
+    }
+    MeshUtils::generateTangents(out.indices, out.vertices, missingTangents);
+
+    if (optimize) {
+
+        // each primitive is optimized inside its own index range so the surfaces stay valid
+        std::vector<MeshUtils::IndexRange> ranges;
+        for (auto& s : out.surfaces) ranges.push_back({ s.startIndex, s.count });
+        MeshUtils::optimizeMesh(out.indices, out.vertices, ranges, *optimize, std::string(mesh.name));
+    }
+
+    // lods + clusters last, lods get appended after every surface and clusters are just cuts through the final index order
+    for (auto& s : out.surfaces) {
+
+        s.detail = std::make_shared<const MeshUtils::SurfaceDetail>(
+            MeshUtils::buildSurfaceDetail(out.indices, out.vertices, { s.startIndex, s.count }, lods));
+    }
 }
 
+// decodeMesh with the knobs from LoadSettings, cpu only so any thread
+static void decodeMesh(const gltfData::LoadSettings& settings, size_t meshIndex, fastgltf::Asset* gltf,
+    std::vector<std::shared_ptr<gltfMaterial>>& materials, MeshStaging& out) {
+
+    MeshUtils::OptimizeSettings optimize;
+    optimize.overdrawThreshold = settings.overdrawThreshold;
+    optimize.report = settings.reportMeshStats;
+
+    MeshUtils::LodSettings lods;
+    lods.maxLevels = settings.maxLods;
+    lods.errorTargets = settings.lodErrorTargets;
+
+    decodeMesh(gltf->meshes[meshIndex], gltf, materials, out, settings.optimizeMeshes ? &optimize : nullptr,
+        settings.generateLods ? &lods : nullptr, settings.benchmarkTangents);
+}
+
+// gl thread, fills in an already created asset so nodes pointing at it start drawing it.
+// records the mesh for the cache when baking (bake->meshes already sized to the file)
+static void uploadStagedMesh(SceneCache::SceneData* bake, bool packed, size_t meshIndex, MeshAsset& mesh, MeshStaging& staged,
+    const std::vector<std::shared_ptr<gltfMaterial>>& materials) {
+
+    mesh.meshBuffers = uploadMesh(staged.indices, staged.vertices, packed);
+    mesh.submeshes = std::move(staged.surfaces);
+
+    if (bake) {
+
+        SceneCache::SceneData::Mesh& baked = bake->meshes[meshIndex];
+        baked.vertexCount = uint32_t(staged.vertices.size());
+        baked.vertices.resize(staged.vertices.size() * sizeof(Vertex));
+        std::memcpy(baked.vertices.data(), staged.vertices.data(), baked.vertices.size());
+        baked.indices = std::move(staged.indices);
+
+        for (auto& sub : mesh.submeshes) {
+
+            auto found = std::find(materials.begin(), materials.end(), sub.material);
+            int32_t matIdx = found != materials.end() ? int32_t(found - materials.begin()) : SceneCache::NONE;
+
+            SceneCache::SurfaceRecord surf{ sub.startIndex, sub.count, matIdx };
+            SceneCache::addSurfaceDetail(baked, surf, *sub.detail);
+            baked.surfaces.push_back(surf);
+        }
+    }
+
+    staged = {}; // free the cpu copy as we go
+}
 
 // Main mesh loading function
 std::vector<std::shared_ptr<MeshAsset>> gltfData::loadMeshes(
     GltfLoadContext ctx, std::vector<std::shared_ptr<gltfMaterial>> materials) {
 
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
     std::vector<std::shared_ptr<MeshAsset>> vecMeshes;
+    std::vector<MeshStaging> staging(ctx.gltf->meshes.size());
 
-    for (fastgltf::Mesh& mesh : ctx.gltf->meshes) {
+    // meshes dont depend on each other so the cpu side can go wide, gl/vk calls stay on this thread
+    auto decode = [&](size_t i) {
 
-        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
-        vecMeshes.push_back(newMesh);
-        //newMesh->name = mesh.name;
+        decodeMesh(settings, i, ctx.gltf, materials, staging[i]);
+    };
 
-        indices.clear();
-        vertices.clear();
+    if (settings.parallelMeshDecode) {
 
-        for (auto& p : mesh.primitives) {
+        Utils::Jobs::get().parallelFor(staging.size(), decode);
+    }
+    else {
 
-            SubMesh newSurface = buildSurface(p, ctx.gltf, indices, vertices, materials);
-            newMesh->submeshes.push_back(newSurface);
-        }
-        loadTangents(indices, vertices);
+        for (size_t i = 0; i < staging.size(); i++) decode(i);
+    }
+
+    // upload in file order so mesh indices line up with what loadNodes expects
+    if (bake) bake->meshes.resize(staging.size());
+    for (size_t i = 0; i < staging.size(); i++) {
 
-        newMesh->meshBuffers = uploadMesh(indices, vertices);
+        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
+        vecMeshes.push_back(newMesh);
+        //newMesh->name = mesh.name;
+
+        uploadStagedMesh(bake.get(), settings.packedVertices, i, *newMesh, staging[i], materials);
     }
 
     return vecMeshes;
@@ -553,16 +990,30 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
             else {
                 std::cout << "iteration node thing first meshIndex: none" << std::endl;
             }
+            glm::mat4 world = *reinterpret_cast<const glm::mat4*>(&matrix);
+            std::vector<glm::mat4> instances;
+            if (node.meshIndex) instances = GltfUtils::loadInstanceTransforms(*ctx.gltf, node, world);
+
+            if (bake) {
+
+                SceneCache::SceneData::Node baked;
+                baked.record.transform = world;
+                baked.record.mesh = node.meshIndex ? int32_t(*node.meshIndex) : SceneCache::NONE;
+                baked.instances = instances;
+                bake->nodes.push_back(std::move(baked));
+            }
             if (!node.meshIndex) {
 
                 auto emptyNode = std::make_shared<Node>();
+                emptyNode->worldTransform = world;
                 nodes.push_back(emptyNode);
                 return;
             }
-            auto meshCopy = vecMeshes[*node.meshIndex]->clone();
-            meshCopy->transform = *reinterpret_cast<const glm::mat4*>(&matrix);
+            // every node referencing this mesh shares the same asset, only the transform is per node
             auto meshNode = std::make_shared<MeshNode>();
-            meshNode->mesh = meshCopy;
+            meshNode->mesh = vecMeshes[*node.meshIndex];
+            meshNode->worldTransform = world;
+            meshNode->instanceTransforms = std::move(instances);
 
             nodes.push_back(meshNode);
         });
@@ -597,6 +1048,202 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
             // actual linking
             sceneNode->children.push_back(nodes[childIdx]);
             nodes[childIdx]->parent = sceneNode;
+            if (bake) bake->nodes[i].children.push_back(uint32_t(childIdx));
+        }
+    }
+    for (auto& node : nodes) {
+
+        if (node->parent.lock() == nullptr) {
+
+            ctx.scene->topNodes.push_back(node);
+        }
+    }
+    return nodes;
+}
+
+static std::vector<GLSampler> loadCachedSamplers(const SceneCache::SceneView& view) {
+
+    std::vector<GLSampler> samplers;
+    for (uint32_t i = 0; i < view.header().samplerCount; i++) {
+
+        const SceneCache::SamplerRecord& rec = view.samplers()[i];
+        auto filter = [](int32_t f) { return f == SceneCache::NONE ? fastgltf::Filter::Nearest : fastgltf::Filter(f); };
+        samplers.push_back(makeSampler(filter(rec.magFilter), filter(rec.minFilter), fastgltf::Wrap(rec.wrapS), fastgltf::Wrap(rec.wrapT)));
+    }
+    return samplers;
+}
+
+// a streamer reads finer levels straight out of the mapping later on, so it holds on to the view
+static GLImage loadCachedImage(const std::shared_ptr<const SceneCache::SceneView>& view, uint32_t index, TextureStreamer* streamer, std::vector<int32_t>& streamed) {
+
+    const SceneCache::ImageRecord& rec = view->images()[index];
+    if (!rec.width) return fallbackImage();
+    if (!streamer) return uploadImageMips(rec, view->bytes(rec.dataOffset));
+
+    uint32_t texture = streamer->add(view, view->bytes(rec.dataOffset), rec.width, rec.height, TextureCompress::Format(rec.format));
+    streamed[index] = int32_t(texture);
+    return streamer->image(texture);
+}
+
+// fills in an already created asset, same as uploadStagedMesh on the cold path
+static void loadCachedMesh(const SceneCache::SceneView& view, uint32_t index, MeshAsset& mesh,
+    const std::vector<std::shared_ptr<gltfMaterial>>& materials, bool packed) {
+
+    const SceneCache::MeshRecord& rec = view.meshes()[index];
+    std::vector<SubMesh> submeshes;
+
+    for (uint32_t s = 0; s < rec.surfaceCount; s++) {
+
+        const SceneCache::SurfaceRecord& surf = view.surfaces()[rec.firstSurface + s];
+        SubMesh sub;
+        sub.startIndex = surf.startIndex;
+        sub.count = surf.count;
+        sub.material = (surf.material != SceneCache::NONE && uint32_t(surf.material) < materials.size()) ? materials[surf.material] : materials[0];
+        sub.detail = std::make_shared<const MeshUtils::SurfaceDetail>(view.surfaceDetail(surf));
+        submeshes.push_back(sub);
+    }
+
+    // straight from the mapping into the gl buffers
+    mesh.meshBuffers = uploadMesh(
+        reinterpret_cast<const uint32_t*>(view.bytes(rec.indexOffset)), rec.indexCount,
+        reinterpret_cast<const Vertex*>(view.bytes(rec.vertexOffset)), rec.vertexCount, packed);
+    mesh.submeshes = std::move(submeshes);
+}
+
+// texture slot order matches SceneCache::TextureSlot
+static GLTexture& textureSlot(PBRSystem::MaterialResources& res, uint32_t slot) {
+
+    GLTexture* slots[SceneCache::SLOT_COUNT] = {
+        &res.albedo, &res.metalRough, &res.occlusion, &res.normalMap, &res.transmission, &res.volumeThickness
+    };
+    return *slots[slot];
+}
+
+// the streamer rewrites these slots whenever it reallocates the image. image = only slots using that one (it just landed)
+void gltfData::trackStreamedSlots(glEngine* engine, const std::shared_ptr<gltfMaterial>& mat, const SceneCache::MaterialRecord& rec, int32_t image) {
+
+    for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+        int32_t img = rec.image[slot];
+        if (img == SceneCache::NONE || rec.sampler[slot] == SceneCache::NONE) continue;
+        if ((image != SceneCache::NONE && img != image) || size_t(img) >= streamedImages.size() || streamedImages[img] == SceneCache::NONE) continue;
+
+        // only base color is srgb, same as fetchPBRTextures
+        engine->_textureStreamer.addUser(uint32_t(streamedImages[img]), mat, &textureSlot(mat->data.resources, slot), slot == SceneCache::SLOT_ALBEDO);
+    }
+}
+
+void gltfData::loadFromCache(GltfLoadContext ctx, const std::shared_ptr<const SceneCache::SceneView>& view) {
+
+    const SceneCache::Header& header = view->header();
+
+    std::vector<GLSampler> samplers = loadCachedSamplers(*view);
+
+    TextureStreamer* streamer = settings.streamTextures ? &ctx.engine->_textureStreamer : nullptr;
+    if (streamer) streamedImages.assign(header.imageCount, SceneCache::NONE);
+
+    std::vector<GLImage> images;
+    for (uint32_t i = 0; i < header.imageCount; i++) {
+
+        images.push_back(loadCachedImage(view, i, streamer, streamedImages));
+    }
+
+    std::vector<std::shared_ptr<gltfMaterial>> materials = loadCachedMaterials(ctx, *view, samplers, images);
+
+    std::vector<std::shared_ptr<MeshAsset>> vecMeshes;
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+
+        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
+        vecMeshes.push_back(newMesh);
+        loadCachedMesh(*view, i, *newMesh, materials, settings.packedVertices);
+    }
+
+    loadCachedNodes(ctx, *view, vecMeshes);
+}
+
+std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadCachedMaterials(GltfLoadContext ctx, const SceneCache::SceneView& view,
+    std::vector<GLSampler>& samplers, std::vector<GLImage>& images) {
+
+    const SceneCache::Header& header = view.header();
+
+    // same single immutable upload as loadMaterials
+    GLuint materialUBO;
+    glCreateBuffers(1, &materialUBO);
+    std::vector<PBRSystem::MaterialPBRConstants> constants(std::max<uint32_t>(header.materialCount, 1));
+    ctx.scene->materialDataBuffer = materialUBO;
+
+    std::vector<std::shared_ptr<gltfMaterial>> materials;
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+
+        const SceneCache::MaterialRecord& rec = view.materials()[i];
+        std::shared_ptr<gltfMaterial> newMat = std::make_shared<gltfMaterial>();
+        materials.push_back(newMat);
+
+        PBRSystem::MaterialResources materialResources;
+
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            GLTexture& dst = textureSlot(materialResources, slot);
+            dst.image = (slot == SceneCache::SLOT_NORMAL) ? ctx.engine->_flatNormalImage : ctx.engine->_whiteImage;
+            dst.sampler = ctx.engine->_defaultSamplerLinear;
+
+            if (rec.image[slot] == SceneCache::NONE || rec.sampler[slot] == SceneCache::NONE) continue;
+            if (uint32_t(rec.image[slot]) >= images.size() || uint32_t(rec.sampler[slot]) >= samplers.size()) continue;
+
+            dst.image = images[rec.image[slot]];
+            dst.sampler = samplers[rec.sampler[slot]];
+
+            // only base color is srgb, same as fetchPBRTextures
+            dst.image.id = (slot == SceneCache::SLOT_ALBEDO) ? dst.image.sRGBID : dst.image.linearID;
+        }
+
+        materialResources.dataBuffer = materialUBO;
+        materialResources.dataBufferOffset = i * sizeof(PBRSystem::MaterialPBRConstants);
+
+        std::memcpy(&constants[i], view.bytes(rec.constantsOffset), sizeof(PBRSystem::MaterialPBRConstants));
+
+        newMat->doubleSided = (rec.flags & SceneCache::MATERIAL_DOUBLE_SIDED) != 0;
+        newMat->data = pbrSystem.writeMaterial(PBRSystem::MaterialPass(rec.pass), materialResources, ctx.engine);
+        trackStreamedSlots(ctx.engine, newMat, rec);
+    }
+
+    glNamedBufferStorage(materialUBO, constants.size() * sizeof(PBRSystem::MaterialPBRConstants), constants.data(), 0);
+    return materials;
+}
+
+std::vector<std::shared_ptr<Node>> gltfData::loadCachedNodes(GltfLoadContext ctx, const SceneCache::SceneView& view,
+    const std::vector<std::shared_ptr<MeshAsset>>& vecMeshes) {
+
+    const SceneCache::Header& header = view.header();
+
+    std::vector<std::shared_ptr<Node>> nodes;
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+
+        const SceneCache::NodeRecord& rec = view.nodes()[i];
+        if (rec.mesh == SceneCache::NONE) {
+
+            auto emptyNode = std::make_shared<Node>();
+            emptyNode->worldTransform = rec.transform;
+            nodes.push_back(emptyNode);
+            continue;
+        }
+        auto meshNode = std::make_shared<MeshNode>();
+        meshNode->mesh = vecMeshes[rec.mesh];
+        meshNode->worldTransform = rec.transform;
+        meshNode->instanceTransforms.assign(view.instances() + rec.firstInstance, view.instances() + rec.firstInstance + rec.instanceCount);
+        nodes.push_back(meshNode);
+    }
+
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+
+        const SceneCache::NodeRecord& rec = view.nodes()[i];
+        for (uint32_t c = 0; c < rec.childCount; c++) {
+
+            uint32_t childIdx = view.children()[rec.firstChild + c];
+            if (childIdx >= nodes.size()) continue;
+
+            nodes[i]->children.push_back(nodes[childIdx]);
+            nodes[childIdx]->parent = nodes[i];
         }
     }
     for (auto& node : nodes) {
@@ -609,30 +1256,378 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
     return nodes;
 }
 
-RenderObject MeshNode::createRenderObject(const SubMesh& surface) {
+// everything LoadAsync keeps between pump() calls
+struct gltfData::StreamState {
+
+    glEngine* engine = nullptr;
+
+    // job pool: hash + cache probe, then the parse if the cache can't be used
+    std::future<void> opening;
+    std::filesystem::path cachePath;
+    uint64_t sourceHash = 0;
+    std::shared_ptr<SceneCache::SceneView> view = std::make_shared<SceneCache::SceneView>();
+    bool fromCache = false;
+    std::unique_ptr<fastgltf::Asset> asset;
+    bool started = false;
+
+    std::vector<GLSampler> samplers;
+    std::vector<std::shared_ptr<gltfMaterial>> materials;
+    std::vector<SceneCache::MaterialRecord> textureSlots; // per material, the image/sampler each slot gets once it's in
+    std::vector<std::shared_ptr<MeshAsset>> meshes;       // created empty up front so the nodes can point at them
+    std::vector<std::vector<std::shared_ptr<MeshNode>>> meshUsers;
+
+    // cold path, decoded on the pool in whatever order they finish. the warm path uploads straight from the mapping in file order
+    std::unique_ptr<Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>>> decodedImages;
+    std::mutex meshLock;
+    std::deque<std::pair<size_t, MeshStaging>> decodedMeshes;
+    std::future<void> imageDecode;
+    std::future<void> meshDecode;
+    std::atomic<bool> cancelled = false;
+
+    uint32_t nextImage = 0;
+    uint32_t nextMesh = 0;
+    size_t imagesLeft = 0;
+    size_t meshesLeft = 0;
+
+    GltfDrawContext batch; // visible but not handed to the engine's context yet
+    std::chrono::steady_clock::time_point lastCommit;
+    std::future<void> cacheWrite;
+
+    ~StreamState() {
+
+        // scene dropped mid load. workers may be parked on a full image queue so keep draining until they're out
+        cancelled = true;
+        if (opening.valid()) opening.wait();
+
+        std::pair<size_t, DecodedImage> leftover;
+        auto drain = [&]() {
+
+            while (decodedImages && decodedImages->tryPop(leftover)) stbi_image_free(leftover.second.data);
+        };
+        while (imageDecode.valid() && imageDecode.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) drain();
+        drain();
+
+        if (meshDecode.valid()) meshDecode.wait();
+        if (cacheWrite.valid()) cacheWrite.wait();
+    }
+};
+
+gltfData::~gltfData() = default;
+
+std::shared_ptr<gltfData> gltfData::LoadAsync(glEngine* engine, std::filesystem::path path, LoadSettings settings) {
+
+    std::shared_ptr<gltfData> scene = std::make_shared<gltfData>();
+    scene->settings = settings;
+    scene->stream = std::make_unique<StreamState>();
+
+    StreamState& s = *scene->stream;
+    s.engine = engine;
+
+    // nothing on this thread touches s until opening is ready, and ~StreamState waits on it
+    gltfData* file = scene.get();
+    s.opening = Utils::Jobs::get().submit([file, &s, path]() {
+
+        if (file->settings.useSceneCache) {
+
+            s.cachePath = SceneCache::cachePathFor(path, "gl");
+            s.sourceHash = SceneCache::hashSource(path, sizeof(Vertex), sizeof(PBRSystem::MaterialPBRConstants), bakeSettings(file->settings));
+            if (s.sourceHash && s.view->open(s.cachePath, s.sourceHash, sizeof(Vertex), sizeof(PBRSystem::MaterialPBRConstants))) {
+
+                s.fromCache = true;
+                return;
+            }
+        }
+        if (s.cancelled) return;
+        s.asset = std::make_unique<fastgltf::Asset>(file->getGltfAsset(path));
+    });
+
+    return scene;
+}
+
+// gl thread, first pump after the file is open. samplers, placeholder materials and the node tree go up in one go
+// (all small), then the pool starts on images + meshes
+void gltfData::beginStream() {
+
+    StreamState& s = *stream;
+    GltfLoadContext ctx = { shared_from_this(), s.asset.get(), s.engine };
+
+    // every texture starts out as the white image, fetchPBRTextures / the cache records still pick the real samplers
+    GLImage placeholder = s.engine->_whiteImage;
+    placeholder.linearID = placeholder.id;
+    placeholder.sRGBID = placeholder.id;
+
+    size_t imageCount = 0;
+    size_t meshCount = 0;
+    std::vector<std::shared_ptr<Node>> nodes;
+
+    if (s.fromCache) {
+
+        std::cout << "streaming scene cache " << s.cachePath << std::endl;
+        const SceneCache::Header& header = s.view->header();
+        imageCount = header.imageCount;
+        meshCount = header.meshCount;
+
+        std::vector<GLImage> images(imageCount, placeholder);
+        if (settings.streamTextures) streamedImages.assign(imageCount, SceneCache::NONE);
+        s.samplers = loadCachedSamplers(*s.view);
+        s.materials = loadCachedMaterials(ctx, *s.view, s.samplers, images);
+        s.textureSlots.assign(s.view->materials(), s.view->materials() + header.materialCount);
+
+        for (size_t i = 0; i < meshCount; i++) s.meshes.push_back(std::make_shared<MeshAsset>());
+        nodes = loadCachedNodes(ctx, *s.view, s.meshes);
+    }
+    else {
+
+        fastgltf::Asset& gltf = *s.asset;
+        imageCount = gltf.images.size();
+        meshCount = gltf.meshes.size();
+
+        if (s.sourceHash) {
+
+            bake = std::make_unique<SceneCache::SceneData>();
+            bake->vertexStride = sizeof(Vertex);
+            bake->materialStride = sizeof(PBRSystem::MaterialPBRConstants);
+            bake->images.resize(imageCount);
+            bake->meshes.resize(meshCount);
+        }
+
+        std::vector<GLImage> images(imageCount, placeholder);
+        if (settings.streamTextures) streamedImages.assign(imageCount, SceneCache::NONE);
+        s.samplers = createSamplers(ctx);
+        s.materials = loadMaterials(ctx, s.samplers, images);
+        s.textureSlots.resize(s.materials.size());
+        for (size_t i = 0; i < s.materials.size(); i++) recordTextureSlots(gltf.materials[i], gltf, s.textureSlots[i]);
+
+        for (size_t i = 0; i < meshCount; i++) s.meshes.push_back(std::make_shared<MeshAsset>());
+        nodes = loadNodes(ctx, s.meshes);
+    }
+
+    // a white normal map would rebuild to a tilted normal, normal slots wait on the flat one instead
+    GLImage flatNormal = s.engine->_flatNormalImage;
+    flatNormal.linearID = flatNormal.id;
+    flatNormal.sRGBID = flatNormal.id;
+    for (size_t m = 0; m < s.materials.size(); m++) {
+
+        if (s.textureSlots[m].image[SceneCache::SLOT_NORMAL] != SceneCache::NONE) s.materials[m]->data.resources.normalMap.image = flatNormal;
+    }
+
+    // which nodes to push once a mesh lands
+    std::unordered_map<const MeshAsset*, size_t> meshIndex;
+    for (size_t i = 0; i < s.meshes.size(); i++) meshIndex[s.meshes[i].get()] = i;
+    s.meshUsers.resize(meshCount);
+    for (auto& node : nodes) {
+
+        auto meshNode = std::dynamic_pointer_cast<MeshNode>(node);
+        if (meshNode && meshNode->mesh) s.meshUsers[meshIndex[meshNode->mesh.get()]].push_back(meshNode);
+    }
+
+    s.imagesLeft = imageCount;
+    s.meshesLeft = meshCount;
+    s.lastCommit = std::chrono::steady_clock::now();
+    if (s.fromCache) return;
+
+    bool buildMips = bake != nullptr || settings.streamTextures;
+    bool compress = settings.compressTextures;
+    std::vector<uint32_t> slotMasks = imageSlotMasks(s.textureSlots, imageCount);
+    bool parallelImages = settings.parallelImageDecode;
+    bool parallelMeshes = settings.parallelMeshDecode;
+    auto each = [](size_t count, bool parallel, const std::function<void(size_t)>& fn) {
+
+        if (parallel) Utils::Jobs::get().parallelFor(count, fn);
+        else for (size_t i = 0; i < count; i++) fn(i);
+    };
+
+    // meshes queue first, on a small pool they then get the workers before the image decode does
+    const LoadSettings& meshSettings = settings;
+    s.meshDecode = Utils::Jobs::get().submit([&s, &meshSettings, each, parallelMeshes]() {
+
+        each(s.asset->meshes.size(), parallelMeshes, [&](size_t i) {
+
+            if (s.cancelled) return;
+            MeshStaging staged;
+            decodeMesh(meshSettings, i, s.asset.get(), s.materials, staged);
+
+            std::lock_guard<std::mutex> lock(s.meshLock);
+            s.decodedMeshes.push_back({ i, std::move(staged) });
+        });
+    });
+
+    s.decodedImages = std::make_unique<Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>>>(settings.imageQueueDepth);
+    s.imageDecode = Utils::Jobs::get().submit([&s, each, buildMips, compress, slotMasks, parallelImages]() {
+
+        each(s.asset->images.size(), parallelImages, [&](size_t i) {
+
+            if (s.cancelled) return;
+            s.decodedImages->push({ i, decodeForUpload(*s.asset, s.asset->images[i], buildMips, compress, slotMasks[i]) });
+        });
+    });
+}
+
+bool gltfData::uploadNextMesh() {
+
+    StreamState& s = *stream;
+    size_t index;
+
+    if (s.fromCache) {
+
+        if (s.nextMesh >= s.meshes.size()) return false;
+        index = s.nextMesh++;
+        loadCachedMesh(*s.view, uint32_t(index), *s.meshes[index], s.materials, settings.packedVertices);
+    }
+    else {
+
+        std::pair<size_t, MeshStaging> ready;
+        {
+            std::lock_guard<std::mutex> lock(s.meshLock);
+            if (s.decodedMeshes.empty()) return false;
+            ready = std::move(s.decodedMeshes.front());
+            s.decodedMeshes.pop_front();
+        }
+        index = ready.first;
+        uploadStagedMesh(bake.get(), settings.packedVertices, index, *s.meshes[index], ready.second, s.materials);
+    }
+
+    // the asset is shared, every node using it becomes visible at once
+    for (auto& node : s.meshUsers[index]) node->pushRenderObjects(s.batch);
+    s.meshUsers[index].clear();
+    s.meshesLeft--;
+    return true;
+}
+
+bool gltfData::uploadNextImage() {
+
+    StreamState& s = *stream;
+    size_t index;
+    GLImage image;
+    TextureStreamer* streamer = settings.streamTextures ? &s.engine->_textureStreamer : nullptr;
+
+    if (s.fromCache) {
+
+        if (s.nextImage >= s.view->header().imageCount) return false;
+        index = s.nextImage++;
+        image = loadCachedImage(s.view, uint32_t(index), streamer, streamedImages);
+    }
+    else {
+
+        std::pair<size_t, DecodedImage> ready;
+        if (!s.decodedImages->tryPop(ready)) return false;
+        index = ready.first;
+        image = storeImage(bake.get(), streamer, index, ready.second, streamedImages);
+    }
+
+    // gl materials read their textures at bind time, so patching the resources is all a swap takes
+    for (size_t m = 0; m < s.materials.size(); m++) {
+
+        const SceneCache::MaterialRecord& rec = s.textureSlots[m];
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            if (rec.image[slot] == SceneCache::NONE || size_t(rec.image[slot]) != index) continue;
+            if (rec.sampler[slot] == SceneCache::NONE || uint32_t(rec.sampler[slot]) >= s.samplers.size()) continue;
+
+            GLTexture& dst = textureSlot(s.materials[m]->data.resources, slot);
+            dst.image = image;
+            dst.image.id = (slot == SceneCache::SLOT_ALBEDO) ? image.sRGBID : image.linearID;
+        }
+        trackStreamedSlots(s.engine, s.materials[m], rec, int32_t(index));
+    }
+    s.imagesLeft--;
+    return true;
+}
+
+bool gltfData::pump(GltfDrawContext& ctx) {
+
+    if (!stream) return false;
+    StreamState& s = *stream;
+
+    if (!s.started) {
+
+        if (s.opening.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+        s.opening.get();
+        beginStream();
+        s.started = true;
+    }
+
+    // geometry first, an untextured object still beats an empty spot. always one item so a tiny budget can't stall the load
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [](std::chrono::steady_clock::time_point since) {
+
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+    bool uploaded = false;
+    while (!uploaded || elapsedMs(start) < settings.streamBudgetMs) {
+
+        if (!uploadNextMesh() && !uploadNextImage()) break;
+        uploaded = true;
+    }
+
+    bool done = s.meshesLeft == 0 && s.imagesLeft == 0;
+    bool pending = !s.batch.opaqueSubmeshes.empty() || !s.batch.transmissionSubmeshes.empty() || !s.batch.transparentSubmeshes.empty();
+
+    // batched so the engine's per commit work (instance upload, mdi rebuild) doesn't run every frame
+    bool committed = false;
+    if (pending && (done || elapsedMs(s.lastCommit) >= settings.streamCommitMs)) {
+
+        ctx.append(s.batch);
+        s.batch.isTransmissionEnabled = false;
+        s.lastCommit = std::chrono::steady_clock::now();
+        committed = true;
+    }
+    if (!done) return committed;
+
+    // everything is in. the cache gets written off thread, the asset + mapping go once that's finished
+    if (bake && !s.cacheWrite.valid()) {
+
+        std::shared_ptr<SceneCache::SceneData> data(std::move(bake));
+        std::filesystem::path cachePath = s.cachePath;
+        uint64_t sourceHash = s.sourceHash;
+        s.cacheWrite = Utils::Jobs::get().submit([data, cachePath, sourceHash]() { SceneCache::write(cachePath, sourceHash, *data); });
+    }
+    if (s.cacheWrite.valid()) {
+
+        if (s.cacheWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return committed;
+        s.cacheWrite.get();
+    }
+    stream.reset();
+    std::cout << "scene streaming done" << std::endl;
+    return committed;
+}
+
+RenderObject MeshNode::createRenderObject(const SubMesh& surface, const glm::mat4& transform) {
 
     RenderObject obj;
     obj.idxStart = surface.startIndex;
     obj.numIndices = surface.count;
     obj.meshBuffers = mesh->meshBuffers;
-    obj.transform = mesh->transform;
+    obj.transform = transform;
     obj.material = surface.material;
+    obj.detail = surface.detail;
     return obj;
 }
 
-void MeshNode::Draw(GltfDrawContext& ctx) {
+void MeshNode::pushRenderObjects(GltfDrawContext& ctx) {
 
-    for (auto& submesh : mesh->submeshes) {
+    auto push = [&](const glm::mat4& transform) {
 
-        RenderObject obj = createRenderObject(submesh);
-        if (obj.material->data.type == PBRSystem::MaterialPass::Opaque) ctx.opaqueSubmeshes.push_back(obj);
-        if (obj.material->data.type == PBRSystem::MaterialPass::Transparent) ctx.transparentSubmeshes.push_back(obj);
-        if (obj.material->data.type == PBRSystem::MaterialPass::Transmission) {
+        for (auto& submesh : mesh->submeshes) {
 
-            ctx.transmissionSubmeshes.push_back(obj);
-            ctx.isTransmissionEnabled = true;
+            RenderObject obj = createRenderObject(submesh, transform);
+            if (obj.material->data.type == PBRSystem::MaterialPass::Opaque) ctx.opaqueSubmeshes.push_back(obj);
+            if (obj.material->data.type == PBRSystem::MaterialPass::Transparent) ctx.transparentSubmeshes.push_back(obj);
+            if (obj.material->data.type == PBRSystem::MaterialPass::Transmission) {
+
+                ctx.transmissionSubmeshes.push_back(obj);
+                ctx.isTransmissionEnabled = true;
+            }
         }
-    }
+    };
+
+    if (instanceTransforms.empty()) push(worldTransform);
+    for (auto& transform : instanceTransforms) push(transform);
+}
+
+void MeshNode::Draw(GltfDrawContext& ctx) {
+
+    pushRenderObjects(ctx);
     Node::Draw(ctx);
 }
 
@@ -642,6 +1637,78 @@ void gltfData::drawNodes(GltfDrawContext& ctx) {
 
         node->Draw(ctx);
     }
+    ctx.buildInstances();
+}
+
+// same geometry range + same material = one draw, order of first appearance is kept so the passes draw in the same order as before.
+// transparent stays one object per instance since those get depth sorted. instances go after whatever is already in the list
+static void groupInstances(std::vector<RenderObject>& objects, std::vector<GPUInstance>& instances, bool merge) {
+
+    auto emit = [&](const RenderObject& obj, const glm::mat4& model) {
+
+        instances.push_back({ model, obj.meshBuffers.posOffset, obj.meshBuffers.posScale });
+    };
+
+    if (!merge) {
+
+        for (auto& obj : objects) {
+
+            obj.firstInstance = static_cast<uint32_t>(instances.size());
+            obj.instanceCount = 1;
+            emit(obj, obj.transform);
+        }
+        return;
+    }
+
+    using Key = std::tuple<GLuint, uint32_t, uint32_t, const gltfMaterial*>;
+    std::map<Key, size_t> slot;
+    std::vector<std::vector<glm::mat4>> transforms;
+    std::vector<RenderObject> grouped;
+
+    for (auto& obj : objects) {
+
+        Key key{ obj.meshBuffers.vao, obj.idxStart, obj.numIndices, obj.material.get() };
+        auto [it, inserted] = slot.try_emplace(key, grouped.size());
+        if (inserted) {
+
+            grouped.push_back(obj);
+            transforms.emplace_back();
+        }
+        transforms[it->second].push_back(obj.transform);
+    }
+    for (size_t i = 0; i < grouped.size(); i++) {
+
+        grouped[i].firstInstance = static_cast<uint32_t>(instances.size());
+        grouped[i].instanceCount = static_cast<uint32_t>(transforms[i].size());
+        for (auto& model : transforms[i]) emit(grouped[i], model);
+    }
+    objects = std::move(grouped);
+}
+
+void GltfDrawContext::buildInstances() {
+
+    instances.clear();
+    uploadedInstances = 0;
+
+    groupInstances(opaqueSubmeshes, instances, true);
+    groupInstances(transmissionSubmeshes, instances, true);
+    groupInstances(transparentSubmeshes, instances, false);
+}
+
+void GltfDrawContext::append(GltfDrawContext& batch) {
+
+    // a mesh streams in whole with every node that uses it, so a batch already holds all instances of what it groups
+    auto take = [&](std::vector<RenderObject>& dst, std::vector<RenderObject>& src, bool merge) {
+
+        groupInstances(src, instances, merge);
+        dst.insert(dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+        src.clear();
+    };
+
+    take(opaqueSubmeshes, batch.opaqueSubmeshes, true);
+    take(transmissionSubmeshes, batch.transmissionSubmeshes, true);
+    take(transparentSubmeshes, batch.transparentSubmeshes, false);
+    isTransmissionEnabled = isTransmissionEnabled || batch.isTransmissionEnabled;
 }
 
 GLenum extract_filter(fastgltf::Filter f) {
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "glEng/program_cache.h"
+
+// same entry point for both the KHR and ARB flavour of parallel_shader_compile
+typedef void (APIENTRY* MaxShaderCompilerThreadsFn)(GLuint count);
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) {
+
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint64_t fnv1a(const std::string& s, uint64_t hash = 0xcbf29ce484222325ull) {
+
+	// the terminator goes in too so "ab" + "c" and "a" + "bc" don't collide
+	return fnv1a(s.c_str(), s.size() + 1, hash);
+}
+
+static bool hasExtension(const char* name) {
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+
+		const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (ext && std::strcmp(ext, name) == 0) return true;
+	}
+	return false;
+}
+
+void ProgramCache::init(std::filesystem::path dir) {
+
+	_dir = std::move(dir);
+	std::error_code ec;
+	std::filesystem::create_directories(_dir, ec);
+
+	_driver = std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + "|" +
+		reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	// some drivers advertise get_program_binary with zero formats, nothing could ever be stored then
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	_binaries = formats > 0;
+
+	MaxShaderCompilerThreadsFn maxThreads = nullptr;
+	if (hasExtension("GL_KHR_parallel_shader_compile")) {
+
+		maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+	}
+	else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+
+		maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+	}
+	if (maxThreads) {
+
+		maxThreads(0xFFFFFFFFu); // driver's choice
+		_parallel = true;
+	}
+
+	std::cout << "program cache: binaries " << (_binaries ? "on" : "off") << ", parallel compile " << (_parallel ? "on" : "off") << std::endl;
+}
+
+ProgramCache::Pending ProgramCache::begin(std::string vsSource, std::string fsSource) {
+
+	Pending pending;
+	pending.vsSource = std::move(vsSource);
+	pending.fsSource = std::move(fsSource);
+
+	uint64_t hash = fnv1a(&VERSION, sizeof(VERSION));
+	hash = fnv1a(_driver, hash);
+	hash = fnv1a(pending.vsSource, hash);
+	pending.key = fnv1a(pending.fsSource, hash);
+
+	if (_binaries && loadBinary(pending)) return pending;
+
+	compileFromSource(pending);
+	return pending;
+}
+
+GLuint ProgramCache::finish(Pending& pending) {
+
+	if (pending.fromBinary) {
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+		if (linked) {
+
+			pending.vsSource.clear();
+			pending.fsSource.clear();
+			return pending.program;
+		}
+
+		// a binary can still be turned down after the header checks (driver settings, etc). the same program object
+		// gets relinked from source so its name stays valid for whoever already holds it, and the entry is overwritten
+		std::cout << "program binary rejected, relinking from source: " << entryPath(pending.key) << std::endl;
+		pending.fromBinary = false;
+		compileFromSource(pending);
+	}
+
+	GLuint program = linkFromSource(pending);
+	if (_binaries) storeBinary(pending);
+
+	pending.vsSource.clear();
+	pending.fsSource.clear();
+	return program;
+}
+
+void ProgramCache::compileFromSource(Pending& pending) {
+
+	// no status checks here, asking would make the driver finish right away. linkFromSource does them
+	auto compile = [](GLenum type, const std::string& src) {
+
+		GLuint shader = glCreateShader(type);
+		const char* csrc = src.c_str();
+		glShaderSource(shader, 1, &csrc, nullptr);
+		glCompileShader(shader);
+		return shader;
+	};
+	pending.vs = compile(GL_VERTEX_SHADER, pending.vsSource);
+	pending.fs = compile(GL_FRAGMENT_SHADER, pending.fsSource);
+
+	if (!pending.program) pending.program = glCreateProgram();
+	glAttachShader(pending.program, pending.vs);
+	glAttachShader(pending.program, pending.fs);
+	if (_binaries) glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.program);
+}
+
+GLuint ProgramCache::linkFromSource(Pending& pending) {
+
+	auto release = [&]() {
+
+		glDeleteShader(pending.vs);
+		glDeleteShader(pending.fs);
+		pending.vs = pending.fs = 0;
+	};
+
+	for (GLuint shader : { pending.vs, pending.fs }) {
+
+		GLint success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (success) continue;
+
+		GLint logLen = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
+		std::string log(logLen, '\0');
+		glGetShaderInfoLog(shader, logLen, nullptr, log.data());
+		std::cerr << "Shader compilation failed: " << log << std::endl;
+		release();
+		glDeleteProgram(pending.program);
+		throw std::runtime_error("Shader compile error");
+	}
+
+	GLint success = 0;
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+	if (!success) {
+
+		GLint logLen = 0;
+		glGetProgramiv(pending.program, GL_INFO_LOG_LENGTH, &logLen);
+		std::string log(logLen, '\0');
+		glGetProgramInfoLog(pending.program, logLen, nullptr, log.data());
+		std::cerr << "Program linking failed: " << log << std::endl;
+		release();
+		glDeleteProgram(pending.program);
+		throw std::runtime_error("Shader link error");
+	}
+
+	glDetachShader(pending.program, pending.vs);
+	glDetachShader(pending.program, pending.fs);
+	release();
+	return pending.program;
+}
+
+std::filesystem::path ProgramCache::entryPath(uint64_t key) const {
+
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+	return _dir / name.str();
+}
+
+bool ProgramCache::loadBinary(Pending& pending) {
+
+	std::ifstream in(entryPath(pending.key), std::ios::binary);
+	if (!in.is_open()) return false;
+
+	FileHeader header{};
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || header.magic != MAGIC || header.version != VERSION || header.size == 0) return false;
+
+	std::vector<uint8_t> data(header.size);
+	in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (!in || fnv1a(data.data(), data.size()) != header.hash) return false;
+
+	pending.program = glCreateProgram();
+	glProgramBinary(pending.program, header.format, data.data(), static_cast<GLsizei>(data.size()));
+	pending.fromBinary = true;
+	return true;
+}
+
+void ProgramCache::storeBinary(const Pending& pending) {
+
+	GLint length = 0;
+	glGetProgramiv(pending.program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<uint8_t> data(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	glGetProgramBinary(pending.program, length, &written, &format, data.data());
+	if (written <= 0) return;
+	data.resize(written);
+
+	FileHeader header{ MAGIC, VERSION, format, static_cast<uint32_t>(data.size()), fnv1a(data.data(), data.size()) };
+
+	// temp + rename like the other caches, a half written entry never loads
+	std::filesystem::path path = entryPath(pending.key);
+	std::filesystem::path tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+
+			std::cerr << "failed to open program cache entry for writing: " << tmpPath << std::endl;
+			return;
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!out) return;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+}
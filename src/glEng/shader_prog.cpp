@@ -1,66 +1,100 @@
 #include "pch.h"
 #include "glEng/shader_prog.h"
+#include "glEng/gl_state.h"
 
-GLuint ShaderProgram::makeShaderProgram(const char* vsPath, const char* fsPath) {
+static std::string injectDefines(const std::string& src, const std::vector<std::string>& defines) {
 
-	std::string vsSource = loadFile(vsPath);
-	std::string fsSource = loadFile(fsPath);
+	if (defines.empty()) return src;
 
-	GLuint vs = compileShader(GL_VERTEX_SHADER, vsSource);
-	GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsSource);
-	GLuint prog = linkProgram(vs, fs);
+	std::string block;
+	for (auto& d : defines) block += "#define " + d + "\n";
 
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+	// #version has to stay the first line so the defines go right under it
+	size_t version = src.find("#version");
+	size_t lineEnd = (version == std::string::npos) ? std::string::npos : src.find('\n', version);
+	if (lineEnd == std::string::npos) return block + src;
+
+	std::string out = src;
+	out.insert(lineEnd + 1, block);
+	return out;
+}
+
+GLuint ShaderProgram::makeShaderProgram(const char* vsPath, const char* fsPath, const std::vector<std::string>& defines) {
 
 	_vsPath = vsPath;
 	_fsPath = fsPath;
-	_programID = prog;
-	return prog;
+	return makeShaderProgramFromSource(injectDefines(loadFile(vsPath), defines), injectDefines(loadFile(fsPath), defines));
+}
+
+GLuint ShaderProgram::makeShaderProgramFromSource(std::string vsSource, std::string fsSource) {
+
+	ProgramCache& cache = ProgramCache::Get();
+	_pending = cache.begin(std::move(vsSource), std::move(fsSource));
+	_programID = _pending.program;
+
+	// without parallel compile there's nothing to overlap, errors show up here like they used to
+	if (!cache.parallelCompile()) id();
+	return _programID;
 }
 
-GLuint ShaderProgram::compileShader(GLenum type, const std::string& src) {
+GLuint ShaderProgram::id() const {
 
-	GLuint shader = glCreateShader(type);
-	const char* csrc = src.c_str();
-	glShaderSource(shader, 1, &csrc, nullptr);
-	glCompileShader(shader);
+	if (_pending.program) {
 
-	GLint success = 0;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
+		ProgramCache::Get().finish(_pending);
+		_pending = ProgramCache::Pending{};
+		reflect();
+	}
+	return _programID;
+}
+
+static bool isSampler(GLenum type) {
+
+	switch (type) {
 
-		GLint logLen = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
-		std::string log(logLen, '\0');
-		glGetShaderInfoLog(shader, logLen, nullptr, log.data());
-		std::cerr << "Shader compilation failed: " << log << std::endl;
-		glDeleteShader(shader);
-		throw std::runtime_error("Shader compile error");
+	case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_3D:
+		return true;
+	default:
+		return false;
 	}
-	return shader;
 }
 
-GLuint ShaderProgram::linkProgram(GLuint vs, GLuint fs) {
+void ShaderProgram::reflect() const {
+
+	_locations.clear();
+	_textureUnits.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(_programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(_programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::string name(std::max(maxLength, 1), '\0');
+	int nextUnit = 0;
+	for (GLint i = 0; i < count; i++) {
 
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vs);
-	glAttachShader(program, fs);
-	glLinkProgram(program);
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(_programID, i, maxLength, &length, &size, &type, name.data());
+		std::string uniform(name.data(), length);
 
-	GLint success = 0;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (!success) {
+		// block members show up too but have no location
+		GLint loc = glGetUniformLocation(_programID, uniform.c_str());
+		if (loc == -1) continue;
 
-		GLint logLen = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLen);
-		std::string log(logLen, '\0');
-		glGetProgramInfoLog(program, logLen, nullptr, log.data());
-		std::cerr << "Program linking failed: " << log << std::endl;
-		glDeleteProgram(program);
-		throw std::runtime_error("Shader link error");
+		// arrays come back as "name[0]", callers use the bare name
+		if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) uniform.resize(uniform.size() - 3);
+		_locations[uniform] = loc;
+
+		if (isSampler(type)) {
+
+			_textureUnits[uniform] = nextUnit;
+			glProgramUniform1i(_programID, loc, nextUnit++);
+		}
 	}
-	return program;
 }
 
 std::string loadFile(const char* path) {
@@ -74,86 +108,77 @@ std::string loadFile(const char* path) {
 }
 
 
-// gets uniform address from uniformName, then binds a texture to active slot, then binds sampler, then lastly binds the unit to the loc
-const void ShaderProgram::setTexture(const std::string& uniformName, GLuint texture, GLint sampler, GLuint texFormat) {
-
-	glUseProgram(this->getID());
-
-	if (_textureUnits.count(uniformName) == 0) {
-
-		_textureUnits[uniformName] = _nextTexUnit++;
-	}
-	int unit = _textureUnits[uniformName];
-
-	GLint loc = glGetUniformLocation(this->getID(), uniformName.c_str());
-
-	if (loc == -1) { 
+// unit was fixed at link, so this is just the texture + sampler on it
+void ShaderProgram::setTexture(const std::string& uniformName, GLuint texture, GLint sampler) {
 
-		//std::cerr << "Warning:: uniform " << uniformName << "not found in shader :(" << std::endl; 
-		return;
-	}
+	bindTextureUnit(textureUnit(uniformName), texture, sampler);
+}
 
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(texFormat, texture);
+void ShaderProgram::bindTextureUnit(int unit, GLuint texture, GLint sampler) {
 
-	if (sampler != -1) { 
+	if (unit < 0) return;
 
-		glBindSampler(unit, sampler); 
-	}
-	else { 
+	GLState& state = GLState::Get();
+	state.bindTexture(unit, texture);
+	// -1 = the default linear sampler (first sampler object made), 0 = texture's own parameters
+	state.bindSampler(unit, sampler != -1 ? GLuint(sampler) : 1);
+}
 
-		glBindSampler(unit, 1); 
-	}
+int ShaderProgram::textureUnit(const std::string& uniformName) const {
 
-	glUniform1i(loc, unit);
+	id();
+	auto it = _textureUnits.find(uniformName);
+	return it == _textureUnits.end() ? -1 : it->second;
 }
 
 void ShaderProgram::useProg() {
 
-	glUseProgram(_programID);
+	GLState::Get().useProgram(id());
 }
 
-GLuint ShaderProgram::getUniformAddress(const std::string& uniformName) {
+GLint ShaderProgram::getUniformAddress(const std::string& uniformName) const {
 
-	return glGetUniformLocation(_programID, uniformName.c_str());
+	id();
+	auto it = _locations.find(uniformName);
+	return it == _locations.end() ? -1 : it->second;
 }
 
 void ShaderProgram::setInt(const std::string& name, int value) const {
 
-	GLint loc = glGetUniformLocation(_programID, name.c_str());
+	GLint loc = getUniformAddress(name);
 	if (loc == -1) {
 		std::cerr << "Warning: uniform '" << name << "' not found in shader.\n";
 	}
-	glUniform1i(loc, value);
+	glProgramUniform1i(_programID, loc, value);
 }
 
 void ShaderProgram::setMat4(const std::string& name, const glm::mat4& mat) const {
 
-	GLint loc = glGetUniformLocation(_programID, name.c_str());
+	GLint loc = getUniformAddress(name);
 	if (loc == -1) {
 		std::cerr << "Warning: uniform '" << name << "' not found in shader.\n";
 	}
-	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
+	glProgramUniformMatrix4fv(_programID, loc, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void ShaderProgram::setFloat(const std::string& name, float value) const {
 
-	GLint loc = glGetUniformLocation(_programID, name.c_str());
+	GLint loc = getUniformAddress(name);
 	if (loc == -1) {
 		std::cerr << "[ShaderProgram] Warning: uniform '" << name << "' not found.\n";
 		return;
 	}
-	glUniform1f(loc, value);
+	glProgramUniform1f(_programID, loc, value);
 }
 
 void ShaderProgram::setVec3(const std::string& name, const glm::vec3& value) const {
 
-	GLint loc = glGetUniformLocation(_programID, name.c_str());
+	GLint loc = getUniformAddress(name);
 	if (loc == -1) {
 		std::cerr << "[ShaderProgram] Warning: uniform '" << name << "' not found.\n";
 		return;
 	}
-	glUniform3fv(loc, 1, glm::value_ptr(value));
+	glProgramUniform3fv(_programID, loc, 1, glm::value_ptr(value));
 }
 
 
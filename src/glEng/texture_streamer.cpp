@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "glEng/texture_streamer.h"
+#include "glEng/gltf_loader.h"
+
+GLTextureFormat glTextureFormat(TextureCompress::Format format) {
+
+	switch (format) {
+
+	case TextureCompress::BC1: return { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT };
+	case TextureCompress::BC4: return { GL_COMPRESSED_RED_RGTC1, 0 };
+	case TextureCompress::BC5: return { GL_COMPRESSED_RG_RGTC2, 0 };
+	case TextureCompress::BC7: return { GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM };
+	default: return { GL_RGBA8, GL_SRGB8_ALPHA8 };
+	}
+}
+
+void setFormatSwizzle(GLuint texture, TextureCompress::Format format) {
+
+	if (format != TextureCompress::BC4) return;
+
+	GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+	glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+uint32_t TextureStreamer::add(std::shared_ptr<const void> owner, const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompress::Format format) {
+
+	uint32_t index = uint32_t(_textures.size());
+	_textures.push_back(TextureStreaming::makeTexture(width, height, format, settings));
+
+	Source src{ std::move(owner), pixels };
+	size_t offset = 0;
+	for (uint32_t level = 0; level < _textures.back().mipCount; level++) {
+
+		src.levelOffsets.push_back(offset);
+		offset += TextureCompress::levelSize(format, width >> level, height >> level);
+	}
+	_sources.push_back(std::move(src));
+	_images.push_back({});
+	_users.emplace_back();
+
+	// nothing on the gpu yet so every level comes from the cpu chain
+	reallocate(index, _textures.back().coarseBase);
+	return index;
+}
+
+void TextureStreamer::addUser(uint32_t texture, std::shared_ptr<gltfMaterial> material, GLTexture* slot, bool srgb) {
+
+	const GLImage& img = _images[texture];
+	slot->image = img;
+	slot->image.id = srgb ? img.sRGBID : img.linearID;
+
+	std::vector<uint32_t>& used = _materialTextures[material.get()];
+	if (std::find(used.begin(), used.end(), texture) == used.end()) used.push_back(texture);
+	_users[texture].push_back({ std::move(material), slot, srgb });
+}
+
+static bool sphereVisible(const MeshUtils::Frustum& frustum, const glm::vec3& center, float radius) {
+
+	for (const auto& p : frustum.planes) {
+
+		if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+	}
+	return true;
+}
+
+void TextureStreamer::update(const GltfDrawContext& ctx, const glm::mat4& viewProj, const glm::vec3& cameraPos, float lodScale) {
+
+	// no camera yet, everything would ask for level 0
+	if (_textures.empty() || lodScale <= 0.0f) return;
+
+	TextureStreaming::beginFrame(_textures);
+	MeshUtils::Frustum frustum = MeshUtils::extractFrustum(viewProj);
+
+	auto requestAll = [&](const std::vector<RenderObject>& objects) {
+
+		for (const auto& obj : objects) {
+
+			auto used = _materialTextures.find(obj.material.get());
+			if (!obj.detail || used == _materialTextures.end()) continue;
+
+			for (uint32_t i = 0; i < obj.instanceCount; i++) {
+
+				const glm::mat4& model = ctx.instances[obj.firstInstance + i].model;
+				glm::mat3 linear(model);
+				float maxScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+				if (!sphereVisible(frustum, glm::vec3(model * glm::vec4(obj.detail->center, 1.0f)), obj.detail->radius * maxScale)) continue;
+
+				for (uint32_t t : used->second) {
+
+					TextureStreaming::Texture& tex = _textures[t];
+					float mip = TextureStreaming::requiredMip(*obj.detail, model, cameraPos, lodScale, std::max(tex.width, tex.height));
+					TextureStreaming::request(tex, mip, settings);
+				}
+			}
+		}
+	};
+	requestAll(ctx.opaqueSubmeshes);
+	requestAll(ctx.transmissionSubmeshes);
+	requestAll(ctx.transparentSubmeshes);
+
+	for (const auto& change : TextureStreaming::plan(_textures, settings, _stats)) reallocate(change.texture, change.base);
+}
+
+void TextureStreamer::reallocate(uint32_t texture, uint32_t base) {
+
+	TextureStreaming::Texture& tex = _textures[texture];
+	const Source& src = _sources[texture];
+	GLImage& img = _images[texture];
+
+	GLsizei width = GLsizei(std::max(1u, tex.width >> base));
+	GLsizei height = GLsizei(std::max(1u, tex.height >> base));
+	GLsizei levels = GLsizei(tex.mipCount - base);
+
+	// immutable storage so the srgb view can alias it
+	GLTextureFormat format = glTextureFormat(tex.format);
+	GLuint id;
+	glCreateTextures(GL_TEXTURE_2D, 1, &id);
+	glTextureStorage2D(id, levels, format.linear, width, height);
+	setFormatSwizzle(id, tex.format);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (uint32_t level = base; level < tex.mipCount; level++) {
+
+		GLsizei w = GLsizei(std::max(1u, tex.width >> level));
+		GLsizei h = GLsizei(std::max(1u, tex.height >> level));
+
+		// already resident, gpu to gpu. only levels finer than the old base cross the bus
+		if (img.linearID && level >= tex.residentBase) {
+
+			glCopyImageSubData(img.linearID, GL_TEXTURE_2D, GLint(level - tex.residentBase), 0, 0, 0,
+				id, GL_TEXTURE_2D, GLint(level - base), 0, 0, 0, w, h, 1);
+		}
+		else if (TextureCompress::isCompressed(tex.format)) {
+
+			GLsizei size = GLsizei(TextureCompress::levelSize(tex.format, uint32_t(w), uint32_t(h)));
+			glCompressedTextureSubImage2D(id, GLint(level - base), 0, 0, w, h, format.linear, size, src.pixels + src.levelOffsets[level]);
+		}
+		else {
+
+			glTextureSubImage2D(id, GLint(level - base), 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, src.pixels + src.levelOffsets[level]);
+		}
+	}
+
+	// views need a name that was never bound, so glGenTextures rather than glCreateTextures
+	GLuint view = id;
+	if (format.srgb) {
+
+		glGenTextures(1, &view);
+		glTextureView(view, GL_TEXTURE_2D, id, format.srgb, 0, GLuint(levels), 0, 1);
+	}
+
+	if (img.linearID) {
+
+		if (img.sRGBID != img.linearID) glDeleteTextures(1, &img.sRGBID);
+		glDeleteTextures(1, &img.linearID);
+	}
+	img = GLImage{ id, width, height, GL_RGBA, id, view };
+	tex.residentBase = base;
+
+	// gl materials read their textures at bind time, patching the slots is the whole swap
+	for (auto& user : _users[texture]) {
+
+		user.slot->image = img;
+		user.slot->image.id = user.srgb ? img.sRGBID : img.linearID;
+	}
+}
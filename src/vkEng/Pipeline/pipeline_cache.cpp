@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "vkEng/Pipeline/pipeline_cache.h"
+#include "Core/Utils/thread_pool.h"
+
+ShaderModules::~ShaderModules() {
+
+    vkDestroyShaderModule(device, frag, nullptr);
+    vkDestroyShaderModule(device, vert, nullptr);
+}
+
+static uint64_t fnv1a(const uint8_t* data, size_t size) {
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physicalDevice, std::filesystem::path path) {
+
+    _device = device;
+    _path = std::move(path);
+    vkGetPhysicalDeviceProperties(physicalDevice, &_props);
+
+    std::vector<uint8_t> data = loadValidated();
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    Logger::vkCheck(vkCreatePipelineCache(device, &cacheInfo, nullptr, &_cache), "failed to create pipeline cache");
+}
+
+void PipelineCache::cleanup() {
+
+    waitIdle();
+    save();
+    vkDestroyPipelineCache(_device, _cache, nullptr);
+    _cache = VK_NULL_HANDLE;
+}
+
+PipelineCache::FileHeader PipelineCache::expectedHeader() const {
+
+    FileHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.vendorID = _props.vendorID;
+    header.deviceID = _props.deviceID;
+    header.driverVersion = _props.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, _props.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+std::vector<uint8_t> PipelineCache::loadValidated() {
+
+    std::ifstream in(_path, std::ios::binary);
+    if (!in.is_open()) return {};
+
+    FileHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in) return {};
+
+    FileHeader expected = expectedHeader();
+    bool sameDevice = header.magic == expected.magic && header.version == expected.version &&
+        header.vendorID == expected.vendorID && header.deviceID == expected.deviceID && header.driverVersion == expected.driverVersion &&
+        std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if (!sameDevice) {
+
+        std::cout << "pipeline cache is from another device/driver, starting fresh: " << _path << std::endl;
+        return {};
+    }
+
+    std::vector<uint8_t> data(header.dataSize);
+    in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!in || fnv1a(data.data(), data.size()) != header.dataHash) {
+
+        std::cout << "pipeline cache is truncated or corrupt, starting fresh: " << _path << std::endl;
+        return {};
+    }
+
+    // the driver's own header has to agree too (VkPipelineCacheHeaderVersionOne), it's what it would check itself
+    VkPipelineCacheHeaderVersionOne driverHeader{};
+    if (data.size() < sizeof(driverHeader)) return {};
+    std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+    if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || driverHeader.vendorID != _props.vendorID ||
+        driverHeader.deviceID != _props.deviceID || std::memcmp(driverHeader.pipelineCacheUUID, _props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+
+        return {};
+    }
+    return data;
+}
+
+bool PipelineCache::save() {
+
+    size_t size = 0;
+    Logger::vkCheck(vkGetPipelineCacheData(_device, _cache, &size, nullptr), "failed to size pipeline cache");
+    std::vector<uint8_t> data(size);
+    Logger::vkCheck(vkGetPipelineCacheData(_device, _cache, &size, data.data()), "failed to read pipeline cache");
+    data.resize(size);
+
+    FileHeader header = expectedHeader();
+    header.dataSize = data.size();
+    header.dataHash = fnv1a(data.data(), data.size());
+
+    // same temp + rename as the scene cache, a crash mid write never leaves a file that validates
+    std::error_code ec;
+    if (_path.has_parent_path()) std::filesystem::create_directories(_path.parent_path(), ec);
+
+    std::filesystem::path tmpPath = _path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+
+            std::cerr << "failed to open pipeline cache for writing: " << tmpPath << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) return false;
+    }
+    std::filesystem::rename(tmpPath, _path, ec);
+    if (ec) return false;
+
+    _dirty = false;
+    return true;
+}
+
+VkPipeline PipelineCache::build(const GraphicsPipelineDesc& desc) {
+
+    // everything below points into desc, which outlives the call
+    VkSpecializationMapEntry packedEntry{ 0, 0, sizeof(VkBool32) };
+    VkSpecializationInfo vertSpecialization{};
+    vertSpecialization.mapEntryCount = 1;
+    vertSpecialization.pMapEntries = &packedEntry;
+    vertSpecialization.dataSize = sizeof(VkBool32);
+    vertSpecialization.pData = &desc.packedVertex;
+
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = desc.shaders->vert;
+    stages[0].pName = "main";
+    stages[0].pSpecializationInfo = &vertSpecialization;
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = desc.shaders->frag;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+    vertexInput.pVertexBindingDescriptions = desc.bindings.data();
+    vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+    vertexInput.pVertexAttributeDescriptions = desc.attributes.data();
+
+    // viewport/scissor are dynamic
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &desc.blendAttachment;
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(desc.dynamicStates.size());
+    dynamicState.pDynamicStates = desc.dynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = 2;
+    info.pStages = stages;
+    info.pVertexInputState = &vertexInput;
+    info.pInputAssemblyState = &desc.inputAssembly;
+    info.pViewportState = &viewportState;
+    info.pRasterizationState = &desc.rasterizer;
+    info.pMultisampleState = &desc.multisampling;
+    info.pDepthStencilState = &desc.depthStencil;
+    info.pColorBlendState = &colorBlending;
+    info.pDynamicState = &dynamicState;
+    info.layout = desc.layout;
+    info.renderPass = desc.renderPass;
+    info.subpass = desc.subpass;
+    info.basePipelineHandle = VK_NULL_HANDLE;
+    info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    Logger::vkCheck(vkCreateGraphicsPipelines(_device, _cache, 1, &info, nullptr, &pipeline), "failed to create graphics pipeline");
+    _dirty = true;
+    return pipeline;
+}
+
+void PipelineCache::buildAsync(GraphicsPipelineDesc desc, std::atomic<VkPipeline>& out) {
+
+    out.store(VK_NULL_HANDLE);
+    _pending.push_back(Utils::Jobs::get().submit([this, desc = std::move(desc), &out]() {
+
+        out.store(build(desc));
+    }));
+}
+
+void PipelineCache::retire() {
+
+    if (_pending.empty()) return;
+
+    for (size_t i = 0; i < _pending.size();) {
+
+        if (_pending[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+
+            i++;
+            continue;
+        }
+        std::future<void> done = std::move(_pending[i]);
+        _pending.erase(_pending.begin() + i);
+        done.get();
+    }
+
+    // everything queued so far is in, worth keeping for the next launch
+    if (_pending.empty() && _dirty) save();
+}
+
+void PipelineCache::waitIdle() {
+
+    std::vector<std::future<void>> pending = std::move(_pending);
+    _pending.clear();
+    for (auto& build : pending) build.wait();
+    for (auto& build : pending) build.get();
+}
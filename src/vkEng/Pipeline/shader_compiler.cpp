@@ -0,0 +1,228 @@
+#include "pch.h"
+#include "vkEng/Pipeline/shader_compiler.h"
+#include "Core/Utils/thread_pool.h"
+#include <shaderc/shaderc.hpp>
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a(const std::string& s, uint64_t hash = 0xcbf29ce484222325ull) {
+
+    return fnv1a(s.data(), s.size(), hash);
+}
+
+static bool readText(const std::filesystem::path& path, std::string& out) {
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+static shaderc_shader_kind stageKind(const std::filesystem::path& path) {
+
+    std::string ext = path.extension().string();
+    if (ext == ".vert") return shaderc_vertex_shader;
+    if (ext == ".frag") return shaderc_fragment_shader;
+    if (ext == ".comp") return shaderc_compute_shader;
+    if (ext == ".geom") return shaderc_geometry_shader;
+    if (ext == ".tesc") return shaderc_tess_control_shader;
+    if (ext == ".tese") return shaderc_tess_evaluation_shader;
+    throw std::runtime_error("unknown shader stage for " + path.string());
+}
+
+// resolves #include and writes down every file it hands to the compiler, that list goes into the cache entry
+class ShaderCompiler::Includer : public shaderc::CompileOptions::IncluderInterface {
+
+public:
+
+    Includer(const std::filesystem::path& includeDir, std::vector<Dependency>& deps) : _includeDir(includeDir), _deps(deps) {}
+
+    shaderc_include_result* GetInclude(const char* requested, shaderc_include_type type, const char* requesting, size_t) override {
+
+        auto* include = new Include();
+
+        std::vector<std::filesystem::path> candidates;
+        if (type == shaderc_include_type_relative) candidates.push_back(std::filesystem::path(requesting).parent_path() / requested);
+        candidates.push_back(_includeDir / requested);
+
+        for (const auto& candidate : candidates) {
+
+            if (!readText(candidate, include->content)) continue;
+
+            include->name = candidate.lexically_normal().generic_string();
+            bool seen = std::any_of(_deps.begin(), _deps.end(), [&](const Dependency& d) { return d.path == include->name; });
+            if (!seen) _deps.push_back({ include->name, fnv1a(include->content) });
+            break;
+        }
+
+        // empty name is how shaderc is told it failed, content is the message then
+        if (include->name.empty()) include->content = std::string("can't find include ") + requested;
+
+        include->result = { include->name.c_str(), include->name.size(), include->content.c_str(), include->content.size(), include };
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* data) override {
+
+        delete static_cast<Include*>(data->user_data);
+    }
+
+private:
+
+    struct Include {
+
+        std::string name;
+        std::string content;
+        shaderc_include_result result{};
+    };
+
+    std::filesystem::path _includeDir;
+    std::vector<Dependency>& _deps;
+};
+
+void ShaderCompiler::init(std::filesystem::path cacheDir, std::filesystem::path includeDir) {
+
+    _cacheDir = std::move(cacheDir);
+    _includeDir = std::move(includeDir);
+
+    std::error_code ec;
+    std::filesystem::create_directories(_cacheDir, ec);
+}
+
+std::vector<std::vector<uint32_t>> ShaderCompiler::compile(const std::vector<Source>& sources) const {
+
+    std::vector<std::vector<uint32_t>> modules(sources.size());
+    Utils::Jobs::get().parallelFor(sources.size(), [&](size_t i) { modules[i] = compile(sources[i]); });
+    return modules;
+}
+
+std::vector<uint32_t> ShaderCompiler::compile(const Source& source) const {
+
+    std::string text;
+    if (!readText(source.path, text)) throw std::runtime_error("failed to open shader " + source.path.string());
+
+    uint64_t key = cacheKey(source, text);
+    std::vector<uint32_t> spirv;
+    if (loadCached(key, spirv)) return spirv;
+
+    std::vector<Dependency> deps;
+
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    for (const auto& [name, value] : source.defines) options.AddMacroDefinition(name, value);
+    options.SetIncluder(std::make_unique<Includer>(_includeDir, deps));
+
+    // a compiler per call, nothing is shared between the stages compiling next to each other
+    shaderc::Compiler compiler;
+    std::string name = source.path.generic_string();
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(text, stageKind(source.path), name.c_str(), options);
+
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+
+        throw std::runtime_error("failed to compile " + name + ":\n" + result.GetErrorMessage());
+    }
+    if (result.GetNumWarnings() > 0) std::cout << result.GetErrorMessage();
+
+    spirv.assign(result.cbegin(), result.cend());
+    storeCached(key, deps, spirv);
+
+    std::cout << "compiled " << name << std::endl;
+    return spirv;
+}
+
+uint64_t ShaderCompiler::cacheKey(const Source& source, const std::string& text) const {
+
+    // bump VERSION when the options above change, old entries then just stop matching
+    uint64_t hash = fnv1a(&VERSION, sizeof(VERSION));
+    hash = fnv1a(source.path.lexically_normal().generic_string(), hash);
+    hash = fnv1a(text, hash);
+    for (const auto& [name, value] : source.defines) {
+
+        hash = fnv1a(name + "=" + value + "\n", hash);
+    }
+    return hash;
+}
+
+std::filesystem::path ShaderCompiler::entryPath(uint64_t key) const {
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+    return _cacheDir / name.str();
+}
+
+bool ShaderCompiler::loadCached(uint64_t key, std::vector<uint32_t>& spirv) const {
+
+    std::ifstream in(entryPath(key), std::ios::binary);
+    if (!in.is_open()) return false;
+
+    uint32_t header[4]{}; // magic, version, dependency count, word count
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || header[0] != MAGIC || header[1] != VERSION) return false;
+
+    // any include that changed since (or went missing) means a recompile
+    for (uint32_t i = 0; i < header[2]; i++) {
+
+        uint32_t length = 0;
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        std::string path(length, '\0');
+        in.read(path.data(), length);
+        uint64_t hash = 0;
+        in.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+        if (!in) return false;
+
+        std::string text;
+        if (!readText(path, text) || fnv1a(text) != hash) return false;
+    }
+
+    spirv.resize(header[3]);
+    in.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+    if (!in || spirv.empty() || spirv[0] != 0x07230203) {
+
+        spirv.clear();
+        return false;
+    }
+    return true;
+}
+
+void ShaderCompiler::storeCached(uint64_t key, const std::vector<Dependency>& deps, const std::vector<uint32_t>& spirv) const {
+
+    // same temp + rename as the pipeline cache, each stage writes its own entry so parallel stores don't collide
+    std::filesystem::path path = entryPath(key);
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+
+            std::cerr << "failed to open spirv cache entry for writing: " << tmpPath << std::endl;
+            return;
+        }
+
+        uint32_t header[4] = { MAGIC, VERSION, static_cast<uint32_t>(deps.size()), static_cast<uint32_t>(spirv.size()) };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto& dep : deps) {
+
+            uint32_t length = static_cast<uint32_t>(dep.path.size());
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(dep.path.data(), length);
+            out.write(reinterpret_cast<const char*>(&dep.hash), sizeof(dep.hash));
+        }
+        out.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+        if (!out) return;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+}
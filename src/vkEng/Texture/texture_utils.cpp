@@ -1,6 +1,30 @@
 #include "pch.h"
 #include "vkEng/vk_engine_setup.h"
 
+VkFormat vkTextureFormat(TextureCompress::Format format) {
+
+    switch (format) {
+
+    case TextureCompress::BC1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case TextureCompress::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case TextureCompress::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case TextureCompress::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+    default: return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+TextureCompress::Format textureCompressFormat(VkFormat format) {
+
+    switch (format) {
+
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return TextureCompress::BC1;
+    case VK_FORMAT_BC4_UNORM_BLOCK: return TextureCompress::BC4;
+    case VK_FORMAT_BC5_UNORM_BLOCK: return TextureCompress::BC5;
+    case VK_FORMAT_BC7_UNORM_BLOCK: return TextureCompress::BC7;
+    default: return TextureCompress::RGBA8;
+    }
+}
+
 // fix later
 VkImageCreateInfo VkEngine::createImageInfo(ImageCreateInfoProperties& properties) {
 
@@ -196,37 +220,29 @@ AllocatedImage VkEngine::createImage(VkExtent3D extent, VkFormat format, VkImage
     viewInfo.subresourceRange.aspectMask = aspectFlag;
     viewInfo.subresourceRange.levelCount = info.mipLevels;
 
+    // bc4 is a lone red channel, read it back as (r, r, r, 1) so every slot sees the value whichever channel it samples
+    if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+
+        viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+    }
+
     vkCreateImageView(device, &viewInfo, nullptr, &newImage.imageView);
     return newImage;
 
 }
 
-// fix this for error thing
+// pixels are staged into the upload batcher and the copy (+ mip blits) recorded into its open batch, no waiting here
 AllocatedImage VkEngine::createImage(void* data, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, bool mipmapped) {
 
     size_t data_size = extent.depth * extent.width * extent.height * 4;
-    AllocatedBuffer uploadbuffer = createBufferVMA(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, _allocator);
-
-    memcpy(uploadbuffer.info.pMappedData, data, data_size);
-
     AllocatedImage newImage = createImage(extent, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipmapped);
 
-    vkResetFences(device, 1, &immFence);
-    vkResetCommandBuffer(immCommandBuffer, 0);
-    VkCommandBuffer cmd = immCommandBuffer;
-
-    VkCommandBufferBeginInfo cmdInfo = {};
-    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdInfo.pNext = nullptr;
-
-    cmdInfo.pInheritanceInfo = nullptr;
-    cmdInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(cmd, &cmdInfo);
+    UploadBatcher::Staging staging = uploader.stage(data, data_size);
+    VkCommandBuffer cmd = uploader.commands();
 
     transitionImage(cmd, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     VkBufferImageCopy copyRegion = {};
-    copyRegion.bufferOffset = 0;
+    copyRegion.bufferOffset = staging.offset;
     copyRegion.bufferRowLength = 0;
     copyRegion.bufferImageHeight = 0;
 
@@ -237,7 +253,7 @@ AllocatedImage VkEngine::createImage(void* data, VkExtent3D extent, VkFormat for
     copyRegion.imageExtent = extent;
 
     // copy the buffer into the image
-    vkCmdCopyBufferToImage(cmd, uploadbuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+    vkCmdCopyBufferToImage(cmd, staging.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
         &copyRegion);
 
     if (mipmapped) {
@@ -246,36 +262,40 @@ AllocatedImage VkEngine::createImage(void* data, VkExtent3D extent, VkFormat for
     else {
         transitionImage(cmd, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     }
-    vkEndCommandBuffer(cmd);
-
-    VkCommandBufferSubmitInfo cmdInfoSubmit{};
-    cmdInfoSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-    cmdInfoSubmit.pNext = nullptr;
-    cmdInfoSubmit.commandBuffer = cmd;
-    cmdInfoSubmit.deviceMask = 0;
-
-    VkSubmitInfo2 info2 = {};
-    info2.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    info2.pNext = nullptr;
-
-    info2.waitSemaphoreInfoCount = 0;
-    info2.pWaitSemaphoreInfos = nullptr;
-
-    info2.signalSemaphoreInfoCount = 0;
-    info2.pSignalSemaphoreInfos = nullptr;
-
-    info2.commandBufferInfoCount = 1;
-    info2.pCommandBufferInfos = &cmdInfoSubmit;
-
-    vkQueueSubmit2(graphicsQueue, 1, &info2, immFence);
-    vkWaitForFences(device, 1, &immFence, true, 9999999999);
-
-    // destroy buffer
     return newImage;
+}
 
+// uploads a chain that was already built on the cpu (tightly packed, largest level first), rgba8 or a TextureCompress block format.
+// createImage(extent, ..., true) allocates the same floor(log2)+1 levels the scene cache bakes
+AllocatedImage VkEngine::createImageWithMips(const void* data, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, uint32_t mipCount) {
+
+    TextureCompress::Format blockFormat = textureCompressFormat(format);
+    std::vector<VkBufferImageCopy> regions;
+    size_t dataSize = 0;
+    for (uint32_t level = 0; level < mipCount; level++) {
+
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = dataSize;
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = level;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = { std::max(1u, extent.width >> level), std::max(1u, extent.height >> level), 1u };
+        regions.push_back(copyRegion);
+
+        dataSize += TextureCompress::levelSize(blockFormat, copyRegion.imageExtent.width, copyRegion.imageExtent.height);
+    }
 
+    AllocatedImage newImage = createImage(extent, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mipCount > 1);
 
+    // regions were laid out from 0, shift them to wherever the chain landed in staging
+    UploadBatcher::Staging staging = uploader.stage(data, dataSize);
+    for (auto& region : regions) region.bufferOffset += staging.offset;
 
-
+    VkCommandBuffer cmd = uploader.commands();
+    transitionImage(cmd, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdCopyBufferToImage(cmd, staging.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+    transitionImage(cmd, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    return newImage;
 }
-
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "vkEng/Upload/upload_batcher.h"
+#include "vkEng/vk_engine.h"
+#include "vkEng/vk_helper_funcs.h"
+
+void UploadBatcher::init(VkEngine* engine, VkDeviceSize ringSize) {
+
+    _engine = engine;
+    _ringSize = ringSize;
+
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(engine->physicalDevice, engine->surface);
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    Logger::vkCheck(vkCreateCommandPool(engine->device, &poolInfo, nullptr, &_pool), "failed to create upload command pool");
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    Logger::vkCheck(vkCreateSemaphore(engine->device, &semaphoreInfo, nullptr, &_timeline), "failed to create upload timeline semaphore");
+
+    _ring = createBufferVMA(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine->_allocator);
+    _mapped = reinterpret_cast<uint8_t*>(_ring.info.pMappedData);
+}
+
+void UploadBatcher::cleanup() {
+
+    flush();
+    wait(_flushed);
+    retire();
+
+    vkDestroySemaphore(_engine->device, _timeline, nullptr);
+    vkDestroyCommandPool(_engine->device, _pool, nullptr);
+    vmaDestroyBuffer(_engine->_allocator, _ring.buffer, _ring.allocation);
+}
+
+UploadBatcher::Staging UploadBatcher::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+
+    // would never fit, goes in its own buffer that dies with the batch
+    if (size > _ringSize) {
+
+        AllocatedBuffer buffer = createBufferVMA(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, _engine->_allocator);
+        std::memcpy(buffer.info.pMappedData, data, size);
+        _open.dedicated.push_back(buffer);
+        return { buffer.buffer, 0 };
+    }
+
+    for (;;) {
+
+        // nothing in flight, start over at the front instead of wrapping around an empty ring
+        if (_head == _tail) _head = _tail = (_head + _ringSize - 1) / _ringSize * _ringSize;
+
+        uint64_t pos = _head % _ringSize;
+        uint64_t aligned = (pos + alignment - 1) / alignment * alignment;
+        // never splits across the end, the rest of the ring is skipped
+        uint64_t start = aligned + size > _ringSize ? _head + (_ringSize - pos) : _head + (aligned - pos);
+        if (start + size - _tail <= _ringSize) {
+
+            _head = start + size;
+            _pending = true;
+            VkDeviceSize offset = start % _ringSize;
+            std::memcpy(_mapped + offset, data, size);
+            return { _ring.buffer, offset };
+        }
+
+        // full. staging handed out but not recorded yet belongs to no batch, flushing could retire it and starting over
+        // would hand its bytes out again. callers record right after each stage, so this only trips on misuse
+        if (_pending) throw std::logic_error("upload ring full with staged data that hasn't been recorded, record after each stage()");
+
+        // the open batch may be what's holding the space, so it goes out first, then the oldest batch is waited on
+        if (_recording) flush();
+        if (_inFlight.empty()) {
+
+            _tail = _head;
+            continue;
+        }
+        wait(_inFlight.front().value);
+        retire();
+    }
+}
+
+VkCommandBuffer UploadBatcher::commands() {
+
+    // whatever was staged is about to be recorded into the open batch, its space now goes with that batch
+    _pending = false;
+    if (_recording) return _open.cmd;
+
+    if (_freeCommands.empty()) {
+
+        VkCommandBufferAllocateInfo cmdInfo = {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.commandPool = _pool;
+        cmdInfo.commandBufferCount = 1;
+        cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        VkCommandBuffer cmd;
+        Logger::vkCheck(vkAllocateCommandBuffers(_engine->device, &cmdInfo, &cmd), "failed to allocate upload command buffer");
+        _freeCommands.push_back(cmd);
+    }
+    _open.cmd = _freeCommands.back();
+    _freeCommands.pop_back();
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    Logger::vkCheck(vkResetCommandBuffer(_open.cmd, 0), "failed to reset upload command buffer");
+    Logger::vkCheck(vkBeginCommandBuffer(_open.cmd, &beginInfo), "failed to begin upload command buffer");
+
+    _recording = true;
+    return _open.cmd;
+}
+
+uint64_t UploadBatcher::flush() {
+
+    if (!_recording) return _flushed;
+
+    Logger::vkCheck(vkEndCommandBuffer(_open.cmd), "failed to end upload command buffer");
+
+    _open.value = ++_flushed;
+    _open.ringEnd = _head;
+
+    VkCommandBufferSubmitInfo cmdInfo{};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    cmdInfo.commandBuffer = _open.cmd;
+
+    VkSemaphoreSubmitInfo signalInfo{};
+    signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalInfo.semaphore = _timeline;
+    signalInfo.value = _open.value;
+    signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo2 submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &cmdInfo;
+    submitInfo.signalSemaphoreInfoCount = 1;
+    submitInfo.pSignalSemaphoreInfos = &signalInfo;
+    Logger::vkCheck(vkQueueSubmit2(_engine->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE), "failed to submit upload batch");
+
+    _inFlight.push_back(std::move(_open));
+    _open = Batch{};
+    _recording = false;
+    return _flushed;
+}
+
+void UploadBatcher::wait(uint64_t value) {
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &_timeline;
+    waitInfo.pValues = &value;
+    Logger::vkCheck(vkWaitSemaphores(_engine->device, &waitInfo, UINT64_MAX), "failed to wait on upload timeline");
+}
+
+void UploadBatcher::retire() {
+
+    uint64_t completed = 0;
+    Logger::vkCheck(vkGetSemaphoreCounterValue(_engine->device, _timeline, &completed), "failed to read upload timeline");
+
+    while (!_inFlight.empty() && _inFlight.front().value <= completed) {
+
+        Batch& batch = _inFlight.front();
+        for (auto& buffer : batch.dedicated) vmaDestroyBuffer(_engine->_allocator, buffer.buffer, buffer.allocation);
+        _freeCommands.push_back(batch.cmd);
+        _tail = std::max(_tail, batch.ringEnd);
+        _inFlight.pop_front();
+    }
+}
@@ -1,14 +1,60 @@
 ﻿#include "pch.h"
 #include "vkEng/gltf_loader.h"
 #include "vkEng/vk_engine_setup.h"
-#include "vkEng/mesh_utils.h"
+#include "Renderer/Scene/mesh_optimizer.h"
+#include "Renderer/Scene/tangents.h"
 #include <cmath>
 #include "stb_image.h"
+#include "Core/Utils/thread_pool.h"
+#include "Core/Utils/bounded_queue.h"
+#include "Renderer/Scene/scene_cache.h"
+#include "Renderer/Scene/texture_compress.h"
+#include "Renderer/Scene/texture_transcode.h"
+#include "Renderer/Scene/gltf_utils.h"
+
+// the part of settings that changes the bake, goes into the cache key. compression is keyed on what this device can
+// actually sample, so a bake made on a bc capable gpu is rebaked uncompressed instead of loaded on one without it
+static SceneCache::BakeSettings bakeSettings(const gltfData::LoadSettings& settings, const VkEngine* engine) {
+
+    SceneCache::BakeSettings bake;
+    bake.optimizeMeshes = settings.optimizeMeshes;
+    bake.overdrawThreshold = settings.overdrawThreshold;
+    bake.generateLods = settings.generateLods;
+    bake.maxLods = settings.maxLods;
+    bake.lodErrorTargets = settings.lodErrorTargets;
+    bake.compressTextures = settings.compressTextures && engine->supportsBlockCompression;
+    return bake;
+}
 
-std::shared_ptr<gltfData> gltfData::Load(VkEngine* engine, std::filesystem::path path) {
+std::shared_ptr<gltfData> gltfData::Load(VkEngine* engine, std::filesystem::path path, LoadSettings settings) {
 
     std::shared_ptr<gltfData> scene = std::make_shared<gltfData>();
     gltfData& file = *scene;
+    file.settings = settings;
+
+    std::filesystem::path cachePath;
+    uint64_t sourceHash = 0;
+
+    if (settings.useSceneCache) {
+
+        cachePath = SceneCache::cachePathFor(path, "vk");
+        sourceHash = SceneCache::hashSource(path, sizeof(Vertex), sizeof(PBRMaterialSystem::MaterialPBRConstants), bakeSettings(settings, engine));
+
+        // warm start, everything comes straight out of the mapped cache and fastgltf never runs
+        SceneCache::SceneView view;
+        if (sourceHash && view.open(cachePath, sourceHash, sizeof(Vertex), sizeof(PBRMaterialSystem::MaterialPBRConstants))) {
+
+            std::cout << "loading scene cache " << cachePath << std::endl;
+            file.loadFromCache({ scene, nullptr, engine }, view);
+            return scene;
+        }
+
+        // missing or stale, record everything on the way through so it can be rebuilt
+        file.bake = std::make_unique<SceneCache::SceneData>();
+        file.bake->vertexStride = sizeof(Vertex);
+        file.bake->materialStride = sizeof(PBRMaterialSystem::MaterialPBRConstants);
+    }
+
     fastgltf::Asset gltf = file.getGltfAsset(path);
     GltfLoadContext ctx = { scene, &gltf, engine };
 
@@ -18,7 +64,12 @@ std::shared_ptr<gltfData> gltfData::Load(VkEngine* engine, std::filesystem::path
     std::vector<std::shared_ptr<gltfMaterial>> materials = file.loadMaterials(ctx, samplers, images);
     std::vector<std::shared_ptr<MeshAsset>> vecMeshes = file.loadMeshes(ctx, materials);
     std::vector<std::shared_ptr<Node>> nodes = file.loadNodes(ctx, vecMeshes);
-    std::cout << typeid(materials[0]->data.materialSet).name() << std::endl;
+
+    if (file.bake) {
+
+        if (sourceHash) SceneCache::write(cachePath, sourceHash, *file.bake);
+        file.bake.reset();
+    }
     return scene;
 }
 
@@ -29,6 +80,10 @@ fastgltf::Asset gltfData::getGltfAsset(std::filesystem::path path) {
 
         fastgltf::Extensions::KHR_materials_volume
       | fastgltf::Extensions::KHR_materials_transmission 
+      | fastgltf::Extensions::EXT_mesh_gpu_instancing
+      | fastgltf::Extensions::KHR_texture_basisu
+      | fastgltf::Extensions::KHR_mesh_quantization
+      | fastgltf::Extensions::EXT_meshopt_compression
     };
 
     constexpr auto gltfOptions =
@@ -43,9 +98,29 @@ fastgltf::Asset gltfData::getGltfAsset(std::filesystem::path path) {
         std::cerr << "Failed to load glTF: " << fastgltf::getErrorMessage(asset.error()) << '\n';
     }
     fastgltf::Asset gltf = std::move(asset.get());
+    GltfUtils::decompressMeshopt(gltf);
     return gltf;
 }
 
+static VkSampler makeSampler(VkDevice device, fastgltf::Filter mag, fastgltf::Filter min) {
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = nullptr;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.minLod = 0;
+    samplerInfo.flags = 0;
+
+    samplerInfo.magFilter = extract_filter(mag);
+    samplerInfo.minFilter = extract_filter(min);
+
+    samplerInfo.mipmapMode = extract_mipmap_mode(min);
+
+    VkSampler newSampler;
+    vkCreateSampler(device, &samplerInfo, nullptr, &newSampler);
+    return newSampler;
+}
+
 std::vector<VkSampler> gltfData::createSamplers(GltfLoadContext ctx) {
 
     std::vector<VkSampler> samplers;
@@ -53,47 +128,276 @@ std::vector<VkSampler> gltfData::createSamplers(GltfLoadContext ctx) {
     /* Sampler creation */
     for (fastgltf::Sampler& sampler : ctx.gltf->samplers) {
 
-        VkSamplerCreateInfo samplerInfo = {};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.pNext = nullptr;
-        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
-        samplerInfo.minLod = 0;
-        samplerInfo.flags = 0;
-
-
         // value_or is used in case sampler.x doesnt exist
-        samplerInfo.magFilter = extract_filter(sampler.magFilter.value_or(fastgltf::Filter::Nearest));
-        samplerInfo.minFilter = extract_filter(sampler.minFilter.value_or(fastgltf::Filter::Nearest));
+        samplers.push_back(makeSampler(ctx.engine->device,
+            sampler.magFilter.value_or(fastgltf::Filter::Nearest),
+            sampler.minFilter.value_or(fastgltf::Filter::Nearest)));
 
-        samplerInfo.mipmapMode = extract_mipmap_mode(sampler.minFilter.value_or(fastgltf::Filter::Nearest));
+        if (bake) {
 
-        VkSampler newSampler;
-        vkCreateSampler(ctx.engine->device, &samplerInfo, nullptr, &newSampler);
-        samplers.push_back(newSampler);
+            bake->samplers.push_back({
+                sampler.magFilter ? int32_t(*sampler.magFilter) : SceneCache::NONE,
+                sampler.minFilter ? int32_t(*sampler.minFilter) : SceneCache::NONE,
+                int32_t(sampler.wrapS), int32_t(sampler.wrapT) });
+        }
     }
     return samplers;
 }
 
-std::vector<AllocatedImage> gltfData::createImages(GltfLoadContext ctx) {
+// KHR_texture_basisu puts the ktx2 image next to the regular one (which can be left out), the ktx2 wins when it's there
+static std::optional<size_t> textureImage(const fastgltf::Texture& tex) {
 
-    std::vector<AllocatedImage> images;
+    if (tex.basisuImageIndex.has_value()) return tex.basisuImageIndex.value();
+    if (tex.imageIndex.has_value()) return tex.imageIndex.value();
+    return {};
+}
+
+// same texture/sampler lookup fetchPBRTextures does, kept as indices for the scene cache
+static void recordTextureSlots(fastgltf::Material& mat, const fastgltf::Asset& gltf, SceneCache::MaterialRecord& rec) {
+
+    for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+        rec.image[slot] = SceneCache::NONE;
+        rec.sampler[slot] = SceneCache::NONE;
+    }
+
+    auto slotTex = [&](SceneCache::TextureSlot slot, auto& texOpt) {
+
+        if (!texOpt.has_value()) return;
+
+        auto& tex = gltf.textures[texOpt.value().textureIndex];
+        std::optional<size_t> image = textureImage(tex);
+        if (!image.has_value() || !tex.samplerIndex.has_value()) return;
+
+        rec.image[slot] = int32_t(*image);
+        rec.sampler[slot] = int32_t(tex.samplerIndex.value());
+    };
+
+    slotTex(SceneCache::SLOT_ALBEDO, mat.pbrData.baseColorTexture);
+    slotTex(SceneCache::SLOT_METAL_ROUGH, mat.pbrData.metallicRoughnessTexture);
+    slotTex(SceneCache::SLOT_OCCLUSION, mat.occlusionTexture);
+    slotTex(SceneCache::SLOT_NORMAL, mat.normalTexture);
+
+    if (mat.transmission) slotTex(SceneCache::SLOT_TRANSMISSION, mat.transmission->transmissionTexture);
+    if (mat.volume) slotTex(SceneCache::SLOT_THICKNESS, mat.volume->thicknessTexture);
+}
+
+// bit per SceneCache::TextureSlot for every image, what TextureCompress::chooseFormat picks from
+static std::vector<uint32_t> imageSlotMasks(const std::vector<SceneCache::MaterialRecord>& materials, size_t imageCount) {
+
+    std::vector<uint32_t> masks(imageCount, 0);
+    for (const auto& rec : materials) {
+
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            if (rec.image[slot] != SceneCache::NONE && size_t(rec.image[slot]) < imageCount) masks[rec.image[slot]] |= 1u << slot;
+        }
+    }
+    return masks;
+}
 
-    // *potential bug make sure the line   materialResources.colorImage = vecImages[img];   the images are in the same order as this enhanced for loop
-    /* Load images */
-    for (fastgltf::Image& image : ctx.gltf->images) {
+static std::vector<uint32_t> imageSlotMasks(fastgltf::Asset& gltf) {
 
-        std::optional<AllocatedImage> img = loadImage(ctx.engine, *ctx.gltf, image);
+    std::vector<SceneCache::MaterialRecord> records(gltf.materials.size());
+    for (size_t i = 0; i < records.size(); i++) recordTextureSlots(gltf.materials[i], gltf, records[i]);
+    return imageSlotMasks(records, gltf.images.size());
+}
+
+// raw rgba8 pixels from stb (or a transcoded ktx2 chain), decoded on a worker and handed to the render thread for upload
+struct DecodedImage {
+
+    unsigned char* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int nrChannels = 0;
+
+    // only filled when baking a scene cache or compressing textures. format is what mips holds
+    std::vector<uint8_t> mips;
+    uint32_t mipCount = 0;
+    TextureCompress::Format format = TextureCompress::RGBA8;
+};
+
+// stb for png/jpeg. KHR_texture_basisu ktx2 goes through libktx instead and comes back as a whole chain in mips (data stays null),
+// already in the format slotMask asks for when the device takes block formats
+static DecodedImage decodeImage(const fastgltf::Asset& asset, const fastgltf::Image& image, uint32_t slotMask = 0, bool blockFormats = false) {
+
+    DecodedImage out;
+    std::vector<uint8_t> storage;
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    if (!GltfUtils::imageBytes(asset, image, storage, bytes, size)) return out;
+
+    if (TextureTranscode::isKtx2(bytes, size)) {
+
+        TextureTranscode::Image ktx;
+        if (!TextureTranscode::transcode(bytes, size, slotMask, blockFormats, ktx)) return out;
+
+        out.width = int(ktx.width);
+        out.height = int(ktx.height);
+        out.nrChannels = int(ktx.channels);
+        out.mips = std::move(ktx.chain);
+        out.mipCount = ktx.mipCount;
+        out.format = ktx.format;
+        return out;
+    }
+
+    out.data = stbi_load_from_memory(bytes, int(size), &out.width, &out.height, &out.nrChannels, 4);
+    return out;
+}
+
+// render thread only, frees the decoded pixels once they're on the gpu
+static std::optional<AllocatedImage> uploadImage(VkEngine* engine, DecodedImage& decoded) {
+
+    if (!decoded.data) return {};
+
+    VkExtent3D imagesize{ uint32_t(decoded.width),
+                          uint32_t(decoded.height),
+                          1u };
+    AllocatedImage newImage = engine->createImage(decoded.data,
+        imagesize,
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_IMAGE_USAGE_SAMPLED_BIT,
+        false);
+    stbi_image_free(decoded.data);
+    decoded.data = nullptr;
+
+    // if nothing loaded, return empty
+    if (newImage.image == VK_NULL_HANDLE) {
+        return {};
+    }
+    else {
+        return newImage;
+    }
+}
+
+std::optional<AllocatedImage> loadImage(VkEngine* engine,
+    fastgltf::Asset& asset,
+    fastgltf::Image& image)
+{
+    DecodedImage decoded = decodeImage(asset, image);
+    return uploadImage(engine, decoded);
+}
 
-        if (img.has_value()) {
+// worker side, the mip chain for the cache gets built right after decode and block compressed
+// for the slots sampling it (slotMask, see imageSlotMasks) when compress is on
+static DecodedImage decodeForUpload(const fastgltf::Asset& asset, const fastgltf::Image& image, bool baking, bool compress, uint32_t slotMask) {
 
-            images.push_back(*img);
+    DecodedImage decoded;
+    try {
+
+        decoded = decodeImage(asset, image, slotMask, compress);
+        if ((baking || compress) && decoded.data) {
+
+            decoded.mipCount = SceneCache::buildMipChain(decoded.data, decoded.width, decoded.height, decoded.mips);
         }
-        else {
+        if (compress && decoded.data && decoded.mipCount) {
 
-            images.push_back(ctx.engine->_errorImage);
-            std::cout << "gltf failed image loading" << std::endl;
+            uint32_t width = uint32_t(decoded.width);
+            uint32_t height = uint32_t(decoded.height);
+            TextureCompress::Choice choice = TextureCompress::chooseFormat(slotMask, decoded.data, width, height);
+            decoded.mips = TextureCompress::compressChain(decoded.mips.data(), width, height, decoded.mipCount, choice);
+            decoded.format = choice.format;
         }
     }
+    catch (const std::exception& e) {
+
+        // the upload side pops one result per image, a throw on a worker would leave it waiting forever.
+        // comes back as a failed decode instead so the image gets the fallback
+        std::cerr << "failed to decode image " << image.name << ": " << e.what() << std::endl;
+        stbi_image_free(decoded.data);
+        return DecodedImage{};
+    }
+    return decoded;
+}
+
+// render thread, records the image for the cache when baking (bake->images already sized to the file)
+static AllocatedImage storeImage(VkEngine* engine, SceneCache::SceneData* bake, size_t index, DecodedImage& decoded) {
+
+    std::optional<AllocatedImage> img;
+    if (decoded.mipCount) {
+
+        // chain is already built (and maybe compressed), same upload as the cache path
+        stbi_image_free(decoded.data);
+        decoded.data = nullptr;
+        img = engine->createImageWithMips(decoded.mips.data(),
+            VkExtent3D{ uint32_t(decoded.width), uint32_t(decoded.height), 1u },
+            vkTextureFormat(decoded.format),
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            decoded.mipCount);
+    }
+    else {
+
+        img = uploadImage(engine, decoded);
+    }
+
+    if (bake) {
+
+        SceneCache::SceneData::Image& baked = bake->images[index];
+        baked.record.width = img.has_value() ? uint32_t(decoded.width) : 0;
+        baked.record.height = img.has_value() ? uint32_t(decoded.height) : 0;
+        baked.record.channels = uint32_t(decoded.nrChannels);
+        baked.record.mipCount = decoded.mipCount;
+        baked.record.format = decoded.format;
+        baked.pixels = std::move(decoded.mips);
+    }
+
+    if (img.has_value()) return *img;
+
+    std::cout << "gltf failed image loading" << std::endl;
+    return engine->_errorImage;
+}
+
+std::vector<AllocatedImage> gltfData::createImages(GltfLoadContext ctx) {
+
+    // indexed by gltf image index, fetchPBRTextures looks images up by that so order has to match the file
+    std::vector<AllocatedImage> images(ctx.gltf->images.size());
+
+    auto upload = [&](size_t index, DecodedImage& decoded) {
+
+        images[index] = storeImage(ctx.engine, bake.get(), index, decoded);
+    };
+
+    bool baking = bake != nullptr;
+    if (baking) bake->images.resize(images.size());
+
+    // bc needs textureCompressionBC, without it images stay rgba8 and ktx2 transcodes to that
+    bool compress = settings.compressTextures && ctx.engine->supportsBlockCompression;
+    std::vector<uint32_t> slotMasks = imageSlotMasks(*ctx.gltf);
+    auto decode = [baking, compress, &slotMasks](const fastgltf::Asset& asset, const fastgltf::Image& image, size_t index) {
+
+        return decodeForUpload(asset, image, baking, compress, slotMasks[index]);
+    };
+
+    if (!settings.parallelImageDecode) {
+
+        for (size_t i = 0; i < images.size(); i++) {
+
+            DecodedImage decoded = decode(*ctx.gltf, ctx.gltf->images[i], i);
+            upload(i, decoded);
+        }
+        return images;
+    }
+
+    // workers decode out of order into a bounded queue, this thread does the createImage calls
+    // (they record into the upload batcher, which isn't thread safe, so they have to stay here). queue depth caps decoded memory
+    Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>> ready(settings.imageQueueDepth);
+    const fastgltf::Asset& asset = *ctx.gltf;
+
+    std::future<void> decoding = Utils::Jobs::get().submit([&]() {
+
+        Utils::Jobs::get().parallelFor(asset.images.size(), [&](size_t i) {
+
+            ready.push({ i, decode(asset, asset.images[i], i) });
+        });
+    });
+
+    for (size_t n = 0; n < images.size(); n++) {
+
+        auto [index, decoded] = ready.pop();
+        upload(index, decoded);
+    }
+    decoding.get();
+
     return images;
 }
 
@@ -104,9 +408,10 @@ void gltfData::fetchPBRTextures(fastgltf::Material& mat, GltfLoadContext ctx, PB
         if (!texOpt.has_value()) return;
 
         auto& tex = ctx.gltf->textures[texOpt.value().textureIndex];
-        if (!tex.imageIndex.has_value() || !tex.samplerIndex.has_value()) return;
+        std::optional<size_t> image = textureImage(tex);
+        if (!image.has_value() || !tex.samplerIndex.has_value()) return;
 
-        dst.image = images[tex.imageIndex.value()];
+        dst.image = images[*image];
         dst.sampler = samplers[tex.samplerIndex.value()];
         };
 
@@ -170,14 +475,6 @@ std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadMaterials(GltfLoadConte
 
     /* Load materials */
 
-    // putting this in scene variable so it doesnt die out of scope...
-    ctx.scene->materialDataBuffer = createBufferVMA(sizeof(PBRMaterialSystem::MaterialPBRConstants) * ctx.gltf->materials.size(),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, ctx.engine->_allocator);
-    int dataIdx = 0;
-
-    // store the mapped pointer *if bugs arise check this line***
-    PBRMaterialSystem::MaterialPBRConstants* sceneMaterialConstants = reinterpret_cast<PBRMaterialSystem::MaterialPBRConstants*>(ctx.scene->materialDataBuffer.info.pMappedData); // info is of VmaAllocationInfo, /vk_engine_seutp.h.h has this AllocatedBuffer struct
-
     // Load material from gltf
     std::vector<std::shared_ptr<gltfMaterial>> materials;
     for (fastgltf::Material& mat : ctx.gltf->materials) {
@@ -213,25 +510,32 @@ std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadMaterials(GltfLoadConte
         materialResources.metalRough.sampler = ctx.engine->_defaultSamplerLinear;
         materialResources.occlusion.image = ctx.engine->_whiteImage;
         materialResources.occlusion.sampler = ctx.engine->_defaultSamplerLinear;
-        materialResources.normalMap.image = ctx.engine->_whiteImage;
+        materialResources.normalMap.image = ctx.engine->_flatNormalImage;
         materialResources.normalMap.sampler = ctx.engine->_defaultSamplerLinear;
         materialResources.transmission.image = ctx.engine->_whiteImage;
         materialResources.transmission.sampler = ctx.engine->_defaultSamplerLinear;
         materialResources.volumeThickness.image = ctx.engine->_whiteImage;
         materialResources.volumeThickness.sampler = ctx.engine->_defaultSamplerLinear;
 
-        // this below data buffer is gonna be pointer to by the GPU (.dataBuffer) (UBO)
-        materialResources.dataBuffer = ctx.scene->materialDataBuffer.buffer;
-        materialResources.dataBufferOffset = dataIdx * sizeof(PBRMaterialSystem::MaterialPBRConstants);
-
-        
+        // goes into the pbr system's material table with the texture slots
+        materialResources.constants = pbrConstants;
 
         fetchPBRTextures(mat, ctx, materialResources, samplers, images);
 
-        sceneMaterialConstants[dataIdx] = pbrConstants;
+        newMat->doubleSided = mat.doubleSided;
+
+        if (bake) {
+
+            SceneCache::SceneData::Material baked;
+            baked.record.pass = uint32_t(passType);
+            baked.record.flags = mat.doubleSided ? SceneCache::MATERIAL_DOUBLE_SIDED : 0;
+            recordTextureSlots(mat, *ctx.gltf, baked.record);
+            baked.constants.resize(sizeof(PBRMaterialSystem::MaterialPBRConstants));
+            std::memcpy(baked.constants.data(), &pbrConstants, sizeof(PBRMaterialSystem::MaterialPBRConstants));
+            bake->materials.push_back(std::move(baked));
+        }
 
         newMat->data = ctx.engine->pbrSystem.writeMaterial(passType, materialResources, ctx.engine);
-        dataIdx++;
     }
     return materials;
 }
@@ -271,9 +575,12 @@ static void loadNormals(fastgltf::Primitive& p, fastgltf::Asset* gltf, std::vect
 
     auto normals = p.findAttribute("NORMAL");
     if (normals != p.attributes.end()) {
-        fastgltf::iterateAccessorWithIndex<glm::vec3>(*gltf, gltf->accessors[(*normals).accessorIndex],
+        // KHR_mesh_quantization normals are snorm8/16, fastgltf dequantizes them but they come out slightly off unit length
+        auto& accessor = gltf->accessors[(*normals).accessorIndex];
+        bool quantized = accessor.componentType != fastgltf::ComponentType::Float;
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(*gltf, accessor,
             [&](glm::vec3 v, size_t index) {
-                vertices[initial_vtx + index].normal = v;
+                vertices[initial_vtx + index].normal = quantized ? glm::normalize(v) : v;
             });
     }
 }
@@ -327,55 +634,148 @@ static GeoSurface buildSurface(fastgltf::Primitive& p, fastgltf::Asset* gltf, st
     return newSurface;
 }
 
-static void loadTangents(const std::vector<uint32_t> &indices, std::vector<Vertex> &vertices) {
+// returns false when the primitive has no TANGENT, those get generated once the whole mesh is in
+static bool loadTangents(fastgltf::Primitive& p, fastgltf::Asset* gltf, std::vector<Vertex>& vertices, size_t initial_vtx) {
+
+    auto tangents = p.findAttribute("TANGENT");
+    if (tangents == p.attributes.end()) return false;
+
+    auto& accessor = gltf->accessors[(*tangents).accessorIndex];
+    bool quantized = accessor.componentType != fastgltf::ComponentType::Float;
+    fastgltf::iterateAccessorWithIndex<glm::vec4>(*gltf, accessor,
+        [&](glm::vec4 v, size_t index) {
+            if (quantized) v = glm::vec4(glm::normalize(glm::vec3(v)), v.w < 0.0f ? -1.0f : 1.0f);
+            vertices[initial_vtx + index].tangent = v;
+        });
+    return true;
+}
+
+// cpu side result of decoding one fastgltf::Mesh, filled on a worker and uploaded later
+struct MeshStaging {
+
+    std::vector<uint32_t> indices;
+    std::vector<Vertex> vertices;
+    std::vector<GeoSurface> surfaces;
+};
+
+static void decodeMesh(fastgltf::Mesh& mesh, fastgltf::Asset* gltf, std::vector<std::shared_ptr<gltfMaterial>>& materials, MeshStaging& out,
+    const MeshUtils::OptimizeSettings* optimize, const MeshUtils::LodSettings* lods, bool benchmarkTangents) {
+
+    // primitives that ship TANGENT keep them, only the rest go through the generator
+    std::vector<MeshUtils::IndexRange> missingTangents;
+    for (auto& p : mesh.primitives) {
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    positions.reserve(vertices.size());
+        size_t firstVertex = out.vertices.size();
+        out.surfaces.push_back(buildSurface(p, gltf, out.indices, out.vertices, materials));
+        if (!loadTangents(p, gltf, out.vertices, firstVertex)) missingTangents.push_back({ out.surfaces.back().startIndex, out.surfaces.back().count });
+    }
 
-    for (auto& v : vertices) {
+    if (benchmarkTangents && !missingTangents.empty()) {
 
-        positions.push_back(v.pos);
-        texCoords.push_back(v.texCoord);
-        normals.push_back(v.normal);
+        MeshUtils::TangentBenchmark bench = MeshUtils::benchmarkTangents(out.indices, out.vertices, missingTangents);
+        std::cout << "tangents " << mesh.name << " (" << out.vertices.size() << " verts): old " << bench.referenceMs << " ms, soa "
+            << bench.serialMs << " ms, soa parallel " << bench.parallelMs << " ms, max diff " << bench.maxDifference << std::endl;
     }
+    MeshUtils::generateTangents(out.indices, out.vertices, missingTangents);
+
+    if (optimize) {
 
-    std::vector<glm::vec4> tangents = MeshUtils::calculateTangents(positions, indices, texCoords, normals);
+        // each primitive is optimized inside its own index range so the surfaces stay valid
+        std::vector<MeshUtils::IndexRange> ranges;
+        for (auto& s : out.surfaces) ranges.push_back({ s.startIndex, s.count });
+        MeshUtils::optimizeMesh(out.indices, out.vertices, ranges, *optimize, std::string(mesh.name));
+    }
 
-    for (int i = 0; i < tangents.size(); i++) {
+    // lods + clusters last, lods get appended after every surface and clusters are just cuts through the final index order
+    for (auto& s : out.surfaces) {
 
-        vertices[i].tangent = tangents[i];
+        s.detail = std::make_shared<const MeshUtils::SurfaceDetail>(
+            MeshUtils::buildSurfaceDetail(out.indices, out.vertices, { s.startIndex, s.count }, lods));
+        s.bounds.origin = s.detail->center;
+        s.bounds.sphereRadius = s.detail->radius;
+        s.bounds.extents = glm::vec3(s.detail->radius);
     }
 }
 
+// decodeMesh with the knobs from LoadSettings, cpu only so any thread
+static void decodeMesh(const gltfData::LoadSettings& settings, size_t meshIndex, fastgltf::Asset* gltf,
+    std::vector<std::shared_ptr<gltfMaterial>>& materials, MeshStaging& out) {
+
+    MeshUtils::OptimizeSettings optimize;
+    optimize.overdrawThreshold = settings.overdrawThreshold;
+    optimize.report = settings.reportMeshStats;
+
+    MeshUtils::LodSettings lods;
+    lods.maxLevels = settings.maxLods;
+    lods.errorTargets = settings.lodErrorTargets;
+
+    decodeMesh(gltf->meshes[meshIndex], gltf, materials, out, settings.optimizeMeshes ? &optimize : nullptr,
+        settings.generateLods ? &lods : nullptr, settings.benchmarkTangents);
+}
+
+// render thread, fills in an already created asset so nodes pointing at it start drawing it.
+// records the mesh for the cache when baking (bake->meshes already sized to the file)
+static void uploadStagedMesh(VkEngine* engine, SceneCache::SceneData* bake, bool packed, size_t meshIndex, MeshAsset& mesh, MeshStaging& staged,
+    const std::vector<std::shared_ptr<gltfMaterial>>& materials) {
+
+    mesh.meshBuffers = engine->uploadMesh(staged.indices, staged.vertices, packed);
+    mesh.surfaces = std::move(staged.surfaces);
+
+    if (bake) {
+
+        SceneCache::SceneData::Mesh& baked = bake->meshes[meshIndex];
+        baked.vertexCount = uint32_t(staged.vertices.size());
+        baked.vertices.resize(staged.vertices.size() * sizeof(Vertex));
+        std::memcpy(baked.vertices.data(), staged.vertices.data(), baked.vertices.size());
+        baked.indices = std::move(staged.indices);
+
+        for (auto& surface : mesh.surfaces) {
+
+            auto found = std::find(materials.begin(), materials.end(), surface.material);
+            int32_t matIdx = found != materials.end() ? int32_t(found - materials.begin()) : SceneCache::NONE;
+
+            SceneCache::SurfaceRecord surf{ surface.startIndex, surface.count, matIdx };
+            SceneCache::addSurfaceDetail(baked, surf, *surface.detail);
+            baked.surfaces.push_back(surf);
+        }
+    }
+
+    staged = {}; // free the cpu copy as we go
+}
+
 // Main mesh loading function
 
 std::vector<std::shared_ptr<MeshAsset>> gltfData::loadMeshes(
     GltfLoadContext ctx, std::vector<std::shared_ptr<gltfMaterial>> materials) {
 
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
     std::vector<std::shared_ptr<MeshAsset>> vecMeshes;
+    std::vector<MeshStaging> staging(ctx.gltf->meshes.size());
 
-    for (fastgltf::Mesh& mesh : ctx.gltf->meshes) {
+    // meshes dont depend on each other so the cpu side can go wide, gl/vk calls stay on this thread
+    auto decode = [&](size_t i) {
 
-        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
-        vecMeshes.push_back(newMesh);
-        newMesh->name = mesh.name;
+        decodeMesh(settings, i, ctx.gltf, materials, staging[i]);
+    };
 
-        indices.clear();
-        vertices.clear();
+    if (settings.parallelMeshDecode) {
 
-        for (auto& p : mesh.primitives) {
+        Utils::Jobs::get().parallelFor(staging.size(), decode);
+    }
+    else {
+
+        for (size_t i = 0; i < staging.size(); i++) decode(i);
+    }
+
+    // upload in file order so mesh indices line up with what loadNodes expects
+    if (bake) bake->meshes.resize(staging.size());
+    for (size_t i = 0; i < staging.size(); i++) {
+
+        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
+        vecMeshes.push_back(newMesh);
+        newMesh->name = ctx.gltf->meshes[i].name;
 
-            GeoSurface newSurface = buildSurface(p, ctx.gltf, indices, vertices, materials);
-            newMesh->surfaces.push_back(newSurface);
-        }
-        loadTangents(indices, vertices);
-        
         std::cout << "mesh name thing idk" << newMesh->name << std::endl;
-        newMesh->meshBuffers = ctx.engine->uploadMesh(indices, vertices);
+        uploadStagedMesh(ctx.engine, bake.get(), settings.packedVertices, i, *newMesh, staging[i], materials);
     }
 
     return vecMeshes;
@@ -397,16 +797,30 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
             else {
                 std::cout << "iteration node thing first meshIndex: none" << std::endl;
             }
+            glm::mat4 world = *reinterpret_cast<const glm::mat4*>(&matrix);
+            std::vector<glm::mat4> instances;
+            if (node.meshIndex) instances = GltfUtils::loadInstanceTransforms(*ctx.gltf, node, world);
+
+            if (bake) {
+
+                SceneCache::SceneData::Node baked;
+                baked.record.transform = world;
+                baked.record.mesh = node.meshIndex ? int32_t(*node.meshIndex) : SceneCache::NONE;
+                baked.instances = instances;
+                bake->nodes.push_back(std::move(baked));
+            }
             if (!node.meshIndex) {
 
                 auto emptyNode = std::make_shared<Node>();
+                emptyNode->worldTransform = world;
                 nodes.push_back(emptyNode);
                 return;
             }
-            auto meshCopy = vecMeshes[*node.meshIndex]->clone();
-            meshCopy->transform = *reinterpret_cast<const glm::mat4*>(&matrix);
+            // every node referencing this mesh shares the same asset, only the transform is per node
             auto meshNode = std::make_shared<MeshNode>();
-            meshNode->mesh = meshCopy;
+            meshNode->mesh = vecMeshes[*node.meshIndex];
+            meshNode->worldTransform = world;
+            meshNode->instanceTransforms = std::move(instances);
 
             nodes.push_back(meshNode);
         });
@@ -441,6 +855,7 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
             // actual linking
             sceneNode->children.push_back(nodes[childIdx]);
             nodes[childIdx]->parent = sceneNode;
+            if (bake) bake->nodes[i].children.push_back(uint32_t(childIdx));
         }
     }
     for (auto& node : nodes) {
@@ -453,138 +868,538 @@ std::vector<std::shared_ptr<Node>> gltfData::loadNodes(GltfLoadContext ctx, std:
     return nodes;
 }
 
-void gltfData::drawNodes(DrawContext& ctx) {
+static std::vector<VkSampler> loadCachedSamplers(VkEngine* engine, const SceneCache::SceneView& view) {
 
-    for (auto& node : topNodes) {
+    std::vector<VkSampler> samplers;
+    for (uint32_t i = 0; i < view.header().samplerCount; i++) {
 
-        node->Draw(ctx);
+        const SceneCache::SamplerRecord& rec = view.samplers()[i];
+        auto filter = [](int32_t f) { return f == SceneCache::NONE ? fastgltf::Filter::Nearest : fastgltf::Filter(f); };
+        samplers.push_back(makeSampler(engine->device, filter(rec.magFilter), filter(rec.minFilter)));
     }
+    return samplers;
+}
+
+// mips come prebuilt (and block compressed unless the bake had compressTextures off)
+static AllocatedImage loadCachedImage(VkEngine* engine, const SceneCache::SceneView& view, uint32_t index) {
+
+    const SceneCache::ImageRecord& rec = view.images()[index];
+    if (rec.width == 0) return engine->_errorImage;
+    // the cache key already covers this, a bc record on a device without textureCompressionBC would be invalid usage though
+    if (TextureCompress::isCompressed(TextureCompress::Format(rec.format)) && !engine->supportsBlockCompression) return engine->_errorImage;
+
+    return engine->createImageWithMips(view.bytes(rec.dataOffset),
+        VkExtent3D{ rec.width, rec.height, 1u },
+        vkTextureFormat(TextureCompress::Format(rec.format)),
+        VK_IMAGE_USAGE_SAMPLED_BIT,
+        rec.mipCount);
+}
+
+// fills in an already created asset, same as uploadStagedMesh on the cold path
+static void loadCachedMesh(VkEngine* engine, const SceneCache::SceneView& view, uint32_t index, MeshAsset& mesh,
+    const std::vector<std::shared_ptr<gltfMaterial>>& materials, bool packed) {
+
+    const SceneCache::MeshRecord& rec = view.meshes()[index];
+    std::vector<GeoSurface> surfaces;
+
+    for (uint32_t s = 0; s < rec.surfaceCount; s++) {
+
+        const SceneCache::SurfaceRecord& surf = view.surfaces()[rec.firstSurface + s];
+        GeoSurface surface;
+        surface.startIndex = surf.startIndex;
+        surface.count = surf.count;
+        surface.material = (surf.material != SceneCache::NONE && uint32_t(surf.material) < materials.size()) ? materials[surf.material] : materials[0];
+        surface.detail = std::make_shared<const MeshUtils::SurfaceDetail>(view.surfaceDetail(surf));
+        surface.bounds.origin = surface.detail->center;
+        surface.bounds.sphereRadius = surface.detail->radius;
+        surface.bounds.extents = glm::vec3(surface.detail->radius);
+        surfaces.push_back(surface);
+    }
+
+    // straight from the mapping into staging
+    mesh.meshBuffers = engine->uploadMesh(
+        reinterpret_cast<const uint32_t*>(view.bytes(rec.indexOffset)), rec.indexCount,
+        reinterpret_cast<const Vertex*>(view.bytes(rec.vertexOffset)), rec.vertexCount, packed);
+    mesh.surfaces = std::move(surfaces);
+}
+
+// texture slot order matches SceneCache::TextureSlot
+static PBRMaterialSystem::TextureBinding& textureSlot(PBRMaterialSystem::MaterialResources& res, uint32_t slot) {
+
+    PBRMaterialSystem::TextureBinding* slots[SceneCache::SLOT_COUNT] = {
+        &res.albedo, &res.metalRough, &res.occlusion, &res.normalMap, &res.transmission, &res.volumeThickness
+    };
+    return *slots[slot];
+}
+
+void gltfData::loadFromCache(GltfLoadContext ctx, const SceneCache::SceneView& view) {
+
+    const SceneCache::Header& header = view.header();
+
+    std::vector<VkSampler> samplers = loadCachedSamplers(ctx.engine, view);
+
+    std::vector<AllocatedImage> images;
+    for (uint32_t i = 0; i < header.imageCount; i++) {
+
+        images.push_back(loadCachedImage(ctx.engine, view, i));
+    }
+
+    std::vector<std::shared_ptr<gltfMaterial>> materials = loadCachedMaterials(ctx, view, samplers, images);
+
+    std::vector<std::shared_ptr<MeshAsset>> vecMeshes;
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+
+        std::shared_ptr<MeshAsset> newMesh = std::make_shared<MeshAsset>();
+        vecMeshes.push_back(newMesh);
+        loadCachedMesh(ctx.engine, view, i, *newMesh, materials, settings.packedVertices);
+    }
+
+    loadCachedNodes(ctx, view, vecMeshes);
 }
-std::optional<AllocatedImage> loadImage(VkEngine* engine,
-    fastgltf::Asset& asset,
-    fastgltf::Image& image)
-{
-    AllocatedImage newImage{};
-    int width, height, nrChannels;
-
-    // handle external URI
-    if (std::holds_alternative<fastgltf::sources::URI>(image.data)) {
-        auto& filePath = std::get<fastgltf::sources::URI>(image.data);
-        assert(filePath.fileByteOffset == 0);
-        assert(filePath.uri.isLocalPath());
-
-        const std::string path(filePath.uri.path().begin(),
-            filePath.uri.path().end());
-        unsigned char* data = stbi_load(path.c_str(),
-            &width, &height, &nrChannels, 4);
-        if (data) {
-            VkExtent3D imagesize{ uint32_t(width),
-                                  uint32_t(height),
-                                  1u };
-            newImage = engine->createImage(data,
-                imagesize,
-                VK_FORMAT_R8G8B8A8_UNORM,
-                VK_IMAGE_USAGE_SAMPLED_BIT,
-                false);
-            stbi_image_free(data);
-        }
 
-        // handle embedded vector
-    }
-    else if (std::holds_alternative<fastgltf::sources::Vector>(image.data)) {
-        auto& vector = std::get<fastgltf::sources::Vector>(image.data);
-        const stbi_uc* rawBytes =
-            reinterpret_cast<const stbi_uc*>(vector.bytes.data());
-        unsigned char* data = stbi_load_from_memory(rawBytes,
-            int(vector.bytes.size()),
-            &width, &height, &nrChannels, 4);
-        if (data) {
-            VkExtent3D imagesize{ uint32_t(width),
-                                  uint32_t(height),
-                                  1u };
-            newImage = engine->createImage(data,
-                imagesize,
-                VK_FORMAT_R8G8B8A8_UNORM,
-                VK_IMAGE_USAGE_SAMPLED_BIT,
-                false);
-            stbi_image_free(data);
+std::vector<std::shared_ptr<gltfMaterial>> gltfData::loadCachedMaterials(GltfLoadContext ctx, const SceneCache::SceneView& view,
+    std::vector<VkSampler>& samplers, std::vector<AllocatedImage>& images) {
+
+    const SceneCache::Header& header = view.header();
+
+    std::vector<std::shared_ptr<gltfMaterial>> materials;
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+
+        const SceneCache::MaterialRecord& rec = view.materials()[i];
+        std::shared_ptr<gltfMaterial> newMat = std::make_shared<gltfMaterial>();
+        materials.push_back(newMat);
+
+        PBRMaterialSystem::MaterialResources materialResources;
+
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            PBRMaterialSystem::TextureBinding& dst = textureSlot(materialResources, slot);
+            dst.image = (slot == SceneCache::SLOT_NORMAL) ? ctx.engine->_flatNormalImage : ctx.engine->_whiteImage;
+            dst.sampler = ctx.engine->_defaultSamplerLinear;
+
+            if (rec.image[slot] == SceneCache::NONE || rec.sampler[slot] == SceneCache::NONE) continue;
+            if (uint32_t(rec.image[slot]) >= images.size() || uint32_t(rec.sampler[slot]) >= samplers.size()) continue;
+
+            dst.image = images[rec.image[slot]];
+            dst.sampler = samplers[rec.sampler[slot]];
         }
 
-        // handle binary-GLB bufferView
+        std::memcpy(&materialResources.constants, view.bytes(rec.constantsOffset), sizeof(PBRMaterialSystem::MaterialPBRConstants));
+
+        newMat->doubleSided = (rec.flags & SceneCache::MATERIAL_DOUBLE_SIDED) != 0;
+        newMat->data = ctx.engine->pbrSystem.writeMaterial(MaterialPass(rec.pass), materialResources, ctx.engine);
     }
-    else if (std::holds_alternative<fastgltf::sources::BufferView>(image.data)) {
-        auto& view = std::get<fastgltf::sources::BufferView>(image.data);
-        auto& bufView = asset.bufferViews[view.bufferViewIndex];
-        auto& buffer = asset.buffers[bufView.bufferIndex];
+    return materials;
+}
+
+std::vector<std::shared_ptr<Node>> gltfData::loadCachedNodes(GltfLoadContext ctx, const SceneCache::SceneView& view,
+    const std::vector<std::shared_ptr<MeshAsset>>& vecMeshes) {
+
+    const SceneCache::Header& header = view.header();
 
-        // debug: enumerate all possible buffer.data types
-        if (std::holds_alternative<fastgltf::sources::URI>(buffer.data)) {
-            std::cout << "buffer.data is URI\n";
+    std::vector<std::shared_ptr<Node>> nodes;
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+
+        const SceneCache::NodeRecord& rec = view.nodes()[i];
+        if (rec.mesh == SceneCache::NONE) {
+
+            auto emptyNode = std::make_shared<Node>();
+            emptyNode->worldTransform = rec.transform;
+            nodes.push_back(emptyNode);
+            continue;
         }
-        else if (std::holds_alternative<fastgltf::sources::Vector>(buffer.data)) {
-            std::cout << "buffer.data is Vector\n";
+        auto meshNode = std::make_shared<MeshNode>();
+        meshNode->mesh = vecMeshes[rec.mesh];
+        meshNode->worldTransform = rec.transform;
+        meshNode->instanceTransforms.assign(view.instances() + rec.firstInstance, view.instances() + rec.firstInstance + rec.instanceCount);
+        nodes.push_back(meshNode);
+    }
+
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+
+        const SceneCache::NodeRecord& rec = view.nodes()[i];
+        for (uint32_t c = 0; c < rec.childCount; c++) {
+
+            uint32_t childIdx = view.children()[rec.firstChild + c];
+            if (childIdx >= nodes.size()) continue;
+
+            nodes[i]->children.push_back(nodes[childIdx]);
+            nodes[childIdx]->parent = nodes[i];
         }
-        else if (std::holds_alternative<fastgltf::sources::BufferView>(buffer.data)) {
-            std::cout << "buffer.data is BufferView\n";
+    }
+    for (auto& node : nodes) {
+
+        if (node->parent.lock() == nullptr) {
+
+            ctx.scene->topNodes.push_back(node);
         }
-        else if (std::holds_alternative<fastgltf::sources::Array>(buffer.data)) {
-            std::cout << "buffer.data is Array\n";
+    }
+    return nodes;
+}
+
+// everything LoadAsync keeps between pump() calls
+struct gltfData::StreamState {
+
+    VkEngine* engine = nullptr;
+
+    // job pool: hash + cache probe, then the parse if the cache can't be used
+    std::future<void> opening;
+    std::filesystem::path cachePath;
+    uint64_t sourceHash = 0;
+    SceneCache::SceneView view;
+    bool fromCache = false;
+    std::unique_ptr<fastgltf::Asset> asset;
+    bool started = false;
+
+    std::vector<VkSampler> samplers;
+    std::vector<std::shared_ptr<gltfMaterial>> materials;
+    std::vector<SceneCache::MaterialRecord> textureSlots; // per material, the image/sampler each slot gets once it's in
+    // what each material's textures should be right now + which frames' table copies haven't been rewritten since it changed
+    std::vector<PBRMaterialSystem::MaterialResources> textures;
+    std::vector<uint32_t> staleFrames;
+    std::vector<std::shared_ptr<MeshAsset>> meshes;       // created empty up front so the nodes can point at them
+    std::vector<std::vector<std::shared_ptr<MeshNode>>> meshUsers;
+
+    // cold path, decoded on the pool in whatever order they finish. the warm path uploads straight from the mapping in file order
+    std::unique_ptr<Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>>> decodedImages;
+    std::mutex meshLock;
+    std::deque<std::pair<size_t, MeshStaging>> decodedMeshes;
+    std::future<void> imageDecode;
+    std::future<void> meshDecode;
+    std::atomic<bool> cancelled = false;
+
+    uint32_t nextImage = 0;
+    uint32_t nextMesh = 0;
+    size_t imagesLeft = 0;
+    size_t meshesLeft = 0;
+
+    DrawContext batch; // visible but not handed to the engine's context yet
+    std::chrono::steady_clock::time_point lastCommit;
+    std::future<void> cacheWrite;
+
+    ~StreamState() {
+
+        // scene dropped mid load. workers may be parked on a full image queue so keep draining until they're out
+        cancelled = true;
+        if (opening.valid()) opening.wait();
+
+        std::pair<size_t, DecodedImage> leftover;
+        auto drain = [&]() {
+
+            while (decodedImages && decodedImages->tryPop(leftover)) stbi_image_free(leftover.second.data);
+        };
+        while (imageDecode.valid() && imageDecode.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) drain();
+        drain();
+
+        if (meshDecode.valid()) meshDecode.wait();
+        if (cacheWrite.valid()) cacheWrite.wait();
+    }
+};
+
+gltfData::~gltfData() = default;
+
+std::shared_ptr<gltfData> gltfData::LoadAsync(VkEngine* engine, std::filesystem::path path, LoadSettings settings) {
+
+    std::shared_ptr<gltfData> scene = std::make_shared<gltfData>();
+    scene->settings = settings;
+    scene->stream = std::make_unique<StreamState>();
+
+    StreamState& s = *scene->stream;
+    s.engine = engine;
+
+    // nothing on this thread touches s until opening is ready, and ~StreamState waits on it
+    gltfData* file = scene.get();
+    s.opening = Utils::Jobs::get().submit([file, &s, path]() {
+
+        if (file->settings.useSceneCache) {
+
+            s.cachePath = SceneCache::cachePathFor(path, "vk");
+            s.sourceHash = SceneCache::hashSource(path, sizeof(Vertex), sizeof(PBRMaterialSystem::MaterialPBRConstants), bakeSettings(file->settings, s.engine));
+            if (s.sourceHash && s.view.open(s.cachePath, s.sourceHash, sizeof(Vertex), sizeof(PBRMaterialSystem::MaterialPBRConstants))) {
+
+                s.fromCache = true;
+                return;
+            }
         }
-        else {
-            std::cout << "buffer.data is UNKNOWN TYPE (index="
-                << buffer.data.index() << ")\n";
+        if (s.cancelled) return;
+        s.asset = std::make_unique<fastgltf::Asset>(file->getGltfAsset(path));
+    });
+
+    return scene;
+}
+
+// render thread, first pump after the file is open. samplers, placeholder materials and the node tree go up in one go
+// (all small), then the pool starts on images + meshes
+void gltfData::beginStream() {
+
+    StreamState& s = *stream;
+    GltfLoadContext ctx = { shared_from_this(), s.asset.get(), s.engine };
+
+    size_t imageCount = 0;
+    size_t meshCount = 0;
+    std::vector<std::shared_ptr<Node>> nodes;
+
+    if (s.fromCache) {
+
+        std::cout << "streaming scene cache " << s.cachePath << std::endl;
+        const SceneCache::Header& header = s.view.header();
+        imageCount = header.imageCount;
+        meshCount = header.meshCount;
+
+        // every texture starts out as the white image, the real samplers are already in
+        std::vector<AllocatedImage> images(imageCount, s.engine->_whiteImage);
+        s.samplers = loadCachedSamplers(s.engine, s.view);
+        s.materials = loadCachedMaterials(ctx, s.view, s.samplers, images);
+        s.textureSlots.assign(s.view.materials(), s.view.materials() + header.materialCount);
+
+        for (size_t i = 0; i < meshCount; i++) s.meshes.push_back(std::make_shared<MeshAsset>());
+        nodes = loadCachedNodes(ctx, s.view, s.meshes);
+    }
+    else {
+
+        fastgltf::Asset& gltf = *s.asset;
+        imageCount = gltf.images.size();
+        meshCount = gltf.meshes.size();
+
+        if (s.sourceHash) {
+
+            bake = std::make_unique<SceneCache::SceneData>();
+            bake->vertexStride = sizeof(Vertex);
+            bake->materialStride = sizeof(PBRMaterialSystem::MaterialPBRConstants);
+            bake->images.resize(imageCount);
+            bake->meshes.resize(meshCount);
         }
 
+        std::vector<AllocatedImage> images(imageCount, s.engine->_whiteImage);
+        s.samplers = createSamplers(ctx);
+        s.materials = loadMaterials(ctx, s.samplers, images);
+        s.textureSlots.resize(s.materials.size());
+        for (size_t i = 0; i < s.materials.size(); i++) recordTextureSlots(gltf.materials[i], gltf, s.textureSlots[i]);
 
-        if (std::holds_alternative<fastgltf::sources::Vector>(buffer.data)) {
-            auto& vector2 = std::get<fastgltf::sources::Vector>(buffer.data);
-            const stbi_uc* rawBytes =
-                reinterpret_cast<const stbi_uc*>(vector2.bytes.data());
-            unsigned char* data = stbi_load_from_memory(
-                rawBytes + bufView.byteOffset,
-                int(bufView.byteLength),
-                &width, &height, &nrChannels, 4);
-            if (data) {
-                VkExtent3D imagesize{ uint32_t(width),
-                                      uint32_t(height),
-                                      1u };
-                newImage = engine->createImage(data,
-                    imagesize,
-                    VK_FORMAT_R8G8B8A8_UNORM,
-                    VK_IMAGE_USAGE_SAMPLED_BIT,
-                    false);
-                stbi_image_free(data);
-            }
+        for (size_t i = 0; i < meshCount; i++) {
+
+            s.meshes.push_back(std::make_shared<MeshAsset>());
+            s.meshes.back()->name = gltf.meshes[i].name;
         }
-        else if (std::holds_alternative<fastgltf::sources::Array>(buffer.data)) {
-            auto& array2 = std::get<fastgltf::sources::Array>(buffer.data);
-            const stbi_uc* rawBytes =
-                reinterpret_cast<const stbi_uc*>(array2.bytes.data());
-            unsigned char* data = stbi_load_from_memory(
-                rawBytes + bufView.byteOffset,
-                int(bufView.byteLength),
-                &width, &height, &nrChannels, 4);
-            if (data) {
-                VkExtent3D imagesize{ uint32_t(width),
-                                      uint32_t(height),
-                                      1u };
-                newImage = engine->createImage(data,
-                    imagesize,
-                    VK_FORMAT_R8G8B8A8_UNORM,
-                    VK_IMAGE_USAGE_SAMPLED_BIT,
-                    false);
-                stbi_image_free(data);
-            }
+        nodes = loadNodes(ctx, s.meshes);
+    }
+
+    // the same bindings loadMaterials / loadCachedMaterials just wrote, kept so a material's texture slots can be rewritten when an image lands
+    s.textures.resize(s.materials.size());
+    s.staleFrames.assign(s.materials.size(), 0);
+    for (size_t m = 0; m < s.materials.size(); m++) {
+
+        const SceneCache::MaterialRecord& rec = s.textureSlots[m];
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            PBRMaterialSystem::TextureBinding& dst = textureSlot(s.textures[m], slot);
+            dst.image = (slot == SceneCache::SLOT_NORMAL) ? s.engine->_flatNormalImage : s.engine->_whiteImage;
+            dst.sampler = s.engine->_defaultSamplerLinear;
+
+            if (rec.image[slot] == SceneCache::NONE || rec.sampler[slot] == SceneCache::NONE) continue;
+            if (uint32_t(rec.image[slot]) >= imageCount || uint32_t(rec.sampler[slot]) >= s.samplers.size()) continue;
+            dst.sampler = s.samplers[rec.sampler[slot]];
+
+            // the material went out with the white placeholder, a white normal map would rebuild to a tilted normal
+            if (slot == SceneCache::SLOT_NORMAL) s.staleFrames[m] = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
         }
     }
 
-    // if nothing loaded, return empty
-    if (newImage.image == VK_NULL_HANDLE) {
-        return {};
+    // which nodes to push once a mesh lands
+    std::unordered_map<const MeshAsset*, size_t> meshIndex;
+    for (size_t i = 0; i < s.meshes.size(); i++) meshIndex[s.meshes[i].get()] = i;
+    s.meshUsers.resize(meshCount);
+    for (auto& node : nodes) {
+
+        auto meshNode = std::dynamic_pointer_cast<MeshNode>(node);
+        if (meshNode && meshNode->mesh) s.meshUsers[meshIndex[meshNode->mesh.get()]].push_back(meshNode);
+    }
+
+    s.imagesLeft = imageCount;
+    s.meshesLeft = meshCount;
+    s.lastCommit = std::chrono::steady_clock::now();
+    if (s.fromCache) return;
+
+    bool baking = bake != nullptr;
+    bool compress = settings.compressTextures && s.engine->supportsBlockCompression;
+    std::vector<uint32_t> slotMasks = imageSlotMasks(s.textureSlots, imageCount);
+    bool parallelImages = settings.parallelImageDecode;
+    bool parallelMeshes = settings.parallelMeshDecode;
+    auto each = [](size_t count, bool parallel, const std::function<void(size_t)>& fn) {
+
+        if (parallel) Utils::Jobs::get().parallelFor(count, fn);
+        else for (size_t i = 0; i < count; i++) fn(i);
+    };
+
+    // meshes queue first, on a small pool they then get the workers before the image decode does
+    const LoadSettings& meshSettings = settings;
+    s.meshDecode = Utils::Jobs::get().submit([&s, &meshSettings, each, parallelMeshes]() {
+
+        each(s.asset->meshes.size(), parallelMeshes, [&](size_t i) {
+
+            if (s.cancelled) return;
+            MeshStaging staged;
+            decodeMesh(meshSettings, i, s.asset.get(), s.materials, staged);
+
+            std::lock_guard<std::mutex> lock(s.meshLock);
+            s.decodedMeshes.push_back({ i, std::move(staged) });
+        });
+    });
+
+    s.decodedImages = std::make_unique<Utils::Jobs::BoundedQueue<std::pair<size_t, DecodedImage>>>(settings.imageQueueDepth);
+    s.imageDecode = Utils::Jobs::get().submit([&s, each, baking, compress, slotMasks, parallelImages]() {
+
+        each(s.asset->images.size(), parallelImages, [&](size_t i) {
+
+            if (s.cancelled) return;
+            s.decodedImages->push({ i, decodeForUpload(*s.asset, s.asset->images[i], baking, compress, slotMasks[i]) });
+        });
+    });
+}
+
+bool gltfData::uploadNextMesh() {
+
+    StreamState& s = *stream;
+    size_t index;
+
+    if (s.fromCache) {
+
+        if (s.nextMesh >= s.meshes.size()) return false;
+        index = s.nextMesh++;
+        loadCachedMesh(s.engine, s.view, uint32_t(index), *s.meshes[index], s.materials, settings.packedVertices);
     }
     else {
-        return newImage;
+
+        std::pair<size_t, MeshStaging> ready;
+        {
+            std::lock_guard<std::mutex> lock(s.meshLock);
+            if (s.decodedMeshes.empty()) return false;
+            ready = std::move(s.decodedMeshes.front());
+            s.decodedMeshes.pop_front();
+        }
+        index = ready.first;
+        uploadStagedMesh(s.engine, bake.get(), settings.packedVertices, index, *s.meshes[index], ready.second, s.materials);
+    }
+
+    // the asset is shared, every node using it becomes visible at once
+    for (auto& node : s.meshUsers[index]) node->pushRenderObjects(s.batch);
+    s.meshUsers[index].clear();
+    s.meshesLeft--;
+    return true;
+}
+
+bool gltfData::uploadNextImage() {
+
+    StreamState& s = *stream;
+    size_t index;
+    AllocatedImage image;
+
+    if (s.fromCache) {
+
+        if (s.nextImage >= s.view.header().imageCount) return false;
+        index = s.nextImage++;
+        image = loadCachedImage(s.engine, s.view, uint32_t(index));
+    }
+    else {
+
+        std::pair<size_t, DecodedImage> ready;
+        if (!s.decodedImages->tryPop(ready)) return false;
+        index = ready.first;
+        image = storeImage(s.engine, bake.get(), index, ready.second);
+    }
+
+    // a material can't change under a frame that's still in flight, so every frame's table copy is flagged and pump rewrites each after its fence
+    for (size_t m = 0; m < s.materials.size(); m++) {
+
+        const SceneCache::MaterialRecord& rec = s.textureSlots[m];
+        for (uint32_t slot = 0; slot < SceneCache::SLOT_COUNT; slot++) {
+
+            if (rec.image[slot] == SceneCache::NONE || size_t(rec.image[slot]) != index) continue;
+            if (rec.sampler[slot] == SceneCache::NONE || uint32_t(rec.sampler[slot]) >= s.samplers.size()) continue;
+
+            textureSlot(s.textures[m], slot).image = image;
+            s.staleFrames[m] = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+        }
+    }
+    s.imagesLeft--;
+    return true;
+}
+
+bool gltfData::pump(DrawContext& ctx, uint32_t frame) {
+
+    if (!stream) return false;
+    StreamState& s = *stream;
+
+    if (!s.started) {
+
+        if (s.opening.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+        s.opening.get();
+        beginStream();
+        s.started = true;
+    }
+
+    // geometry first, an untextured object still beats an empty spot. always one item so a tiny budget can't stall the load
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [](std::chrono::steady_clock::time_point since) {
+
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+    bool uploaded = false;
+    while (!uploaded || elapsedMs(start) < settings.streamBudgetMs) {
+
+        if (!uploadNextMesh() && !uploadNextImage()) break;
+        uploaded = true;
+    }
+
+    // this frame's fence was just waited on, so its copy of the material table is free to rewrite
+    bool stale = false;
+    for (size_t m = 0; m < s.materials.size(); m++) {
+
+        if (s.staleFrames[m] & (1u << frame)) {
+
+            s.engine->pbrSystem.writeTextures(frame, s.materials[m]->data.materialIndex, s.textures[m], s.engine);
+            s.staleFrames[m] &= ~(1u << frame);
+        }
+        stale = stale || s.staleFrames[m] != 0;
+    }
+
+    bool done = s.meshesLeft == 0 && s.imagesLeft == 0;
+
+    // batched so the per commit instance upload doesn't run every frame
+    bool committed = false;
+    if (!s.batch.surfaces.empty() && (done || elapsedMs(s.lastCommit) >= settings.streamCommitMs)) {
+
+        ctx.append(s.batch);
+        s.lastCommit = std::chrono::steady_clock::now();
+        committed = true;
+    }
+    if (!done || stale) return committed;
+
+    // everything is in. the cache gets written off thread, the asset + mapping go once that's finished
+    if (bake && !s.cacheWrite.valid()) {
+
+        std::shared_ptr<SceneCache::SceneData> data(std::move(bake));
+        std::filesystem::path cachePath = s.cachePath;
+        uint64_t sourceHash = s.sourceHash;
+        s.cacheWrite = Utils::Jobs::get().submit([data, cachePath, sourceHash]() { SceneCache::write(cachePath, sourceHash, *data); });
+    }
+    if (s.cacheWrite.valid()) {
+
+        if (s.cacheWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return committed;
+        s.cacheWrite.get();
+    }
+    stream.reset();
+    std::cout << "scene streaming done" << std::endl;
+    return committed;
+}
+
+void gltfData::drawNodes(DrawContext& ctx) {
+
+    for (auto& node : topNodes) {
+
+        node->Draw(ctx);
     }
+    ctx.buildInstances();
 }
 VkFilter extract_filter(fastgltf::Filter filter) {
 
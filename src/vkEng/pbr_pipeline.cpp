@@ -1,48 +1,124 @@
 #include "pch.h"
 #include "vkEng/vk_engine_setup.h"
 #include "vkEng/pbr_pipeline.h"
+#include "vkEng/vk_helper_funcs.h"
+#include "Renderer/Scene/scene_cache.h"
 
 // uses descriptor manager to create bindings and layouts.
 void PBRMaterialSystem::initDescriptorSetLayouts() {
 
    std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-   // create layout for material (0 = color I/S, 1 = metal I/S, 2 = UBO material)
-   VkDescriptorSetLayoutBinding colorSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
-   VkDescriptorSetLayoutBinding metalSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-   VkDescriptorSetLayoutBinding occSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
-   VkDescriptorSetLayoutBinding normalSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3);
-   VkDescriptorSetLayoutBinding transmissionSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4);
-   VkDescriptorSetLayoutBinding thicknessSamplerBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5);
-   VkDescriptorSetLayoutBinding materialBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 6);
-   
-
-   bindings.push_back(colorSamplerBinding);
-   bindings.push_back(metalSamplerBinding);
-   bindings.push_back(occSamplerBinding);
-   bindings.push_back(normalSamplerBinding);
-   bindings.push_back(transmissionSamplerBinding);
-   bindings.push_back(thicknessSamplerBinding);
-   bindings.push_back(materialBinding);
-
-   _descriptorManager->createDescriptorLayout(bindings, _descriptorSetLayoutMat);
+   // bindless set (0 = every texture, 1 = material table). the array is sized for the worst case and only partly
+   // written, slots get filled while frames that never read them are still in flight
+   VkDescriptorSetLayoutBinding texturesBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, BINDLESS_TEXTURES);
+   texturesBinding.descriptorCount = MAX_BINDLESS_TEXTURES;
+   VkDescriptorSetLayoutBinding materialsBinding = _descriptorManager->createLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, BINDLESS_MATERIALS);
+
+   bindings.push_back(texturesBinding);
+   bindings.push_back(materialsBinding);
+
+   std::vector<VkDescriptorBindingFlags> bindingFlags = {
+       VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+       0
+   };
+
+   _descriptorManager->createDescriptorLayout(bindings, _descriptorSetLayoutMat, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, bindingFlags);
 }
 
-VkWriteDescriptorSet PBRMaterialSystem::makeImageWrite(VkDescriptorSet dstSet, uint32_t dstBinding, const TextureBinding& tb, VkDescriptorImageInfo& outInfo) {
+void PBRMaterialSystem::initBindless(VkEngine* engine) {
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = MAX_BINDLESS_TEXTURES;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+    Logger::vkCheck(vkCreateDescriptorPool(engine->device, &poolInfo, nullptr, &_bindlessPool), "failed to create bindless descriptor pool");
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _bindlessPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_descriptorSetLayoutMat;
+    Logger::vkCheck(vkAllocateDescriptorSets(engine->device, &allocInfo, &bindlessSet), "failed to allocate bindless descriptor set");
+
+    // mapped for good, a material is written straight into the copy of whichever frame isn't on the gpu
+    VkDeviceSize tableSize = sizeof(GPUMaterial) * MAX_MATERIALS * MAX_FRAMES_IN_FLIGHT;
+    _materialTable = createBufferVMA(tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine->_allocator);
 
-    outInfo = {};
-    outInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    outInfo.imageView = tb.image.imageView;
-    outInfo.sampler = tb.sampler;
+    VkDescriptorBufferInfo bufInfo{};
+    bufInfo.buffer = _materialTable.buffer;
+    bufInfo.offset = 0;
+    bufInfo.range = tableSize;
 
     VkWriteDescriptorSet w{};
     w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    w.dstSet = dstSet;
-    w.dstBinding = dstBinding;
+    w.dstSet = bindlessSet;
+    w.dstBinding = BINDLESS_MATERIALS;
+    w.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    w.descriptorCount = 1;
+    w.pBufferInfo = &bufInfo;
+    vkUpdateDescriptorSets(engine->device, 1, &w, 0, nullptr);
+}
+
+void PBRMaterialSystem::cleanupBindless(VkDevice device, VmaAllocator allocator) {
+
+    vmaDestroyBuffer(allocator, _materialTable.buffer, _materialTable.allocation);
+    vkDestroyDescriptorPool(device, _bindlessPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, _descriptorSetLayoutMat, nullptr);
+    _textureSlots.clear();
+    _materialCount = 0;
+}
+
+uint32_t PBRMaterialSystem::textureIndex(const TextureBinding& tb, VkEngine* engine) {
+
+    auto key = std::make_pair(tb.image.imageView, tb.sampler);
+    auto it = _textureSlots.find(key);
+    if (it != _textureSlots.end()) return it->second;
+
+    // out of slots, falls back to whatever got slot 0 (the first default image) instead of reading an unwritten one
+    if (_textureSlots.size() >= MAX_BINDLESS_TEXTURES) {
+
+        std::cout << "bindless texture array full (" << MAX_BINDLESS_TEXTURES << "), falling back to slot 0" << std::endl;
+        return 0;
+    }
+
+    // a new pair always lands in a slot nothing has read yet, so no frame in flight can see this write
+    uint32_t slot = static_cast<uint32_t>(_textureSlots.size());
+    _textureSlots.emplace(key, slot);
+
+    VkDescriptorImageInfo info{};
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    info.imageView = tb.image.imageView;
+    info.sampler = tb.sampler;
+
+    VkWriteDescriptorSet w{};
+    w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    w.dstSet = bindlessSet;
+    w.dstBinding = BINDLESS_TEXTURES;
+    w.dstArrayElement = slot;
     w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     w.descriptorCount = 1;
-    w.pImageInfo = &outInfo;
-    return w;
+    w.pImageInfo = &info;
+    vkUpdateDescriptorSets(engine->device, 1, &w, 0, nullptr);
+    return slot;
+}
+
+void PBRMaterialSystem::fillTextures(GPUMaterial& dst, const MaterialResources& resources, VkEngine* engine) {
+
+    dst.textures[SceneCache::SLOT_ALBEDO] = textureIndex(resources.albedo, engine);
+    dst.textures[SceneCache::SLOT_METAL_ROUGH] = textureIndex(resources.metalRough, engine);
+    dst.textures[SceneCache::SLOT_OCCLUSION] = textureIndex(resources.occlusion, engine);
+    dst.textures[SceneCache::SLOT_NORMAL] = textureIndex(resources.normalMap, engine);
+    dst.textures[SceneCache::SLOT_TRANSMISSION] = textureIndex(resources.transmission, engine);
+    dst.textures[SceneCache::SLOT_THICKNESS] = textureIndex(resources.volumeThickness, engine);
 }
 
 MaterialInstance PBRMaterialSystem::writeMaterial(MaterialPass pass, const PBRMaterialSystem::MaterialResources& resources, VkEngine* engine) {
@@ -52,58 +128,36 @@ MaterialInstance PBRMaterialSystem::writeMaterial(MaterialPass pass, const PBRMa
 
     materialData.matPipeline = getPipeline(pass, engine);
 
-    materialData.materialSet.resize(MAX_FRAMES_IN_FLIGHT);
+    if (_materialCount >= MAX_MATERIALS) {
 
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, _descriptorSetLayoutMat);
-
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = _descriptorManager->_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
+        std::cout << "bindless material table full (" << MAX_MATERIALS << "), reusing material 0" << std::endl;
+        materialData.materialIndex = 0;
+        return materialData;
+    }
+    materialData.materialIndex = _materialCount++;
 
-   
-    Logger::vkCheck(vkAllocateDescriptorSets(engine->device, &allocInfo, materialData.materialSet.data()), "failed to allocate descriptor sets pbr pipeline");
+    GPUMaterial gpuMat{};
+    gpuMat.constants = resources.constants;
+    fillTextures(gpuMat, resources, engine);
 
     for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 
-        VkDescriptorBufferInfo bufInfo{};
-        bufInfo.buffer = resources.dataBuffer;
-        bufInfo.offset = resources.dataBufferOffset;
-        bufInfo.range = sizeof(MaterialPBRConstants);
-
-        VkWriteDescriptorSet uboWrite{};
-        uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uboWrite.dstSet = materialData.materialSet[i];
-        uboWrite.dstBinding = UBO_INDEX;                           
-        uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboWrite.descriptorCount = 1;
-        uboWrite.pBufferInfo = &bufInfo;
-
-        std::array<VkDescriptorImageInfo, 6> imgInfos;
-        std::array<VkWriteDescriptorSet, 7>  writes; // 1 UBO + 4 images
-
-        writes[0] = uboWrite;
-        writes[1] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_ALBEDO, resources.albedo, imgInfos[0]);
-        writes[2] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_METAL_ROUGH, resources.metalRough, imgInfos[1]);
-        writes[3] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_OCCLUSION, resources.occlusion, imgInfos[2]);
-        writes[4] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_NORMAL, resources.normalMap, imgInfos[3]);
-        writes[5] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_TRANSMISSION, resources.transmission, imgInfos[4]);
-        writes[6] = makeImageWrite(materialData.materialSet[i], MATERIAL_TEX_THICKNESS, resources.volumeThickness, imgInfos[5]);
-
-        vkUpdateDescriptorSets(engine->device,
-            static_cast<uint32_t>(writes.size()), writes.data(),
-            0, nullptr);
+        *tableEntry(i, materialData.materialIndex) = gpuMat;
     }
 
     return materialData;
 }
+
+void PBRMaterialSystem::writeTextures(uint32_t frame, uint32_t materialIndex, const MaterialResources& resources, VkEngine* engine) {
+
+    fillTextures(*tableEntry(frame, materialIndex), resources, engine);
+}
+
 MaterialPipeline PBRMaterialSystem::getPipeline(MaterialPass pass, VkEngine* engine) {
 
+    // only a snapshot, the permutation may still be compiling. drawing goes through VkEngine::pipelineFor
     MaterialPipeline p;
-    if (pass == MaterialPass::Opaque) p.pipeline = engine->pipelines.opaque;
-    else if (pass == MaterialPass::Transparent) p.pipeline = engine->pipelines.transparent;
-    else if (pass == MaterialPass::Transmission) p.pipeline = engine->pipelines.transparent;
+    p.pipeline = engine->pipelineFor(pass);
     p.layout = engine->pipelines.layout;
     return p;
 }
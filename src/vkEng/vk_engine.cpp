@@ -5,6 +5,8 @@
 #include "imgui.h"
 #include "backends/imgui_impl_vulkan.h"
 #include "vkEng/vk_engine.h"
+#include "Core/Utils/thread_pool.h"
+#include <map>
 
 // Wait for previous frame to finish -> Acquire an image from the swap chain -> Record a command buffer which draws the scene onto that image -> Submit the reocrded command buffer -> Present the swap chain image
 // Semaphores are for GPU synchronization, Fences are for CPU
@@ -12,6 +14,7 @@ void VkEngine::drawFrame() {
 
     // Make CPU wait until the GPU is done.
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    streamSceneFrame();
 
     uint32_t imageIndex;
     // This tells the imageAvailableSemaphore to be signaled when done.
@@ -35,6 +38,9 @@ void VkEngine::drawFrame() {
     // Record draw commands
     recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
+    // whatever got uploaded since the last frame goes out in one submit ahead of it
+    uploader.flush();
+    pipelineCache.retire();
     submitFrame(commandBuffers[currentFrame]);
 
     presentFrame(imageIndex);
@@ -42,14 +48,40 @@ void VkEngine::drawFrame() {
     currentFrame = (currentFrame + 1) % (MAX_FRAMES_IN_FLIGHT);
 }
 
+// runs right after this frame's fence, so anything only this frame could have been using is free to change
+void VkEngine::streamSceneFrame() {
+
+    uploader.retire();
+    for (auto it = _retiredBuffers.begin(); it != _retiredBuffers.end();) {
+
+        if (--it->second == 0) {
+
+            vmaDestroyBuffer(_allocator, it->first.buffer, it->first.allocation);
+            it = _retiredBuffers.erase(it);
+        }
+        else ++it;
+    }
+
+    if (!_scene || !_scene->streaming()) return;
+    if (_scene->pump(ctx, currentFrame)) uploadInstances();
+}
+
 void VkEngine::submitFrame(VkCommandBuffer cmd) {
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    // second wait is the upload timeline, so nothing drawn can read a buffer/image whose copy hasn't landed yet.
+    // the binary semaphore's value is ignored
+    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame], uploader.semaphore() };
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+    uint64_t waitValues[] = { 0, uploader.lastFlushed() };
     VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 
+    VkTimelineSemaphoreSubmitInfo timelineInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineInfo.waitSemaphoreValueCount = 2;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+
     VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 2;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
@@ -101,9 +133,10 @@ void VkEngine::recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex) {
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // the scene comes in as secondaries recorded on the job pool
+    vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    recordScene(cmd);
+    recordScene(cmd, imageIndex);
 
     vkCmdEndRenderPass(cmd);
 
@@ -112,56 +145,211 @@ void VkEngine::recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex) {
     Logger::vkCheck(vkEndCommandBuffer(cmd), "failed to record command buffer");
 }
 
-void VkEngine::bindDraw(RenderObject& obj, VkCommandBuffer cmd) {
+void VkEngine::bindDraw(const RenderObject& obj, SceneRecorder& rec) {
+
+    VkCommandBuffer cmd = rec.cmd;
+
+    // true (and counted) when state differs from what's bound, otherwise counted as skipped
+    auto changed = [&](auto& bound, auto value) {
+
+        if (bound == value) {
+
+            rec.bindsSkipped++;
+            return false;
+        }
+        bound = value;
+        rec.bindsIssued++;
+        return true;
+    };
+
+    VkPipeline pipeline = pipelineFor(obj.material->data.type);
+    if (changed(rec.bound.pipeline, pipeline)) vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    // sets are bound once per slice, the material is just an index into this frame's copy of the table
+    uint32_t material = currentFrame * PBRMaterialSystem::MAX_MATERIALS + obj.materialIndex;
+    if (changed(rec.bound.material, material)) vkCmdPushConstants(cmd, pipelines.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &material);
+
+    // binding 1 (instances) stays bound for the whole slice
+    VkDeviceSize offset = 0;
+    if (changed(rec.bound.vertexBuffer, obj.vertexBuffer)) vkCmdBindVertexBuffers(cmd, 0, 1, &obj.vertexBuffer, &offset);
+
+    // bound from the start of the buffer so surfaces sharing it don't rebind, idxStart goes in firstIndex instead
+    bool indexChanged = changed(rec.bound.indexBuffer, obj.indexBuffer);
+    indexChanged = changed(rec.bound.indexType, obj.indexType) || indexChanged;
+    if (indexChanged) vkCmdBindIndexBuffer(cmd, obj.indexBuffer, 0, obj.indexType);
+
+    if ((!useClusterCulling && !useLods) || !obj.detail) {
+
+        rec.cullStats.trianglesSubmitted += obj.numIndices / 3 * obj.instanceCount;
+        vkCmdDrawIndexed(cmd, obj.numIndices, obj.instanceCount, obj.idxStart, 0, obj.firstInstance);
+        return;
+    }
+
+    // instances pick a lod and cull separately, each surviving run of clusters is one draw.
+    // lower lods sit after idxStart in the same buffer, ranges are absolute
+    bool backface = useClusterCulling && !obj.material->doubleSided;
+    for (uint32_t i = 0; i < obj.instanceCount; i++) {
+
+        uint32_t slot = obj.firstInstance + i;
+        rec.visibleClusters.clear();
+        MeshUtils::cullSurface(*obj.detail, ctx.instances[slot].model, _cullParams, backface, rec.visibleClusters, rec.cullStats);
+
+        for (auto& range : rec.visibleClusters) vkCmdDrawIndexed(cmd, range.count, 1, range.start, 0, slot);
+    }
+}
+
+// passes that go through the blending pipeline (depth writes off), they have to be drawn far to near
+static bool blends(MaterialPass pass) {
 
+    return pass == MaterialPass::Transparent || pass == MaterialPass::Transmission;
+}
+
+VkPipeline VkEngine::pipelineFor(MaterialPass pass) const {
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (blends(pass)) pipeline = pipelines.transparent.load();
+    return pipeline ? pipeline : pipelines.opaque;
+}
+
+static uint32_t passRank(MaterialPass pass) {
+
+    switch (pass) {
+
+    case MaterialPass::Transmission: return 1;
+    case MaterialPass::Transparent: return 2;
+    default: return 0;
+    }
+}
+
+uint64_t VkEngine::drawKey(const RenderObject& obj) {
+
+    // ids are only for grouping, so they just wrap if a scene ever has more than fit
+    auto id = [](auto& ids, auto handle) { return ids.try_emplace(handle, uint32_t(ids.size())).first->second; };
+
+    MaterialPass type = obj.material->data.type;
+    uint64_t pass = passRank(type);
+    uint64_t pipeline = id(_pipelineIds, pipelineFor(type)) & 0x3F;
+    uint64_t material = obj.materialIndex & 0xFFF;
+    uint64_t mesh = id(_meshIds, obj.vertexBuffer) & 0xFFFF;
+
+    // distance to the first instance. a positive float's bits sort the same as its value, the top 24 (after the sign) are plenty
+    glm::vec3 pos = glm::vec3(ctx.instances[obj.firstInstance].model[3]);
+    float dist = glm::length(pos - cullCameraPos);
+    uint32_t distBits;
+    std::memcpy(&distBits, &dist, sizeof(distBits));
+    uint64_t depth = (distBits >> 7) & 0xFFFFFF;
+
+    // | pass 2 | pipeline 6 | material 12 | mesh 16 | depth 24 | (front to back within a state group)
+    if (!blends(type)) return (pass << 62) | (pipeline << 56) | (material << 44) | (mesh << 28) | (depth << 4);
+
+    // | pass 2 | far to near 24 | pipeline 6 | material 12 | mesh 16 | (transmission + transparent, each still its own rank)
+    return (pass << 62) | ((0xFFFFFF - depth) << 38) | (pipeline << 32) | (material << 20) | (mesh << 4);
+}
+
+void VkEngine::sortDraws() {
+
+    _drawOrder.clear();
+    _drawOrder.reserve(ctx.surfaces.size());
+    for (uint32_t i = 0; i < ctx.surfaces.size(); i++) _drawOrder.push_back({ drawKey(ctx.surfaces[i]), i });
+
+    std::sort(_drawOrder.begin(), _drawOrder.end(), [](const SortedDraw& a, const SortedDraw& b) { return a.key < b.key; });
+}
+
+void VkEngine::recordSlice(SceneRecorder& rec, size_t first, size_t last, uint32_t imageIndex) {
+
+    // this frame's fence was waited on before recording started, nothing from the last use of the pool is pending
+    Logger::vkCheck(vkResetCommandPool(device, rec.pool, 0), "failed to reset scene recorder pool");
+
+    VkCommandBufferInheritanceInfo inheritance{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance.renderPass = renderPass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = swapChainFramebuffers[imageIndex];
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    Logger::vkCheck(vkBeginCommandBuffer(rec.cmd, &beginInfo), "failed to begin scene secondary");
+
+    // nothing is inherited from the primary, every slice sets up its own state
+    VkViewport viewport{ 0, 0,
+        (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f };
+    vkCmdSetViewport(rec.cmd, 0, 1, &viewport);
+
+    VkRect2D scissor{ {0,0}, swapChainExtent };
+    vkCmdSetScissor(rec.cmd, 0, 1, &scissor);
+
+    // camera + the bindless textures/materials, once per slice
     VkDescriptorSet sets[] = {
 
             descriptorManager._descriptorSets[currentFrame],
-            obj.materialSet[currentFrame]
+            pbrSystem.bindlessSet
     };
 
-    vkCmdBindDescriptorSets(cmd,
+    vkCmdBindDescriptorSets(rec.cmd,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelines.layout,
         0, 2, sets,
         0, nullptr);
 
-    // push constants
-    vkCmdPushConstants(
-        cmd, pipelines.layout,
-        VK_SHADER_STAGE_VERTEX_BIT,
-        0, sizeof(glm::mat4),
-        &obj.transform);
+    // per instance model matrices, the same buffer for every draw this frame
+    VkDeviceSize instanceOffset = 0;
+    vkCmdBindVertexBuffers(rec.cmd, 1, 1, &ctx.instanceBuffer.buffer, &instanceOffset);
 
-    // vertex/index buffers
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(cmd, 0, 1, &obj.vertexBuffer, &offset);
-    vkCmdBindIndexBuffer(cmd, obj.indexBuffer,
-        obj.idxStart * sizeof(uint32_t),
-        VK_INDEX_TYPE_UINT32);
+    rec.bound = {};
+    rec.bindsIssued = 2;
+    rec.bindsSkipped = 0;
+    rec.cullStats = {};
 
-    vkCmdDrawIndexed(cmd, obj.numIndices, 1, 0, 0, 0);
+    for (size_t i = first; i < last; i++) bindDraw(ctx.surfaces[_drawOrder[i].surface], rec);
+
+    Logger::vkCheck(vkEndCommandBuffer(rec.cmd), "failed to record scene secondary");
 }
 
-void VkEngine::recordScene(VkCommandBuffer cmd) {
+void VkEngine::recordScene(VkCommandBuffer cmd, uint32_t imageIndex) {
 
-    // add a check to see if its the same pipeline as last one later.
-    // also look into sorting opaque materials for performacne later
-    //vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.transparent);
+    auto recordStart = std::chrono::steady_clock::now();
 
-    VkViewport viewport{ 0, 0,
-        (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f };
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    _cullParams.frustum = MeshUtils::extractFrustum(cullViewProj);
+    _cullParams.cameraPos = cullCameraPos;
+    _cullParams.frustumCull = useClusterCulling;
+    _cullParams.coneCull = useClusterCulling;
+    _cullParams.lodSelect = useLods;
+    _cullParams.lodScale = cullProjScale * float(swapChainExtent.height) * 0.5f;
+    _cullParams.lodErrorPixels = lodErrorPixels;
+    _cullParams.forceLod = useLods ? forceLod : 0;
 
-    VkRect2D scissor{ {0,0}, swapChainExtent };
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    sortDraws();
+
+    // contiguous slices of the sorted list, executed in order so transparent draws keep their back to front order
+    std::vector<SceneRecorder>& recorders = sceneRecorders[currentFrame];
+    size_t draws = _drawOrder.size();
+    size_t slices = std::clamp<size_t>((draws + MIN_DRAWS_PER_SLICE - 1) / MIN_DRAWS_PER_SLICE, 1, recorders.size());
+
+    Utils::Jobs::get().parallelFor(slices, [&](size_t i) {
+
+        recordSlice(recorders[i], draws * i / slices, draws * (i + 1) / slices, imageIndex);
+    });
 
-    for (auto& obj : ctx.surfaces) {
+    std::vector<VkCommandBuffer> secondaries;
+    MeshUtils::CullStats cullStats;
+    uint32_t bindsIssued = 0, bindsSkipped = 0;
+    for (size_t i = 0; i < slices; i++) {
 
-        //vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.material->data.matPipeline.pipeline);
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
-        bindDraw(obj, cmd);
+        secondaries.push_back(recorders[i].cmd);
+        cullStats.clustersTested += recorders[i].cullStats.clustersTested;
+        cullStats.clustersCulled += recorders[i].cullStats.clustersCulled;
+        cullStats.trianglesSubmitted += recorders[i].cullStats.trianglesSubmitted;
+        bindsIssued += recorders[i].bindsIssued;
+        bindsSkipped += recorders[i].bindsSkipped;
     }
+    vkCmdExecuteCommands(cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+    editorContext.clustersTested = cullStats.clustersTested;
+    editorContext.clustersCulled = cullStats.clustersCulled;
+    editorContext.trianglesSubmitted = cullStats.trianglesSubmitted;
+    editorContext.bindsIssued = bindsIssued;
+    editorContext.bindsSkipped = bindsSkipped;
+    editorContext.recordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 }
 
 void VkEngine::drawGUI(VkCommandBuffer cb, VkImageView imageView) {
@@ -193,13 +381,35 @@ void VkEngine::drawGUI(VkCommandBuffer cb, VkImageView imageView) {
 
 // Note: May want to add functionality to cleanup and create another render pass as well (ie: moving window to a different monitor)
 
-GPUMeshBuffers VkEngine::uploadMesh(std::vector<uint32_t> indices, std::vector<Vertex> vertices) {
+GPUMeshBuffers VkEngine::uploadMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, bool packed) {
 
-    size_t vbSize = vertices.size() * sizeof(Vertex);
-    size_t idxSize = indices.size() * sizeof(uint32_t);
+    return uploadMesh(indices.data(), indices.size(), vertices.data(), vertices.size(), packed);
+}
+
+// pointer version so the scene cache can copy straight out of the mapped file into staging
+GPUMeshBuffers VkEngine::uploadMesh(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, bool packed) {
+
+    size_t vbSize = vertexCount * sizeof(Vertex);
+    size_t idxSize = indexCount * sizeof(uint32_t);
+    const void* vertexData = vertices;
+    const void* indexData = indices;
 
     GPUMeshBuffers newSurface{};
 
+    MeshUtils::PackedMesh packedMesh;
+    if (packed) {
+
+        MeshUtils::packMesh(indices, indexCount, vertices, vertexCount, packedMesh);
+        vbSize = packedMesh.vertices.size() * sizeof(MeshUtils::PackedVertex);
+        idxSize = packedMesh.indices.size();
+        vertexData = packedMesh.vertices.data();
+        indexData = packedMesh.indices.data();
+
+        newSurface.indexType = packedMesh.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        newSurface.posOffset = packedMesh.posOffset;
+        newSurface.posScale = packedMesh.posScale;
+    }
+
     newSurface.vertexBuffer = createBufferVMA(vbSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
         VMA_MEMORY_USAGE_GPU_ONLY, _allocator);
 
@@ -217,115 +427,115 @@ GPUMeshBuffers VkEngine::uploadMesh(std::vector<uint32_t> indices, std::vector<V
 
     newSurface.indexBuffer = createBufferVMA(idxSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, _allocator);
 
-    // create staging buffer and populate it with vertex/index data 
-    AllocatedBuffer staging = createBufferVMA(vbSize + idxSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, _allocator);
-
-    void* ptr = staging.allocation->GetMappedData();
-    void* data = staging.allocation->GetMappedData();
-
-    memcpy(data, vertices.data(), vbSize);
-    memcpy((char*)data + vbSize, indices.data(), idxSize);
-
-    // transfer buffers to GPU memory using command buffers
-    if (vkResetFences(device, 1, &immFence) != VK_SUCCESS) {
-
-        throw std::runtime_error("failed to reset fence imm");
-    }
-    if ((vkResetCommandBuffer(immCommandBuffer, 0)) != VK_SUCCESS) {
-
-        throw std::runtime_error("failed to reset command buffer imm");
-    }
-
-    // command buffer create info
-    VkCommandBuffer cmd = immCommandBuffer;
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.pNext = nullptr;
-    beginInfo.pInheritanceInfo = nullptr;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    if (vkBeginCommandBuffer(cmd, &beginInfo) != VK_SUCCESS) {
-
-        throw std::runtime_error("failed to begin command buffer imm");
-    }
-
-    // ready to copy buffers to GPU (index buffer is right after vertex buffer)
+    // both copies go into the open upload batch, the frame that first draws this mesh waits on it
+    UploadBatcher::Staging vertexStaging = uploader.stage(vertexData, vbSize);
     VkBufferCopy vertexCopy{ 0 };
+    vertexCopy.srcOffset = vertexStaging.offset;
     vertexCopy.dstOffset = 0;
-    vertexCopy.srcOffset = 0;
     vertexCopy.size = vbSize;
-    vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy); // copies raw bytes from staging buffer (after submit queues of course)
+    vkCmdCopyBuffer(uploader.commands(), vertexStaging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy);
 
+    UploadBatcher::Staging indexStaging = uploader.stage(indexData, idxSize);
     VkBufferCopy indexCopy{ 0 };
+    indexCopy.srcOffset = indexStaging.offset;
     indexCopy.dstOffset = 0;
-    indexCopy.srcOffset = vbSize;
     indexCopy.size = idxSize;
-    vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
-
-    if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
-
-        throw std::runtime_error("failed to end command buffer imm");
-    }
-
-    // submit command buffer to queue for GPU
-    VkCommandBufferSubmitInfo cmdSubmitInfo = {};
-    cmdSubmitInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-    cmdSubmitInfo.pNext = nullptr;
-    cmdSubmitInfo.commandBuffer = cmd;
-    cmdSubmitInfo.deviceMask = 0;
-
-    VkSubmitInfo2 cmdSubmitInfo2 = {};
-    cmdSubmitInfo2.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    cmdSubmitInfo2.pNext = nullptr;
-    cmdSubmitInfo2.waitSemaphoreInfoCount = 0;
-    cmdSubmitInfo2.pWaitSemaphoreInfos = nullptr;
-    cmdSubmitInfo2.signalSemaphoreInfoCount = 0;
-    cmdSubmitInfo2.pSignalSemaphoreInfos = nullptr;
-
-    cmdSubmitInfo2.commandBufferInfoCount = 1;
-    cmdSubmitInfo2.pCommandBufferInfos = &cmdSubmitInfo;
-
-    if (vkQueueSubmit2(graphicsQueue, 1, &cmdSubmitInfo2, immFence) != VK_SUCCESS) {
-
-        throw std::runtime_error("failed to queue submit2 imm");
-    }
-
-    if (vkWaitForFences(device, 1, &immFence, true, 99999999) != VK_SUCCESS) {
-
-        throw std::runtime_error("error waiting for fences imm");
-    }
-    
-    // destroy staging add functionality.
+    vkCmdCopyBuffer(uploader.commands(), indexStaging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
 
     return newSurface;
 }
 
 // gets info from the MeshAsset within MeshNode
-RenderObject MeshNode::createRenderObject(const GeoSurface& surface) {
+RenderObject MeshNode::createRenderObject(const GeoSurface& surface, const glm::mat4& transform) {
 
     // next make it so 
     RenderObject obj;
-    obj.materialSet.resize(MAX_FRAMES_IN_FLIGHT);
     obj.idxStart = surface.startIndex;
     //obj.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress;
     obj.indexBuffer = mesh->meshBuffers.indexBuffer.buffer;
     obj.numIndices = surface.count;
     obj.vertexBuffer = mesh->meshBuffers.vertexBuffer.buffer;
-    obj.transform = mesh->transform;
+    obj.indexType = mesh->meshBuffers.indexType;
+    obj.posOffset = mesh->meshBuffers.posOffset;
+    obj.posScale = mesh->meshBuffers.posScale;
+    obj.transform = transform;
     obj.material = surface.material;
-    obj.materialSet = surface.material->data.materialSet;
+    obj.detail = surface.detail;
+    obj.materialIndex = surface.material->data.materialIndex;
     std::cerr << surface.material->data.type << std::endl;
     return obj;
 }
 
+void MeshNode::pushRenderObjects(DrawContext& ctx) {
+
+    auto push = [&](const glm::mat4& transform) {
+
+        for (auto& surface : mesh->surfaces) {
+
+            ctx.surfaces.push_back(createRenderObject(surface, transform));
+        }
+    };
+
+    if (instanceTransforms.empty()) push(worldTransform);
+    for (auto& transform : instanceTransforms) push(transform);
+}
+
 void MeshNode::Draw(DrawContext& ctx) {
 
-    for (auto& surface : mesh->surfaces) {
+    pushRenderObjects(ctx);
+    Node::Draw(ctx); // draws the children too....
+
+}
+
+// instances go after whatever is already in the list
+static void groupInstances(std::vector<RenderObject>& surfaces, std::vector<InstanceData>& instances) {
 
-        ctx.surfaces.push_back(createRenderObject(surface));
+    // same vertex buffer + index range + material = one draw, kept in order of first appearance
+    using Key = std::tuple<VkBuffer, uint32_t, uint32_t, const gltfMaterial*>;
+    std::map<Key, size_t> slot;
+    std::vector<std::vector<glm::mat4>> transforms;
+    std::vector<RenderObject> grouped;
+
+    for (auto& obj : surfaces) {
+
+        if (obj.material->data.type == MaterialPass::Transparent) {
+
+            grouped.push_back(obj);
+            transforms.push_back({ obj.transform });
+            continue;
+        }
+
+        Key key{ obj.vertexBuffer, obj.idxStart, obj.numIndices, obj.material.get() };
+        auto [it, inserted] = slot.try_emplace(key, grouped.size());
+        if (inserted) {
+
+            grouped.push_back(obj);
+            transforms.emplace_back();
+        }
+        transforms[it->second].push_back(obj.transform);
     }
-    Node::Draw(ctx); // draws the children too....
+    for (size_t i = 0; i < grouped.size(); i++) {
 
+        grouped[i].firstInstance = static_cast<uint32_t>(instances.size());
+        grouped[i].instanceCount = static_cast<uint32_t>(transforms[i].size());
+        for (auto& model : transforms[i]) instances.push_back({ model, grouped[i].posOffset, grouped[i].posScale });
+    }
+    surfaces = std::move(grouped);
+}
+
+void DrawContext::buildInstances() {
+
+    instances.clear();
+    uploadedInstances = 0;
+    groupInstances(surfaces, instances);
+}
+
+void DrawContext::append(DrawContext& batch) {
+
+    // a mesh streams in whole with every node that uses it, so a batch already holds all instances of what it groups
+    groupInstances(batch.surfaces, instances);
+    surfaces.insert(surfaces.end(), std::make_move_iterator(batch.surfaces.begin()), std::make_move_iterator(batch.surfaces.end()));
+    batch.surfaces.clear();
 }
 
 void VkEngine::recreateSwapChain() {
@@ -397,9 +607,20 @@ void VkEngine::cleanupVkObjects() {
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
 
+    uploader.cleanup();
+    pbrSystem.cleanupBindless(device, _allocator);
+    for (auto& recorders : sceneRecorders) {
+
+        for (auto& rec : recorders) vkDestroyCommandPool(device, rec.pool, nullptr);
+    }
     vkDestroyCommandPool(device, commandPool, nullptr);
 
+    // background builds have to land before anything they made (or the cache) goes away
+    pipelineCache.waitIdle();
     vkDestroyPipeline(device, pipelines.opaque, nullptr);
+    vkDestroyPipeline(device, pipelines.transparent, nullptr);
+    vkDestroyPipeline(device, pbrSystem.trPass.pipeline, nullptr);
+    pipelineCache.cleanup();
     vkDestroyPipelineLayout(device, pipelines.layout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -4,6 +4,8 @@
 #include "Renderer/renderer_setup.h"
 #include "vkEng/vk_helper_funcs.h"
 #include "vkEng/Texture/texture_utils.h"
+#include "Core/Utils/thread_pool.h"
+#include "vkEng/Pipeline/pipeline_cache.h"
 #include "VkBootstrap.h"
 #include "vkEng/vk_engine_setup.h"
 #include "backends/imgui_impl_glfw.h"
@@ -11,7 +13,9 @@
 
 void VkEngine::setupEngine() {
 
-    VkUtils::File::compileShader(SHADER_FILE_PATHS_TO_COMPILE);
+    // only what changed since the last run actually compiles, the rest comes out of cache/spirv
+    shaderCompiler.init("cache/spirv");
+    shaderModules = Utils::Jobs::get().submit([this]() { return shaderCompiler.compile(SHADER_SOURCES); });
     VulkanSetup::initVulkan(this);
     initGUI();
     loadGltfFile();
@@ -55,6 +59,12 @@ namespace VulkanSetup {
         features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
         features12.bufferDeviceAddress = true;
         features12.descriptorIndexing = true;
+        // bindless material textures (PBRMaterialSystem)
+        features12.runtimeDescriptorArray = true;
+        features12.descriptorBindingPartiallyBound = true;
+        features12.descriptorBindingSampledImageUpdateAfterBind = true;
+        features12.descriptorBindingUpdateUnusedWhilePending = true;
+        features12.timelineSemaphore = true;
 
         VkPhysicalDeviceFeatures legacyFeatures{};
         legacyFeatures.samplerAnisotropy = VK_TRUE;
@@ -70,6 +80,11 @@ namespace VulkanSetup {
             .select()
             .value();
 
+        // bc formats for the compressed / transcoded gltf textures, the loaders keep rgba8 on devices without them
+        VkPhysicalDeviceFeatures blockFeatures{};
+        blockFeatures.textureCompressionBC = VK_TRUE;
+        engine->supportsBlockCompression = physicalDeviceVkb.enable_features_if_present(blockFeatures);
+
         vkb::DeviceBuilder deviceBuilder{ physicalDeviceVkb };
         vkb::Device vkbDevice = deviceBuilder.build().value();
 
@@ -109,6 +124,10 @@ namespace VulkanSetup {
         uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
         engine->_whiteImage = engine->createImage((void*)&white, VkExtent3D{ 1, 1, 1 }, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, false);
 
+        // tangent space +z, what a missing normal map has to read as now that the shaders rebuild z from xy
+        uint32_t flatNormal = glm::packUnorm4x8(glm::vec4(0.5f, 0.5f, 1, 1));
+        engine->_flatNormalImage = engine->createImage((void*)&flatNormal, VkExtent3D{ 1, 1, 1 }, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, false);
+
         uint32_t black = glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
         engine->_blackImage = engine->createImage((void*)&black, VkExtent3D{ 1, 1, 1 }, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, false);
 
@@ -335,51 +354,38 @@ namespace VulkanSetup {
 
     void createGraphicsPipeline(VkEngine* engine) {
 
-        auto vertShaderCode = VkUtils::File::readFile("shaders/vk/shaderCompilation/vPBR.spv");
-        auto fragShaderCode = VkUtils::File::readFile("shaders/vk/shaderCompilation/fPBR.spv");
-        VkUtils::File::deleteAllExceptCompileBat("shaders/vk/shaderCompilation/Sun-Temple-Vert.spv"); // ihave to do this or else windows defender gets mad ...
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, engine->device);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, engine->device);
+        // rethrows the compiler log if a stage failed
+        std::vector<std::vector<uint32_t>> spirv = engine->shaderModules.get();
 
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
+        // modules go away with the last pipeline desc holding them, background permutations included
+        GraphicsPipelineDesc opaque;
+        opaque.shaders = std::make_shared<const ShaderModules>(engine->device,
+            createShaderModule(spirv[0], engine->device), createShaderModule(spirv[1], engine->device));
+        opaque.packedVertex = engine->usePackedVertices ? VK_TRUE : VK_FALSE;
 
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+        // binding 0 per vertex (float or packed layout), binding 1 per instance model matrix
+        opaque.bindings = {
+            engine->usePackedVertices ? PackedVertexInput::getBindingDescription() : Vertex::getBindingDescription(),
+            InstanceData::getBindingDescription()
+        };
 
-        // Change this for data being per-vertex/per-instance
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        if (engine->usePackedVertices) {
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+            for (auto& a : PackedVertexInput::getAttributeDescriptions()) opaque.attributes.push_back(a);
+        }
+        else {
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+            for (auto& a : Vertex::getAttributeDescriptions()) opaque.attributes.push_back(a);
+        }
+        for (auto& a : InstanceData::getAttributeDescriptions()) opaque.attributes.push_back(a);
 
         // This describes what kind of geometry will be drawn from vertices and if primitive restart should be enabled
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        VkPipelineInputAssemblyStateCreateInfo& inputAssembly = opaque.inputAssembly;
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        VkPipelineRasterizationStateCreateInfo& rasterizer = opaque.rasterizer;
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rasterizer.depthClampEnable = VK_FALSE;
         rasterizer.rasterizerDiscardEnable = VK_FALSE;
@@ -391,17 +397,16 @@ namespace VulkanSetup {
         rasterizer.depthBiasClamp = 0.0f;
         rasterizer.depthBiasSlopeFactor = 0.0f;
 
-        VkPipelineMultisampleStateCreateInfo multisampling{};
+        VkPipelineMultisampleStateCreateInfo& multisampling = opaque.multisampling;
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.sampleShadingEnable = VK_FALSE;
         multisampling.rasterizationSamples = engine->msaaSamples;
-        multisampling.minSampleShading = 1.0f;
         multisampling.pSampleMask = nullptr;
         multisampling.alphaToCoverageEnable = VK_FALSE;
         multisampling.alphaToOneEnable = VK_FALSE;
+        multisampling.sampleShadingEnable = VK_TRUE;
+        multisampling.minSampleShading = .2f;
 
-        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        VkPipelineDepthStencilStateCreateInfo& depthStencil = opaque.depthStencil;
         depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         depthStencil.depthTestEnable = VK_TRUE;
         depthStencil.depthWriteEnable = VK_TRUE;
@@ -410,12 +415,10 @@ namespace VulkanSetup {
         depthStencil.minDepthBounds = 0.0f;
         depthStencil.maxDepthBounds = 1.0f;
         depthStencil.stencilTestEnable = VK_FALSE;
-        multisampling.sampleShadingEnable = VK_TRUE;
-        multisampling.minSampleShading = .2f;
         depthStencil.front = {};
         depthStencil.back = {};
 
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        VkPipelineColorBlendAttachmentState& colorBlendAttachment = opaque.blendAttachment;
         colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
         colorBlendAttachment.blendEnable = VK_FALSE;
         colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
@@ -425,81 +428,53 @@ namespace VulkanSetup {
         colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
         colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
-
         // Viewport/Scissor will be dynamic and set in command buffer
-        std::vector<VkDynamicState> dynamicStates = {
+        opaque.dynamicStates = {
 
             VK_DYNAMIC_STATE_VIEWPORT,
             VK_DYNAMIC_STATE_SCISSOR
         };
 
-        VkPipelineDynamicStateCreateInfo dynamicState{};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-        dynamicState.pDynamicStates = dynamicStates.data();
-
         VkDescriptorSetLayout setLayouts[] = { engine->descriptorManager._descriptorSetLayoutCamera, engine->pbrSystem._descriptorSetLayoutMat };
 
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(glm::mat4);
-
         // This is for uniforms later as well
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = 2;
         pipelineLayoutInfo.pSetLayouts = setLayouts;
+        // model matrix comes in per instance, the push constant is just the material index
+        VkPushConstantRange materialRange{};
+        materialRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        materialRange.offset = 0;
+        materialRange.size = sizeof(uint32_t);
         pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        pipelineLayoutInfo.pPushConstantRanges = &materialRange;
 
         Logger::vkCheck(vkCreatePipelineLayout(engine->device, &pipelineLayoutInfo, nullptr, &engine->pipelines.layout), "failed to create pipeline layout");
 
-        VkGraphicsPipelineCreateInfo opaqueInfo{};
-        opaqueInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        opaqueInfo.stageCount = 2;
-        opaqueInfo.pStages = shaderStages;
-        opaqueInfo.pVertexInputState = &vertexInputInfo;
-        opaqueInfo.pInputAssemblyState = &inputAssembly;
-        opaqueInfo.pViewportState = &viewportState;
-        opaqueInfo.pRasterizationState = &rasterizer;
-        opaqueInfo.pMultisampleState = &multisampling;
-        opaqueInfo.pDepthStencilState = &depthStencil;
-        opaqueInfo.pColorBlendState = &colorBlending;
-        opaqueInfo.pDynamicState = &dynamicState;
-        opaqueInfo.layout = engine->pipelines.layout;
-        opaqueInfo.renderPass = engine->renderPass;
-        opaqueInfo.subpass = 0;
-        opaqueInfo.basePipelineHandle = VK_NULL_HANDLE;
-        opaqueInfo.basePipelineIndex = -1;
-
-        Logger::vkCheck(vkCreateGraphicsPipelines(engine->device, VK_NULL_HANDLE, 1, &opaqueInfo, nullptr, &engine->pipelines.opaque), "failed to create graphics pipeline");
+        opaque.layout = engine->pipelines.layout;
+        opaque.renderPass = engine->renderPass;
+        opaque.subpass = 0;
 
-        // ** above was opaque, this is opaque transmission subpass **
-        // make a new pipeline that is identical to opaque, but uses trPass.renderPass
-        VkGraphicsPipelineCreateInfo trOpaqueInfo = opaqueInfo; 
+        // opaque is the fallback every material draws with until its own permutation is ready, so it's the only one built up front
+        engine->pipelines.opaque = engine->pipelineCache.build(opaque);
 
-        trOpaqueInfo.renderPass = engine->pbrSystem.trPass.renderPass;
-        trOpaqueInfo.subpass = 0;
+        // blend materials (and transmission for now): alpha blended, depth tested but not written. recordScene draws them last, back to front
+        GraphicsPipelineDesc transparent = opaque;
+        transparent.blendAttachment.blendEnable = VK_TRUE;
+        transparent.blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        transparent.blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        transparent.blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        transparent.blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        transparent.depthStencil.depthWriteEnable = VK_FALSE;
+        engine->pipelineCache.buildAsync(std::move(transparent), engine->pipelines.transparent);
 
-        Logger::vkCheck(
-            vkCreateGraphicsPipelines(engine->device, VK_NULL_HANDLE, 1, &trOpaqueInfo, nullptr, &engine->pbrSystem.trPass.pipeline),
-            "failed to create transmission opaque pipeline"
-        );
-
-
-        vkDestroyShaderModule(engine->device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(engine->device, vertShaderModule, nullptr);
+        // ** above was opaque, this is opaque transmission subpass **
+        // make a new pipeline that is identical to opaque, but uses trPass.renderPass
+        GraphicsPipelineDesc trOpaque = opaque;
+        trOpaque.renderPass = engine->pbrSystem.trPass.renderPass;
+        trOpaque.subpass = 0;
+        engine->pipelineCache.buildAsync(std::move(trOpaque), engine->pbrSystem.trPass.pipeline);
     }
 
     void createCommandPool(VkEngine* engine) {
@@ -589,6 +564,7 @@ namespace VulkanSetup {
         engine->descriptorManager.initDescriptorSets();
         engine->descriptorManager.initCameraDescriptor();
         //descriptorManager.writeSamplerDescriptor();
+        engine->pbrSystem.initBindless(engine);
     }
 
     void createCommandBuffers(VkEngine* engine) {
@@ -603,6 +579,28 @@ namespace VulkanSetup {
 
         Logger::vkCheck(vkAllocateCommandBuffers(engine->device, &allocInfo, engine->commandBuffers.data()), "failed to allocate command buffers");
 
+        // scene secondaries, one pool + buffer per recording job per frame. transient since the pools get reset every frame
+        QueueFamilyIndices recorderFamilies = findQueueFamilies(engine->physicalDevice, engine->surface);
+        for (auto& recorders : engine->sceneRecorders) {
+
+            recorders.resize(Utils::Jobs::get().concurrency());
+            for (auto& rec : recorders) {
+
+                VkCommandPoolCreateInfo recorderPoolInfo{};
+                recorderPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                recorderPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                recorderPoolInfo.queueFamilyIndex = recorderFamilies.graphicsFamily.value();
+                Logger::vkCheck(vkCreateCommandPool(engine->device, &recorderPoolInfo, nullptr, &rec.pool), "failed to create scene recorder pool");
+
+                VkCommandBufferAllocateInfo secondaryInfo{};
+                secondaryInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                secondaryInfo.commandPool = rec.pool;
+                secondaryInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                secondaryInfo.commandBufferCount = 1;
+                Logger::vkCheck(vkAllocateCommandBuffers(engine->device, &secondaryInfo, &rec.cmd), "failed to allocate scene secondary");
+            }
+        }
+
         //abstract this pool stuff later
         QueueFamilyIndices queueFamilyIndices = findQueueFamilies(engine->physicalDevice, engine->surface);
         VkCommandPoolCreateInfo poolInfo{};
@@ -666,6 +664,7 @@ namespace VulkanSetup {
         engine->pbrSystem.initTransmissionPass(engine->swapChainExtent.width, engine->swapChainExtent.height, engine->device, engine->_allocator);
 
         createDescriptorSetLayouts(engine);
+        engine->pipelineCache.init(engine->device, engine->physicalDevice, "cache/vk_pipelines.bin");
         createGraphicsPipeline(engine);
         createCommandPool(engine);
         createColorResources(engine);
@@ -675,6 +674,7 @@ namespace VulkanSetup {
         createDescriptorPools(engine);
         createCommandBuffers(engine);
         createSyncObjects(engine);
+        engine->uploader.init(engine);
         initDefaultImages(engine);
         
     }
@@ -732,9 +732,40 @@ void VkEngine::initGUI() {
 }
 
 void VkEngine::loadGltfFile() {
-    std::shared_ptr<gltfData> gltf;
-    //std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/SunTemple/SunTemple.glb");
-    //std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/DragonAttenuation.glb");
-    std::shared_ptr<gltfData> scene = gltfData::Load(this, "assets/Chess.glb");
-    scene->drawNodes(ctx);
+    //_scene = gltfData::Load(this, "assets/SunTemple/SunTemple.glb");
+    //_scene = gltfData::Load(this, "assets/DragonAttenuation.glb");
+    gltfData::LoadSettings settings;
+    settings.packedVertices = usePackedVertices;
+
+    // streamed: first frame goes out right away and the scene fills in over the next ones (streamScene)
+    if (streamScene) {
+
+        _scene = gltfData::LoadAsync(this, "assets/Chess.glb", settings);
+        return;
+    }
+
+    _scene = gltfData::Load(this, "assets/Chess.glb", settings);
+    _scene->drawNodes(ctx);
+    uploadInstances();
+}
+
+// instances only ever get appended, so just the new tail is copied into host visible memory. growing swaps in a bigger
+// buffer and the old one is kept until every frame that could still be reading it has been waited on
+void VkEngine::uploadInstances() {
+
+    size_t count = ctx.instances.size();
+    if (!ctx.instanceBuffer.buffer || count > ctx.instanceCapacity) {
+
+        if (ctx.instanceBuffer.buffer) _retiredBuffers.push_back({ ctx.instanceBuffer, uint32_t(MAX_FRAMES_IN_FLIGHT) });
+
+        ctx.instanceCapacity = std::max({ count, ctx.instanceCapacity * 2, size_t(1) });
+        ctx.instanceBuffer = createBufferVMA(ctx.instanceCapacity * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, _allocator);
+        ctx.uploadedInstances = 0;
+    }
+    if (count > ctx.uploadedInstances) {
+
+        InstanceData* mapped = reinterpret_cast<InstanceData*>(ctx.instanceBuffer.info.pMappedData);
+        std::memcpy(mapped + ctx.uploadedInstances, ctx.instances.data() + ctx.uploadedInstances, (count - ctx.uploadedInstances) * sizeof(InstanceData));
+    }
+    ctx.uploadedInstances = count;
 }
\ No newline at end of file
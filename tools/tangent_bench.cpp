@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "Renderer/Scene/tangents.h"
+#include "Renderer/Scene/gltf_utils.h"
+#include <cctype>
+
+// standalone timing for MeshUtils::generateTangents on real scenes, no window or engine. every mesh with normals and uvs
+// gets its tangents regenerated (shipped ones or not), with and without the job pool, plus the old scalar version as the
+// baseline. builds from this file, src/Renderer/Scene/{tangents,gltf_utils,meshopt_codec}.cpp, src/Core/Utils/thread_pool.cpp
+// and fastgltf, run from the folder that has assets/ in it:
+//   tangent_bench [iterations] [scene.glb ...]
+// without scenes it goes through the ones the engines load
+
+struct BenchVertex {
+
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+	glm::vec4 tangent;
+};
+
+struct BenchMesh {
+
+	std::string name;
+	std::vector<BenchVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshUtils::IndexRange> ranges;
+};
+
+static std::vector<BenchMesh> loadMeshes(const std::filesystem::path& path) {
+
+	std::vector<BenchMesh> out;
+
+	fastgltf::Parser parser{ fastgltf::Extensions::KHR_mesh_quantization | fastgltf::Extensions::EXT_meshopt_compression
+		| fastgltf::Extensions::EXT_mesh_gpu_instancing | fastgltf::Extensions::KHR_texture_basisu
+		| fastgltf::Extensions::KHR_materials_volume | fastgltf::Extensions::KHR_materials_transmission };
+	auto data = fastgltf::GltfDataBuffer::FromPath(path);
+	if (data.error() != fastgltf::Error::None) {
+
+		std::cerr << "can't read " << path << '\n';
+		return out;
+	}
+	auto asset = parser.loadGltf(data.get(), path.parent_path(), fastgltf::Options::LoadExternalBuffers | fastgltf::Options::AllowDouble);
+	if (asset.error() != fastgltf::Error::None) {
+
+		std::cerr << "Failed to load glTF: " << fastgltf::getErrorMessage(asset.error()) << '\n';
+		return out;
+	}
+	fastgltf::Asset& gltf = asset.get();
+	GltfUtils::decompressMeshopt(gltf);
+
+	// same shape as the loaders' decodeMesh: one vertex / index list per mesh, one range per primitive
+	for (fastgltf::Mesh& mesh : gltf.meshes) {
+
+		BenchMesh m;
+		m.name = mesh.name;
+		for (fastgltf::Primitive& p : mesh.primitives) {
+
+			auto position = p.findAttribute("POSITION");
+			auto normal = p.findAttribute("NORMAL");
+			auto uv = p.findAttribute("TEXCOORD_0");
+			if (position == p.attributes.end() || normal == p.attributes.end() || uv == p.attributes.end() || !p.indicesAccessor) continue;
+
+			size_t initial = m.vertices.size();
+			m.vertices.resize(initial + gltf.accessors[position->accessorIndex].count);
+			fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[position->accessorIndex],
+				[&](glm::vec3 v, size_t i) { m.vertices[initial + i].pos = v; });
+			fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[normal->accessorIndex],
+				[&](glm::vec3 v, size_t i) { m.vertices[initial + i].normal = v; });
+			fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[uv->accessorIndex],
+				[&](glm::vec2 v, size_t i) { m.vertices[initial + i].texCoord = v; });
+
+			uint32_t start = uint32_t(m.indices.size());
+			fastgltf::iterateAccessor<uint32_t>(gltf, gltf.accessors[*p.indicesAccessor],
+				[&](uint32_t idx) { m.indices.push_back(uint32_t(idx + initial)); });
+			m.ranges.push_back({ start, uint32_t(m.indices.size()) - start });
+		}
+		if (!m.ranges.empty()) out.push_back(std::move(m));
+	}
+	return out;
+}
+
+// serial and pooled runs have to come out bit for bit the same, that's the whole point of the gather
+static bool identical(const BenchMesh& mesh) {
+
+	std::vector<BenchVertex> serial = mesh.vertices, parallel = mesh.vertices;
+	MeshUtils::TangentSettings settings;
+	settings.parallel = false;
+	MeshUtils::generateTangents(mesh.indices, serial, mesh.ranges, settings);
+	MeshUtils::generateTangents(mesh.indices, parallel, mesh.ranges);
+	return std::memcmp(serial.data(), parallel.data(), serial.size() * sizeof(BenchVertex)) == 0;
+}
+
+int main(int argc, char** argv) {
+
+	uint32_t iterations = 5;
+	std::vector<std::filesystem::path> scenes;
+	for (int i = 1; i < argc; i++) {
+
+		if (i == 1 && std::isdigit(static_cast<unsigned char>(argv[i][0]))) iterations = uint32_t(std::stoul(argv[i]));
+		else scenes.push_back(argv[i]);
+	}
+	if (scenes.empty()) scenes = { "assets/Chess_Edit.glb", "assets/Chess.glb", "assets/DragonAttenuation.glb", "assets/Duck.glb", "assets/SunTemple/SunTemple.glb" };
+
+	std::cout << "job pool: " << Utils::Jobs::get().concurrency() << " threads, best of " << iterations << '\n';
+	std::cout << std::fixed << std::setprecision(3);
+
+	for (const std::filesystem::path& path : scenes) {
+
+		if (!std::filesystem::exists(path)) {
+
+			std::cout << path.string() << ": missing, skipped\n";
+			continue;
+		}
+
+		std::vector<BenchMesh> meshes = loadMeshes(path);
+		MeshUtils::TangentBenchmark total;
+		size_t triangles = 0, vertices = 0, mismatched = 0;
+		for (const BenchMesh& mesh : meshes) {
+
+			MeshUtils::TangentBenchmark bench = MeshUtils::benchmarkTangents(mesh.indices, mesh.vertices, mesh.ranges, iterations);
+			total.referenceMs += bench.referenceMs;
+			total.serialMs += bench.serialMs;
+			total.parallelMs += bench.parallelMs;
+			total.maxDifference = std::max(total.maxDifference, bench.maxDifference);
+			triangles += mesh.indices.size() / 3;
+			vertices += mesh.vertices.size();
+			if (!identical(mesh)) mismatched++;
+		}
+
+		std::cout << path.string() << ": " << meshes.size() << " meshes, " << triangles << " tris, " << vertices << " verts\n"
+			<< "  scalar baseline " << total.referenceMs << " ms\n"
+			<< "  serial          " << total.serialMs << " ms\n"
+			<< "  parallel        " << total.parallelMs << " ms (" << (total.parallelMs > 0.0 ? total.serialMs / total.parallelMs : 0.0) << "x serial)\n"
+			<< "  max diff vs baseline " << total.maxDifference << ", serial / parallel mismatches " << mismatched << '\n';
+	}
+	return 0;
+}